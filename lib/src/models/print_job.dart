@@ -0,0 +1,20 @@
+import 'package:thermal_printer_flutter/src/models/printer.dart';
+
+/// Um trabalho enviado com `writeBatch`, com as mesmas opções de `printBytes`
+class PrintJob {
+  final Printer printer;
+  final List<int> bytes;
+  final int copies;
+  final String? jobKey;
+  final bool barrier;
+  final bool optimize;
+
+  PrintJob({
+    required this.printer,
+    required this.bytes,
+    this.copies = 1,
+    this.jobKey,
+    this.barrier = false,
+    this.optimize = false,
+  });
+}
@@ -10,6 +10,7 @@ class Printer {
   final String usbAddress;
   final PrinterType type;
   final bool isConnected;
+  final String model;
 
   Printer({
     required this.type,
@@ -19,6 +20,7 @@ class Printer {
     this.bleAddress = '',
     this.usbAddress = '',
     this.isConnected = false,
+    this.model = '',
   });
 
   Printer copyWith({
@@ -29,6 +31,7 @@ class Printer {
     String? usbAddress,
     PrinterType? type,
     bool? isConnected,
+    String? model,
   }) {
     return Printer(
       name: name ?? this.name,
@@ -38,6 +41,7 @@ class Printer {
       usbAddress: usbAddress ?? this.usbAddress,
       type: type ?? this.type,
       isConnected: isConnected ?? this.isConnected,
+      model: model ?? this.model,
     );
   }
 
@@ -50,6 +54,7 @@ class Printer {
       'usbAddress': usbAddress,
       'type': type.name,
       'isConnected': isConnected,
+      'model': model,
     };
   }
 
@@ -62,6 +67,7 @@ class Printer {
       usbAddress: map['usbAddress'] ?? '',
       type: PrinterType.values.byName(map['type']),
       isConnected: map['isConnected'] ?? false,
+      model: map['model'] ?? '',
     );
   }
 
@@ -73,11 +79,11 @@ class Printer {
   bool operator ==(Object other) {
     if (identical(this, other)) return true;
 
-    return other is Printer && other.name == name && other.ip == ip && other.port == port && other.bleAddress == bleAddress && other.usbAddress == usbAddress && other.type == type && other.isConnected == isConnected;
+    return other is Printer && other.name == name && other.ip == ip && other.port == port && other.bleAddress == bleAddress && other.usbAddress == usbAddress && other.type == type && other.isConnected == isConnected && other.model == model;
   }
 
   @override
   int get hashCode {
-    return name.hashCode ^ ip.hashCode ^ port.hashCode ^ bleAddress.hashCode ^ usbAddress.hashCode ^ type.hashCode ^ isConnected.hashCode;
+    return name.hashCode ^ ip.hashCode ^ port.hashCode ^ bleAddress.hashCode ^ usbAddress.hashCode ^ type.hashCode ^ isConnected.hashCode ^ model.hashCode;
   }
 }
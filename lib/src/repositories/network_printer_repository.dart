@@ -1,10 +1,38 @@
 import 'dart:developer';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
 import 'package:thermal_printer_flutter/thermal_printer_flutter.dart';
 import 'package:thermal_printer_flutter/src/network_printer.dart';
 import 'printer_repository.dart';
 
 class NetworkPrinterRepository implements PrinterRepository {
   final Map<String, NetworkPrinter> _networkPrinters = {};
+  // Conexões abertas por [warmUp] que ainda não terminaram
+  final Map<String, Future<bool>> _warmingUp = {};
+  final MethodChannel _channel = const MethodChannel('thermal_printer_flutter');
+
+  /// No Linux, impressoras LPD (porta 515) passam pela fila nativa, que fala
+  /// RFC 1179 e mantém uma sessão aberta entre trabalhos seguidos
+  bool _usesNativeLpd(Printer printer) => Platform.isLinux && printer.port == '515';
+
+  /// Se [printBytes] envia os trabalhos simples de [printer] por uma conexão
+  /// mantida aqui, e não pela fila nativa
+  bool printsInDart(Printer printer) => printer.type == PrinterType.network && !_usesNativeLpd(printer);
+
+  /// Chave sob a qual a conexão de [printer] é guardada
+  String connectionKey(Printer printer) => '${printer.ip}:${printer.port}';
+
+  /// Conecta [printer] antes do primeiro trabalho, se ainda não estiver
+  /// conectada, para que [printBytes] já encontre a conexão aberta
+  Future<bool> warmUp(Printer printer) {
+    final key = connectionKey(printer);
+    final networkPrinter = _networkPrinters[key];
+    if (networkPrinter != null && networkPrinter.isConnected) {
+      return Future.value(true);
+    }
+    return _warmingUp.putIfAbsent(key, () => connect(printer).whenComplete(() => _warmingUp.remove(key)));
+  }
 
   @override
   Future<List<Printer>> getPrinters() async {
@@ -92,9 +120,38 @@ class NetworkPrinterRepository implements PrinterRepository {
   }
 
   @override
-  Future<void> printBytes({required List<int> bytes, required Printer printer}) async {
+  Future<void> printBytes({required List<int> bytes, required Printer printer, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) async {
     try {
-      final key = '${printer.ip}:${printer.port}';
+      // Só a fila nativa retoma um trabalho, ignora um jobKey repetido ou
+      // mede uma barreira
+      final lpd = _usesNativeLpd(printer);
+      if (lpd || ((jobKey != null || barrier) && Platform.isLinux)) {
+        final bool result = await _channel.invokeMethod<bool>(
+              'writebytes',
+              <String, dynamic>{
+                'bytes': bytes is Uint8List ? bytes : Uint8List.fromList(bytes),
+                'ip': printer.ip,
+                'port': printer.port,
+                'protocol': lpd ? 'lpd' : 'raw',
+                if (optimize) 'optimize': true,
+                if (copies > 1) 'copies': copies,
+                if (jobKey != null) 'jobKey': jobKey,
+                if (barrier) 'barrier': true,
+              },
+            ) ??
+            false;
+        if (!result) {
+          throw Exception('Failed to print to network printer');
+        }
+        return;
+      }
+
+      final key = connectionKey(printer);
+      // Um aquecimento em andamento abre a conexão que este trabalho vai usar
+      final warmingUp = _warmingUp[key];
+      if (warmingUp != null) {
+        await warmingUp;
+      }
       NetworkPrinter? networkPrinter = _networkPrinters[key];
 
       // Se não há conexão ativa, tenta conectar
@@ -106,7 +163,10 @@ class NetworkPrinterRepository implements PrinterRepository {
         networkPrinter = _networkPrinters[key]!;
       }
 
-      final success = await networkPrinter.printBytes(bytes, disconnectAfterPrint: false);
+      var success = true;
+      for (var copy = 0; copy < copies && success; copy++) {
+        success = await networkPrinter.printBytes(bytes, disconnectAfterPrint: false);
+      }
 
       if (!success) {
         log('Failed to print via network', name: 'THERMAL_PRINTER_FLUTTER');
@@ -1,4 +1,5 @@
 import 'dart:developer';
+import 'dart:typed_data';
 import 'package:flutter/services.dart';
 import 'package:thermal_printer_flutter/thermal_printer_flutter.dart';
 import 'printer_repository.dart';
@@ -17,6 +18,7 @@ class UsbPrinterRepository implements PrinterRepository {
                 name: device['name'] ?? '',
                 usbAddress: device['usbAddress'] ?? '',
                 isConnected: device['isConnected'] ?? false,
+                model: device['model'] ?? '',
               );
             }
             return Printer(
@@ -42,13 +44,18 @@ class UsbPrinterRepository implements PrinterRepository {
   }
 
   @override
-  Future<void> printBytes({required List<int> bytes, required Printer printer}) async {
+  Future<void> printBytes({required List<int> bytes, required Printer printer, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) async {
     try {
       final bool result = await _channel.invokeMethod<bool>(
             'writebytes',
             <String, dynamic>{
-              'bytes': bytes,
+              'bytes': bytes is Uint8List ? bytes : Uint8List.fromList(bytes),
               'printerName': printer.name,
+              'usbAddress': printer.usbAddress,
+              if (optimize) 'optimize': true,
+              if (copies > 1) 'copies': copies,
+              if (jobKey != null) 'jobKey': jobKey,
+              if (barrier) 'barrier': true,
             },
           ) ??
           false;
@@ -62,12 +69,33 @@ class UsbPrinterRepository implements PrinterRepository {
     }
   }
 
+  Future<bool> configureSerialPort(Printer printer, {int? baudRate, String? flowControl}) async {
+    try {
+      return await _channel.invokeMethod<bool>(
+            'configureSerial',
+            <String, dynamic>{
+              'printerName': printer.name,
+              'usbAddress': printer.usbAddress,
+              if (baudRate != null) 'baudRate': baudRate,
+              if (flowControl != null) 'flowControl': flowControl,
+            },
+          ) ??
+          false;
+    } catch (e) {
+      log('Error configuring serial port: $e', name: 'THERMAL_PRINTER_FLUTTER');
+      return false;
+    }
+  }
+
   @override
   Future<bool> isConnected(Printer printer) async {
     try {
       final bool result = await _channel.invokeMethod<bool>(
             'isConnected',
-            printer.usbAddress,
+            <String, dynamic>{
+              'printerName': printer.name,
+              'usbAddress': printer.usbAddress,
+            },
           ) ??
           false;
       return result;
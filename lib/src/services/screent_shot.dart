@@ -63,8 +63,8 @@ class ThermalScreenshot {
 
         // Conversão direta para imagem monocromática
         final monoImage = useBetterText
-            ? _convertTextOptimizedMonochrome(rgbaBytes, image.width, image.height, newWidth, threshold)
-            : _convertRgbaToMonochromeFast(rgbaBytes, image.width, image.height, newWidth, threshold);
+            ? _convertTextOptimizedMonochrome(rgbaBytes, image.width, image.height, newWidth, threshold, flipHorizontal)
+            : _convertRgbaToMonochromeFast(rgbaBytes, image.width, image.height, newWidth, threshold, flipHorizontal);
 
         image.dispose();
         log('Screen shot time: ${stopwatch.elapsedMilliseconds}ms', name: 'THERMAL_PRINTER_FLUTTER');
@@ -95,17 +95,25 @@ class ThermalScreenshot {
   }
 
   // Conversão direta de RGBA para monocromático com dithering
-  static img.Image _convertTextOptimizedMonochrome(Uint8List rgbaBytes, int srcWidth, int srcHeight, int dstWidth, int threshold) {
+  // O espelhamento só troca a coluna de origem, sem custo extra por pixel
+  static img.Image _convertTextOptimizedMonochrome(Uint8List rgbaBytes, int srcWidth, int srcHeight, int dstWidth, int threshold, bool flipHorizontal) {
     final dstHeight = (srcHeight * (dstWidth / srcWidth)).toInt();
     final monoImage = img.Image(width: dstWidth, height: dstHeight);
 
     // Configurações específicas para texto
     final enhancedThreshold = (threshold * 0.9).toInt(); // Threshold mais baixo para texto
 
+    // Coluna de origem de cada coluna de destino, calculada uma vez por
+    // imagem em vez de uma divisão a cada pixel
+    final srcColumns = Int32List(dstWidth);
+    for (int x = 0; x < dstWidth; x++) {
+      srcColumns[x] = ((flipHorizontal ? dstWidth - 1 - x : x) * srcWidth / dstWidth).toInt();
+    }
+
     for (int y = 0; y < dstHeight; y++) {
       final srcY = (y * srcHeight / dstHeight).toInt();
       for (int x = 0; x < dstWidth; x++) {
-        final srcX = (x * srcWidth / dstWidth).toInt();
+        final srcX = srcColumns[x];
         final pixelOffset = (srcY * srcWidth + srcX) * 4;
 
         // Detecta bordas de texto (alta variação de cor)
@@ -154,15 +162,21 @@ class ThermalScreenshot {
   }
 
   // Versão ultrarrápida sem dithering
-  static img.Image _convertRgbaToMonochromeFast(Uint8List rgbaBytes, int srcWidth, int srcHeight, int dstWidth, int threshold) {
+  static img.Image _convertRgbaToMonochromeFast(Uint8List rgbaBytes, int srcWidth, int srcHeight, int dstWidth, int threshold, bool flipHorizontal) {
     final scale = dstWidth / srcWidth;
     final dstHeight = (srcHeight * scale).toInt();
     final monoImage = img.Image(width: dstWidth, height: dstHeight);
 
+    // Como acima: as colunas de origem são calculadas uma vez por imagem
+    final srcColumns = Int32List(dstWidth);
+    for (int x = 0; x < dstWidth; x++) {
+      srcColumns[x] = ((flipHorizontal ? dstWidth - 1 - x : x) / scale).toInt().clamp(0, srcWidth - 1);
+    }
+
     for (int y = 0; y < dstHeight; y++) {
       final srcY = (y / scale).toInt().clamp(0, srcHeight - 1);
       for (int x = 0; x < dstWidth; x++) {
-        final srcX = (x / scale).toInt().clamp(0, srcWidth - 1);
+        final srcX = srcColumns[x];
         final pixelOffset = (srcY * srcWidth + srcX) * 4;
 
         if (rgbaBytes[pixelOffset + 3] < 200) {
@@ -1,3 +1,5 @@
+import 'dart:typed_data';
+
 import 'package:flutter/cupertino.dart';
 import 'package:thermal_printer_flutter/src/enums/printer_type.dart';
 import 'package:thermal_printer_flutter/src/models/printer.dart';
@@ -5,6 +7,7 @@ import 'package:thermal_printer_flutter/src/services/screent_shot.dart';
 import 'package:thermal_printer_flutter/src/repositories/network_printer_repository.dart';
 import 'thermal_printer_flutter_platform_interface.dart';
 export './src/models/printer.dart';
+export './src/models/print_job.dart';
 export './src/enums/printer_type.dart';
 export './src/services/screent_shot.dart';
 import 'package:image/image.dart' as img;
@@ -53,9 +56,46 @@ class ThermalPrinterFlutter implements ThermalPrinterFlutterPlatform {
     return await _networkRepository.discoverNetworkPrinters(onProgress: onProgress);
   }
 
+  /// Imprime [bytes] ESC/POS
+  ///
+  /// Com [optimize], o plugin nativo (Linux) remove mudanças de modo
+  /// redundantes e junta avanços de linha antes de enviar. [copies] imprime
+  /// várias vias enviando o trabalho uma só vez quando a impressora
+  /// suporta macros (`GS :`/`GS ^`)
+  ///
+  /// [jobKey] identifica o trabalho na fila nativa (Linux): reenviar a mesma
+  /// chave não imprime de novo, e um trabalho que falhou no meio continua
+  /// do último comando que a impressora recebeu. As chaves das últimas 1024
+  /// impressões ficam no diário da fila e valem também depois de reiniciar
+  /// o app
+  ///
+  /// Com [barrier] (Linux), a fila envia `GS r 1` depois do trabalho e mede
+  /// quando a impressora responde, isto é, quando terminou de processá-lo.
+  /// Veja [getPrinterLatency]
+  ///
+  /// No Linux, se a fila já guarda o limite de memória (64 MiB), o trabalho
+  /// é recusado com um [PlatformException] de código `queue_full`: espere a
+  /// fila esvaziar e envie de novo. Um [Uint8List] é enviado sem cópia
+  ///
+  /// Com o daemon, se ele recebeu o trabalho mas não confirmou, o erro tem
+  /// código `daemon_unconfirmed`: o trabalho ainda pode sair, então não é
+  /// reenfileirado no app
+  @override
+  Future<void> printBytes({required List<int> bytes, required Printer printer, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) async {
+    return await ThermalPrinterFlutterPlatform.instance
+        .printBytes(bytes: bytes, printer: printer, optimize: optimize, copies: copies, jobKey: jobKey, barrier: barrier);
+  }
+
+  /// Envia vários trabalhos numa só chamada ao código nativo (Linux)
+  ///
+  /// Os trabalhos vão num envelope binário, decodificado de uma vez e
+  /// colocado na fila nativa em ordem. Retorna o id de cada trabalho na
+  /// fila, ou 0 para os que não entraram: se um trabalho passaria do limite
+  /// de memória, ele e os seguintes são recusados, e podem ser enviados de
+  /// novo a partir do primeiro 0 quando a fila esvaziar
   @override
-  Future<void> printBytes({required List<int> bytes, required Printer printer}) async {
-    return await ThermalPrinterFlutterPlatform.instance.printBytes(bytes: bytes, printer: printer);
+  Future<List<int>> writeBatch({required List<PrintJob> jobs}) async {
+    return await ThermalPrinterFlutterPlatform.instance.writeBatch(jobs: jobs);
   }
 
   @override
@@ -68,11 +108,283 @@ class ThermalPrinterFlutter implements ThermalPrinterFlutterPlatform {
     await ThermalPrinterFlutterPlatform.instance.disconnect(printer: printer);
   }
 
+  /// Se a impressora está conectada
+  ///
+  /// No Linux, impressoras USB e seriais respondem pelo estado que o plugin
+  /// mantém (veja [watchPrinter]): só a primeira consulta chega ao código
+  /// nativo
   @override
   Future<bool> isConnected({required Printer printer}) async {
     return await ThermalPrinterFlutterPlatform.instance.isConnected(printer: printer);
   }
 
+  /// Configura uma porta serial (RS-232 ou adaptador USB-serial) no Linux
+  ///
+  /// As portas `/dev/ttyS*`, `/dev/ttyUSB*` e `/dev/ttyACM*` aparecem em
+  /// `getPrinters(printerType: PrinterType.usb)` junto com as impressoras USB.
+  ///
+  /// [baudRate] - 1200 a 921600, ou 0 para detectar automaticamente
+  /// [flowControl] - 'none', 'rtscts' ou 'xonxoff'
+  @override
+  Future<bool> configureSerialPort({required Printer printer, int? baudRate, String? flowControl}) async {
+    return await ThermalPrinterFlutterPlatform.instance.configureSerialPort(printer: printer, baudRate: baudRate, flowControl: flowControl);
+  }
+
+  /// Imprime uma imagem PNG ou JPEG sem decodificá-la no Dart (Linux)
+  ///
+  /// A decodificação, o redimensionamento, o dithering e a conversão para
+  /// raster acontecem no plugin nativo, linha a linha.
+  ///
+  /// [width] - largura em pontos (padrão: a da imagem, até 576)
+  /// [threshold] - luminância (0-255) abaixo da qual o ponto é impresso
+  /// [dither] - usa Floyd-Steinberg em vez de limiar simples
+  /// [rotation] - giro no sentido horário: 0, 90, 180 ou 270 graus. Com 90
+  /// ou 270 a altura da imagem passa a ocupar a largura do papel, útil para
+  /// etiquetas em paisagem e tabelas largas
+  /// [mirror] - espelha a impressão da esquerda para a direita
+  /// [copies] - número de vias (1 a 255); a imagem é codificada uma só vez
+  @override
+  Future<bool> printImage({
+    required Uint8List imageBytes,
+    required Printer printer,
+    int? width,
+    int? threshold,
+    bool dither = true,
+    int rotation = 0,
+    bool mirror = false,
+    int copies = 1,
+  }) async {
+    return await ThermalPrinterFlutterPlatform.instance.printImage(
+        imageBytes: imageBytes,
+        printer: printer,
+        width: width,
+        threshold: threshold,
+        dither: dither,
+        rotation: rotation,
+        mirror: mirror,
+        copies: copies);
+  }
+
+  /// Imprime um arquivo sem carregá-lo na memória do Dart (Linux)
+  ///
+  /// O plugin mapeia o arquivo com `mmap` e o envia à impressora em faixas,
+  /// então o uso de memória depende do tamanho da faixa e não do arquivo.
+  /// O arquivo precisa continuar no lugar até ser impresso.
+  ///
+  /// [format] - 'escpos' (comandos prontos), 'bitmap' (linhas de 1 bit por
+  /// ponto, com [bitmapWidth] pontos de largura) ou 'image' (PNG/JPEG)
+  /// [width], [threshold], [dither], [rotation] e [mirror] - como em
+  /// [printImage]
+  @override
+  Future<bool> printFile({
+    required String path,
+    required Printer printer,
+    String format = 'escpos',
+    int? bitmapWidth,
+    int? width,
+    int? threshold,
+    bool dither = true,
+    int rotation = 0,
+    bool mirror = false,
+  }) async {
+    return await ThermalPrinterFlutterPlatform.instance.printFile(
+        path: path, printer: printer, format: format, bitmapWidth: bitmapWidth, width: width, threshold: threshold, dither: dither,
+        rotation: rotation, mirror: mirror);
+  }
+
+  /// Imprime um QR Code gerado no plugin nativo (Linux)
+  ///
+  /// Não depende do suporte da impressora a `GS ( k` nem da captura de
+  /// widgets: o código vira raster direto, e códigos repetidos (PIX, URL da
+  /// loja) saem de um cache.
+  ///
+  /// [errorCorrection] - nível de correção: 'L', 'M', 'Q' ou 'H'
+  /// [moduleSize] - pontos por módulo; reduzido se o código não couber no papel
+  @override
+  Future<bool> printQrCode({
+    required String data,
+    required Printer printer,
+    String errorCorrection = 'M',
+    int moduleSize = 6,
+  }) async {
+    return await ThermalPrinterFlutterPlatform.instance
+        .printQrCode(data: data, printer: printer, errorCorrection: errorCorrection, moduleSize: moduleSize);
+  }
+
+  /// Imprime um código de barras gerado no plugin nativo (Linux)
+  ///
+  /// [type] - 'code128', 'ean13' ou 'ean8'. Para EAN o dígito verificador
+  /// pode ser omitido; se informado, precisa estar correto
+  /// [moduleWidth] - largura da barra mais fina, em pontos
+  /// [height] - altura das barras, em pontos
+  @override
+  Future<bool> printBarcode({
+    required String data,
+    required Printer printer,
+    String type = 'code128',
+    int moduleWidth = 2,
+    int height = 80,
+  }) async {
+    return await ThermalPrinterFlutterPlatform.instance
+        .printBarcode(data: data, printer: printer, type: type, moduleWidth: moduleWidth, height: height);
+  }
+
+  /// Agrupa impressões pequenas e consecutivas em uma única escrita (Linux)
+  ///
+  /// Com [enabled], trabalhos enviados para a mesma impressora dentro de
+  /// [window] são juntados até somarem [maxBytes], economizando uma ida e
+  /// volta ao dispositivo por trabalho.
+  @override
+  Future<bool> setCoalescing({required bool enabled, Duration? window, int? maxBytes}) async {
+    return await ThermalPrinterFlutterPlatform.instance.setCoalescing(enabled: enabled, window: window, maxBytes: maxBytes);
+  }
+
+  /// Envia imediatamente os trabalhos retidos pelo agrupamento
+  ///
+  /// Sem [printer], todas as impressoras são descarregadas.
+  @override
+  Future<bool> flush({Printer? printer}) async {
+    return await ThermalPrinterFlutterPlatform.instance.flush(printer: printer);
+  }
+
+  /// Estatísticas da fila nativa (Linux), incluindo `coalescedWrites`,
+  /// `coalescedJobs`, o reaproveitamento de faixas de imagem
+  /// (`rasterBands`/`rasterBandsReused`, `lastJobBands`/`lastJobBandsReused`)
+  /// o efeito do otimizador (`optimizedBytesIn`/`optimizedBytesOut`), as
+  /// vias impressas por macro ou reenviadas (`macroCopies`/`resentCopies`),
+  /// os bytes reenviados ou pulados ao retomar trabalhos
+  /// (`resentBytes`/`resumedBytes`) e os envios repetidos de um mesmo
+  /// [printBytes] `jobKey` (`deduplicatedJobs`) e os trabalhos de grupo
+  /// movidos para outra impressora após uma falha (`failedOverJobs`), os
+  /// bytes na fila e os trabalhos recusados por falta de memória
+  /// (`queuedBytes`/`rejectedJobs`) e os buffers alocados ou reaproveitados
+  /// (`bufferAllocations`/`bufferReuses`)
+  @override
+  Future<Map<String, int>> getQueueStats() async {
+    return await ThermalPrinterFlutterPlatform.instance.getQueueStats();
+  }
+
+  /// Perfil da impressora identificado pelo plugin (Linux)
+  ///
+  /// O perfil é resolvido antes do primeiro trabalho, pelo ID IEEE 1284 ou
+  /// pela resposta ao `GS I`, e define a largura do papel (`paperWidth`), a
+  /// altura das faixas de imagem (`bandHeight`) e o uso de macros
+  /// (`macros`). Até lá, `resolved` é `false` e o perfil é o genérico.
+  /// `chunkSize` e `chunkPacingMicros` são o tamanho dos blocos e o
+  /// intervalo entre eles aprendidos ao imprimir (0 enquanto não aprendidos).
+  @override
+  Future<Map<String, dynamic>> getPrinterProfile({required Printer printer}) async {
+    return await ThermalPrinterFlutterPlatform.instance.getPrinterProfile(printer: printer);
+  }
+
+  /// Latência dos trabalhos enviados com `barrier` (Linux)
+  ///
+  /// `handoff` mede do envio até os bytes serem entregues ao sistema e
+  /// `completion` até a impressora responder ao `GS r 1`, cada um com
+  /// `samples`, `meanMs`, `p50Ms`, `p90Ms`, `p99Ms`, `maxMs` e `buckets`
+  /// (contagens em faixas de potências de 2 ms). `unanswered` conta as
+  /// barreiras sem resposta, `unsupported` as que não foram enviadas porque
+  /// a conexão não as comporta (filas LPD, conexões só de escrita) e
+  /// `lastCompletionMs` é a hora da última resposta em milissegundos desde
+  /// 1970.
+  @override
+  Future<Map<String, dynamic>> getPrinterLatency({required Printer printer}) async {
+    return await ThermalPrinterFlutterPlatform.instance.getPrinterLatency(printer: printer);
+  }
+
+  /// Define um grupo de impressoras iguais (Linux)
+  ///
+  /// Trabalhos enviados ao grupo com [printGroupBytes] vão para a impressora
+  /// que deve terminá-los primeiro, pelos bytes na fila e pela velocidade
+  /// medida. Se uma impressora falhar, seus trabalhos passam para as outras.
+  /// Uma lista vazia remove o grupo.
+  @override
+  Future<bool> setPrinterGroup({required String group, required List<Printer> printers}) async {
+    return await ThermalPrinterFlutterPlatform.instance.setPrinterGroup(group: group, printers: printers);
+  }
+
+  /// Imprime bytes em um grupo definido com [setPrinterGroup] (Linux)
+  ///
+  /// Os parâmetros são os mesmos de [printBytes].
+  @override
+  Future<bool> printGroupBytes({required List<int> bytes, required String group, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) async {
+    return await ThermalPrinterFlutterPlatform.instance
+        .printGroupBytes(bytes: bytes, group: group, optimize: optimize, copies: copies, jobKey: jobKey, barrier: barrier);
+  }
+
+  /// Uso de cada impressora de um grupo (Linux): bytes na fila
+  /// (`queuedBytes`), velocidade medida (`bytesPerSecond`), fração do tempo
+  /// imprimindo (`utilization`), trabalhos recebidos (`routedJobs`) e
+  /// repassados (`failedOverJobs`) e se está fora do ar (`offline`)
+  @override
+  Future<List<Map<String, dynamic>>> getPrinterGroupStats({required String group}) async {
+    return await ThermalPrinterFlutterPlatform.instance.getPrinterGroupStats(group: group);
+  }
+
+  /// Passa a acompanhar o estado da impressora (Linux)
+  ///
+  /// A fila nativa consulta a impressora (`DLE EOT 1` e `DLE EOT 4`) a cada
+  /// 2 segundos enquanto ela não imprime, além de observar como terminam
+  /// os trabalhos, e envia as mudanças por [printerStatusChanges]. Retorna o
+  /// estado atual: `printer` (a chave da fila), `connected`, `online`,
+  /// `paper` (`present`, `nearEnd`, `out` ou `unknown`) e `ready` (conectada
+  /// e identificada; veja [warmUp])
+  @override
+  Future<Map<String, dynamic>> watchPrinter({required Printer printer}) async {
+    return await ThermalPrinterFlutterPlatform.instance.watchPrinter(printer: printer);
+  }
+
+  /// Último estado recebido de uma impressora acompanhada com
+  /// [watchPrinter], ou `null`. Não usa o canal nativo, então pode ser lido
+  /// a cada quadro
+  @override
+  Map<String, dynamic>? printerStatus({required Printer printer}) {
+    return ThermalPrinterFlutterPlatform.instance.printerStatus(printer: printer);
+  }
+
+  /// Mudanças de estado das impressoras acompanhadas com [watchPrinter]
+  @override
+  Stream<Map<String, dynamic>> get printerStatusChanges => ThermalPrinterFlutterPlatform.instance.printerStatusChanges;
+
+  /// Grava em [path] o registro dos últimos eventos da fila nativa (Linux)
+  ///
+  /// O arquivo está no formato de trace do Chrome e abre no Perfetto
+  /// (ui.perfetto.dev) ou em chrome://tracing: cada trabalho, da fila até a
+  /// impressão, as escritas com seus bytes, reconexões e respostas de
+  /// status. Com o daemon, é ele quem grava o arquivo. Retorna se o arquivo
+  /// foi gravado.
+  @override
+  Future<bool> dumpTrace({required String path}) async {
+    return await ThermalPrinterFlutterPlatform.instance.dumpTrace(path: path);
+  }
+
+  /// Grava o trace em [path] sozinho quando um trabalho levar mais que
+  /// [threshold], no máximo uma vez por minuto (Linux)
+  ///
+  /// `Duration.zero` desliga.
+  @override
+  Future<bool> setTraceThreshold({required Duration threshold, required String path}) async {
+    return await ThermalPrinterFlutterPlatform.instance.setTraceThreshold(threshold: threshold, path: path);
+  }
+
+  /// Prepara as impressoras antes do primeiro trabalho (Linux e Windows)
+  ///
+  /// Em segundo plano, abre a conexão com cada impressora de [printers]
+  /// (todas as USB e seriais encontradas, ou no Windows todas as
+  /// instaladas, se omitido). No Linux, também lê o ID do dispositivo,
+  /// consulta o estado e carrega as imagens de [images] (os caminhos
+  /// absolutos que serão passados a [printFile]) no cache de raster; no
+  /// Windows, abre a impressora no spooler e guarda o handle para o
+  /// primeiro trabalho. Impressoras de rede são conectadas na mesma
+  /// conexão que [printBytes] usa. Chame ao abrir o app. Retorna as chaves
+  /// das impressoras; no Linux, e para impressoras de rede, cada uma chega
+  /// por [printerStatusChanges] com `ready` verdadeiro quando o primeiro
+  /// trabalho não precisar mais esperar a conexão.
+  @override
+  Future<List<String>> warmUp({List<Printer>? printers, List<String> images = const []}) async {
+    return await ThermalPrinterFlutterPlatform.instance.warmUp(printers: printers, images: images);
+  }
+
   Future<img.Image> screenShotWidget(
     BuildContext context, {
     required Widget widget,
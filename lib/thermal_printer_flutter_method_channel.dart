@@ -1,5 +1,7 @@
 import 'dart:async';
+import 'dart:convert';
 import 'dart:io';
+import 'dart:typed_data';
 import 'package:flutter/services.dart';
 import 'package:thermal_printer_flutter/thermal_printer_flutter.dart';
 import 'package:thermal_printer_flutter/src/repositories/bluetooth_printer_repository.dart';
@@ -10,6 +12,16 @@ import 'thermal_printer_flutter_platform_interface.dart';
 /// An implementation of [ThermalPrinterFlutterPlatform] that uses method channels.
 class MethodChannelThermalPrinterFlutter implements ThermalPrinterFlutterPlatform {
   final MethodChannel _channel = const MethodChannel('thermal_printer_flutter');
+  final EventChannel _statusChannel = const EventChannel('thermal_printer_flutter/status');
+  final StreamController<Map<String, dynamic>> _statusChanges = StreamController<Map<String, dynamic>>.broadcast();
+  StreamSubscription<dynamic>? _statusSubscription;
+  // Último estado de cada impressora acompanhada, pela chave da fila nativa
+  final Map<String, Map<String, dynamic>> _statuses = {};
+  // Chave da fila nativa de cada impressora acompanhada
+  final Map<String, String> _statusKeys = {};
+  // Como em linux/core/job_batch.h
+  static const int _batchMagic = 0x42465054;
+  static const int _maxBatchJobs = 4096;
   final BluetoothPrinterRepository _bluetoothRepository = BluetoothPrinterRepository();
   final UsbPrinterRepository _usbRepository = UsbPrinterRepository();
   final NetworkPrinterRepository _networkRepository = NetworkPrinterRepository();
@@ -75,23 +87,91 @@ class MethodChannelThermalPrinterFlutter implements ThermalPrinterFlutterPlatfor
   }
 
   @override
-  Future<void> printBytes({required List<int> bytes, required Printer printer}) async {
+  Future<void> printBytes({required List<int> bytes, required Printer printer, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) async {
     switch (printer.type) {
       case PrinterType.usb:
-        await _usbRepository.printBytes(bytes: bytes, printer: printer);
+        // Só o plugin do Linux imprime as vias por conta própria
+        final nativeCopies = Platform.isLinux ? copies : 1;
+        for (var sent = 0; sent < copies; sent += nativeCopies) {
+          await _usbRepository.printBytes(bytes: bytes, printer: printer, optimize: optimize, copies: nativeCopies, jobKey: jobKey, barrier: barrier);
+        }
         break;
       case PrinterType.bluethoot:
         if (Platform.isWindows) {
           throw UnimplementedError('Bluetooth printing is not supported on Windows');
         }
-        await _bluetoothRepository.printBytes(bytes: bytes, printer: printer);
+        for (var copy = 0; copy < copies; copy++) {
+          await _bluetoothRepository.printBytes(bytes: bytes, printer: printer);
+        }
         break;
       case PrinterType.network:
-        await _networkRepository.printBytes(bytes: bytes, printer: printer);
+        await _networkRepository.printBytes(bytes: bytes, printer: printer, optimize: optimize, copies: copies, jobKey: jobKey, barrier: barrier);
         break;
     }
   }
 
+  @override
+  Future<List<int>> writeBatch({required List<PrintJob> jobs}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Batch printing is only supported on Linux');
+    }
+    final ids = <int>[];
+    for (var start = 0; start < jobs.length; start += _maxBatchJobs) {
+      final end = start + _maxBatchJobs < jobs.length ? start + _maxBatchJobs : jobs.length;
+      ids.addAll(await _writeBatch(jobs.sublist(start, end)));
+    }
+    return ids;
+  }
+
+  Future<List<int>> _writeBatch(List<PrintJob> jobs) async {
+    // Cada impressora vai uma vez; os trabalhos apontam para ela pelo índice
+    final printers = <Map<String, dynamic>>[];
+    final printerIndexes = <String, int>{};
+    final indexes = <int>[];
+    final keys = <List<int>>[];
+    var size = 8;
+    for (final job in jobs) {
+      if (job.printer.type == PrinterType.bluethoot) {
+        throw UnimplementedError('Bluetooth printers cannot be batched');
+      }
+      if (job.copies < 1 || job.copies > 255) {
+        throw ArgumentError.value(job.copies, 'copies', 'must be between 1 and 255');
+      }
+      final key = utf8.encode(job.jobKey ?? '');
+      if (key.length > 255) {
+        throw ArgumentError.value(job.jobKey, 'jobKey', 'must be at most 255 bytes');
+      }
+      indexes.add(printerIndexes.putIfAbsent(_printerIdentity(job.printer), () {
+        printers.add(_nativePrinterArguments(job.printer));
+        return printers.length - 1;
+      }));
+      keys.add(key);
+      size += 9 + key.length + job.bytes.length;
+    }
+    final envelope = Uint8List(size);
+    final data = ByteData.sublistView(envelope);
+    data.setUint32(0, _batchMagic, Endian.little);
+    data.setUint32(4, jobs.length, Endian.little);
+    var offset = 8;
+    for (var i = 0; i < jobs.length; i++) {
+      final job = jobs[i];
+      data.setUint16(offset, indexes[i], Endian.little);
+      envelope[offset + 2] = (job.barrier ? 1 : 0) | (job.optimize ? 2 : 0);
+      envelope[offset + 3] = job.copies;
+      envelope[offset + 4] = keys[i].length;
+      envelope.setAll(offset + 5, keys[i]);
+      offset += 5 + keys[i].length;
+      data.setUint32(offset, job.bytes.length, Endian.little);
+      envelope.setAll(offset + 4, job.bytes);
+      offset += 4 + job.bytes.length;
+    }
+    final List<dynamic>? ids = await _channel.invokeMethod<List<dynamic>>(
+      'writeBatch',
+      <String, dynamic>{'printers': printers, 'jobs': envelope},
+    );
+    return ids?.cast<int>() ?? List<int>.filled(jobs.length, 0);
+  }
+
   @override
   Future<bool> connect({required Printer printer}) async {
     switch (printer.type) {
@@ -125,6 +205,238 @@ class MethodChannelThermalPrinterFlutter implements ThermalPrinterFlutterPlatfor
     }
   }
 
+  @override
+  Future<bool> configureSerialPort({required Printer printer, int? baudRate, String? flowControl}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Serial printers are only supported on Linux');
+    }
+    return _usbRepository.configureSerialPort(printer, baudRate: baudRate, flowControl: flowControl);
+  }
+
+  /// Identifica [printer] para a fila nativa do mesmo jeito que `writebytes`
+  Map<String, dynamic> _nativePrinterArguments(Printer printer) {
+    if (printer.type == PrinterType.network) {
+      return <String, dynamic>{'ip': printer.ip, 'port': printer.port};
+    }
+    return <String, dynamic>{'printerName': printer.name, 'usbAddress': printer.usbAddress};
+  }
+
+  @override
+  Future<bool> printImage({
+    required Uint8List imageBytes,
+    required Printer printer,
+    int? width,
+    int? threshold,
+    bool dither = true,
+    int rotation = 0,
+    bool mirror = false,
+    int copies = 1,
+  }) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Native image printing is only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'printImage',
+          <String, dynamic>{
+            ..._nativePrinterArguments(printer),
+            'image': imageBytes,
+            if (width != null) 'width': width,
+            if (threshold != null) 'threshold': threshold,
+            'dither': dither,
+            'rotation': rotation,
+            'mirror': mirror,
+            if (copies > 1) 'copies': copies,
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<bool> printFile({
+    required String path,
+    required Printer printer,
+    String format = 'escpos',
+    int? bitmapWidth,
+    int? width,
+    int? threshold,
+    bool dither = true,
+    int rotation = 0,
+    bool mirror = false,
+  }) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Printing from files is only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'printFile',
+          <String, dynamic>{
+            ..._nativePrinterArguments(printer),
+            'path': path,
+            'format': format,
+            if (bitmapWidth != null) 'bitmapWidth': bitmapWidth,
+            if (width != null) 'width': width,
+            if (threshold != null) 'threshold': threshold,
+            'dither': dither,
+            'rotation': rotation,
+            'mirror': mirror,
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<bool> printQrCode({
+    required String data,
+    required Printer printer,
+    String errorCorrection = 'M',
+    int moduleSize = 6,
+  }) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Native QR codes are only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'printSymbol',
+          <String, dynamic>{
+            ..._nativePrinterArguments(printer),
+            'type': 'qr',
+            'data': data,
+            'ecc': errorCorrection,
+            'moduleSize': moduleSize,
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<bool> printBarcode({
+    required String data,
+    required Printer printer,
+    String type = 'code128',
+    int moduleWidth = 2,
+    int height = 80,
+  }) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Native barcodes are only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'printSymbol',
+          <String, dynamic>{
+            ..._nativePrinterArguments(printer),
+            'type': type,
+            'data': data,
+            'moduleSize': moduleWidth,
+            'height': height,
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<bool> setCoalescing({required bool enabled, Duration? window, int? maxBytes}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Job coalescing is only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'setCoalescing',
+          <String, dynamic>{
+            'enabled': enabled,
+            if (window != null) 'windowMs': window.inMilliseconds,
+            if (maxBytes != null) 'maxBytes': maxBytes,
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<bool> flush({Printer? printer}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Job coalescing is only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'flush',
+          printer != null ? _nativePrinterArguments(printer) : <String, dynamic>{},
+        ) ??
+        false;
+  }
+
+  @override
+  Future<Map<String, int>> getQueueStats() async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Queue statistics are only supported on Linux');
+    }
+    final Map<dynamic, dynamic>? stats = await _channel.invokeMethod<Map<dynamic, dynamic>>('queueStats');
+    return stats?.map((key, value) => MapEntry(key as String, value as int)) ?? {};
+  }
+
+  @override
+  Future<Map<String, dynamic>> getPrinterProfile({required Printer printer}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Printer profiles are only supported on Linux');
+    }
+    final Map<dynamic, dynamic>? profile = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'printerProfile',
+      _nativePrinterArguments(printer),
+    );
+    return profile?.map((key, value) => MapEntry(key as String, value)) ?? {};
+  }
+
+  @override
+  Future<Map<String, dynamic>> getPrinterLatency({required Printer printer}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Print latency is only measured on Linux');
+    }
+    final Map<dynamic, dynamic>? latency = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'printerLatency',
+      _nativePrinterArguments(printer),
+    );
+    return latency?.map((key, value) => MapEntry(key as String, value)) ?? {};
+  }
+
+  @override
+  Future<bool> setPrinterGroup({required String group, required List<Printer> printers}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Printer groups are only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'setPrinterGroup',
+          <String, dynamic>{
+            'group': group,
+            'printers': printers.map(_nativePrinterArguments).toList(),
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<bool> printGroupBytes({required List<int> bytes, required String group, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Printer groups are only supported on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'writebytes',
+          <String, dynamic>{
+            'bytes': bytes is Uint8List ? bytes : Uint8List.fromList(bytes),
+            'group': group,
+            if (optimize) 'optimize': true,
+            if (copies > 1) 'copies': copies,
+            if (jobKey != null) 'jobKey': jobKey,
+            if (barrier) 'barrier': true,
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<List<Map<String, dynamic>>> getPrinterGroupStats({required String group}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Printer groups are only supported on Linux');
+    }
+    final List<dynamic>? members = await _channel.invokeMethod<List<dynamic>>(
+      'printerGroupStats',
+      <String, dynamic>{'group': group},
+    );
+    return members?.map((member) => (member as Map<dynamic, dynamic>).map((key, value) => MapEntry(key as String, value))).toList() ?? [];
+  }
+
   @override
   Future<bool> isConnected({required Printer printer}) async {
     switch (printer.type) {
@@ -134,9 +446,137 @@ class MethodChannelThermalPrinterFlutter implements ThermalPrinterFlutterPlatfor
         }
         return _bluetoothRepository.isConnected(printer);
       case PrinterType.usb:
+        if (Platform.isLinux) {
+          final status = printerStatus(printer: printer) ?? await watchPrinter(printer: printer);
+          return status['connected'] == true;
+        }
         return _usbRepository.isConnected(printer);
       case PrinterType.network:
         return _networkRepository.isConnected(printer);
     }
   }
+
+  void _listenForStatuses() {
+    _statusSubscription ??= _statusChannel.receiveBroadcastStream().listen((event) {
+      for (final change in event as List<dynamic>) {
+        final status = (change as Map<dynamic, dynamic>).map((key, value) => MapEntry(key as String, value));
+        _statuses[status['printer'] as String] = status;
+        _statusChanges.add(status);
+      }
+    });
+  }
+
+  String _printerIdentity(Printer printer) => '${printer.type.name}|${printer.name}|${printer.usbAddress}|${printer.ip}|${printer.port}';
+
+  @override
+  Future<Map<String, dynamic>> watchPrinter({required Printer printer}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Printer status is only pushed on Linux');
+    }
+    _listenForStatuses();
+    final Map<dynamic, dynamic>? result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
+      'watchPrinter',
+      _nativePrinterArguments(printer),
+    );
+    final status = result?.map((key, value) => MapEntry(key as String, value)) ?? <String, dynamic>{};
+    final key = status['printer'] as String;
+    _statusKeys[_printerIdentity(printer)] = key;
+    // Uma mudança que chegou pelo canal de eventos é mais recente
+    return _statuses.putIfAbsent(key, () => status);
+  }
+
+  @override
+  Map<String, dynamic>? printerStatus({required Printer printer}) {
+    final key = _statusKeys[_printerIdentity(printer)];
+    return key == null ? null : _statuses[key];
+  }
+
+  @override
+  Stream<Map<String, dynamic>> get printerStatusChanges => _statusChanges.stream;
+
+  @override
+  Future<bool> dumpTrace({required String path}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Print traces are only recorded on Linux');
+    }
+    return await _channel.invokeMethod<bool>('dumpTrace', <String, dynamic>{'path': path}) ?? false;
+  }
+
+  @override
+  Future<bool> setTraceThreshold({required Duration threshold, required String path}) async {
+    if (!Platform.isLinux) {
+      throw UnimplementedError('Print traces are only recorded on Linux');
+    }
+    return await _channel.invokeMethod<bool>(
+          'setTraceThreshold',
+          <String, dynamic>{
+            'thresholdMs': threshold.inMilliseconds,
+            'path': path,
+          },
+        ) ??
+        false;
+  }
+
+  @override
+  Future<List<String>> warmUp({List<Printer>? printers, List<String> images = const []}) async {
+    if (!Platform.isLinux && !Platform.isWindows) {
+      throw UnimplementedError('Warming printers up is only supported on Linux and Windows');
+    }
+    // As impressoras de rede que o Dart imprime direto são conectadas aqui,
+    // na conexão que printBytes vai usar; as demais, pela fila nativa
+    final nativePrinters = printers?.where((printer) => !_networkRepository.printsInDart(printer)).toList();
+    var nativeKeys = <String>[];
+    if (nativePrinters == null || nativePrinters.isNotEmpty) {
+      if (Platform.isLinux) {
+        _listenForStatuses();
+      }
+      final List<dynamic>? keys = await _channel.invokeMethod<List<dynamic>>(
+        'warmUp',
+        <String, dynamic>{
+          if (nativePrinters != null) 'printers': nativePrinters.map(_nativePrinterArguments).toList(),
+          // As printFile envia por padrão, para que as faixas em cache sejam as
+          // que o primeiro trabalho vai pedir
+          'files': images
+              .map((path) => <String, dynamic>{
+                    'path': path,
+                    'format': 'image',
+                    'dither': true,
+                    'rotation': 0,
+                    'mirror': false,
+                  })
+              .toList(),
+        },
+      );
+      nativeKeys = keys?.cast<String>() ?? <String>[];
+    }
+    if (printers == null) {
+      return nativeKeys;
+    }
+    final result = <String>[];
+    var native = 0;
+    for (final printer in printers) {
+      final String key;
+      if (_networkRepository.printsInDart(printer)) {
+        key = _networkRepository.connectionKey(printer);
+        _networkRepository.warmUp(printer).then((ready) {
+          final status = <String, dynamic>{
+            'printer': key,
+            'connected': ready,
+            'online': ready,
+            'paper': 'unknown',
+            'ready': ready,
+          };
+          _statuses[key] = status;
+          _statusChanges.add(status);
+        });
+      } else if (native < nativeKeys.length) {
+        key = nativeKeys[native++];
+      } else {
+        continue;
+      }
+      _statusKeys[_printerIdentity(printer)] = key;
+      result.add(key);
+    }
+    return result;
+  }
 }
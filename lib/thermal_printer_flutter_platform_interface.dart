@@ -1,3 +1,5 @@
+import 'dart:typed_data';
+
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 import 'package:thermal_printer_flutter/thermal_printer_flutter.dart';
 import 'thermal_printer_flutter_method_channel.dart';
@@ -43,10 +45,14 @@ abstract class ThermalPrinterFlutterPlatform extends PlatformInterface {
     throw UnimplementedError('getPrinters() has not been implemented.');
   }
 
-  Future<void> printBytes({required List<int> bytes, required Printer printer}) {
+  Future<void> printBytes({required List<int> bytes, required Printer printer, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) {
     throw UnimplementedError('printBytes() has not been implemented.');
   }
 
+  Future<List<int>> writeBatch({required List<PrintJob> jobs}) {
+    throw UnimplementedError('writeBatch() has not been implemented.');
+  }
+
   Future<bool> connect({required Printer printer}) {
     throw UnimplementedError('connect() has not been implemented.');
   }
@@ -58,4 +64,110 @@ abstract class ThermalPrinterFlutterPlatform extends PlatformInterface {
   Future<bool> isConnected({required Printer printer}) {
     throw UnimplementedError('isConnected() has not been implemented.');
   }
+
+  Future<bool> configureSerialPort({required Printer printer, int? baudRate, String? flowControl}) {
+    throw UnimplementedError('configureSerialPort() has not been implemented.');
+  }
+
+  Future<bool> printImage({
+    required Uint8List imageBytes,
+    required Printer printer,
+    int? width,
+    int? threshold,
+    bool dither = true,
+    int rotation = 0,
+    bool mirror = false,
+    int copies = 1,
+  }) {
+    throw UnimplementedError('printImage() has not been implemented.');
+  }
+
+  Future<bool> printFile({
+    required String path,
+    required Printer printer,
+    String format = 'escpos',
+    int? bitmapWidth,
+    int? width,
+    int? threshold,
+    bool dither = true,
+    int rotation = 0,
+    bool mirror = false,
+  }) {
+    throw UnimplementedError('printFile() has not been implemented.');
+  }
+
+  Future<bool> printQrCode({
+    required String data,
+    required Printer printer,
+    String errorCorrection = 'M',
+    int moduleSize = 6,
+  }) {
+    throw UnimplementedError('printQrCode() has not been implemented.');
+  }
+
+  Future<bool> printBarcode({
+    required String data,
+    required Printer printer,
+    String type = 'code128',
+    int moduleWidth = 2,
+    int height = 80,
+  }) {
+    throw UnimplementedError('printBarcode() has not been implemented.');
+  }
+
+  Future<bool> setCoalescing({required bool enabled, Duration? window, int? maxBytes}) {
+    throw UnimplementedError('setCoalescing() has not been implemented.');
+  }
+
+  Future<bool> flush({Printer? printer}) {
+    throw UnimplementedError('flush() has not been implemented.');
+  }
+
+  Future<Map<String, int>> getQueueStats() {
+    throw UnimplementedError('getQueueStats() has not been implemented.');
+  }
+
+  Future<Map<String, dynamic>> getPrinterProfile({required Printer printer}) {
+    throw UnimplementedError('getPrinterProfile() has not been implemented.');
+  }
+
+  Future<Map<String, dynamic>> getPrinterLatency({required Printer printer}) {
+    throw UnimplementedError('getPrinterLatency() has not been implemented.');
+  }
+
+  Future<bool> setPrinterGroup({required String group, required List<Printer> printers}) {
+    throw UnimplementedError('setPrinterGroup() has not been implemented.');
+  }
+
+  Future<bool> printGroupBytes({required List<int> bytes, required String group, bool optimize = false, int copies = 1, String? jobKey, bool barrier = false}) {
+    throw UnimplementedError('printGroupBytes() has not been implemented.');
+  }
+
+  Future<List<Map<String, dynamic>>> getPrinterGroupStats({required String group}) {
+    throw UnimplementedError('getPrinterGroupStats() has not been implemented.');
+  }
+
+  Future<Map<String, dynamic>> watchPrinter({required Printer printer}) {
+    throw UnimplementedError('watchPrinter() has not been implemented.');
+  }
+
+  Map<String, dynamic>? printerStatus({required Printer printer}) {
+    throw UnimplementedError('printerStatus() has not been implemented.');
+  }
+
+  Stream<Map<String, dynamic>> get printerStatusChanges {
+    throw UnimplementedError('printerStatusChanges has not been implemented.');
+  }
+
+  Future<bool> dumpTrace({required String path}) {
+    throw UnimplementedError('dumpTrace() has not been implemented.');
+  }
+
+  Future<bool> setTraceThreshold({required Duration threshold, required String path}) {
+    throw UnimplementedError('setTraceThreshold() has not been implemented.');
+  }
+
+  Future<List<String>> warmUp({List<Printer>? printers, List<String> images = const []}) {
+    throw UnimplementedError('warmUp() has not been implemented.');
+  }
 }
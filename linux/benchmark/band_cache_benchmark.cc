@@ -0,0 +1,65 @@
+#include <cstdint>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/band_cache.h"
+#include "core/raster_encoder.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+// An 80 mm receipt: a logo and header, the items, then a fixed footer.
+constexpr int kWidth = 576;
+constexpr int kHeaderRows = 512;
+constexpr int kItemRows = 384;
+constexpr int kFooterRows = 512;
+constexpr int kHeight = kHeaderRows + kItemRows + kFooterRows;
+constexpr int kReceipts = 50;
+
+uint8_t ReceiptPixel(int receipt, int x, int y) {
+  if (y >= kHeaderRows && y < kHeaderRows + kItemRows) {
+    return static_cast<uint8_t>((x * 7 + y * 13 + receipt * 101) & 0xFF);
+  }
+  return static_cast<uint8_t>((x * x + y * 3) & 0xFF);
+}
+
+double EncodeReceipts(BandCache* cache) {
+  std::vector<uint8_t> row(kWidth);
+  size_t bytes = 0;
+  Stopwatch encode;
+  for (int receipt = 0; receipt < kReceipts; receipt++) {
+    RasterEncoder encoder(kWidth, kHeight, RasterOptions(),
+                          [&bytes](const uint8_t* data, size_t length) {
+                            bytes += length;
+                            return data != nullptr;
+                          });
+    encoder.SetBandCache(cache);
+    for (int y = 0; y < kHeight; y++) {
+      for (int x = 0; x < kWidth; x++) {
+        row[x] = ReceiptPixel(receipt, x, y);
+      }
+      encoder.PushRow(row.data(), 1);
+    }
+    encoder.Finish();
+  }
+  return encode.ElapsedMillis();
+}
+
+}  // namespace
+
+TPF_BENCHMARK(BandCacheReceipts) {
+  double uncached = EncodeReceipts(nullptr);
+  ReportMetric("receipts (no band cache)", kReceipts / (uncached / 1000.0),
+               "receipts/s");
+  BandCache cache;
+  double cached = EncodeReceipts(&cache);
+  ReportMetric("receipts (band cache)", kReceipts / (cached / 1000.0),
+               "receipts/s");
+  BandCacheStats stats = cache.stats();
+  ReportMetric("bands reused", 100.0 * stats.reused / stats.bands, "%");
+}
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
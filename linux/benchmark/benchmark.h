@@ -0,0 +1,52 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_BENCHMARK_BENCHMARK_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_BENCHMARK_BENCHMARK_H_
+
+#include <chrono>
+#include <string>
+
+// A deliberately tiny harness: benchmarks register themselves with
+// TPF_BENCHMARK, run once each and print their own metrics through
+// ReportMetric(). Pass substrings on the command line to run a subset.
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+using BenchmarkFunction = void (*)();
+
+struct BenchmarkRegistration {
+  BenchmarkRegistration(const char* name, BenchmarkFunction function);
+};
+
+void ReportMetric(const std::string& metric, double value, const char* unit);
+
+// Creates a scratch directory that is removed when the process exits.
+std::string ScratchDirectory();
+
+class Stopwatch {
+ public:
+  Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+  void Restart() { start_ = std::chrono::steady_clock::now(); }
+
+  double ElapsedMicros() const {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start_)
+        .count();
+  }
+
+  double ElapsedMillis() const { return ElapsedMicros() / 1000.0; }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
+
+#define TPF_BENCHMARK(name)                                            \
+  static void name();                                                  \
+  static ::thermal_printer_flutter::benchmark::BenchmarkRegistration  \
+      name##_registration(#name, name);                                \
+  static void name()
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_BENCHMARK_BENCHMARK_H_
@@ -0,0 +1,76 @@
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+std::vector<std::pair<const char*, BenchmarkFunction>>& Registry() {
+  static std::vector<std::pair<const char*, BenchmarkFunction>> registry;
+  return registry;
+}
+
+const char* current_benchmark = "";
+std::string scratch_directory;
+
+int RemoveEntry(const char* path, const struct stat*, int, struct FTW*) {
+  return remove(path);
+}
+
+void RemoveScratchDirectory() {
+  if (!scratch_directory.empty()) {
+    nftw(scratch_directory.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+  }
+}
+
+}  // namespace
+
+BenchmarkRegistration::BenchmarkRegistration(const char* name,
+                                             BenchmarkFunction function) {
+  Registry().emplace_back(name, function);
+}
+
+void ReportMetric(const std::string& metric, double value, const char* unit) {
+  printf("%-40s %-34s %14.3f %s\n", current_benchmark, metric.c_str(), value,
+         unit);
+  fflush(stdout);
+}
+
+std::string ScratchDirectory() {
+  if (scratch_directory.empty()) {
+    char dir_template[] = "/tmp/tpf_benchmark_XXXXXX";
+    if (mkdtemp(dir_template) == nullptr) {
+      perror("mkdtemp");
+      exit(1);
+    }
+    scratch_directory = dir_template;
+    atexit(RemoveScratchDirectory);
+  }
+  return scratch_directory;
+}
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
+
+int main(int argc, char** argv) {
+  using thermal_printer_flutter::benchmark::Registry;
+  for (const auto& entry : Registry()) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc && !selected; i++) {
+      selected = std::string(entry.first).find(argv[i]) != std::string::npos;
+    }
+    if (selected) {
+      thermal_printer_flutter::benchmark::current_benchmark = entry.first;
+      entry.second();
+    }
+  }
+  return 0;
+}
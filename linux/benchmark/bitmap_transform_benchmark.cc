@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/bitmap_transform.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+// A long landscape label: 3000 dots (about 37 cm at 203 dpi) turned to run
+// across 80 mm paper.
+constexpr int kWidth = 3000;
+constexpr int kHeight = 576;
+constexpr int kRuns = 20;
+
+std::vector<uint8_t> Label() {
+  std::vector<uint8_t> bitmap(PackedStride(kWidth) * kHeight);
+  for (size_t i = 0; i < bitmap.size(); i++) {
+    bitmap[i] = static_cast<uint8_t>(i * 131 + (i >> 7));
+  }
+  return bitmap;
+}
+
+// What the Dart side did: one dot at a time.
+void RotateByDot(const std::vector<uint8_t>& src, std::vector<uint8_t>* dst) {
+  const size_t src_stride = PackedStride(kWidth);
+  const size_t dst_stride = PackedStride(kHeight);
+  std::fill(dst->begin(), dst->end(), 0);
+  for (int y = 0; y < kHeight; y++) {
+    for (int x = 0; x < kWidth; x++) {
+      if ((src[y * src_stride + x / 8] >> (7 - x % 8)) & 1) {
+        int out_x = kHeight - 1 - y;
+        (*dst)[x * dst_stride + out_x / 8] |=
+            static_cast<uint8_t>(0x80 >> (out_x % 8));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TPF_BENCHMARK(BitmapRotate90) {
+  std::vector<uint8_t> src = Label();
+  std::vector<uint8_t> dst(PackedStride(kHeight) * kWidth);
+  const double megabytes = static_cast<double>(src.size()) / (1024 * 1024);
+
+  Stopwatch by_dot;
+  for (int run = 0; run < kRuns; run++) {
+    RotateByDot(src, &dst);
+  }
+  double by_dot_ms = by_dot.ElapsedMillis() / kRuns;
+  std::vector<uint8_t> expected = dst;
+
+  Stopwatch blocked;
+  for (int run = 0; run < kRuns; run++) {
+    TransformBitmap(src.data(), kWidth, kHeight, Rotation::k90, false, 0,
+                    kWidth, dst.data());
+  }
+  double blocked_ms = blocked.ElapsedMillis() / kRuns;
+
+  ReportMetric("per-dot rotate", by_dot_ms, "ms");
+  ReportMetric("blocked rotate", blocked_ms, "ms");
+  ReportMetric("blocked throughput", megabytes / (blocked_ms / 1000.0),
+               "MiB/s");
+  ReportMetric("results match", dst == expected ? 1 : 0, "bool");
+}
+
+TPF_BENCHMARK(BitmapMirror) {
+  std::vector<uint8_t> src = Label();
+  std::vector<uint8_t> dst(src.size());
+  Stopwatch mirror;
+  for (int run = 0; run < kRuns; run++) {
+    TransformBitmap(src.data(), kWidth, kHeight, Rotation::k0, true, 0,
+                    kHeight, dst.data());
+  }
+  ReportMetric("mirror", mirror.ElapsedMillis() / kRuns, "ms");
+}
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,137 @@
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/device_transport.h"
+#include "core/io_loop.h"
+#include "core/print_queue.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kJobs = 20;
+constexpr size_t kTicketBytes = 8192;
+constexpr int kSocketBuffer = 4096;
+// The stand-in printer takes this much every millisecond, about 256 KB/s:
+// a USB 1.1 printer busy feeding paper.
+constexpr size_t kDrainPerTick = 256;
+
+// A printer at the end of a socketpair that counts the writes it is given.
+class SocketTransport : public Transport {
+ public:
+  SocketTransport(int fd, std::atomic<int>* writes, std::atomic<int>* blocked)
+      : fd_(fd), writes_(writes), blocked_(blocked) {}
+
+  bool Open() override {
+    open_ = true;
+    return true;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override {
+    (*writes_)++;
+    return WriteAllNonBlocking(fd_, data, length, 10000);
+  }
+  int StreamFd() const override { return open_ ? fd_ : -1; }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override {
+    (*writes_)++;
+    ssize_t written = WriteNonBlocking(fd_, data, length);
+    if (written >= 0 && static_cast<size_t>(written) < length) {
+      (*blocked_)++;
+    }
+    return written;
+  }
+
+ private:
+  int fd_;
+  std::atomic<int>* writes_;
+  std::atomic<int>* blocked_;
+  bool open_ = false;
+};
+
+// Prints |kJobs| tickets one after another to a printer that drains at a
+// fixed rate, and reports how many jobs the tuner needed to settle and what
+// it settled on.
+void TunePrinter(bool io_loop) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                 fds) != 0) {
+    return;
+  }
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &kSocketBuffer,
+             sizeof(kSocketBuffer));
+  setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &kSocketBuffer,
+             sizeof(kSocketBuffer));
+
+  std::atomic<bool> done(false);
+  std::thread printer([&] {
+    uint8_t buffer[kDrainPerTick];
+    while (!done) {
+      ssize_t count = read(fds[1], buffer, sizeof(buffer));
+      (void)count;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+
+  std::atomic<int> writes(0);
+  std::atomic<int> blocked(0);
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(
+            new SocketTransport(fds[0], &writes, &blocked));
+      },
+      nullptr);
+  if (io_loop) {
+    queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  }
+  queue.SetProfileResolver([](Transport*) { return PrinterProfile(); });
+
+  std::vector<uint8_t> ticket(kTicketBytes, 'x');
+  int converged_after = -1;
+  PrinterProfile profile;
+  Stopwatch elapsed;
+  for (int job = 1; job <= kJobs; job++) {
+    queue.Submit("printer", ticket);
+    while (queue.stats().completed + queue.stats().failed <
+           static_cast<uint64_t>(job)) {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    if (converged_after < 0 && queue.GetProfile("printer", &profile) &&
+        profile.chunk_size > 0) {
+      converged_after = job;
+    }
+  }
+  double millis = elapsed.ElapsedMillis();
+  queue.GetProfile("printer", &profile);
+  done = true;
+  printer.join();
+  queue.Shutdown();
+  close(fds[0]);
+  close(fds[1]);
+
+  ReportMetric("throughput",
+               kJobs * kTicketBytes / 1024.0 / (millis / 1000.0), "KiB/s");
+  ReportMetric("converged after", converged_after, "jobs");
+  ReportMetric("chunk size", profile.chunk_size, "bytes");
+  ReportMetric("pacing", profile.chunk_pacing_us, "us");
+  ReportMetric("writes", writes, "writes");
+  ReportMetric("blocked writes", blocked, "writes");
+}
+
+}  // namespace
+
+TPF_BENCHMARK(ChunkTunerBlocking) { TunePrinter(false); }
+
+TPF_BENCHMARK(ChunkTunerIoLoop) { TunePrinter(true); }
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
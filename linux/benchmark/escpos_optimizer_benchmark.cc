@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/escpos_optimizer.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kLines = 200000;
+
+void Append(std::vector<uint8_t>* stream,
+            std::initializer_list<uint8_t> bytes) {
+  stream->insert(stream->end(), bytes.begin(), bytes.end());
+}
+
+// What a generator that restates every style per line produces: code page,
+// print mode, justification and emphasis before each item.
+std::vector<uint8_t> Receipt() {
+  std::vector<uint8_t> stream = {0x1B, '@'};
+  for (int line = 0; line < kLines; line++) {
+    Append(&stream, {0x1B, 't', 16, 0x1B, '!', 0, 0x1B, 'a', 0});
+    Append(&stream, {0x1B, 'E', static_cast<uint8_t>(line % 10 == 0)});
+    std::string text = "ITEM " + std::to_string(line) + "   1 x 12,50";
+    stream.insert(stream.end(), text.begin(), text.end());
+    Append(&stream, {0x0A});
+    if (line % 20 == 19) {
+      Append(&stream, {0x0A, 0x0A, 0x0A, 0x0A});
+    }
+  }
+  return stream;
+}
+
+}  // namespace
+
+TPF_BENCHMARK(EscPosOptimize) {
+  std::vector<uint8_t> input = Receipt();
+  std::vector<uint8_t> output;
+  EscPosStats stats;
+  Stopwatch optimize;
+  OptimizeEscPos(input.data(), input.size(), &output, &stats);
+  double elapsed = optimize.ElapsedMillis();
+  ReportMetric("optimizer throughput", input.size() / 1e6 / (elapsed / 1000.0),
+               "MB/s");
+  ReportMetric("bytes in", static_cast<double>(stats.bytes_in), "bytes");
+  ReportMetric("bytes out", static_cast<double>(stats.bytes_out), "bytes");
+  ReportMetric("saved", 100.0 * (1.0 - static_cast<double>(stats.bytes_out) /
+                                           stats.bytes_in),
+               "%");
+}
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
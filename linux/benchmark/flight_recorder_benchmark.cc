@@ -0,0 +1,51 @@
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/flight_recorder.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kEvents = 1000000;
+
+// Records |kEvents| events on each of |threads| threads at once.
+void RecordEvents(int threads) {
+  FlightRecorder recorder;
+  uint16_t printer = recorder.PrinterIndex("lp0");
+  auto record = [&] {
+    for (int i = 0; i < kEvents; i++) {
+      recorder.Record(TraceEventType::kStageBegin, 4, printer,
+                      static_cast<uint64_t>(i), 512);
+    }
+  };
+  Stopwatch elapsed;
+  std::vector<std::thread> recorders;
+  for (int i = 0; i < threads; i++) {
+    recorders.emplace_back(record);
+  }
+  for (std::thread& thread : recorders) {
+    thread.join();
+  }
+  // Over every thread's events, so threads that contend show up as a
+  // lower rate than one thread alone times |threads|.
+  ReportMetric("events", threads * kEvents / elapsed.ElapsedMicros(),
+               "M/s");
+
+  elapsed.Restart();
+  bool written =
+      recorder.WriteChromeTrace(ScratchDirectory() + "/flight_recorder.json");
+  ReportMetric("dump", elapsed.ElapsedMillis(), "ms");
+  ReportMetric("dump written", written, "bool");
+}
+
+}  // namespace
+
+TPF_BENCHMARK(FlightRecorderOneThread) { RecordEvents(1); }
+
+TPF_BENCHMARK(FlightRecorderFourThreads) { RecordEvents(4); }
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,159 @@
+#include <dirent.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/device_transport.h"
+#include "core/io_loop.h"
+#include "core/print_queue.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kPrinters = 64;
+constexpr int kJobsPerPrinter = 100;
+constexpr size_t kTicketBytes = 4096;
+// Small socket buffers, so writes keep finding the printer busy the way a
+// 9600 baud or USB 1.1 printer would.
+constexpr int kSocketBuffer = 4096;
+
+// A printer at the end of a socketpair, drained by a thread of the
+// benchmark's.
+class SocketTransport : public Transport {
+ public:
+  explicit SocketTransport(int fd) : fd_(fd) {}
+  ~SocketTransport() override { close(fd_); }
+
+  bool Open() override {
+    open_ = true;
+    return true;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override {
+    return WriteAllNonBlocking(fd_, data, length, 10000);
+  }
+  int StreamFd() const override { return open_ ? fd_ : -1; }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override {
+    return WriteNonBlocking(fd_, data, length);
+  }
+
+ private:
+  int fd_;
+  bool open_ = false;
+};
+
+int CountThreads() {
+  DIR* dir = opendir("/proc/self/task");
+  if (dir == nullptr) {
+    return -1;
+  }
+  int threads = 0;
+  while (struct dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      threads++;
+    }
+  }
+  closedir(dir);
+  return threads;
+}
+
+// Prints |kJobsPerPrinter| tickets to each of |kPrinters| printers and
+// reports the throughput and the threads the process had while printing.
+void PrintToManyPrinters(bool io_loop) {
+  std::vector<int> printer_ends;
+  std::vector<int> queue_ends;
+  for (int i = 0; i < kPrinters; i++) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                   fds) != 0) {
+      return;
+    }
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &kSocketBuffer,
+               sizeof(kSocketBuffer));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &kSocketBuffer,
+               sizeof(kSocketBuffer));
+    queue_ends.push_back(fds[0]);
+    printer_ends.push_back(fds[1]);
+  }
+
+  const size_t expected = static_cast<size_t>(kPrinters) * kJobsPerPrinter *
+                          kTicketBytes;
+  std::atomic<size_t> received(0);
+  std::atomic<bool> done(false);
+  std::thread printers([&] {
+    std::vector<struct pollfd> fds;
+    for (int fd : printer_ends) {
+      fds.push_back({fd, POLLIN, 0});
+    }
+    uint8_t buffer[16384];
+    while (!done && received < expected) {
+      if (poll(fds.data(), fds.size(), 100) <= 0) {
+        continue;
+      }
+      for (struct pollfd& pfd : fds) {
+        ssize_t count;
+        while ((pfd.revents & POLLIN) != 0 &&
+               (count = read(pfd.fd, buffer, sizeof(buffer))) > 0) {
+          received += static_cast<size_t>(count);
+        }
+      }
+    }
+  });
+
+  int next = 0;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(
+            new SocketTransport(queue_ends[next++]));
+      },
+      nullptr);
+  if (io_loop) {
+    queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  }
+  std::vector<uint8_t> ticket(kTicketBytes, 'x');
+  Stopwatch elapsed;
+  for (int job = 0; job < kJobsPerPrinter; job++) {
+    for (int printer = 0; printer < kPrinters; printer++) {
+      queue.Submit("printer-" + std::to_string(printer), ticket);
+    }
+  }
+  // Less this thread and the printers'.
+  int threads = CountThreads() - 2;
+  const uint64_t total_jobs = static_cast<uint64_t>(kPrinters) *
+                              kJobsPerPrinter;
+  while (queue.stats().completed + queue.stats().failed < total_jobs) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  double millis = elapsed.ElapsedMillis();
+  done = true;
+  printers.join();
+  queue.Shutdown();
+  for (int fd : printer_ends) {
+    close(fd);
+  }
+
+  ReportMetric("printers", kPrinters, "printers");
+  ReportMetric("queue threads", threads, "threads");
+  ReportMetric("throughput", expected / 1024.0 / 1024.0 / (millis / 1000.0),
+               "MiB/s");
+  ReportMetric("failed jobs", queue.stats().failed, "jobs");
+}
+
+}  // namespace
+
+TPF_BENCHMARK(ManyPrintersThreadPerPrinter) { PrintToManyPrinters(false); }
+
+TPF_BENCHMARK(ManyPrintersIoLoop) { PrintToManyPrinters(true); }
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
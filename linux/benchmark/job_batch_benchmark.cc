@@ -0,0 +1,109 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/job_batch.h"
+#include "core/print_queue.h"
+#include "core/spool_journal.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kJobs = 8192;
+constexpr int kBatchSize = 256;
+constexpr size_t kTicketBytes = 512;
+const char* const kPrinters[] = {"lp0", "lp1"};
+
+// A printer that takes everything at once, so only the queue is measured.
+class NullTransport : public Transport {
+ public:
+  NullTransport() : fd_(open("/dev/null", O_WRONLY | O_CLOEXEC)) {}
+  ~NullTransport() override { close(fd_); }
+
+  bool Open() override {
+    open_ = true;
+    return true;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override { return true; }
+  int StreamFd() const override { return open_ ? fd_ : -1; }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override {
+    return static_cast<ssize_t>(length);
+  }
+
+ private:
+  int fd_;
+  bool open_ = false;
+};
+
+// Submits kJobs tickets split over two printers, one Submit() per job or
+// kBatchSize jobs per decoded envelope, and reports how fast the platform
+// thread got through them. The channel round trips a batch also saves are
+// not counted here.
+void SubmitTickets(bool batched) {
+  SpoolJournal journal;
+  std::vector<JournaledJob> pending;
+  if (!journal.Open(ScratchDirectory() +
+                        (batched ? "/batched.journal" : "/per_call.journal"),
+                    &pending)) {
+    return;
+  }
+  PrintQueue queue(
+      [](const std::string&) {
+        return std::unique_ptr<Transport>(new NullTransport());
+      },
+      &journal);
+  std::vector<uint8_t> ticket(kTicketBytes, 'x');
+  std::vector<BatchJob> jobs(kBatchSize);
+  for (int i = 0; i < kBatchSize; i++) {
+    jobs[i].printer = i % 2;
+    jobs[i].data = ticket.data();
+    jobs[i].length = ticket.size();
+  }
+  const std::vector<uint8_t> envelope = EncodeJobBatch(jobs);
+  const std::vector<std::string> printers(std::begin(kPrinters),
+                                          std::end(kPrinters));
+
+  Stopwatch elapsed;
+  std::vector<BatchJob> decoded;
+  std::vector<uint64_t> ids;
+  for (int submitted = 0; submitted < kJobs; submitted += kBatchSize) {
+    if (batched) {
+      DecodeJobBatch(envelope.data(), envelope.size(), printers.size(),
+                     &decoded);
+      queue.SubmitBatch(printers, decoded, &ids);
+      continue;
+    }
+    for (int i = 0; i < kBatchSize; i++) {
+      // Each call names its printer again.
+      queue.Submit(std::string(kPrinters[i % 2]), ticket.data(),
+                   ticket.size());
+    }
+  }
+  double submit_millis = elapsed.ElapsedMillis();
+  while (queue.stats().completed < static_cast<uint64_t>(kJobs)) {
+    std::this_thread::yield();
+  }
+  double total_millis = elapsed.ElapsedMillis();
+  queue.Shutdown();
+
+  ReportMetric("submitted", kJobs * 1000.0 / submit_millis, "jobs/s");
+  ReportMetric("printed", kJobs * 1000.0 / total_millis, "jobs/s");
+}
+
+}  // namespace
+
+TPF_BENCHMARK(JobBatchPerCall) { SubmitTickets(false); }
+
+TPF_BENCHMARK(JobBatchBatched) { SubmitTickets(true); }
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
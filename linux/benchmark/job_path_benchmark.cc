@@ -0,0 +1,135 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/io_loop.h"
+#include "core/print_queue.h"
+#include "core/spool_journal.h"
+
+// Every allocation in the process, whichever thread makes it.
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* pointer = malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept { free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kWarmUpJobs = 1000;
+constexpr int kJobs = 10000;
+constexpr size_t kTicketBytes = 2048;
+// Printers as the plugin names them: a network printer, whose key is too
+// long to be stored inline in a std::string, and a USB one.
+const char* const kPrinters[] = {"tcp://192.168.100.200:9100",
+                                 "/dev/usb/lp0"};
+
+// A printer that takes everything at once, so only the queue is measured.
+class NullTransport : public Transport {
+ public:
+  NullTransport() : fd_(open("/dev/null", O_WRONLY | O_CLOEXEC)) {}
+  ~NullTransport() override { close(fd_); }
+
+  bool Open() override {
+    open_ = true;
+    return true;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override { return true; }
+  int StreamFd() const override { return open_ ? fd_ : -1; }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override {
+    return static_cast<ssize_t>(length);
+  }
+
+ private:
+  int fd_;
+  bool open_ = false;
+};
+
+// Submits |jobs| tickets, a few at a time as a busy app would and to each
+// printer in turn, and waits for them to print.
+void PrintTickets(PrintQueue* queue, const std::vector<std::string>& printers,
+                  const std::vector<uint8_t>& ticket, int jobs) {
+  uint64_t first = queue->stats().completed;
+  for (int job = 1; job <= jobs; job++) {
+    queue->Submit(printers[job % printers.size()], ticket.data(),
+                  ticket.size());
+    while (queue->stats().completed + 4 < first + job) {
+      std::this_thread::yield();
+    }
+  }
+  while (queue->stats().completed < first + jobs) {
+    std::this_thread::yield();
+  }
+}
+
+// Counts allocations per job once the queue is warm: its buffers pooled,
+// its rings grown and the printers' workers running. Jobs are journaled, as
+// the plugin's are.
+void CountAllocations(bool io_loop) {
+  SpoolJournal journal;
+  std::vector<JournaledJob> pending;
+  if (!journal.Open(ScratchDirectory() + "/job_path.journal", &pending)) {
+    return;
+  }
+  PrintQueue queue(
+      [](const std::string&) {
+        return std::unique_ptr<Transport>(new NullTransport());
+      },
+      &journal);
+  if (io_loop) {
+    queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  }
+  // Built once, so that only the queue's own copies are counted.
+  const std::vector<std::string> printers(std::begin(kPrinters),
+                                          std::end(kPrinters));
+  std::vector<uint8_t> ticket(kTicketBytes, 'x');
+  PrintTickets(&queue, printers, ticket, kWarmUpJobs);
+
+  uint64_t before = allocations.load();
+  Stopwatch elapsed;
+  PrintTickets(&queue, printers, ticket, kJobs);
+  double millis = elapsed.ElapsedMillis();
+  uint64_t allocated = allocations.load() - before;
+  PrintQueueStats stats = queue.stats();
+  queue.Shutdown();
+
+  ReportMetric("allocations", static_cast<double>(allocated) / kJobs,
+               "per job");
+  ReportMetric("buffer reuses",
+               100.0 * stats.buffer_reuses /
+                   (stats.buffer_reuses + stats.buffer_allocations),
+               "%");
+  ReportMetric("job time", millis * 1000 / kJobs, "us");
+}
+
+}  // namespace
+
+TPF_BENCHMARK(JobPathBlocking) { CountAllocations(false); }
+
+TPF_BENCHMARK(JobPathIoLoop) { CountAllocations(true); }
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/bitmap_transform.h"
+#include "core/raster_kernels.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kRows = 20000;
+
+// What the encoder did before the kernels: one dot at a time, setting bits
+// in a cleared row and the error arrays updated in memory.
+void DitherByDot(const float* gray, int width, float threshold,
+                 float* current, float* next, uint8_t* packed) {
+  memset(packed, 0, PackedStride(width));
+  for (int x = 0; x < width; x++) {
+    float value = gray[x] + current[x];
+    bool black = value < threshold;
+    float error = value - (black ? 0.0f : 255.0f);
+    current[x + 1] += error * (7.0f / 16.0f);
+    next[x - 1] += error * (3.0f / 16.0f);
+    next[x] += error * (5.0f / 16.0f);
+    next[x + 1] += error * (1.0f / 16.0f);
+    if (black) {
+      packed[x >> 3] |= static_cast<uint8_t>(0x80 >> (x & 7));
+    }
+  }
+}
+
+void ThresholdByDot(const float* gray, int width, float threshold,
+                    uint8_t* packed) {
+  memset(packed, 0, PackedStride(width));
+  for (int x = 0; x < width; x++) {
+    if (gray[x] < threshold) {
+      packed[x >> 3] |= static_cast<uint8_t>(0x80 >> (x & 7));
+    }
+  }
+}
+
+// Dithers or thresholds kRows rows of |width| dots: per dot as before,
+// with the generic kernels and with those specialized for the width.
+void CompareKernels(int width, bool dither) {
+  std::vector<float> rows(static_cast<size_t>(width) * 64);
+  for (size_t i = 0; i < rows.size(); i++) {
+    rows[i] = static_cast<float>((i * 37 + i / 11) % 256);
+  }
+  const RasterKernels* variants[] = {nullptr, &GenericRasterKernels(),
+                                     &RasterKernelsFor(width)};
+  const char* names[] = {"per-dot", "generic", "specialized"};
+  std::vector<uint8_t> packed(PackedStride(width));
+  std::vector<uint8_t> first;
+  bool match = true;
+  for (int i = 0; i < 3; i++) {
+    std::vector<float> current(width + 2, 0.0f);
+    std::vector<float> next(width + 2, 0.0f);
+    Stopwatch elapsed;
+    for (int row = 0; row < kRows; row++) {
+      const float* gray = rows.data() + (row % 64) * width;
+      if (variants[i] == nullptr && dither) {
+        DitherByDot(gray, width, 128.0f, current.data() + 1, next.data() + 1,
+                    packed.data());
+        current.swap(next);
+        std::fill(next.begin(), next.end(), 0.0f);
+      } else if (variants[i] == nullptr) {
+        ThresholdByDot(gray, width, 128.0f, packed.data());
+      } else if (dither) {
+        variants[i]->dither(gray, width, 128.0f, current.data() + 1,
+                            next.data() + 1, packed.data());
+        current.swap(next);
+      } else {
+        variants[i]->threshold(gray, width, 128.0f, packed.data());
+      }
+    }
+    ReportMetric(names[i], kRows / (elapsed.ElapsedMillis() / 1000.0),
+                 "rows/s");
+    if (i == 0) {
+      first = packed;
+    }
+    match = match && packed == first;
+  }
+  ReportMetric("results match", match ? 1 : 0, "bool");
+}
+
+}  // namespace
+
+TPF_BENCHMARK(RasterKernelsThreshold384) { CompareKernels(384, false); }
+
+TPF_BENCHMARK(RasterKernelsThreshold576) { CompareKernels(576, false); }
+
+TPF_BENCHMARK(RasterKernelsDither384) { CompareKernels(384, true); }
+
+TPF_BENCHMARK(RasterKernelsDither576) { CompareKernels(576, true); }
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,89 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/spool_journal.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+// A typical text receipt is a few hundred bytes; raster logos are larger.
+constexpr size_t kTicketBytes = 768;
+constexpr int kJobs = 10000;
+
+std::vector<uint8_t> Ticket() {
+  std::vector<uint8_t> ticket(kTicketBytes);
+  for (size_t i = 0; i < ticket.size(); i++) {
+    ticket[i] = static_cast<uint8_t>(i * 31);
+  }
+  return ticket;
+}
+
+}  // namespace
+
+TPF_BENCHMARK(SpoolJournalAppend) {
+  std::string path = ScratchDirectory() + "/append.journal";
+  std::vector<uint8_t> ticket = Ticket();
+  SpoolJournal journal;
+  journal.Open(path, nullptr);
+
+  std::vector<double> samples;
+  samples.reserve(kJobs);
+  Stopwatch total;
+  for (int id = 1; id <= kJobs; id++) {
+    Stopwatch append;
+    journal.AppendJob(id, "/dev/usb/lp0", ticket.data(), ticket.size());
+    samples.push_back(append.ElapsedMicros());
+  }
+  double append_total = total.ElapsedMicros();
+  journal.Sync();
+  double durable_total = total.ElapsedMicros();
+
+  std::sort(samples.begin(), samples.end());
+  ReportMetric("append mean", append_total / kJobs, "us");
+  ReportMetric("append p50", samples[samples.size() / 2], "us");
+  ReportMetric("append p99", samples[samples.size() * 99 / 100], "us");
+  ReportMetric("10k appends durable", durable_total / 1000.0, "ms");
+  ReportMetric("group commits", journal.stats().commits, "msync");
+  journal.Close();
+  unlink(path.c_str());
+}
+
+TPF_BENCHMARK(SpoolJournalRecovery) {
+  std::string path = ScratchDirectory() + "/recovery.journal";
+  std::vector<uint8_t> ticket = Ticket();
+  {
+    SpoolJournal journal;
+    journal.Open(path, nullptr);
+    // Half of the jobs were printed before the "crash".
+    for (int id = 1; id <= kJobs; id++) {
+      journal.AppendJob(id, "/dev/usb/lp0", ticket.data(), ticket.size());
+      if (id % 2 == 0) {
+        journal.AppendCompletion(id, true);
+      }
+    }
+  }
+
+  std::vector<JournaledJob> pending;
+  Stopwatch replay;
+  SpoolJournal journal;
+  journal.Open(path, &pending);
+  ReportMetric("replay+compact 10k jobs", replay.ElapsedMillis(), "ms");
+  ReportMetric("pending jobs", pending.size(), "jobs");
+  journal.Close();
+
+  Stopwatch clean_replay;
+  journal.Open(path, &pending);
+  ReportMetric("replay 5k pending, no compaction", clean_replay.ElapsedMillis(),
+               "ms");
+  journal.Close();
+  unlink(path.c_str());
+}
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,69 @@
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/symbol_raster.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+constexpr int kCodes = 2000;
+
+// A PIX-style payment payload: ~120 bytes, different on every ticket.
+std::string PaymentPayload(int id) {
+  return "00020126580014br.gov.bcb.pix0136123e4567-e12d-4d3a-a456-" +
+         std::to_string(100000000000 + id) +
+         "5204000053039865406123.455802BR5913LOJA EXEMPLO6009SAO PAULO";
+}
+
+}  // namespace
+
+TPF_BENCHMARK(SymbolQrRender) {
+  SymbolOptions options;
+  options.ecc = QrEcc::kMedium;
+  options.module_size = 6;
+  std::vector<uint8_t> output;
+  Stopwatch render;
+  for (int id = 0; id < kCodes; id++) {
+    output.clear();
+    RenderSymbol(PaymentPayload(id), options, &output);
+  }
+  double elapsed = render.ElapsedMillis();
+  ReportMetric("QR render (uncached)", kCodes / (elapsed / 1000.0), "codes/s");
+  ReportMetric("QR raster size", static_cast<double>(output.size()), "bytes");
+}
+
+TPF_BENCHMARK(SymbolQrCached) {
+  SymbolOptions options;
+  options.module_size = 6;
+  SymbolCache cache;
+  // The same handful of store URLs and payment keys, over and over.
+  const int kDistinct = 8;
+  Stopwatch lookups;
+  for (int i = 0; i < kCodes * 10; i++) {
+    cache.Get(PaymentPayload(i % kDistinct), options);
+  }
+  double elapsed = lookups.ElapsedMillis();
+  ReportMetric("QR via cache", kCodes * 10 / (elapsed / 1000.0), "codes/s");
+  ReportMetric("cache hits", static_cast<double>(cache.stats().hits), "hits");
+}
+
+TPF_BENCHMARK(SymbolCode128Render) {
+  SymbolOptions options;
+  options.type = SymbolType::kCode128;
+  options.module_size = 2;
+  options.height = 80;
+  std::vector<uint8_t> output;
+  Stopwatch render;
+  for (int id = 0; id < kCodes; id++) {
+    output.clear();
+    RenderSymbol("PED-" + std::to_string(20240000 + id), options, &output);
+  }
+  double elapsed = render.ElapsedMillis();
+  ReportMetric("Code 128 render", kCodes / (elapsed / 1000.0), "codes/s");
+}
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "core/io_loop.h"
+#include "core/print_queue.h"
+
+namespace thermal_printer_flutter {
+namespace benchmark {
+
+namespace {
+
+// What a USB printer typically costs before its first byte: the open, and
+// the device ID read that identifies it.
+constexpr std::chrono::milliseconds kOpenDelay{20};
+constexpr std::chrono::milliseconds kIdentifyDelay{80};
+constexpr int kPrinters = 4;
+
+// A printer that is slow to open and takes everything written at once.
+class SlowOpenTransport : public Transport {
+ public:
+  bool Open() override {
+    std::this_thread::sleep_for(kOpenDelay);
+    open_ = true;
+    return true;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override { return true; }
+
+ private:
+  bool open_ = false;
+};
+
+void WaitUntil(const std::function<bool()>& condition) {
+  while (!condition()) {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+}
+
+// Times each printer's first job, from Submit() to printed, after warming
+// the printers up first if |warm|.
+void FirstJobLatency(bool io_loop, bool warm) {
+  PrintQueue queue(
+      [](const std::string&) {
+        return std::unique_ptr<Transport>(new SlowOpenTransport());
+      },
+      nullptr);
+  if (io_loop) {
+    queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  }
+  queue.SetProfileResolver([](Transport*) {
+    std::this_thread::sleep_for(kIdentifyDelay);
+    return PrinterProfile();
+  });
+  std::vector<std::string> printers;
+  for (int i = 0; i < kPrinters; i++) {
+    printers.push_back("lp" + std::to_string(i));
+  }
+  if (warm) {
+    Stopwatch warm_up;
+    for (const std::string& printer : printers) {
+      queue.WarmUp(printer);
+    }
+    for (const std::string& printer : printers) {
+      WaitUntil([&] {
+        PrinterStatus status;
+        return queue.GetStatus(printer, &status) && status.ready;
+      });
+    }
+    ReportMetric("warm-up, all printers", warm_up.ElapsedMillis(), "ms");
+  }
+
+  const std::vector<uint8_t> ticket(512, 'x');
+  double total = 0;
+  for (const std::string& printer : printers) {
+    uint64_t completed = queue.stats().completed;
+    Stopwatch latency;
+    queue.Submit(printer, ticket.data(), ticket.size());
+    WaitUntil([&] { return queue.stats().completed > completed; });
+    total += latency.ElapsedMillis();
+  }
+  queue.Shutdown();
+  ReportMetric("first job", total / kPrinters, "ms");
+}
+
+}  // namespace
+
+TPF_BENCHMARK(FirstJobCold) { FirstJobLatency(false, false); }
+
+TPF_BENCHMARK(FirstJobWarm) { FirstJobLatency(false, true); }
+
+TPF_BENCHMARK(FirstJobColdIoLoop) { FirstJobLatency(true, false); }
+
+TPF_BENCHMARK(FirstJobWarmIoLoop) { FirstJobLatency(true, true); }
+
+}  // namespace benchmark
+}  // namespace thermal_printer_flutter
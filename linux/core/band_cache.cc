@@ -0,0 +1,95 @@
+#include "band_cache.h"
+
+#include <cstring>
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+inline uint64_t RotateLeft(uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+inline uint64_t MixWord(uint64_t word) {
+  word *= 0x87C37B91114253D5ull;
+  word = RotateLeft(word, 31);
+  return word * 0x4CF5AD432745937Full;
+}
+
+inline uint64_t Finalize(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ull;
+  return h ^ (h >> 33);
+}
+
+}  // namespace
+
+uint64_t HashBytes(const void* data, size_t length, uint64_t seed) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  uint64_t h = seed ^ (length * 0x9E3779B97F4A7C15ull);
+  while (length >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    h ^= MixWord(word);
+    h = RotateLeft(h, 27) * 5 + 0x52DCE729;
+    p += 8;
+    length -= 8;
+  }
+  if (length > 0) {
+    uint64_t word = 0;
+    memcpy(&word, p, length);
+    h ^= MixWord(word);
+  }
+  return Finalize(h);
+}
+
+BandCache::BandCache(size_t capacity) : capacity_(capacity) {}
+
+bool BandCache::Lookup(uint64_t key, uint8_t* rows, size_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = index_.find(key);
+  if (found == index_.end() || found->second->second.size() != length) {
+    return false;
+  }
+  entries_.splice(entries_.begin(), entries_, found->second);
+  memcpy(rows, found->second->second.data(), length);
+  return true;
+}
+
+void BandCache::Insert(uint64_t key, const uint8_t* rows, size_t length) {
+  if (length > capacity_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    bytes_ -= found->second->second.size();
+    entries_.erase(found->second);
+    index_.erase(found);
+  }
+  entries_.emplace_front(key, std::vector<uint8_t>(rows, rows + length));
+  index_[key] = entries_.begin();
+  bytes_ += length;
+  while (bytes_ > capacity_) {
+    bytes_ -= entries_.back().second.size();
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+void BandCache::RecordJob(const BandStats& job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.bands += job.bands;
+  stats_.reused += job.reused;
+  stats_.last_job = job;
+}
+
+BandCacheStats BandCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,64 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BAND_CACHE_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BAND_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+// Bands of one raster job, and how many of them came from the cache.
+struct BandStats {
+  int bands = 0;
+  int reused = 0;
+};
+
+struct BandCacheStats {
+  uint64_t bands = 0;
+  uint64_t reused = 0;
+  BandStats last_job;
+};
+
+// Packed rows of recently encoded raster bands, keyed by a hash of the
+// band's input, so the header, footer and fixed text that every receipt
+// from a store shares are dithered and packed once. Least recently used
+// bands are dropped beyond |capacity| bytes. Thread-safe: image jobs are
+// encoded both on the platform thread and on print queue workers.
+class BandCache {
+ public:
+  explicit BandCache(size_t capacity = 4 * 1024 * 1024);
+
+  BandCache(const BandCache&) = delete;
+  BandCache& operator=(const BandCache&) = delete;
+
+  // Copies the band stored under |key| to |rows| if it is |length| bytes.
+  bool Lookup(uint64_t key, uint8_t* rows, size_t length);
+  void Insert(uint64_t key, const uint8_t* rows, size_t length);
+
+  // Called by the encoder as each job finishes.
+  void RecordJob(const BandStats& job);
+
+  BandCacheStats stats() const;
+
+ private:
+  using Entry = std::pair<uint64_t, std::vector<uint8_t>>;
+
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+  size_t bytes_ = 0;
+  BandCacheStats stats_;
+};
+
+// 64-bit hash of |length| bytes (MurmurHash3-style mixing), chained
+// through |seed|.
+uint64_t HashBytes(const void* data, size_t length, uint64_t seed);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BAND_CACHE_H_
@@ -0,0 +1,197 @@
+#include "bitmap_transform.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// A tile is kTileColumns source bytes across kTileGroups groups of 16 rows:
+// 256 rows of 32 bytes in, 256 rows of 32 bytes out, 16 KiB together.
+constexpr int kTileColumns = 32;
+constexpr int kTileGroups = 16;
+
+struct ReversedBytes {
+  uint8_t table[256];
+
+  ReversedBytes() {
+    for (int i = 0; i < 256; i++) {
+      uint8_t reversed = 0;
+      for (int bit = 0; bit < 8; bit++) {
+        if (i & (1 << bit)) {
+          reversed |= static_cast<uint8_t>(0x80 >> bit);
+        }
+      }
+      table[i] = reversed;
+    }
+  }
+};
+
+const uint8_t* Reversed() {
+  static const ReversedBytes reversed;
+  return reversed.table;
+}
+
+#if !defined(__SSE2__)
+// Transposes the 8x8 bit matrix held in |x|, row 0 in the top byte and
+// column 0 in each byte's top bit (Hacker's Delight, 7-3).
+uint64_t Transpose8x8(uint64_t x) {
+  x = (x & 0xAA55AA55AA55AA55ull) | ((x & 0x00AA00AA00AA00AAull) << 7) |
+      ((x >> 7) & 0x00AA00AA00AA00AAull);
+  x = (x & 0xCCCC3333CCCC3333ull) | ((x & 0x0000CCCC0000CCCCull) << 14) |
+      ((x >> 14) & 0x0000CCCC0000CCCCull);
+  x = (x & 0xF0F0F0F00F0F0F0Full) | ((x & 0x00000000F0F0F0F0ull) << 28) |
+      ((x >> 28) & 0x00000000F0F0F0F0ull);
+  return x;
+}
+#endif
+
+// |rows| holds one byte from each of 16 rows. For each of its 8 dots,
+// |columns| receives that dot's column, top to bottom, as 2 packed bytes.
+void Transpose16x8(const uint8_t rows[16], uint8_t columns[8][2]) {
+#if defined(__SSE2__)
+  // Row i goes in lane 15 - i so that movemask puts row 0 in the top bit;
+  // each doubling then moves the next dot up into the sign bit.
+  uint8_t lanes[16];
+  for (int i = 0; i < 16; i++) {
+    lanes[15 - i] = rows[i];
+  }
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+  for (int j = 0; j < 8; j++) {
+    int mask = _mm_movemask_epi8(v);
+    columns[j][0] = static_cast<uint8_t>(mask >> 8);
+    columns[j][1] = static_cast<uint8_t>(mask & 0xFF);
+    v = _mm_add_epi8(v, v);
+  }
+#else
+  for (int half = 0; half < 2; half++) {
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++) {
+      x = (x << 8) | rows[half * 8 + i];
+    }
+    x = Transpose8x8(x);
+    for (int j = 0; j < 8; j++) {
+      columns[j][half] = static_cast<uint8_t>(x >> (56 - 8 * j));
+    }
+  }
+#endif
+}
+
+}  // namespace
+
+void RotatedSize(int width, int height, Rotation rotation, int* rotated_width,
+                 int* rotated_height) {
+  bool quarter = IsQuarterTurn(rotation);
+  *rotated_width = quarter ? height : width;
+  *rotated_height = quarter ? width : height;
+}
+
+void MirrorRow(uint8_t* row, int width) {
+  if (width <= 0) {
+    return;
+  }
+  const uint8_t* reversed = Reversed();
+  size_t stride = PackedStride(width);
+  for (size_t i = 0, j = stride - 1; i < j; i++, j--) {
+    uint8_t left = reversed[row[i]];
+    row[i] = reversed[row[j]];
+    row[j] = left;
+  }
+  if (stride % 2 == 1) {
+    row[stride / 2] = reversed[row[stride / 2]];
+  }
+  // The padding is now at the start of the row; shift it back to the end.
+  int pad = static_cast<int>(stride * 8 - static_cast<size_t>(width));
+  if (pad != 0) {
+    for (size_t i = 0; i + 1 < stride; i++) {
+      row[i] = static_cast<uint8_t>((row[i] << pad) | (row[i + 1] >> (8 - pad)));
+    }
+    row[stride - 1] = static_cast<uint8_t>(row[stride - 1] << pad);
+  }
+}
+
+void TransformBitmap(const uint8_t* src, int width, int height,
+                     Rotation rotation, bool mirror, int first_row,
+                     int row_count, uint8_t* dst) {
+  int rotated_width;
+  int rotated_height;
+  RotatedSize(width, height, rotation, &rotated_width, &rotated_height);
+  first_row = std::max(first_row, 0);
+  const int end_row = std::min(first_row + row_count, rotated_height);
+  if (width <= 0 || height <= 0 || first_row >= end_row) {
+    return;
+  }
+  const size_t src_stride = PackedStride(width);
+  const size_t dst_stride = PackedStride(rotated_width);
+
+  if (!IsQuarterTurn(rotation)) {
+    const bool flip_rows = rotation == Rotation::k180;
+    const bool flip_dots = flip_rows != mirror;
+    for (int y = first_row; y < end_row; y++) {
+      uint8_t* out = dst + static_cast<size_t>(y - first_row) * dst_stride;
+      int source_row = flip_rows ? height - 1 - y : y;
+      memcpy(out, src + static_cast<size_t>(source_row) * src_stride,
+             src_stride);
+      if (flip_dots) {
+        MirrorRow(out, width);
+      }
+    }
+    return;
+  }
+
+  // Output dot (X, Y) is source dot (x, y) with x = Y or width - 1 - Y and
+  // y = X or height - 1 - X, depending on the direction and the mirror.
+  const bool flip_rows = (rotation == Rotation::k90) != mirror;
+  const bool flip_columns = rotation == Rotation::k270;
+  // Source columns that land in the requested output rows.
+  const int x_begin = flip_columns ? width - end_row : first_row;
+  const int x_end = flip_columns ? width - first_row : end_row;
+  const int first_byte = x_begin / 8;
+  const int end_byte = (x_end + 7) / 8;
+  const int groups = (height + 15) / 16;
+
+  for (int c0 = first_byte; c0 < end_byte; c0 += kTileColumns) {
+    const int c1 = std::min(c0 + kTileColumns, end_byte);
+    for (int g0 = 0; g0 < groups; g0 += kTileGroups) {
+      const int g1 = std::min(g0 + kTileGroups, groups);
+      for (int c = c0; c < c1; c++) {
+        for (int g = g0; g < g1; g++) {
+          uint8_t rows[16];
+          for (int i = 0; i < 16; i++) {
+            int x = g * 16 + i;
+            if (x >= height) {
+              // Past the last row: the white padding of the output rows.
+              rows[i] = 0;
+              continue;
+            }
+            int y = flip_rows ? height - 1 - x : x;
+            rows[i] = src[static_cast<size_t>(y) * src_stride + c];
+          }
+          uint8_t columns[8][2];
+          Transpose16x8(rows, columns);
+          const size_t out_byte = static_cast<size_t>(g) * 2;
+          for (int j = 0; j < 8; j++) {
+            int x = c * 8 + j;
+            if (x < x_begin || x >= x_end) {
+              continue;
+            }
+            int y = flip_columns ? width - 1 - x : x;
+            uint8_t* out =
+                dst + static_cast<size_t>(y - first_row) * dst_stride + out_byte;
+            out[0] = columns[j][0];
+            if (out_byte + 1 < dst_stride) {
+              out[1] = columns[j][1];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace thermal_printer_flutter
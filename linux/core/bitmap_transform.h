@@ -0,0 +1,48 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BITMAP_TRANSFORM_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BITMAP_TRANSFORM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Rotation and mirroring of packed 1bpp bitmaps: rows of dots, most
+// significant bit first, 1 = black, each row padded with white to a whole
+// byte.
+
+namespace thermal_printer_flutter {
+
+// Clockwise.
+enum class Rotation {
+  k0,
+  k90,
+  k180,
+  k270,
+};
+
+inline bool IsQuarterTurn(Rotation rotation) {
+  return rotation == Rotation::k90 || rotation == Rotation::k270;
+}
+
+inline size_t PackedStride(int width) {
+  return (static_cast<size_t>(width) + 7) / 8;
+}
+
+void RotatedSize(int width, int height, Rotation rotation, int* rotated_width,
+                 int* rotated_height);
+
+// Reverses the first |width| dots of |row| in place. Padding must be white.
+void MirrorRow(uint8_t* row, int width);
+
+// Rotates the |width| x |height| bitmap |src| by |rotation|, then mirrors it
+// left to right if |mirror|, and writes rows [first_row, first_row +
+// row_count) of the result to |dst|, PackedStride(rotated width) apart.
+//
+// Quarter turns are 8x8 bit-matrix transposes (16 rows at a time with SSE2)
+// walked in tiles that keep both sides in L1, with the flips folded into
+// which rows are read and written, so every source byte is touched once.
+void TransformBitmap(const uint8_t* src, int width, int height,
+                     Rotation rotation, bool mirror, int first_row,
+                     int row_count, uint8_t* dst);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BITMAP_TRANSFORM_H_
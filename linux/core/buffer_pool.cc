@@ -0,0 +1,75 @@
+#include "buffer_pool.h"
+
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+constexpr size_t BufferPool::kMinClass;
+constexpr int BufferPool::kClasses;
+constexpr size_t BufferPool::kBuffersPerClass;
+constexpr size_t BufferPool::kMaxCachedBytes;
+
+namespace {
+
+size_t ClassSize(int size_class) {
+  return BufferPool::kMinClass << size_class;
+}
+
+}  // namespace
+
+BufferPool::BufferPool() {
+  for (auto& buffers : free_) {
+    buffers.reserve(kBuffersPerClass);
+  }
+}
+
+std::vector<uint8_t> BufferPool::Acquire(const uint8_t* data, size_t length) {
+  int size_class = 0;
+  while (size_class < kClasses && ClassSize(size_class) < length) {
+    size_class++;
+  }
+  std::vector<uint8_t> buffer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (size_class < kClasses && !free_[size_class].empty()) {
+      buffer.swap(free_[size_class].back());
+      free_[size_class].pop_back();
+      stats_.cached_bytes -= buffer.capacity();
+      stats_.reuses++;
+    } else {
+      stats_.allocations++;
+    }
+  }
+  if (buffer.capacity() == 0) {
+    buffer.reserve(size_class < kClasses ? ClassSize(size_class) : length);
+  }
+  buffer.assign(data, data + length);
+  return buffer;
+}
+
+void BufferPool::Release(std::vector<uint8_t> buffer) {
+  if (buffer.capacity() >= ClassSize(kClasses)) {
+    return;
+  }
+  // The largest class the buffer can serve whole.
+  int size_class = kClasses - 1;
+  while (size_class >= 0 && ClassSize(size_class) > buffer.capacity()) {
+    size_class--;
+  }
+  if (size_class < 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_[size_class].size() < kBuffersPerClass &&
+      stats_.cached_bytes + buffer.capacity() <= kMaxCachedBytes) {
+    stats_.cached_bytes += buffer.capacity();
+    free_[size_class].push_back(std::move(buffer));
+  }
+}
+
+BufferPoolStats BufferPool::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace thermal_printer_flutter
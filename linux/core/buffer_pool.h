@@ -0,0 +1,55 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BUFFER_POOL_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+struct BufferPoolStats {
+  // Buffers that had to be allocated, and those handed out again instead.
+  uint64_t allocations = 0;
+  uint64_t reuses = 0;
+  // Held for reuse.
+  size_t cached_bytes = 0;
+};
+
+// Job buffers recycled by size class, powers of two from kMinClass, so a
+// steady stream of jobs stops allocating once the pool has a buffer of
+// each size in use. Larger buffers are allocated to size and not kept.
+// Thread-safe: jobs are submitted on the platform thread and finished on
+// the queue's workers.
+class BufferPool {
+ public:
+  static constexpr size_t kMinClass = 256;
+  // 256 bytes to 1 MB.
+  static constexpr int kClasses = 13;
+  static constexpr size_t kBuffersPerClass = 8;
+  static constexpr size_t kMaxCachedBytes = 8 * 1024 * 1024;
+
+  BufferPool();
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // A buffer holding a copy of |length| bytes of |data|.
+  std::vector<uint8_t> Acquire(const uint8_t* data, size_t length);
+
+  // Keeps |buffer| for reuse if there is room for it. Buffers that did not
+  // come from Acquire() are taken too.
+  void Release(std::vector<uint8_t> buffer);
+
+  BufferPoolStats stats() const;
+
+ private:
+  mutable std::mutex mutex_;
+  // Each reserved up front, so releasing never allocates.
+  std::vector<std::vector<uint8_t>> free_[kClasses];
+  BufferPoolStats stats_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_BUFFER_POOL_H_
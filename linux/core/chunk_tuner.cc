@@ -0,0 +1,100 @@
+#include "chunk_tuner.h"
+
+#include <algorithm>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr int kStatusTimeoutMs = 100;
+
+}  // namespace
+
+constexpr size_t ChunkTuner::kMinChunk;
+constexpr size_t ChunkTuner::kMaxChunk;
+constexpr size_t ChunkTuner::kInitialChunk;
+constexpr size_t ChunkTuner::kIncrease;
+constexpr std::chrono::microseconds ChunkTuner::kSlowWrite;
+constexpr std::chrono::microseconds ChunkTuner::kPacingStep;
+constexpr std::chrono::microseconds ChunkTuner::kMaxPacing;
+constexpr int ChunkTuner::kSettledStalls;
+
+void ChunkTuner::Seed(size_t chunk_size, std::chrono::microseconds pacing) {
+  if (pinned_) {
+    return;
+  }
+  chunk_size_ = std::min(std::max(chunk_size, kMinChunk), kMaxChunk);
+  pacing_ = std::min(std::max(pacing, std::chrono::microseconds(0)),
+                     kMaxPacing);
+  stalls_ = kSettledStalls;
+}
+
+void ChunkTuner::Pin(size_t chunk_size) {
+  pinned_ = chunk_size > 0;
+  if (pinned_) {
+    chunk_size_ = std::min(std::max(chunk_size, kMinChunk), kMaxChunk);
+    pacing_ = std::chrono::microseconds(0);
+    stalls_ = 0;
+  }
+}
+
+void ChunkTuner::OnWritten(size_t length, std::chrono::microseconds latency) {
+  if (pinned_) {
+    return;
+  }
+  if (latency > kSlowWrite) {
+    Decrease();
+  } else if (length == chunk_size_) {
+    // A short tail says nothing about whether a whole chunk would fit.
+    Increase();
+  }
+}
+
+void ChunkTuner::OnBlocked() {
+  if (!pinned_) {
+    Decrease();
+  }
+}
+
+void ChunkTuner::OnStall(bool printer_offline) {
+  if (!printer_offline && !pinned_) {
+    Decrease();
+  }
+}
+
+void ChunkTuner::Increase() {
+  chunk_size_ = std::min(chunk_size_ + kIncrease, kMaxChunk);
+  pacing_ = pacing_ > kPacingStep ? pacing_ - kPacingStep
+                                  : std::chrono::microseconds(0);
+}
+
+void ChunkTuner::Decrease() {
+  stalls_++;
+  if (chunk_size_ > kMinChunk) {
+    chunk_size_ = std::max(chunk_size_ / 2, kMinChunk);
+  } else {
+    pacing_ = std::min(
+        pacing_ > std::chrono::microseconds(0) ? pacing_ * 2 : kPacingStep,
+        kMaxPacing);
+  }
+}
+
+bool ReadPrinterStatus(Transport* transport, uint8_t* status,
+                       uint8_t function) {
+  // A real-time command, answered even while the printer's input buffer is
+  // full, but written without blocking: the link itself may be the stall.
+  const uint8_t kStatusRequest[] = {0x10, 0x04, function};
+  if (transport->WriteSome(kStatusRequest, sizeof(kStatusRequest)) !=
+      static_cast<ssize_t>(sizeof(kStatusRequest))) {
+    return false;
+  }
+  uint8_t reply;
+  if (transport->Read(&reply, 1, kStatusTimeoutMs) != 1 ||
+      (reply & 0x93) != 0x12) {
+    return false;
+  }
+  *status = reply;
+  return true;
+}
+
+}  // namespace thermal_printer_flutter
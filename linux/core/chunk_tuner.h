@@ -0,0 +1,83 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_CHUNK_TUNER_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_CHUNK_TUNER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// Learns how a printer wants to be fed: the largest chunk its link takes
+// without stalling, and how long to wait between chunks once even the
+// smallest one stalls. Additive increase, multiplicative decrease, as in
+// TCP congestion control: every chunk taken promptly grows the next one by
+// kIncrease and trims the pacing, and every stall halves the chunk or, at
+// kMinChunk, doubles the pacing.
+class ChunkTuner {
+ public:
+  static constexpr size_t kMinChunk = 256;
+  static constexpr size_t kMaxChunk = 64 * 1024;
+  static constexpr size_t kInitialChunk = 4096;
+  static constexpr size_t kIncrease = 512;
+  // A chunk that takes longer than this to write was waiting on the
+  // printer, not the link.
+  static constexpr std::chrono::microseconds kSlowWrite{20000};
+  static constexpr std::chrono::microseconds kPacingStep{500};
+  static constexpr std::chrono::microseconds kMaxPacing{50000};
+  // Stalls after which the chunk size is taken to have found its level.
+  static constexpr int kSettledStalls = 3;
+
+  ChunkTuner() = default;
+
+  // Starts from values learned earlier, as kept in the printer's profile.
+  void Seed(size_t chunk_size, std::chrono::microseconds pacing);
+
+  // Fixes the chunk size, without pacing, and stops learning, so a given
+  // size can be measured. 0 starts learning again from the current values.
+  void Pin(size_t chunk_size);
+  bool pinned() const { return pinned_; }
+
+  size_t chunk_size() const { return chunk_size_; }
+  std::chrono::microseconds pacing() const { return pacing_; }
+  // True once it has found the printer's level, or was seeded with it.
+  bool converged() const { return stalls_ >= kSettledStalls; }
+
+  // A chunk of |length| bytes was taken whole after |latency|.
+  void OnWritten(size_t length, std::chrono::microseconds latency);
+  // The transport took only part of a chunk, or none of it.
+  void OnBlocked();
+  // A write failed. Stalls of a printer that reports itself offline (paper
+  // out, cover open) are not learned from: smaller chunks would not help.
+  void OnStall(bool printer_offline);
+
+ private:
+  void Increase();
+  void Decrease();
+
+  size_t chunk_size_ = kInitialChunk;
+  std::chrono::microseconds pacing_{0};
+  int stalls_ = 0;
+  bool pinned_ = false;
+};
+
+// Sends DLE EOT |function|, 1 for the printer status and 4 for the paper
+// roll sensor, and reads the status byte the printer answers with.
+// Returns false for transports without WriteSome() or Read(), and if
+// nothing valid came back.
+bool ReadPrinterStatus(Transport* transport, uint8_t* status,
+                       uint8_t function = 1);
+
+// True for a DLE EOT 1 status byte with the offline bit set.
+inline bool IsOfflineStatus(uint8_t status) { return (status & 0x08) != 0; }
+
+// For DLE EOT 4 status bytes: the roll is nearly used up, or gone.
+inline bool IsPaperNearEndStatus(uint8_t status) {
+  return (status & 0x0C) != 0;
+}
+inline bool IsPaperOutStatus(uint8_t status) { return (status & 0x60) != 0; }
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_CHUNK_TUNER_H_
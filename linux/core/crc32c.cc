@@ -0,0 +1,83 @@
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+#if !defined(__SSE4_2__)
+// Slicing-by-8 tables, built once on first use.
+struct Crc32cTables {
+  uint32_t table[8][256];
+
+  Crc32cTables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+      }
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+      for (int slice = 1; slice < 8; slice++) {
+        uint32_t prev = table[slice - 1][i];
+        table[slice][i] = (prev >> 8) ^ table[0][prev & 0xFF];
+      }
+    }
+  }
+};
+
+const Crc32cTables& Tables() {
+  static const Crc32cTables tables;
+  return tables;
+}
+#endif
+
+}  // namespace
+
+uint32_t Crc32c(uint32_t crc, const void* data, size_t length) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+#if defined(__SSE4_2__)
+  uint64_t crc64 = crc;
+  while (length >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    p += 8;
+    length -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (length > 0) {
+    crc = _mm_crc32_u8(crc, *p++);
+    length--;
+  }
+#else
+  const Crc32cTables& t = Tables();
+  while (length >= 8) {
+    uint32_t lo;
+    uint32_t hi;
+    memcpy(&lo, p, sizeof(lo));
+    memcpy(&hi, p + 4, sizeof(hi));
+    lo ^= crc;
+    crc = t.table[7][lo & 0xFF] ^ t.table[6][(lo >> 8) & 0xFF] ^
+          t.table[5][(lo >> 16) & 0xFF] ^ t.table[4][lo >> 24] ^
+          t.table[3][hi & 0xFF] ^ t.table[2][(hi >> 8) & 0xFF] ^
+          t.table[1][(hi >> 16) & 0xFF] ^ t.table[0][hi >> 24];
+    p += 8;
+    length -= 8;
+  }
+  while (length > 0) {
+    crc = (crc >> 8) ^ t.table[0][(crc ^ *p++) & 0xFF];
+    length--;
+  }
+#endif
+  return ~crc;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,15 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_CRC32C_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermal_printer_flutter {
+
+// CRC-32C (Castagnoli). Pass the previous return value as |crc| to extend a
+// checksum over several buffers; start with 0.
+uint32_t Crc32c(uint32_t crc, const void* data, size_t length);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_CRC32C_H_
@@ -0,0 +1,405 @@
+#include "daemon_client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// Writes |data| to |path| through a temporary file, so a reader never sees
+// half of it.
+bool WriteFileWhole(const std::string& path, const std::vector<uint8_t>& data) {
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "we");
+  if (file == nullptr) {
+    return false;
+  }
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+  written = fclose(file) == 0 && written;
+  if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// A new connection to the daemon at |path|, or -1.
+int ConnectSocket(const std::string& path) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    return -1;
+  }
+  memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+}  // namespace
+
+constexpr std::chrono::seconds DaemonClient::kRetryInterval;
+constexpr int DaemonClient::kReplyTimeoutMs;
+
+DaemonClient::DaemonClient(std::string path) : path_(std::move(path)) {}
+
+DaemonClient::~DaemonClient() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CloseLocked();
+  if (subscription_ >= 0) {
+    close(subscription_);
+  }
+}
+
+bool DaemonClient::Connect() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ConnectLocked();
+}
+
+bool DaemonClient::connected() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return socket_ >= 0;
+}
+
+bool DaemonClient::ConnectLocked() {
+  if (socket_ >= 0) {
+    return true;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (now < next_attempt_) {
+    return false;
+  }
+  next_attempt_ = now + kRetryInterval;
+  socket_ = ConnectSocket(path_);
+  return socket_ >= 0;
+}
+
+void DaemonClient::CloseLocked() {
+  if (socket_ >= 0) {
+    close(socket_);
+    socket_ = -1;
+  }
+}
+
+bool DaemonClient::Call(const DaemonRequest& request, int fd,
+                        DaemonReply* reply, int* reply_fd, bool* sent) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint8_t> packet = EncodeDaemonRequest(request);
+  bool delivered = ConnectLocked() && SendPacket(socket_, packet, fd);
+  if (!delivered && socket_ >= 0) {
+    // The daemon restarted since the last call. Nothing reached it, so the
+    // request is safe to send again on a new connection.
+    CloseLocked();
+    next_attempt_ = std::chrono::steady_clock::time_point();
+    delivered = ConnectLocked() && SendPacket(socket_, packet, fd);
+  }
+  if (sent != nullptr) {
+    *sent = delivered;
+  }
+  int passed_fd;
+  if (!delivered ||
+      !ReceivePacket(socket_, &packet, &passed_fd, kReplyTimeoutMs)) {
+    CloseLocked();
+    return false;
+  }
+  bool ok = DecodeDaemonReply(packet.data(), packet.size(), reply) &&
+            reply->ok;
+  if (ok && reply_fd != nullptr) {
+    *reply_fd = passed_fd;
+  } else if (passed_fd >= 0) {
+    close(passed_fd);
+  }
+  return ok;
+}
+
+bool DaemonClient::Submit(const std::string& printer, const uint8_t* data,
+                          size_t length, int copies, const std::string& key,
+                          uint64_t* job_id, bool barrier, bool* full,
+                          bool* sent) {
+  if (sent != nullptr) {
+    *sent = false;
+  }
+  int fd = CreateSealedBuffer(data, length);
+  if (fd < 0) {
+    return false;
+  }
+  DaemonRequest request;
+  request.call = DaemonCall::kSubmit;
+  request.printer = printer;
+  request.copies = copies;
+  request.key = key;
+  request.barrier = barrier;
+  DaemonReply reply;
+  bool called = Call(request, fd, &reply, nullptr, sent);
+  close(fd);
+  *job_id = reply.job_id;
+  if (full != nullptr) {
+    *full = reply.resolved;
+  }
+  return called;
+}
+
+bool DaemonClient::SubmitFile(const std::string& printer,
+                              const FileJobSpec& spec, uint64_t* job_id,
+                              bool* sent) {
+  *job_id = 0;
+  if (sent != nullptr) {
+    *sent = false;
+  }
+  int fd = open(spec.path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  DaemonRequest request;
+  request.call = DaemonCall::kSubmitFile;
+  request.printer = printer;
+  request.spec = SerializeFileJobSpec(spec);
+  DaemonReply reply;
+  bool called = Call(request, fd, &reply, nullptr, sent);
+  close(fd);
+  *job_id = reply.job_id;
+  return called;
+}
+
+bool DaemonClient::SubmitBatch(const std::vector<std::string>& printers,
+                               const uint8_t* envelope, size_t length,
+                               std::vector<uint64_t>* ids, bool* sent) {
+  if (sent != nullptr) {
+    *sent = false;
+  }
+  int fd = CreateSealedBuffer(envelope, length);
+  if (fd < 0) {
+    return false;
+  }
+  DaemonRequest request;
+  request.call = DaemonCall::kSubmitBatch;
+  request.members = printers;
+  DaemonReply reply;
+  bool called = Call(request, fd, &reply, nullptr, sent);
+  close(fd);
+  ids->swap(reply.job_ids);
+  return called;
+}
+
+bool DaemonClient::Flush(const std::string& printer) {
+  DaemonRequest request;
+  request.call = DaemonCall::kFlush;
+  request.printer = printer;
+  DaemonReply reply;
+  return Call(request, -1, &reply);
+}
+
+bool DaemonClient::GetStats(PrintQueueStats* stats) {
+  DaemonRequest request;
+  request.call = DaemonCall::kStats;
+  DaemonReply reply;
+  if (!Call(request, -1, &reply)) {
+    return false;
+  }
+  *stats = reply.stats;
+  return true;
+}
+
+bool DaemonClient::GetProfile(const std::string& printer,
+                              PrinterProfile* profile, bool* resolved) {
+  DaemonRequest request;
+  request.call = DaemonCall::kProfile;
+  request.printer = printer;
+  DaemonReply reply;
+  if (!Call(request, -1, &reply)) {
+    return false;
+  }
+  *profile = reply.profile;
+  *resolved = reply.resolved;
+  return true;
+}
+
+bool DaemonClient::SetSerialOptions(const std::string& printer,
+                                    const SerialOptions& options) {
+  DaemonRequest request;
+  request.call = DaemonCall::kSerialOptions;
+  request.printer = printer;
+  request.serial = options;
+  DaemonReply reply;
+  return Call(request, -1, &reply);
+}
+
+bool DaemonClient::SetCoalesceOptions(const CoalesceOptions& options) {
+  DaemonRequest request;
+  request.call = DaemonCall::kCoalesce;
+  request.coalesce = options;
+  DaemonReply reply;
+  return Call(request, -1, &reply);
+}
+
+bool DaemonClient::GetLatency(const std::string& printer,
+                              PrinterLatency* latency, bool* measured) {
+  DaemonRequest request;
+  request.call = DaemonCall::kLatency;
+  request.printer = printer;
+  DaemonReply reply;
+  if (!Call(request, -1, &reply)) {
+    return false;
+  }
+  *latency = reply.latency;
+  *measured = reply.resolved;
+  return true;
+}
+
+bool DaemonClient::GetStatus(const std::string& printer,
+                             PrinterStatus* status, bool* known) {
+  DaemonRequest request;
+  request.call = DaemonCall::kStatus;
+  request.printer = printer;
+  DaemonReply reply;
+  if (!Call(request, -1, &reply)) {
+    return false;
+  }
+  *status = reply.status;
+  *known = reply.resolved;
+  return true;
+}
+
+bool DaemonClient::SetGroup(const std::string& group,
+                            const std::vector<std::string>& printers) {
+  DaemonRequest request;
+  request.call = DaemonCall::kGroup;
+  request.printer = group;
+  request.members = printers;
+  DaemonReply reply;
+  return Call(request, -1, &reply);
+}
+
+bool DaemonClient::GetGroupStats(const std::string& group,
+                                 std::vector<GroupMemberStats>* members) {
+  DaemonRequest request;
+  request.call = DaemonCall::kGroupStats;
+  request.printer = group;
+  DaemonReply reply;
+  if (!Call(request, -1, &reply)) {
+    return false;
+  }
+  *members = std::move(reply.members);
+  return true;
+}
+
+bool DaemonClient::DumpTrace(const std::string& path) {
+  DaemonRequest request;
+  request.call = DaemonCall::kDumpTrace;
+  DaemonReply reply;
+  int trace = -1;
+  std::vector<uint8_t> data;
+  bool received = Call(request, -1, &reply, &trace) && trace >= 0 &&
+                  ReadSealedBuffer(trace, &data);
+  if (trace >= 0) {
+    close(trace);
+  }
+  return received && WriteFileWhole(path, data);
+}
+
+bool DaemonClient::SetTraceThreshold(std::chrono::milliseconds threshold,
+                                     const std::string& path) {
+  DaemonRequest request;
+  request.call = DaemonCall::kTraceThreshold;
+  int fd = -1;
+  if (threshold.count() > 0 && !path.empty()) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    request.trace_threshold_ms = static_cast<uint64_t>(threshold.count());
+  }
+  DaemonReply reply;
+  bool called = Call(request, fd, &reply);
+  if (fd >= 0) {
+    close(fd);
+  }
+  return called;
+}
+
+bool DaemonClient::WarmUp(const std::vector<std::string>& printers,
+                          const std::vector<FileJobSpec>& preload) {
+  DaemonRequest request;
+  request.call = DaemonCall::kWarmUp;
+  request.members = printers;
+  for (const FileJobSpec& spec : preload) {
+    request.preload.push_back(SerializeFileJobSpec(spec));
+  }
+  DaemonReply reply;
+  return Call(request, -1, &reply);
+}
+
+int DaemonClient::Subscribe() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (subscription_ >= 0) {
+    return subscription_;
+  }
+  int fd = ConnectSocket(path_);
+  if (fd < 0) {
+    return -1;
+  }
+  DaemonRequest request;
+  request.call = DaemonCall::kSubscribe;
+  std::vector<uint8_t> packet;
+  int passed_fd = -1;
+  DaemonReply reply;
+  if (!SendPacket(fd, EncodeDaemonRequest(request), -1) ||
+      !ReceivePacket(fd, &packet, &passed_fd, kReplyTimeoutMs) ||
+      !DecodeDaemonReply(packet.data(), packet.size(), &reply) ||
+      !reply.ok) {
+    if (passed_fd >= 0) {
+      close(passed_fd);
+    }
+    close(fd);
+    return -1;
+  }
+  subscription_ = fd;
+  return fd;
+}
+
+bool DaemonClient::ReadStatusChanges(
+    std::vector<PrinterStatusChange>* changes) {
+  changes->clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (subscription_ >= 0) {
+    struct pollfd ready = {subscription_, POLLIN, 0};
+    if (poll(&ready, 1, 0) <= 0) {
+      return true;
+    }
+    std::vector<uint8_t> packet;
+    int fd = -1;
+    DaemonReply reply;
+    bool received = ReceivePacket(subscription_, &packet, &fd, 0) &&
+                    DecodeDaemonReply(packet.data(), packet.size(), &reply);
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (!received) {
+      close(subscription_);
+      subscription_ = -1;
+      return false;
+    }
+    changes->insert(changes->end(), reply.statuses.begin(),
+                    reply.statuses.end());
+  }
+  return false;
+}
+
+}  // namespace thermal_printer_flutter
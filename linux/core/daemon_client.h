@@ -0,0 +1,119 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DAEMON_CLIENT_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DAEMON_CLIENT_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "daemon_protocol.h"
+#include "file_source.h"
+#include "print_queue.h"
+#include "printer_profile.h"
+#include "serial_transport.h"
+
+namespace thermal_printer_flutter {
+
+// The plugin's end of the PrintDaemon socket. Calls connect on first use
+// and again after the daemon restarts; while no daemon is listening they
+// fail fast, trying to connect at most once per |kRetryInterval|, and the
+// caller falls back to its own queue.
+class DaemonClient {
+ public:
+  explicit DaemonClient(std::string path);
+  ~DaemonClient();
+
+  DaemonClient(const DaemonClient&) = delete;
+  DaemonClient& operator=(const DaemonClient&) = delete;
+
+  // Connects unless already connected. Returns false if no daemon answers.
+  bool Connect();
+  bool connected() const;
+
+  // Each call returns false if the daemon could not be reached or refused
+  // the request. Job bytes are handed over in a sealed memfd rather than
+  // through the socket. A job the daemon refused has a |job_id| of 0, and
+  // |full|, if given, says whether that was for its memory limit. |sent|,
+  // if given, says whether the request reached the daemon: once it has,
+  // the job may print even though its reply was lost, so the caller must
+  // not queue it anywhere else.
+  bool Submit(const std::string& printer, const uint8_t* data, size_t length,
+              int copies, const std::string& key, uint64_t* job_id,
+              bool barrier = false, bool* full = nullptr,
+              bool* sent = nullptr);
+  // The file is opened here, with the caller's rights, and passed to the
+  // daemon, which prints only that file.
+  bool SubmitFile(const std::string& printer, const FileJobSpec& spec,
+                  uint64_t* job_id, bool* sent = nullptr);
+  // Submits an EncodeJobBatch() envelope whose jobs refer to |printers|.
+  // |ids| is set as PrintQueue::SubmitBatch() would set it.
+  bool SubmitBatch(const std::vector<std::string>& printers,
+                   const uint8_t* envelope, size_t length,
+                   std::vector<uint64_t>* ids, bool* sent = nullptr);
+  bool Flush(const std::string& printer);
+  bool GetStats(PrintQueueStats* stats);
+  // |resolved| is set as PrintQueue::GetProfile() would return it.
+  bool GetProfile(const std::string& printer, PrinterProfile* profile,
+                  bool* resolved);
+  // |measured| is set as PrintQueue::GetLatency() would return it.
+  bool GetLatency(const std::string& printer, PrinterLatency* latency,
+                  bool* measured);
+  // Has the daemon watch |printer|. |known| is set as
+  // PrintQueue::GetStatus() would return it.
+  bool GetStatus(const std::string& printer, PrinterStatus* status,
+                 bool* known);
+  bool SetSerialOptions(const std::string& printer,
+                        const SerialOptions& options);
+  bool SetCoalesceOptions(const CoalesceOptions& options);
+  bool SetGroup(const std::string& group,
+                const std::vector<std::string>& printers);
+  bool GetGroupStats(const std::string& group,
+                     std::vector<GroupMemberStats>* members);
+  // Writes the daemon's flight recorder trace, which it returns in a
+  // memfd, to |path|.
+  bool DumpTrace(const std::string& path);
+  // Has the daemon dump its trace by itself once a job takes longer than
+  // |threshold|. |path| is opened here and the daemon writes each dump
+  // over the file through that descriptor.
+  bool SetTraceThreshold(std::chrono::milliseconds threshold,
+                         const std::string& path);
+  // Has the daemon warm up each of |printers|, as PrintQueue::WarmUp()
+  // does. The daemon only reads files the caller's user may read.
+  bool WarmUp(const std::vector<std::string>& printers,
+              const std::vector<FileJobSpec>& preload);
+
+  // Opens a second connection, on which the daemon pushes the status of
+  // each printer whose status changes, several at a time. Returns its
+  // socket for the caller to poll for input, or -1. It stays open, and
+  // later calls return it, until the daemon goes away.
+  int Subscribe();
+  // Reads the changes pushed since the last call into |changes|, the
+  // oldest first. Returns false, closing the subscription, once the daemon
+  // has gone.
+  bool ReadStatusChanges(std::vector<PrinterStatusChange>* changes);
+
+  static constexpr std::chrono::seconds kRetryInterval{1};
+  // How long a call waits for the daemon to answer.
+  static constexpr int kReplyTimeoutMs = 5000;
+
+ private:
+  bool ConnectLocked();
+  void CloseLocked();
+  // Sets |reply_fd|, if given, to the descriptor the daemon passed back,
+  // or -1; the caller owns it. Sets |sent|, if given, once the request has
+  // been written to the daemon, whether or not a reply came back.
+  bool Call(const DaemonRequest& request, int fd, DaemonReply* reply,
+            int* reply_fd = nullptr, bool* sent = nullptr);
+
+  const std::string path_;
+  mutable std::mutex mutex_;
+  int socket_ = -1;
+  int subscription_ = -1;
+  std::chrono::steady_clock::time_point next_attempt_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DAEMON_CLIENT_H_
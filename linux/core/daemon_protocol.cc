@@ -0,0 +1,520 @@
+#include "daemon_protocol.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include "device_transport.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr uint32_t kMessageMagic = 0x44465054;  // "TPFD"
+// 2: profiles carry the learned chunk size and pacing.
+// 3: printer groups.
+// 4: barrier jobs and their latencies.
+// 5: memory limits.
+// 6: printer status.
+// 7: job batches.
+// 8: flight recorder traces.
+// 9: warm-up, and whether a printer is ready.
+constexpr uint8_t kProtocolVersion = 12;
+// Requests carry at most a printer key, a job key and a file job spec, or
+// the printers of a batch; replies at most kMaxBatchJobs job ids.
+constexpr size_t kMaxMessageSize = 64 * 1024;
+constexpr int kSeals = F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+
+struct MessageHeader {
+  uint32_t magic;
+  uint8_t version;
+  // DaemonCall for requests, 1 (ok) or 0 for replies.
+  uint8_t kind;
+  uint16_t reserved;
+};
+
+static_assert(sizeof(MessageHeader) == 8, "unexpected MessageHeader layout");
+
+class MessageWriter {
+ public:
+  explicit MessageWriter(uint8_t kind) {
+    MessageHeader header = {kMessageMagic, kProtocolVersion, kind, 0};
+    Put(&header, sizeof(header));
+  }
+
+  void U8(uint8_t value) { Put(&value, sizeof(value)); }
+  void I32(int32_t value) { Put(&value, sizeof(value)); }
+  void U64(uint64_t value) { Put(&value, sizeof(value)); }
+  void F64(double value) { Put(&value, sizeof(value)); }
+  void Bytes(const void* data, size_t length) {
+    uint32_t size = static_cast<uint32_t>(length);
+    Put(&size, sizeof(size));
+    Put(data, length);
+  }
+  void String(const std::string& value) { Bytes(value.data(), value.size()); }
+
+  void Histogram(const LatencyHistogram& histogram) {
+    for (uint64_t count : histogram.counts) {
+      U64(count);
+    }
+    U64(histogram.samples);
+    U64(histogram.total_ms);
+    U64(histogram.max_ms);
+  }
+
+  std::vector<uint8_t> Take() { return std::move(data_); }
+
+ private:
+  void Put(const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    data_.insert(data_.end(), bytes, bytes + length);
+  }
+
+  std::vector<uint8_t> data_;
+};
+
+// Every getter fails once the message runs out, so a decoder can read all
+// its fields and check the result once.
+class MessageReader {
+ public:
+  MessageReader(const uint8_t* data, size_t length)
+      : data_(data), length_(length) {}
+
+  bool Header(uint8_t* kind) {
+    MessageHeader header;
+    if (!Get(&header, sizeof(header)) || header.magic != kMessageMagic ||
+        header.version != kProtocolVersion) {
+      return false;
+    }
+    *kind = header.kind;
+    return true;
+  }
+  uint8_t U8() {
+    uint8_t value = 0;
+    Get(&value, sizeof(value));
+    return value;
+  }
+  int32_t I32() {
+    int32_t value = 0;
+    Get(&value, sizeof(value));
+    return value;
+  }
+  uint64_t U64() {
+    uint64_t value = 0;
+    Get(&value, sizeof(value));
+    return value;
+  }
+  double F64() {
+    double value = 0;
+    Get(&value, sizeof(value));
+    return value;
+  }
+  // A list length, which fails the message if it has fewer than
+  // |min_size| bytes left for each entry.
+  size_t Count(size_t min_size) {
+    uint32_t count = 0;
+    if (!Get(&count, sizeof(count)) ||
+        count > (length_ - offset_) / min_size) {
+      ok_ = false;
+      return 0;
+    }
+    return count;
+  }
+  std::vector<uint8_t> Bytes() {
+    uint32_t size = 0;
+    if (!Get(&size, sizeof(size)) || size > length_ - offset_) {
+      ok_ = false;
+      return std::vector<uint8_t>();
+    }
+    offset_ += size;
+    return std::vector<uint8_t>(data_ + offset_ - size, data_ + offset_);
+  }
+  std::string String() {
+    std::vector<uint8_t> bytes = Bytes();
+    return std::string(bytes.begin(), bytes.end());
+  }
+
+  void Histogram(LatencyHistogram* histogram) {
+    for (uint64_t& count : histogram->counts) {
+      count = U64();
+    }
+    histogram->samples = U64();
+    histogram->total_ms = U64();
+    histogram->max_ms = U64();
+  }
+
+  bool ok() const { return ok_; }
+
+ private:
+  bool Get(void* value, size_t size) {
+    if (!ok_ || size > length_ - offset_) {
+      ok_ = false;
+      return false;
+    }
+    memcpy(value, data_ + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  const uint8_t* data_;
+  size_t length_;
+  size_t offset_ = 0;
+  bool ok_ = true;
+};
+
+}  // namespace
+
+std::vector<uint8_t> EncodeDaemonRequest(const DaemonRequest& request) {
+  MessageWriter writer(static_cast<uint8_t>(request.call));
+  writer.String(request.printer);
+  writer.I32(request.copies);
+  writer.String(request.key);
+  writer.U8(request.barrier ? 1 : 0);
+  writer.Bytes(request.spec.data(), request.spec.size());
+  writer.I32(request.serial.baud_rate);
+  writer.U8(static_cast<uint8_t>(request.serial.flow_control));
+  writer.I32(request.serial.write_timeout_ms);
+  writer.U8(request.coalesce.enabled ? 1 : 0);
+  writer.U64(static_cast<uint64_t>(request.coalesce.window.count()));
+  writer.U64(request.coalesce.max_bytes);
+  writer.I32(static_cast<int32_t>(request.members.size()));
+  for (const std::string& member : request.members) {
+    writer.String(member);
+  }
+  writer.U64(request.trace_threshold_ms);
+  writer.I32(static_cast<int32_t>(request.preload.size()));
+  for (const std::vector<uint8_t>& spec : request.preload) {
+    writer.Bytes(spec.data(), spec.size());
+  }
+  return writer.Take();
+}
+
+bool DecodeDaemonRequest(const uint8_t* data, size_t length,
+                         DaemonRequest* request) {
+  MessageReader reader(data, length);
+  uint8_t kind;
+  if (!reader.Header(&kind) ||
+      kind < static_cast<uint8_t>(DaemonCall::kSubmit) ||
+      kind > static_cast<uint8_t>(DaemonCall::kSubscribe)) {
+    return false;
+  }
+  request->call = static_cast<DaemonCall>(kind);
+  request->printer = reader.String();
+  request->copies = reader.I32();
+  request->key = reader.String();
+  request->barrier = reader.U8() != 0;
+  request->spec = reader.Bytes();
+  request->serial.baud_rate = reader.I32();
+  uint8_t flow_control = reader.U8();
+  request->serial.write_timeout_ms = reader.I32();
+  request->coalesce.enabled = reader.U8() != 0;
+  request->coalesce.window = std::chrono::milliseconds(reader.U64());
+  request->coalesce.max_bytes = static_cast<size_t>(reader.U64());
+  request->members.resize(reader.Count(sizeof(uint32_t)));
+  for (std::string& member : request->members) {
+    member = reader.String();
+  }
+  request->trace_threshold_ms = reader.U64();
+  request->preload.resize(reader.Count(sizeof(uint32_t)));
+  for (std::vector<uint8_t>& spec : request->preload) {
+    spec = reader.Bytes();
+  }
+  if (flow_control > static_cast<uint8_t>(FlowControl::kXonXoff)) {
+    return false;
+  }
+  request->serial.flow_control = static_cast<FlowControl>(flow_control);
+  return reader.ok();
+}
+
+std::vector<uint8_t> EncodeDaemonReply(const DaemonReply& reply) {
+  MessageWriter writer(reply.ok ? 1 : 0);
+  writer.U64(reply.job_id);
+  const PrintQueueStats& stats = reply.stats;
+  writer.U64(stats.submitted);
+  writer.U64(stats.completed);
+  writer.U64(stats.failed);
+  writer.U64(stats.bytes_written);
+  writer.U64(stats.coalesced_writes);
+  writer.U64(stats.coalesced_jobs);
+  writer.U64(stats.macro_copies);
+  writer.U64(stats.resent_copies);
+  writer.U64(stats.resent_bytes);
+  writer.U64(stats.resumed_bytes);
+  writer.U64(stats.deduplicated_jobs);
+  writer.U64(stats.failed_over_jobs);
+  writer.U64(stats.queued_bytes);
+  writer.U64(stats.rejected_jobs);
+  writer.U64(stats.buffer_allocations);
+  writer.U64(stats.buffer_reuses);
+  const PrinterProfile& profile = reply.profile;
+  writer.U8(reply.resolved ? 1 : 0);
+  writer.String(profile.name);
+  writer.String(profile.id.manufacturer);
+  writer.String(profile.id.model);
+  writer.String(profile.id.command_set);
+  writer.I32(profile.paper_width);
+  writer.I32(profile.band_height);
+  writer.U8(static_cast<uint8_t>(profile.macros));
+  writer.I32(profile.chunk_size);
+  writer.I32(profile.chunk_pacing_us);
+  writer.I32(static_cast<int32_t>(reply.members.size()));
+  for (const GroupMemberStats& member : reply.members) {
+    writer.String(member.printer);
+    writer.U64(member.queued_bytes);
+    writer.F64(member.bytes_per_second);
+    writer.F64(member.utilization);
+    writer.U64(member.routed_jobs);
+    writer.U64(member.failed_over_jobs);
+    writer.U8(member.offline ? 1 : 0);
+  }
+  writer.Histogram(reply.latency.handoff);
+  writer.Histogram(reply.latency.completion);
+  writer.U64(reply.latency.unanswered);
+  writer.U64(reply.latency.unsupported);
+  writer.U64(static_cast<uint64_t>(reply.latency.last_completion_ms));
+  writer.U8(reply.status.connected ? 1 : 0);
+  writer.U8(reply.status.online ? 1 : 0);
+  writer.U8(static_cast<uint8_t>(reply.status.paper));
+  writer.U8(reply.status.ready ? 1 : 0);
+  writer.I32(static_cast<int32_t>(reply.job_ids.size()));
+  for (uint64_t job_id : reply.job_ids) {
+    writer.U64(job_id);
+  }
+  writer.I32(static_cast<int32_t>(reply.statuses.size()));
+  for (const PrinterStatusChange& change : reply.statuses) {
+    writer.String(change.printer);
+    writer.U8(change.status.connected ? 1 : 0);
+    writer.U8(change.status.online ? 1 : 0);
+    writer.U8(static_cast<uint8_t>(change.status.paper));
+    writer.U8(change.status.ready ? 1 : 0);
+  }
+  return writer.Take();
+}
+
+bool DecodeDaemonReply(const uint8_t* data, size_t length,
+                       DaemonReply* reply) {
+  MessageReader reader(data, length);
+  uint8_t kind;
+  if (!reader.Header(&kind)) {
+    return false;
+  }
+  reply->ok = kind == 1;
+  reply->job_id = reader.U64();
+  PrintQueueStats& stats = reply->stats;
+  stats.submitted = reader.U64();
+  stats.completed = reader.U64();
+  stats.failed = reader.U64();
+  stats.bytes_written = reader.U64();
+  stats.coalesced_writes = reader.U64();
+  stats.coalesced_jobs = reader.U64();
+  stats.macro_copies = reader.U64();
+  stats.resent_copies = reader.U64();
+  stats.resent_bytes = reader.U64();
+  stats.resumed_bytes = reader.U64();
+  stats.deduplicated_jobs = reader.U64();
+  stats.failed_over_jobs = reader.U64();
+  stats.queued_bytes = reader.U64();
+  stats.rejected_jobs = reader.U64();
+  stats.buffer_allocations = reader.U64();
+  stats.buffer_reuses = reader.U64();
+  PrinterProfile& profile = reply->profile;
+  reply->resolved = reader.U8() != 0;
+  profile.name = reader.String();
+  profile.id.manufacturer = reader.String();
+  profile.id.model = reader.String();
+  profile.id.command_set = reader.String();
+  profile.paper_width = reader.I32();
+  profile.band_height = reader.I32();
+  uint8_t macros = reader.U8();
+  if (macros > static_cast<uint8_t>(MacroSupport::kUnsupported)) {
+    return false;
+  }
+  profile.macros = static_cast<MacroSupport>(macros);
+  profile.chunk_size = reader.I32();
+  profile.chunk_pacing_us = reader.I32();
+  // Each entry is at least an empty printer name and the numbers after it.
+  reply->members.resize(reader.Count(4 + 8 * 5 + 1));
+  for (GroupMemberStats& member : reply->members) {
+    member.printer = reader.String();
+    member.queued_bytes = reader.U64();
+    member.bytes_per_second = reader.F64();
+    member.utilization = reader.F64();
+    member.routed_jobs = reader.U64();
+    member.failed_over_jobs = reader.U64();
+    member.offline = reader.U8() != 0;
+  }
+  reader.Histogram(&reply->latency.handoff);
+  reader.Histogram(&reply->latency.completion);
+  reply->latency.unanswered = reader.U64();
+  reply->latency.unsupported = reader.U64();
+  reply->latency.last_completion_ms = static_cast<int64_t>(reader.U64());
+  reply->status.connected = reader.U8() != 0;
+  reply->status.online = reader.U8() != 0;
+  uint8_t paper = reader.U8();
+  if (paper > static_cast<uint8_t>(PaperState::kOut)) {
+    return false;
+  }
+  reply->status.paper = static_cast<PaperState>(paper);
+  reply->status.ready = reader.U8() != 0;
+  reply->job_ids.resize(reader.Count(sizeof(uint64_t)));
+  for (uint64_t& job_id : reply->job_ids) {
+    job_id = reader.U64();
+  }
+  // Each entry is at least an empty printer name and the four flags.
+  reply->statuses.resize(reader.Count(4 + 4));
+  for (PrinterStatusChange& change : reply->statuses) {
+    change.printer = reader.String();
+    change.status.connected = reader.U8() != 0;
+    change.status.online = reader.U8() != 0;
+    paper = reader.U8();
+    if (paper > static_cast<uint8_t>(PaperState::kOut)) {
+      return false;
+    }
+    change.status.paper = static_cast<PaperState>(paper);
+    change.status.ready = reader.U8() != 0;
+  }
+  return reader.ok();
+}
+
+std::string DefaultDaemonSocketPath() {
+  const char* path = getenv("THERMAL_PRINTER_FLUTTER_SOCKET");
+  if (path != nullptr && path[0] != '\0') {
+    return path;
+  }
+  const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+  if (runtime_dir != nullptr && runtime_dir[0] == '/') {
+    return std::string(runtime_dir) + "/thermal_printer_flutter.sock";
+  }
+  return "/tmp/thermal_printer_flutter-" + std::to_string(getuid()) + ".sock";
+}
+
+bool SendPacket(int socket, const std::vector<uint8_t>& message, int fd) {
+  struct iovec iov;
+  iov.iov_base = const_cast<uint8_t*>(message.data());
+  iov.iov_len = message.size();
+  struct msghdr header = {};
+  header.msg_iov = &iov;
+  header.msg_iovlen = 1;
+  union {
+    char buffer[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  if (fd >= 0) {
+    memset(&control, 0, sizeof(control));
+    header.msg_control = control.buffer;
+    header.msg_controllen = sizeof(control.buffer);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+  while (true) {
+    ssize_t sent = sendmsg(socket, &header, MSG_NOSIGNAL);
+    if (sent >= 0) {
+      return static_cast<size_t>(sent) == message.size();
+    }
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+}
+
+bool ReceivePacket(int socket, std::vector<uint8_t>* message, int* fd,
+                   int timeout_ms) {
+  *fd = -1;
+  if (timeout_ms >= 0 && !WaitForFd(socket, POLLIN, timeout_ms)) {
+    return false;
+  }
+  message->resize(kMaxMessageSize);
+  struct iovec iov;
+  iov.iov_base = message->data();
+  iov.iov_len = message->size();
+  struct msghdr header = {};
+  header.msg_iov = &iov;
+  header.msg_iovlen = 1;
+  union {
+    char buffer[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  header.msg_control = control.buffer;
+  header.msg_controllen = sizeof(control.buffer);
+  ssize_t received;
+  do {
+    received = recvmsg(socket, &header, MSG_CMSG_CLOEXEC);
+  } while (received < 0 && errno == EINTR);
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&header, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+      memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+  if (received <= 0 || (header.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+    return false;
+  }
+  message->resize(static_cast<size_t>(received));
+  return true;
+}
+
+int CreateSealedBuffer(const uint8_t* data, size_t length) {
+  int fd = memfd_create("thermal_printer_job", MFD_CLOEXEC |
+                                                   MFD_ALLOW_SEALING);
+  if (fd < 0) {
+    return -1;
+  }
+  size_t offset = 0;
+  while (offset < length) {
+    ssize_t written = write(fd, data + offset, length - offset);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      close(fd);
+      return -1;
+    }
+    offset += static_cast<size_t>(written);
+  }
+  if (!SealBuffer(fd)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool SealBuffer(int fd) { return fcntl(fd, F_ADD_SEALS, kSeals) == 0; }
+
+bool ReadSealedBuffer(int fd, std::vector<uint8_t>* data) {
+  // Without the seals the sender could truncate the file while it is mapped
+  // and crash the daemon with SIGBUS.
+  struct stat info;
+  if ((fcntl(fd, F_GET_SEALS) & kSeals) != kSeals || fstat(fd, &info) != 0) {
+    return false;
+  }
+  size_t length = static_cast<size_t>(info.st_size);
+  if (length == 0) {
+    data->clear();
+    return true;
+  }
+  void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(mapping);
+  data->assign(bytes, bytes + length);
+  munmap(mapping, length);
+  return true;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,143 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DAEMON_PROTOCOL_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DAEMON_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "print_queue.h"
+#include "printer_profile.h"
+#include "serial_transport.h"
+
+namespace thermal_printer_flutter {
+
+// Messages between the plugin and the print daemon. Each request and reply
+// is one SOCK_SEQPACKET packet on a Unix domain socket; the bytes of a
+// submitted job are not in the packet but in a sealed memfd passed along
+// with it as SCM_RIGHTS ancillary data.
+//
+// The daemon may run as another user, so it never opens a path a client
+// names with its own rights: a client passes the files it prints, and the
+// file automatic traces go to, as descriptors it opened itself, and gets
+// kDumpTrace's trace back in a sealed memfd with the reply.
+
+enum class DaemonCall : uint8_t {
+  kSubmit = 1,
+  kSubmitFile = 2,
+  kFlush = 3,
+  kStats = 4,
+  kProfile = 5,
+  kSerialOptions = 6,
+  kCoalesce = 7,
+  kGroup = 8,
+  kGroupStats = 9,
+  kLatency = 10,
+  kStatus = 11,
+  kSubmitBatch = 12,
+  kDumpTrace = 13,
+  kTraceThreshold = 14,
+  kWarmUp = 15,
+  // Turns the connection into one the daemon pushes status changes on.
+  kSubscribe = 16,
+};
+
+struct DaemonRequest {
+  DaemonCall call = DaemonCall::kStats;
+  // Empty for kFlush means every printer. The group for kGroup and
+  // kGroupStats. kStatus watches the printer as well.
+  std::string printer;
+  // kSubmit.
+  int copies = 1;
+  std::string key;
+  bool barrier = false;
+  // kSubmitFile: the SerializeFileJobSpec() bytes. The file itself is
+  // passed as a descriptor opened for reading.
+  std::vector<uint8_t> spec;
+  // kSerialOptions.
+  SerialOptions serial;
+  // kCoalesce.
+  CoalesceOptions coalesce;
+  // kGroup, the printers the jobs of a kSubmitBatch envelope, passed as
+  // the memfd, refer to, and the printers kWarmUp warms up.
+  std::vector<std::string> members;
+  // kTraceThreshold; 0 turns automatic dumps off. Otherwise the file they
+  // are written to is passed as a descriptor opened for writing.
+  uint64_t trace_threshold_ms = 0;
+  // kWarmUp: the SerializeFileJobSpec() bytes of each file to read ahead.
+  // Only files the client's user may read are.
+  std::vector<std::vector<uint8_t>> preload;
+};
+
+// A printer whose status changed, with its status when the change was
+// pushed.
+struct PrinterStatusChange {
+  std::string printer;
+  PrinterStatus status;
+};
+
+struct DaemonReply {
+  bool ok = false;
+  // kSubmit and kSubmitFile; 0 if the job was refused.
+  uint64_t job_id = 0;
+  // kStats.
+  PrintQueueStats stats;
+  // kProfile: whether |profile| was resolved or is the generic default.
+  // kLatency: whether the printer has measured any barrier jobs.
+  // kStatus: whether anything is known of the printer's status yet.
+  // kSubmit: whether a refused job would have gone over the daemon's
+  // memory limit.
+  bool resolved = false;
+  PrinterProfile profile;
+  // kGroupStats.
+  std::vector<GroupMemberStats> members;
+  // kLatency.
+  PrinterLatency latency;
+  // kStatus.
+  PrinterStatus status;
+  // kSubmitBatch, as PrintQueue::SubmitBatch() sets them.
+  std::vector<uint64_t> job_ids;
+  // Pushed after kSubscribe: every printer whose status changed since the
+  // last push, once each.
+  std::vector<PrinterStatusChange> statuses;
+};
+
+std::vector<uint8_t> EncodeDaemonRequest(const DaemonRequest& request);
+// Returns false for truncated packets and other protocol versions.
+bool DecodeDaemonRequest(const uint8_t* data, size_t length,
+                         DaemonRequest* request);
+std::vector<uint8_t> EncodeDaemonReply(const DaemonReply& reply);
+bool DecodeDaemonReply(const uint8_t* data, size_t length, DaemonReply* reply);
+
+// $THERMAL_PRINTER_FLUTTER_SOCKET if set, else thermal_printer_flutter.sock
+// in $XDG_RUNTIME_DIR, else a per-user path under /tmp.
+std::string DefaultDaemonSocketPath();
+
+// Sends |message| as one packet on |socket|, passing |fd| along if it is
+// not -1.
+bool SendPacket(int socket, const std::vector<uint8_t>& message, int fd);
+
+// Receives one packet, waiting at most |timeout_ms| (-1 waits forever).
+// |fd| is set to a descriptor passed with it, or -1; the caller owns it.
+// Returns false on timeout, on a closed or failed socket and for packets
+// larger than the largest message.
+bool ReceivePacket(int socket, std::vector<uint8_t>* message, int* fd,
+                   int timeout_ms);
+
+// Copies |data| into a new memfd and seals it against writes and resizing,
+// so the receiver can map it without the sender changing it underneath.
+// Returns -1 on failure.
+int CreateSealedBuffer(const uint8_t* data, size_t length);
+
+// Seals |fd|, a memfd created with MFD_ALLOW_SEALING, as
+// CreateSealedBuffer() does, once it holds what is to be passed.
+bool SealBuffer(int fd);
+
+// Maps the memfd |fd| and copies it into |data|. Returns false unless it
+// carries the seals CreateSealedBuffer() applies.
+bool ReadSealedBuffer(int fd, std::vector<uint8_t>* data);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DAEMON_PROTOCOL_H_
@@ -0,0 +1,167 @@
+#include "device_transport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// usblp's LPIOC_GET_DEVICE_ID(len), which the kernel does not export. The
+// reply is a big-endian length, counting itself, then the ID.
+constexpr size_t kDeviceIdSize = 1024;
+constexpr uint32_t kGetDeviceId = _IOC(_IOC_READ, 'P', 1, kDeviceIdSize);
+
+// usblp copies each write() into a buffer of this size and takes the next
+// one once the printer has received it, so only the last can be lost.
+constexpr size_t kUsblpBufferSize = 8192;
+
+}  // namespace
+
+bool WaitForFd(int fd, short events, int timeout_ms) {
+  struct pollfd pfd = {};
+  pfd.fd = fd;
+  pfd.events = events;
+  int ret;
+  do {
+    ret = poll(&pfd, 1, timeout_ms);
+  } while (ret < 0 && errno == EINTR);
+  return ret > 0 && (pfd.revents & events) != 0;
+}
+
+bool WriteAllNonBlocking(int fd, const uint8_t* data, size_t length,
+                         int timeout_ms, size_t* written) {
+  size_t offset = 0;
+  bool complete = true;
+  while (offset < length) {
+    ssize_t count = write(fd, data + offset, length - offset);
+    if (count > 0) {
+      offset += static_cast<size_t>(count);
+      continue;
+    }
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if ((count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ||
+        !WaitForFd(fd, POLLOUT, timeout_ms)) {
+      complete = false;
+      break;
+    }
+  }
+  if (written != nullptr) {
+    *written = offset;
+  }
+  return complete;
+}
+
+ssize_t WriteNonBlocking(int fd, const uint8_t* data, size_t length) {
+  ssize_t count;
+  do {
+    count = write(fd, data, length);
+  } while (count < 0 && errno == EINTR);
+  if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 0;
+  }
+  return count;
+}
+
+DeviceTransport::DeviceTransport(std::string path, int write_timeout_ms)
+    : path_(std::move(path)), write_timeout_ms_(write_timeout_ms) {}
+
+DeviceTransport::~DeviceTransport() { Close(); }
+
+bool DeviceTransport::Open() {
+  if (fd_ >= 0) {
+    return true;
+  }
+  const int flags = O_NONBLOCK | O_CLOEXEC | O_NOCTTY | O_NOFOLLOW;
+  fd_ = open(path_.c_str(), O_RDWR | flags);
+  if (fd_ < 0 && (errno == EACCES || errno == EROFS)) {
+    // Unidirectional printers only grant write access.
+    fd_ = open(path_.c_str(), O_WRONLY | flags);
+  }
+  // Only ever a device: jobs are never written into a file a printer name
+  // happens to name.
+  struct stat info;
+  if (fd_ >= 0 && (fstat(fd_, &info) != 0 || !S_ISCHR(info.st_mode))) {
+    Close();
+  }
+  sent_ = 0;
+  return fd_ >= 0;
+}
+
+void DeviceTransport::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool DeviceTransport::Write(const uint8_t* data, size_t length) {
+  acknowledged_ = 0;
+  size_t written = 0;
+  bool complete = fd_ >= 0 && WriteAllNonBlocking(fd_, data, length,
+                                                  write_timeout_ms_, &written);
+  sent_ += written;
+  if (complete) {
+    return true;
+  }
+  acknowledged_ = written > kUsblpBufferSize ? written - kUsblpBufferSize : 0;
+  return false;
+}
+
+ssize_t DeviceTransport::WriteSome(const uint8_t* data, size_t length) {
+  if (fd_ < 0) {
+    return -1;
+  }
+  ssize_t count = WriteNonBlocking(fd_, data, length);
+  if (count > 0) {
+    sent_ += static_cast<size_t>(count);
+  }
+  return count;
+}
+
+size_t DeviceTransport::BytesDelivered() const {
+  return sent_ > kUsblpBufferSize ? sent_ - kUsblpBufferSize : 0;
+}
+
+ssize_t DeviceTransport::Read(uint8_t* data, size_t length, int timeout_ms) {
+  if (fd_ < 0) {
+    return -1;
+  }
+  if (!WaitForFd(fd_, POLLIN, timeout_ms)) {
+    return 0;
+  }
+  ssize_t ret;
+  do {
+    ret = read(fd_, data, length);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 0;
+  }
+  return ret;
+}
+
+bool DeviceTransport::ReadDeviceId(std::string* id) {
+  if (fd_ < 0) {
+    return false;
+  }
+  uint8_t buffer[kDeviceIdSize] = {};
+  if (ioctl(fd_, kGetDeviceId, buffer) < 0) {
+    return false;
+  }
+  size_t length = (static_cast<size_t>(buffer[0]) << 8) | buffer[1];
+  if (length < 2 || length > sizeof(buffer)) {
+    return false;
+  }
+  id->assign(reinterpret_cast<const char*>(buffer) + 2, length - 2);
+  return true;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,65 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DEVICE_TRANSPORT_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DEVICE_TRANSPORT_H_
+
+#include <string>
+
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// Transport for character devices such as /dev/usb/lp0. The device is opened
+// non-blocking and writes wait for POLLOUT, so a printer that stops draining
+// (paper out, cover open) fails the write after |write_timeout_ms| instead of
+// hanging the worker forever.
+class DeviceTransport : public Transport {
+ public:
+  explicit DeviceTransport(std::string path, int write_timeout_ms = 10000);
+  ~DeviceTransport() override;
+
+  DeviceTransport(const DeviceTransport&) = delete;
+  DeviceTransport& operator=(const DeviceTransport&) = delete;
+
+  bool Open() override;
+  void Close() override;
+  bool IsOpen() const override { return fd_ >= 0; }
+  bool Write(const uint8_t* data, size_t length) override;
+  // What write() accepted, less the buffer usblp may not have sent yet.
+  size_t Acknowledged() const override { return acknowledged_; }
+  int StreamFd() const override { return fd_; }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override;
+  size_t BytesSent() const override { return sent_; }
+  size_t BytesDelivered() const override;
+  int write_timeout_ms() const override { return write_timeout_ms_; }
+  ssize_t Read(uint8_t* data, size_t length, int timeout_ms) override;
+  // Asks the usblp driver, which keeps the ID it read when the printer was
+  // plugged in. Fails for devices other than USB printers.
+  bool ReadDeviceId(std::string* id) override;
+
+  const std::string& path() const { return path_; }
+  int fd() const { return fd_; }
+
+ private:
+  std::string path_;
+  int write_timeout_ms_;
+  int fd_ = -1;
+  size_t acknowledged_ = 0;
+  // Bytes Write() and WriteSome() have written since Open().
+  size_t sent_ = 0;
+};
+
+// Returns true if |fd| became ready for |events| within |timeout_ms|.
+bool WaitForFd(int fd, short events, int timeout_ms);
+
+// Writes all of |data| to the non-blocking |fd|, polling between short
+// writes. Fails if the descriptor stays unwritable for |timeout_ms|.
+// |written|, if given, is set to the bytes write() accepted.
+bool WriteAllNonBlocking(int fd, const uint8_t* data, size_t length,
+                         int timeout_ms, size_t* written = nullptr);
+
+// One write() to the non-blocking |fd|: the bytes written, 0 if it would
+// block and -1 on failure.
+ssize_t WriteNonBlocking(int fd, const uint8_t* data, size_t length);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_DEVICE_TRANSPORT_H_
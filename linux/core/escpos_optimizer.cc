@@ -0,0 +1,430 @@
+#include "escpos_optimizer.h"
+
+#include <algorithm>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr uint8_t kLf = 0x0A;
+constexpr uint8_t kDle = 0x10;
+constexpr uint8_t kEsc = 0x1B;
+constexpr uint8_t kFs = 0x1C;
+constexpr uint8_t kGs = 0x1D;
+
+bool IsCommandStart(uint8_t byte) {
+  return byte == kEsc || byte == kGs || byte == kFs || byte == kDle;
+}
+
+size_t Word(const uint8_t* p) {
+  return p[0] | (static_cast<size_t>(p[1]) << 8);
+}
+
+// Length of a parameter list that ends with a NUL, starting at |from|.
+size_t NulTerminated(const uint8_t* p, size_t available, size_t from) {
+  for (size_t i = from; i < available; i++) {
+    if (p[i] == 0) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+size_t EscLength(const uint8_t* p, size_t available) {
+  switch (p[1]) {
+    case '@': case '2': case '<': case 'L': case 'S': case 'i': case 'm':
+    case 0x0C:
+      return 2;
+    case ' ': case '!': case '%': case '-': case '3': case '=': case '?':
+    case 'E': case 'G': case 'J': case 'K': case 'M': case 'R': case 'T':
+    case 'U': case 'V': case 'a': case 'd': case 'e': case 'r': case 't':
+    case 'u': case '{':
+      return 3;
+    case '$': case '\\':
+      return 4;
+    case 'c':
+      // ESC c 3 n, ESC c 4 n and ESC c 5 n: paper sensors and panel keys.
+      return available >= 3 && p[2] >= '3' && p[2] <= '5' ? 4 : 0;
+    case 'p':
+      return 5;
+    case 'W':
+      return 10;
+    case 'D':
+      return NulTerminated(p, available, 2);
+    case '*': {
+      // ESC * m nL nH: n columns of 1 (8-dot) or 3 (24-dot) bytes.
+      if (available < 5) {
+        return 0;
+      }
+      const uint8_t m = p[2];
+      if (m == 0 || m == 1) {
+        return 5 + Word(p + 3);
+      }
+      if (m == 32 || m == 33) {
+        return 5 + 3 * Word(p + 3);
+      }
+      return 0;
+    }
+    case '&': {
+      // ESC & y c1 c2, then x and y * x bytes per character.
+      if (available < 5 || p[4] < p[3]) {
+        return 0;
+      }
+      size_t offset = 5;
+      for (int code = p[3]; code <= p[4]; code++) {
+        if (offset >= available) {
+          return 0;
+        }
+        offset += 1 + static_cast<size_t>(p[2]) * p[offset];
+      }
+      return offset;
+    }
+    case '(':
+      return available >= 5 ? 5 + Word(p + 3) : 0;
+  }
+  return 0;
+}
+
+size_t GsLength(const uint8_t* p, size_t available) {
+  switch (p[1]) {
+    case ':':
+      return 2;
+    case '!': case '/': case 'B': case 'E': case 'H': case 'I': case 'T':
+    case 'a': case 'b': case 'f': case 'h': case 'j': case 'r': case 'w':
+      return 3;
+    case '$': case 'L': case 'P': case 'W': case '\\':
+      return 4;
+    case '^': case 'g':
+      return 5;
+    case 'V': {
+      if (available < 3) {
+        return 0;
+      }
+      const uint8_t m = p[2];
+      if (m == 0 || m == 1 || m == 48 || m == 49) {
+        return 3;
+      }
+      if (m == 65 || m == 66 || m == 97 || m == 98 || m == 103 || m == 104) {
+        return 4;
+      }
+      return 0;
+    }
+    case 'k': {
+      if (available < 3) {
+        return 0;
+      }
+      const uint8_t m = p[2];
+      if (m <= 6) {
+        return NulTerminated(p, available, 3);
+      }
+      if (m >= 65 && m <= 79) {
+        return available >= 4 ? 4 + p[3] : 0;
+      }
+      return 0;
+    }
+    case '(':
+      return available >= 5 ? 5 + Word(p + 3) : 0;
+    case '8':
+      // GS 8 L p1 p2 p3 p4: the 32-bit form of GS ( L.
+      if (available < 7 || p[2] != 'L') {
+        return 0;
+      }
+      return 7 + (Word(p + 3) | (Word(p + 5) << 16));
+    case '*':
+      return available >= 4 ? 4 + static_cast<size_t>(p[2]) * p[3] * 8 : 0;
+    case 'v':
+      // GS v 0 m xL xH yL yH: x bytes by y rows.
+      if (available < 8 || p[2] != '0') {
+        return 0;
+      }
+      return 8 + Word(p + 4) * Word(p + 6);
+  }
+  return 0;
+}
+
+size_t FsLength(const uint8_t* p, size_t available) {
+  switch (p[1]) {
+    case '&': case '.':
+      return 2;
+    case '!': case '-': case 'W':
+      return 3;
+    case 'S': case 'p':
+      return 4;
+    case '(':
+      return available >= 5 ? 5 + Word(p + 3) : 0;
+    case 'q': {
+      // FS q n, then xL xH yL yH and x * y * 8 bytes per image.
+      if (available < 3) {
+        return 0;
+      }
+      size_t offset = 3;
+      for (int image = 0; image < p[2]; image++) {
+        if (offset + 4 > available) {
+          return 0;
+        }
+        offset += 4 + Word(p + offset) * Word(p + offset + 2) * 8;
+      }
+      return offset;
+    }
+  }
+  return 0;
+}
+
+size_t DleLength(const uint8_t* p, size_t available) {
+  switch (p[1]) {
+    case 0x04:  // DLE EOT n
+    case 0x05:  // DLE ENQ n
+      return 3;
+    case 0x14:  // DLE DC4 fn ...
+      if (available < 3) {
+        return 0;
+      }
+      if (p[2] == 1 || p[2] == 2) {
+        return 5;
+      }
+      return p[2] == 8 ? 10 : 0;
+  }
+  return 0;
+}
+
+// Length of the command at |p|, parameters and data included, or 0 if it
+// is not a known command or does not fit in |available| bytes.
+size_t CommandLength(const uint8_t* p, size_t available) {
+  if (available < 2) {
+    return 0;
+  }
+  size_t length = 0;
+  switch (p[0]) {
+    case kEsc:
+      length = EscLength(p, available);
+      break;
+    case kGs:
+      length = GsLength(p, available);
+      break;
+    case kFs:
+      length = FsLength(p, available);
+      break;
+    case kDle:
+      length = DleLength(p, available);
+      break;
+  }
+  return length <= available ? length : 0;
+}
+
+// Printer settings the optimizer follows.
+enum Slot {
+  kPrintMode,      // ESC !
+  kEmphasis,       // ESC E
+  kUnderline,      // ESC -
+  kDoubleStrike,   // ESC G
+  kFont,           // ESC M
+  kCharacterSize,  // GS !
+  kReverse,        // GS B
+  kJustification,  // ESC a
+  kCodePage,       // ESC t
+  kCharacterSet,   // ESC R
+  kLineSpacing,    // ESC 2, ESC 3
+  kUpsideDown,     // ESC {
+  kSlotCount,
+};
+
+constexpr int kUnknown = -1;
+// ESC 2, the default line spacing, told apart from every ESC 3 n.
+constexpr int kDefaultLineSpacing = 256;
+
+// The setting |p| changes and the value it sets, if it is a mode command.
+bool ModeSetting(const uint8_t* p, Slot* slot, int* value) {
+  if (p[0] == kEsc) {
+    switch (p[1]) {
+      case '!': *slot = kPrintMode; break;
+      case 'E': *slot = kEmphasis; break;
+      case '-': *slot = kUnderline; break;
+      case 'G': *slot = kDoubleStrike; break;
+      case 'M': *slot = kFont; break;
+      case 'a': *slot = kJustification; break;
+      case 't': *slot = kCodePage; break;
+      case 'R': *slot = kCharacterSet; break;
+      case '3': *slot = kLineSpacing; break;
+      case '{': *slot = kUpsideDown; break;
+      case '2':
+        *slot = kLineSpacing;
+        *value = kDefaultLineSpacing;
+        return true;
+      default:
+        return false;
+    }
+  } else if (p[0] == kGs && (p[1] == '!' || p[1] == 'B')) {
+    *slot = p[1] == '!' ? kCharacterSize : kReverse;
+  } else {
+    return false;
+  }
+  *value = p[2];
+  return true;
+}
+
+class Optimizer {
+ public:
+  explicit Optimizer(std::vector<uint8_t>* output) : output_(output) {
+    Forget();
+  }
+
+  void Text(const uint8_t* data, size_t length) {
+    FlushFeeds();
+    Append(data, length);
+  }
+
+  void LineFeed() {
+    if (pending_dots_ > 0) {
+      FlushFeeds();
+    }
+    pending_lines_++;
+  }
+
+  void Command(const uint8_t* p, size_t length);
+
+  // Writes the feeds held back for merging.
+  void FlushFeeds();
+
+  int removed() const { return removed_; }
+
+ private:
+  void Append(const uint8_t* data, size_t length) {
+    output_->insert(output_->end(), data, data + length);
+  }
+
+  void Forget() { std::fill(state_, state_ + kSlotCount, kUnknown); }
+
+  std::vector<uint8_t>* output_;
+  int state_[kSlotCount];
+  int pending_lines_ = 0;
+  int pending_dots_ = 0;
+  int removed_ = 0;
+};
+
+void Optimizer::Command(const uint8_t* p, size_t length) {
+  Slot slot;
+  int value;
+  if (ModeSetting(p, &slot, &value)) {
+    if (state_[slot] == value) {
+      removed_++;
+      return;
+    }
+    FlushFeeds();
+    Append(p, length);
+    state_[slot] = value;
+    // ESC ! sets the font, emphasis, underline and double size bits at
+    // once, and each of those commands changes part of what it set.
+    if (slot == kPrintMode) {
+      state_[kEmphasis] = kUnknown;
+      state_[kUnderline] = kUnknown;
+      state_[kFont] = kUnknown;
+      state_[kCharacterSize] = kUnknown;
+    } else if (slot == kEmphasis || slot == kUnderline || slot == kFont ||
+               slot == kCharacterSize) {
+      state_[kPrintMode] = kUnknown;
+    }
+    return;
+  }
+  // ESC d n and ESC J n print the buffer and feed n lines or dots, as n
+  // line feeds would.
+  if (p[0] == kEsc && p[1] == 'd' && p[2] > 0) {
+    if (pending_dots_ > 0) {
+      FlushFeeds();
+    }
+    pending_lines_ += p[2];
+    return;
+  }
+  if (p[0] == kEsc && p[1] == 'J' && p[2] > 0) {
+    if (pending_lines_ > 0) {
+      FlushFeeds();
+    }
+    pending_dots_ += p[2];
+    return;
+  }
+  FlushFeeds();
+  Append(p, length);
+  // ESC @ restores the power-on settings, which are configurable.
+  if (p[0] == kEsc && p[1] == '@') {
+    Forget();
+  }
+}
+
+void Optimizer::FlushFeeds() {
+  // Up to three line feeds are shorter than ESC d n.
+  while (pending_lines_ >= 4) {
+    int lines = std::min(pending_lines_, 255);
+    const uint8_t feed[] = {kEsc, 'd', static_cast<uint8_t>(lines)};
+    Append(feed, sizeof(feed));
+    pending_lines_ -= lines;
+  }
+  output_->insert(output_->end(), pending_lines_, kLf);
+  pending_lines_ = 0;
+  while (pending_dots_ > 0) {
+    int dots = std::min(pending_dots_, 255);
+    const uint8_t feed[] = {kEsc, 'J', static_cast<uint8_t>(dots)};
+    Append(feed, sizeof(feed));
+    pending_dots_ -= dots;
+  }
+}
+
+}  // namespace
+
+bool OptimizeEscPos(const uint8_t* data, size_t length,
+                    std::vector<uint8_t>* output, EscPosStats* stats) {
+  const size_t start = output->size();
+  output->reserve(start + length);
+  Optimizer optimizer(output);
+  size_t offset = 0;
+  while (offset < length) {
+    const uint8_t byte = data[offset];
+    if (byte == kLf) {
+      optimizer.LineFeed();
+      offset++;
+      continue;
+    }
+    if (!IsCommandStart(byte)) {
+      size_t end = offset + 1;
+      while (end < length && data[end] != kLf && !IsCommandStart(data[end])) {
+        end++;
+      }
+      optimizer.Text(data + offset, end - offset);
+      offset = end;
+      continue;
+    }
+    size_t command = CommandLength(data + offset, length - offset);
+    if (command == 0) {
+      break;
+    }
+    optimizer.Command(data + offset, command);
+    offset += command;
+  }
+  optimizer.FlushFeeds();
+  output->insert(output->end(), data + offset, data + length);
+
+  if (stats != nullptr) {
+    stats->bytes_in = length;
+    stats->bytes_out = output->size() - start;
+    stats->commands_removed = optimizer.removed();
+    stats->parsed = offset;
+  }
+  return offset == length;
+}
+
+size_t CommandBoundary(const uint8_t* data, size_t length, size_t offset) {
+  offset = std::min(offset, length);
+  size_t position = 0;
+  while (position < offset) {
+    if (!IsCommandStart(data[position])) {
+      position++;
+      continue;
+    }
+    size_t command = CommandLength(data + position, length - position);
+    if (command == 0 || position + command > offset) {
+      return position;
+    }
+    position += command;
+  }
+  return position;
+}
+
+}  // namespace thermal_printer_flutter
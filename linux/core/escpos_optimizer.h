@@ -0,0 +1,42 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_ESCPOS_OPTIMIZER_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_ESCPOS_OPTIMIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+struct EscPosStats {
+  size_t bytes_in = 0;
+  size_t bytes_out = 0;
+  // Mode changes dropped because the printer was already in that mode.
+  int commands_removed = 0;
+  // Bytes of the input that were parsed; the rest, from the first command
+  // that is unknown or cut short, is passed through untouched.
+  size_t parsed = 0;
+};
+
+// Rewrites an ESC/POS stream in one pass into a shorter one that prints the
+// same. Character and paragraph mode commands (ESC !, ESC E, ESC a, ESC t,
+// GS ! and friends) that repeat the printer's current setting are dropped,
+// which joins the text runs either side of them, and consecutive line or
+// dot feeds are merged into a single ESC d or ESC J.
+//
+// Every command's length is checked against the ESC/POS command set. The
+// printer's state is unknown at the start of the stream, since earlier
+// jobs may have changed it, so only changes made within the stream can be
+// proven redundant. Returns false if parsing stopped before the end of the
+// stream; |output| is complete either way.
+bool OptimizeEscPos(const uint8_t* data, size_t length,
+                    std::vector<uint8_t>* output, EscPosStats* stats);
+
+// The last point at or before |offset| that |data| can be resent from
+// without splitting a command: the start of the command |offset| falls in,
+// or |offset| itself if it falls in text. Parsing stops at the first
+// unknown command, which is then the furthest boundary.
+size_t CommandBoundary(const uint8_t* data, size_t length, size_t offset);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_ESCPOS_OPTIMIZER_H_
@@ -0,0 +1,245 @@
+#include "file_source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr uint8_t kSpecVersion = 2;
+// version, format, flags, threshold, width (u16), band height (u16),
+// bitmap width (u32), device (u64), inode (u64), then the path. Version 1,
+// still read from old journals, has no device and inode.
+constexpr size_t kSpecHeaderSize = 28;
+constexpr size_t kVersion1HeaderSize = 12;
+// Flags: bit 0 dither, bit 1 mirror, bits 2-3 quarter turns clockwise.
+constexpr uint8_t kFlagDither = 0x01;
+constexpr uint8_t kFlagMirror = 0x02;
+constexpr int kRotationShift = 2;
+
+size_t PageSize() {
+  static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return page_size;
+}
+
+class EscPosFileSource : public JobSource {
+ public:
+  explicit EscPosFileSource(std::unique_ptr<MappedFile> file)
+      : file_(std::move(file)) {}
+
+  bool Next(const uint8_t** data, size_t* length) override {
+    file_->Release(offset_);
+    if (offset_ >= file_->size()) {
+      return false;
+    }
+    *data = file_->data() + offset_;
+    *length = std::min(kFileChunkSize, file_->size() - offset_);
+    offset_ += *length;
+    return true;
+  }
+
+  bool failed() const override { return false; }
+
+  bool TotalLength(uint64_t* length) const override {
+    *length = file_->size();
+    return true;
+  }
+
+ private:
+  std::unique_ptr<MappedFile> file_;
+  size_t offset_ = 0;
+};
+
+// Alternates a GS v 0 header with the band's rows, which are written
+// straight out of the mapping.
+class BitmapFileSource : public JobSource {
+ public:
+  BitmapFileSource(std::unique_ptr<MappedFile> file, int width,
+                   int band_height)
+      : file_(std::move(file)),
+        bytes_per_row_(static_cast<size_t>(width) / 8),
+        rows_(bytes_per_row_ != 0 ? file_->size() / bytes_per_row_ : 0),
+        band_height_(static_cast<size_t>(
+            std::max(1, std::min(band_height, 0xFFFF)))) {}
+
+  bool Next(const uint8_t** data, size_t* length) override {
+    file_->Release(row_ * bytes_per_row_);
+    if (pending_rows_ != 0) {
+      *data = file_->data() + row_ * bytes_per_row_;
+      *length = pending_rows_ * bytes_per_row_;
+      row_ += pending_rows_;
+      pending_rows_ = 0;
+      return true;
+    }
+    if (row_ >= rows_) {
+      return false;
+    }
+    pending_rows_ = std::min(band_height_, rows_ - row_);
+    header_[0] = 0x1D;
+    header_[1] = 0x76;
+    header_[2] = 0x30;
+    header_[3] = 0x00;
+    header_[4] = static_cast<uint8_t>(bytes_per_row_ & 0xFF);
+    header_[5] = static_cast<uint8_t>(bytes_per_row_ >> 8);
+    header_[6] = static_cast<uint8_t>(pending_rows_ & 0xFF);
+    header_[7] = static_cast<uint8_t>(pending_rows_ >> 8);
+    *data = header_;
+    *length = sizeof(header_);
+    return true;
+  }
+
+  bool failed() const override { return false; }
+
+  // The rows, and a header per band.
+  bool TotalLength(uint64_t* length) const override {
+    size_t bands = (rows_ + band_height_ - 1) / band_height_;
+    *length = rows_ * bytes_per_row_ + bands * sizeof(header_);
+    return true;
+  }
+
+ private:
+  std::unique_ptr<MappedFile> file_;
+  size_t bytes_per_row_;
+  size_t rows_;
+  size_t band_height_;
+  size_t row_ = 0;
+  size_t pending_rows_ = 0;
+  uint8_t header_[8];
+};
+
+}  // namespace
+
+std::vector<uint8_t> SerializeFileJobSpec(const FileJobSpec& spec) {
+  std::vector<uint8_t> out(kSpecHeaderSize + spec.path.size());
+  out[0] = kSpecVersion;
+  out[1] = static_cast<uint8_t>(spec.format);
+  out[2] = static_cast<uint8_t>(
+      (spec.raster.dither == DitherMode::kFloydSteinberg ? kFlagDither : 0) |
+      (spec.raster.mirror ? kFlagMirror : 0) |
+      (static_cast<int>(spec.raster.rotation) << kRotationShift));
+  out[3] = static_cast<uint8_t>(std::max(0, std::min(spec.raster.threshold,
+                                                     255)));
+  uint16_t width = static_cast<uint16_t>(spec.raster.width);
+  uint16_t band_height = static_cast<uint16_t>(spec.raster.band_height);
+  uint32_t bitmap_width = static_cast<uint32_t>(spec.bitmap_width);
+  memcpy(&out[4], &width, sizeof(width));
+  memcpy(&out[6], &band_height, sizeof(band_height));
+  memcpy(&out[8], &bitmap_width, sizeof(bitmap_width));
+  memcpy(&out[12], &spec.device, sizeof(spec.device));
+  memcpy(&out[20], &spec.inode, sizeof(spec.inode));
+  memcpy(out.data() + kSpecHeaderSize, spec.path.data(), spec.path.size());
+  return out;
+}
+
+bool ParseFileJobSpec(const uint8_t* data, size_t length, FileJobSpec* spec) {
+  size_t header_size =
+      length > 0 && data[0] == 1 ? kVersion1HeaderSize : kSpecHeaderSize;
+  if (length < header_size || (data[0] != 1 && data[0] != kSpecVersion) ||
+      data[1] < static_cast<uint8_t>(FileFormat::kEscPos) ||
+      data[1] > static_cast<uint8_t>(FileFormat::kImage)) {
+    return false;
+  }
+  spec->format = static_cast<FileFormat>(data[1]);
+  spec->raster.dither = (data[2] & kFlagDither) != 0
+                            ? DitherMode::kFloydSteinberg
+                            : DitherMode::kThreshold;
+  spec->raster.mirror = (data[2] & kFlagMirror) != 0;
+  spec->raster.rotation =
+      static_cast<Rotation>((data[2] >> kRotationShift) & 0x03);
+  spec->raster.threshold = data[3];
+  uint16_t width;
+  uint16_t band_height;
+  uint32_t bitmap_width;
+  memcpy(&width, data + 4, sizeof(width));
+  memcpy(&band_height, data + 6, sizeof(band_height));
+  memcpy(&bitmap_width, data + 8, sizeof(bitmap_width));
+  spec->raster.width = width;
+  spec->raster.band_height = band_height;
+  spec->bitmap_width = static_cast<int>(bitmap_width);
+  spec->device = 0;
+  spec->inode = 0;
+  if (header_size == kSpecHeaderSize) {
+    memcpy(&spec->device, data + 12, sizeof(spec->device));
+    memcpy(&spec->inode, data + 20, sizeof(spec->inode));
+  }
+  spec->path.assign(reinterpret_cast<const char*>(data) + header_size,
+                    length - header_size);
+  return !spec->path.empty();
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string& path, uint64_t device,
+                      uint64_t inode) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      (device != 0 && static_cast<uint64_t>(st.st_dev) != device) ||
+      (inode != 0 && static_cast<uint64_t>(st.st_ino) != inode)) {
+    close(fd);
+    return false;
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0) {
+    void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      close(fd);
+      size_ = 0;
+      return false;
+    }
+    data_ = static_cast<uint8_t*>(map);
+    madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  // The mapping keeps the file referenced.
+  close(fd);
+  released_ = 0;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+    data_ = nullptr;
+  }
+  size_ = 0;
+  released_ = 0;
+}
+
+void MappedFile::Release(size_t end) {
+  size_t aligned_end = std::min(end, size_) / PageSize() * PageSize();
+  if (data_ == nullptr || aligned_end <= released_) {
+    return;
+  }
+  madvise(data_ + released_, aligned_end - released_, MADV_DONTNEED);
+  released_ = aligned_end;
+}
+
+std::unique_ptr<JobSource> OpenFileSource(const FileJobSpec& spec) {
+  if (spec.format == FileFormat::kImage ||
+      (spec.format == FileFormat::kBitmap &&
+       (spec.bitmap_width <= 0 || spec.bitmap_width % 8 != 0))) {
+    return nullptr;
+  }
+  std::unique_ptr<MappedFile> file(new MappedFile());
+  if (!file->Open(spec.path, spec.device, spec.inode)) {
+    return nullptr;
+  }
+  if (spec.format == FileFormat::kBitmap) {
+    return std::unique_ptr<JobSource>(new BitmapFileSource(
+        std::move(file), spec.bitmap_width, spec.raster.band_height));
+  }
+  return std::unique_ptr<JobSource>(new EscPosFileSource(std::move(file)));
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,82 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_FILE_SOURCE_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_FILE_SOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "job_source.h"
+#include "raster_encoder.h"
+
+namespace thermal_printer_flutter {
+
+enum class FileFormat : uint8_t {
+  // Printer commands, sent as they are.
+  kEscPos = 1,
+  // Packed 1bpp rows, most significant bit first, 1 = black.
+  kBitmap = 2,
+  // PNG or JPEG, decoded by the platform layer.
+  kImage = 3,
+};
+
+// Everything needed to print a file, small enough to journal in place of the
+// file's contents.
+struct FileJobSpec {
+  std::string path;
+  FileFormat format = FileFormat::kEscPos;
+  // kBitmap: row width in dots, a multiple of 8.
+  int bitmap_width = 0;
+  // kBitmap uses band_height; kImage uses all of it.
+  RasterOptions raster;
+  // The file's device and inode when it was submitted, or 0. Set, the job
+  // only prints that file, whatever |path| names by then: the print daemon
+  // pins the file its client opened.
+  uint64_t device = 0;
+  uint64_t inode = 0;
+};
+
+std::vector<uint8_t> SerializeFileJobSpec(const FileJobSpec& spec);
+bool ParseFileJobSpec(const uint8_t* data, size_t length, FileJobSpec* spec);
+
+// Read-only mapping of a whole file that can hand consumed pages back to the
+// kernel, so reading a file front to back keeps only a window resident.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Fails for anything but a regular file, and unless the file is
+  // |device| and |inode| if they are set.
+  bool Open(const std::string& path, uint64_t device = 0,
+            uint64_t inode = 0);
+  void Close();
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Drops the pages wholly below |end| from this process. They are clean
+  // file pages, so this frees them immediately and a later access would
+  // simply read them again.
+  void Release(size_t end);
+
+ private:
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  size_t released_ = 0;
+};
+
+// Opens the ESC/POS and bitmap formats. Returns null for kImage, which
+// needs the platform's image decoder, and for files that cannot be mapped.
+std::unique_ptr<JobSource> OpenFileSource(const FileJobSpec& spec);
+
+// Size of the pieces ESC/POS files are written in.
+constexpr size_t kFileChunkSize = 64 * 1024;
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_FILE_SOURCE_H_
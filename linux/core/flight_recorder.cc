@@ -0,0 +1,450 @@
+#include "flight_recorder.h"
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+constexpr size_t FlightRecorder::kEventsPerThread;
+constexpr size_t FlightRecorder::kMaxThreads;
+constexpr std::chrono::seconds FlightRecorder::kAutoDumpInterval;
+
+namespace {
+
+std::atomic<uint64_t> next_serial(1);
+
+uint32_t CurrentThreadId() {
+  static thread_local uint32_t id =
+      static_cast<uint32_t>(syscall(SYS_gettid));
+  return id;
+}
+
+const char* StageName(uint8_t stage) {
+  switch (static_cast<TraceStage>(stage)) {
+    case TraceStage::kConnect:
+      return "connect";
+    case TraceStage::kIdentify:
+      return "identify";
+    case TraceStage::kJournal:
+      return "journal";
+    case TraceStage::kWrite:
+      return "write";
+    case TraceStage::kBarrier:
+      return "barrier";
+    case TraceStage::kProbe:
+      return "probe";
+    case TraceStage::kWarmUp:
+      return "warm-up";
+  }
+  return "stage";
+}
+
+// |text| as a JSON string, quotes included.
+std::string JsonString(const std::string& text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+// Writes |events| to |file| in the Trace Event Format. |printers| are the
+// names events refer to, as JSON strings.
+void WriteTraceEvents(const std::vector<TraceEvent>& events,
+                      const std::vector<std::string>& printers, FILE* file) {
+  int pid = static_cast<int>(getpid());
+  fprintf(file,
+          "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+          "\"args\":{\"name\":\"thermal_printer_flutter\"}}",
+          pid);
+  // Stages open on each thread; the end of a stage whose beginning was
+  // overwritten is left out.
+  std::map<uint32_t, int> open_stages;
+  for (const TraceEvent& event : events) {
+    const char* printer = event.printer > 0 && event.printer <= printers.size()
+                              ? printers[event.printer - 1].c_str()
+                              : "null";
+    // Microseconds, as the format wants them.
+    char ts[32];
+    snprintf(ts, sizeof(ts), "%" PRId64 ".%03d", event.timestamp_ns / 1000,
+             static_cast<int>(event.timestamp_ns % 1000));
+    char common[96];
+    snprintf(common, sizeof(common), "\"ts\":%s,\"pid\":%d,\"tid\":%" PRIu32,
+             ts, pid, event.thread);
+    switch (event.type) {
+      case TraceEventType::kEnqueue:
+        fprintf(file,
+                ",\n{\"name\":\"queued\",\"cat\":\"job\",\"ph\":\"b\","
+                "\"id\":%" PRIu64 ",%s,\"args\":{\"printer\":%s,"
+                "\"bytes\":%" PRId64 "}}",
+                event.job, common, printer, event.value);
+        break;
+      case TraceEventType::kDequeue:
+        fprintf(file,
+                ",\n{\"name\":\"queued\",\"cat\":\"job\",\"ph\":\"e\","
+                "\"id\":%" PRIu64 ",%s}"
+                ",\n{\"name\":\"printing\",\"cat\":\"job\",\"ph\":\"b\","
+                "\"id\":%" PRIu64 ",%s,\"args\":{\"printer\":%s}}",
+                event.job, common, event.job, common, printer);
+        break;
+      case TraceEventType::kFinish:
+        fprintf(file,
+                ",\n{\"name\":\"printing\",\"cat\":\"job\",\"ph\":\"e\","
+                "\"id\":%" PRIu64 ",%s,\"args\":{\"printed\":%s}}",
+                event.job, common, event.value != 0 ? "true" : "false");
+        break;
+      case TraceEventType::kStageBegin:
+        open_stages[event.thread]++;
+        fprintf(file,
+                ",\n{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"B\",%s,"
+                "\"args\":{\"printer\":%s,\"job\":%" PRIu64,
+                StageName(event.detail), common, printer, event.job);
+        if (static_cast<TraceStage>(event.detail) == TraceStage::kWrite) {
+          fprintf(file, ",\"bytes\":%" PRId64, event.value);
+        }
+        fprintf(file, "}}");
+        break;
+      case TraceEventType::kStageEnd:
+        if (open_stages[event.thread] == 0) {
+          break;
+        }
+        open_stages[event.thread]--;
+        if (static_cast<TraceStage>(event.detail) == TraceStage::kWrite) {
+          fprintf(file,
+                  ",\n{\"ph\":\"E\",%s,\"args\":{\"written\":%" PRId64 "}}",
+                  common, event.value);
+        } else {
+          fprintf(file, ",\n{\"ph\":\"E\",%s,\"args\":{\"ok\":%s}}", common,
+                  event.value != 0 ? "true" : "false");
+        }
+        break;
+      case TraceEventType::kReconnect:
+        fprintf(file,
+                ",\n{\"name\":\"reconnect\",\"ph\":\"i\",\"s\":\"t\",%s,"
+                "\"args\":{\"printer\":%s,\"job\":%" PRIu64
+                ",\"attempt\":%" PRId64 "}}",
+                common, printer, event.job, event.value);
+        break;
+      case TraceEventType::kStatusReply:
+        fprintf(file,
+                ",\n{\"name\":\"status\",\"ph\":\"i\",\"s\":\"t\",%s,"
+                "\"args\":{\"printer\":%s,\"request\":%d,"
+                "\"reply\":%" PRId64 "}}",
+                common, printer, event.detail, event.value);
+        break;
+    }
+  }
+  fprintf(file, "\n]}\n");
+}
+
+// Writes the trace to |path| through a temporary file, so a reader never
+// sees half of it.
+bool WriteTraceFile(const std::vector<TraceEvent>& events,
+                    const std::vector<std::string>& printers,
+                    const std::string& path) {
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "we");
+  if (file == nullptr) {
+    return false;
+  }
+  WriteTraceEvents(events, printers, file);
+  bool written = !ferror(file);
+  written = fclose(file) == 0 && written;
+  if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Writes the trace over what |fd| holds, through a descriptor of its own.
+bool WriteTraceToFd(const std::vector<TraceEvent>& events,
+                    const std::vector<std::string>& printers, int fd) {
+  int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (copy < 0) {
+    return false;
+  }
+  FILE* file = nullptr;
+  if (ftruncate(copy, 0) == 0 && lseek(copy, 0, SEEK_SET) == 0) {
+    file = fdopen(copy, "w");
+  }
+  if (file == nullptr) {
+    close(copy);
+    return false;
+  }
+  WriteTraceEvents(events, printers, file);
+  bool written = !ferror(file);
+  return fclose(file) == 0 && written;
+}
+
+}  // namespace
+
+// One thread's events. Its owner writes an event's slot between raising
+// |claimed| and |written|, so a reader that copied a slot and then finds
+// |claimed| past it knows the copy may be torn.
+struct FlightRecorder::Ring {
+  // Timestamp, job, value, and type | detail << 8 | printer << 16 |
+  // thread << 32.
+  std::atomic<uint64_t> slots[kEventsPerThread][4];
+  std::atomic<uint64_t> claimed{0};
+  std::atomic<uint64_t> written{0};
+  std::atomic<bool> in_use{false};
+};
+
+FlightRecorder::FlightRecorder()
+    : serial_(next_serial.fetch_add(1)),
+      auto_dump_threshold_ns_(0),
+      dropped_(0) {}
+
+FlightRecorder::~FlightRecorder() {
+  {
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    if (dump_thread_.joinable()) {
+      dump_thread_.join();
+    }
+  }
+  if (auto_dump_fd_ >= 0) {
+    close(auto_dump_fd_);
+  }
+}
+
+uint16_t FlightRecorder::PrinterIndex(const std::string& printer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::find(printers_.begin(), printers_.end(), printer);
+  if (it != printers_.end()) {
+    return static_cast<uint16_t>(it - printers_.begin() + 1);
+  }
+  if (printers_.size() >= UINT16_MAX) {
+    return 0;
+  }
+  printers_.push_back(printer);
+  return static_cast<uint16_t>(printers_.size());
+}
+
+FlightRecorder::Ring* FlightRecorder::ThreadRing() {
+  // Gives the ring back when the thread exits, or moves on to another
+  // recorder.
+  struct Local {
+    ~Local() { Release(); }
+    void Release() {
+      if (ring) {
+        ring->in_use.store(false, std::memory_order_release);
+        ring.reset();
+      }
+    }
+    uint64_t serial = 0;
+    std::shared_ptr<Ring> ring;
+  };
+  static thread_local Local local;
+  if (local.serial == serial_) {
+    return local.ring.get();
+  }
+  local.Release();
+  local.serial = serial_;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::shared_ptr<Ring>& ring : rings_) {
+    bool in_use = false;
+    if (ring->in_use.compare_exchange_strong(in_use, true,
+                                             std::memory_order_acquire)) {
+      local.ring = ring;
+      return ring.get();
+    }
+  }
+  if (rings_.size() < kMaxThreads) {
+    local.ring = std::make_shared<Ring>();
+    local.ring->in_use.store(true);
+    rings_.push_back(local.ring);
+  }
+  return local.ring.get();
+}
+
+void FlightRecorder::Record(TraceEventType type, uint8_t detail,
+                            uint16_t printer, uint64_t job, int64_t value) {
+  Ring* ring = ThreadRing();
+  if (ring == nullptr) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+  uint64_t index = ring->written.load(std::memory_order_relaxed);
+  ring->claimed.store(index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::atomic<uint64_t>* slot = ring->slots[index % kEventsPerThread];
+  slot[0].store(static_cast<uint64_t>(now), std::memory_order_relaxed);
+  slot[1].store(job, std::memory_order_relaxed);
+  slot[2].store(static_cast<uint64_t>(value), std::memory_order_relaxed);
+  slot[3].store(static_cast<uint64_t>(type) |
+                    static_cast<uint64_t>(detail) << 8 |
+                    static_cast<uint64_t>(printer) << 16 |
+                    static_cast<uint64_t>(CurrentThreadId()) << 32,
+                std::memory_order_relaxed);
+  ring->written.store(index + 1, std::memory_order_release);
+}
+
+void FlightRecorder::Snapshot(std::vector<TraceEvent>* events) const {
+  std::vector<std::shared_ptr<Ring>> rings;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings = rings_;
+  }
+  events->clear();
+  std::vector<TraceEvent> copied;
+  for (const std::shared_ptr<Ring>& ring : rings) {
+    uint64_t end = ring->written.load(std::memory_order_acquire);
+    uint64_t begin = end > kEventsPerThread ? end - kEventsPerThread : 0;
+    copied.resize(end - begin);
+    for (uint64_t index = begin; index < end; index++) {
+      const std::atomic<uint64_t>* slot =
+          ring->slots[index % kEventsPerThread];
+      TraceEvent& event = copied[index - begin];
+      event.timestamp_ns =
+          static_cast<int64_t>(slot[0].load(std::memory_order_relaxed));
+      event.job = slot[1].load(std::memory_order_relaxed);
+      event.value =
+          static_cast<int64_t>(slot[2].load(std::memory_order_relaxed));
+      uint64_t packed = slot[3].load(std::memory_order_relaxed);
+      event.type = static_cast<TraceEventType>(packed & 0xFF);
+      event.detail = static_cast<uint8_t>(packed >> 8);
+      event.printer = static_cast<uint16_t>(packed >> 16);
+      event.thread = static_cast<uint32_t>(packed >> 32);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // Slots the owner has started to overwrite since they were copied.
+    uint64_t claimed = ring->claimed.load(std::memory_order_relaxed);
+    uint64_t valid =
+        claimed > kEventsPerThread ? claimed - kEventsPerThread : 0;
+    for (uint64_t index = std::max(begin, valid); index < end; index++) {
+      events->push_back(copied[index - begin]);
+    }
+  }
+  std::stable_sort(events->begin(), events->end(),
+                   [](const TraceEvent& a, const TraceEvent& b) {
+                     return a.timestamp_ns < b.timestamp_ns;
+                   });
+}
+
+bool FlightRecorder::WriteChromeTrace(const std::string& path) const {
+  std::vector<TraceEvent> events;
+  Snapshot(&events);
+  return WriteTraceFile(events, PrinterNames(), path);
+}
+
+bool FlightRecorder::WriteChromeTrace(int fd) const {
+  std::vector<TraceEvent> events;
+  Snapshot(&events);
+  return WriteTraceToFd(events, PrinterNames(), fd);
+}
+
+std::vector<std::string> FlightRecorder::PrinterNames() const {
+  std::vector<std::string> printers;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const std::string& printer : printers_) {
+    printers.push_back(JsonString(printer));
+  }
+  return printers;
+}
+
+void FlightRecorder::SetAutoDump(std::chrono::milliseconds threshold,
+                                 const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto_dump_path_ = path;
+  if (auto_dump_fd_ >= 0) {
+    close(auto_dump_fd_);
+    auto_dump_fd_ = -1;
+  }
+  next_auto_dump_ = std::chrono::steady_clock::time_point();
+  auto_dump_threshold_ns_.store(
+      path.empty() ? 0
+                   : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         threshold)
+                         .count());
+}
+
+void FlightRecorder::SetAutoDump(std::chrono::milliseconds threshold,
+                                 int fd) {
+  int copy = fd >= 0 ? fcntl(fd, F_DUPFD_CLOEXEC, 0) : -1;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto_dump_path_.clear();
+  if (auto_dump_fd_ >= 0) {
+    close(auto_dump_fd_);
+  }
+  auto_dump_fd_ = copy;
+  next_auto_dump_ = std::chrono::steady_clock::time_point();
+  auto_dump_threshold_ns_.store(
+      copy < 0 ? 0
+               : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     threshold)
+                     .count());
+}
+
+bool FlightRecorder::NoteLatency(std::chrono::steady_clock::duration latency) {
+  int64_t threshold = auto_dump_threshold_ns_.load(std::memory_order_relaxed);
+  if (threshold <= 0 ||
+      std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count() <=
+          threshold) {
+    return false;
+  }
+  std::string path;
+  // A copy the writing thread closes, so SetAutoDump() may close the
+  // recorder's own meanwhile.
+  int fd = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_auto_dump_) {
+      return false;
+    }
+    next_auto_dump_ = now + kAutoDumpInterval;
+    path = auto_dump_path_;
+    if (auto_dump_fd_ >= 0) {
+      fd = fcntl(auto_dump_fd_, F_DUPFD_CLOEXEC, 0);
+      if (fd < 0) {
+        return false;
+      }
+    }
+  }
+  // Copied now, so the trace ends at the slow job, and written on a thread
+  // of its own: the caller may be the IoLoop's thread, which every printer
+  // waits on.
+  std::vector<TraceEvent> events;
+  Snapshot(&events);
+  std::vector<std::string> printers = PrinterNames();
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  if (dump_thread_.joinable()) {
+    dump_thread_.join();
+  }
+  dump_thread_ = std::thread(
+      [path, fd](std::vector<TraceEvent> events,
+                 std::vector<std::string> printers) {
+        if (fd >= 0) {
+          WriteTraceToFd(events, printers, fd);
+          close(fd);
+        } else {
+          WriteTraceFile(events, printers, path);
+        }
+      },
+      std::move(events), std::move(printers));
+  return true;
+}
+
+}  // namespace thermal_printer_flutter
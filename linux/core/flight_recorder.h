@@ -0,0 +1,161 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_FLIGHT_RECORDER_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_FLIGHT_RECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+enum class TraceEventType : uint8_t {
+  // A job was queued for a printer; |value| is its size in bytes.
+  kEnqueue = 1,
+  // A job was taken off the queue to be written; |value| as for kEnqueue.
+  kDequeue = 2,
+  // A job printed (|value| 1) or failed (0).
+  kFinish = 3,
+  // A TraceStage, in |detail|, began or ended on this thread. For kWrite
+  // |value| is the bytes asked to be written and then those written, or
+  // -1; for the other stages it is 1 at the end if the stage succeeded.
+  kStageBegin = 4,
+  kStageEnd = 5,
+  // The printer's link is opened again after a failure; |value| is the
+  // attempt.
+  kReconnect = 6,
+  // The printer answered the status request in |detail| (1 and 4 for
+  // DLE EOT n, 'r' for the GS r barrier) with the byte in |value|, or did
+  // not answer (-1).
+  kStatusReply = 7,
+};
+
+enum class TraceStage : uint8_t {
+  kConnect = 1,
+  kIdentify = 2,
+  kJournal = 3,
+  kWrite = 4,
+  kBarrier = 5,
+  kProbe = 6,
+  // PrintQueue::WarmUp(), around the connect, identify and probe stages it
+  // runs.
+  kWarmUp = 7,
+};
+
+struct TraceEvent {
+  // steady_clock, in nanoseconds.
+  int64_t timestamp_ns = 0;
+  uint64_t job = 0;
+  int64_t value = 0;
+  // The kernel's id for the thread that recorded it.
+  uint32_t thread = 0;
+  // From FlightRecorder::PrinterIndex(), or 0.
+  uint16_t printer = 0;
+  TraceEventType type = TraceEventType::kEnqueue;
+  uint8_t detail = 0;
+};
+
+// Always-on record of the last kEventsPerThread events of every thread that
+// reports to it, kept so that an occasional slow job can be explained after
+// the fact.
+//
+// Each thread writes to a ring of its own, so Record() takes no lock: a
+// handful of relaxed stores once the thread's ring is set up on its first
+// event. Readers copy the rings while they are being written and drop the
+// events that were overwritten underneath them, so a dump never holds up
+// printing. Threads beyond kMaxThreads that are alive at once are not
+// recorded; the ring of a thread that exits goes to the next one.
+//
+// WriteChromeTrace() writes the events in the Trace Event Format, which
+// Perfetto (ui.perfetto.dev) and chrome://tracing open: jobs as async
+// slices from queued to printed, stages as slices on the thread that ran
+// them, reconnects and status replies as instant events.
+class FlightRecorder {
+ public:
+  static constexpr size_t kEventsPerThread = 4096;
+  static constexpr size_t kMaxThreads = 64;
+  // Automatic dumps are at least this far apart, so a printer that stays
+  // slow does not have the trace rewritten after every job.
+  static constexpr std::chrono::seconds kAutoDumpInterval{60};
+
+  FlightRecorder();
+  ~FlightRecorder();
+
+  FlightRecorder(const FlightRecorder&) = delete;
+  FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+  // The index events for |printer| carry, starting from 1; 0 once 65535
+  // printers have been named.
+  uint16_t PrinterIndex(const std::string& printer);
+
+  void Record(TraceEventType type, uint8_t detail, uint16_t printer,
+              uint64_t job, int64_t value);
+  void BeginStage(TraceStage stage, uint16_t printer, uint64_t job,
+                  int64_t value = 0) {
+    Record(TraceEventType::kStageBegin, static_cast<uint8_t>(stage), printer,
+           job, value);
+  }
+  void EndStage(TraceStage stage, uint16_t printer, uint64_t job,
+                int64_t value) {
+    Record(TraceEventType::kStageEnd, static_cast<uint8_t>(stage), printer,
+           job, value);
+  }
+
+  // Sets |events| to the events still held, oldest first.
+  void Snapshot(std::vector<TraceEvent>* events) const;
+
+  // Writes the trace to |path|, replacing it whole. Returns false if it
+  // could not be written.
+  bool WriteChromeTrace(const std::string& path) const;
+  // Writes the trace over the contents of the file or memfd |fd|, for
+  // callers that must not open paths for others.
+  bool WriteChromeTrace(int fd) const;
+
+  // Has NoteLatency() write the trace to |path| once a job takes longer
+  // than |threshold|; 0 turns it off. The events are copied when the job
+  // is noted and written to the file in the background.
+  void SetAutoDump(std::chrono::milliseconds threshold,
+                   const std::string& path);
+  // As above, writing over the contents of a copy of |fd| instead, so the
+  // dump can land in a file only the caller could open.
+  void SetAutoDump(std::chrono::milliseconds threshold, int fd);
+
+  // Told how long a job took, from queued to printed. Returns true if that
+  // crossed the threshold and the trace is being written.
+  bool NoteLatency(std::chrono::steady_clock::duration latency);
+
+  // Events not recorded for want of a ring.
+  uint64_t dropped() const { return dropped_.load(); }
+
+ private:
+  struct Ring;
+
+  // The calling thread's ring, claimed on its first event.
+  Ring* ThreadRing();
+  // The names of the printers events refer to, as JSON strings.
+  std::vector<std::string> PrinterNames() const;
+
+  // Unlike its address, never reused, so a thread can tell whether the
+  // ring it holds came from this recorder.
+  const uint64_t serial_;
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<Ring>> rings_;
+  std::vector<std::string> printers_;
+  std::string auto_dump_path_;
+  int auto_dump_fd_ = -1;
+  std::chrono::steady_clock::time_point next_auto_dump_;
+  // Read on every job without |mutex_|.
+  std::atomic<int64_t> auto_dump_threshold_ns_;
+  std::atomic<uint64_t> dropped_;
+  // Writes the last automatic dump; joined before the next one starts.
+  std::mutex dump_mutex_;
+  std::thread dump_thread_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_FLIGHT_RECORDER_H_
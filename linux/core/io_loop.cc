@@ -0,0 +1,142 @@
+#include "io_loop.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+PollIoLoop::PollIoLoop()
+    : wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      thread_(&PollIoLoop::Run, this) {}
+
+PollIoLoop::~PollIoLoop() {
+  Stop();
+  if (wake_fd_ >= 0) {
+    close(wake_fd_);
+  }
+}
+
+void PollIoLoop::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  Wake();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void PollIoLoop::WaitForFd(int fd, short events, int timeout_ms,
+                           std::function<void(bool ready)> callback) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FdWait& wait = waits_[next_wait_id_++];
+    wait.fd = fd;
+    wait.events = events;
+    wait.deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    wait.callback = std::move(callback);
+  }
+  Wake();
+}
+
+void PollIoLoop::Post(std::chrono::milliseconds delay,
+                      std::function<void()> callback) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timers_.emplace(Clock::now() + delay, std::move(callback));
+  }
+  Wake();
+}
+
+void PollIoLoop::Wake() {
+  uint64_t one = 1;
+  ssize_t written = write(wake_fd_, &one, sizeof(one));
+  (void)written;
+}
+
+void PollIoLoop::Run() {
+  std::vector<struct pollfd> fds;
+  std::vector<uint64_t> ids;
+  std::vector<std::function<void(bool)>> ready;
+  std::vector<std::function<void(bool)>> expired;
+  std::vector<std::function<void()>> due;
+  while (true) {
+    fds.clear();
+    ids.clear();
+    fds.push_back({wake_fd_, POLLIN, 0});
+    Clock::time_point next = Clock::time_point::max();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) {
+        return;
+      }
+      for (const auto& entry : waits_) {
+        fds.push_back({entry.second.fd, entry.second.events, 0});
+        ids.push_back(entry.first);
+        next = std::min(next, entry.second.deadline);
+      }
+      if (!timers_.empty()) {
+        next = std::min(next, timers_.begin()->first);
+      }
+    }
+    int timeout_ms = -1;
+    if (next != Clock::time_point::max()) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+          next - Clock::now() + std::chrono::microseconds(999));
+      timeout_ms = static_cast<int>(std::max<int64_t>(remaining.count(), 0));
+    }
+    if (poll(fds.data(), fds.size(), timeout_ms) < 0 && errno != EINTR) {
+      return;
+    }
+    if (fds[0].revents != 0) {
+      uint64_t count;
+      ssize_t drained = read(wake_fd_, &count, sizeof(count));
+      (void)drained;
+    }
+
+    Clock::time_point now = Clock::now();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Waits added since |fds| was built are only checked for expiry.
+      for (size_t i = 1; i < fds.size(); i++) {
+        auto it = waits_.find(ids[i - 1]);
+        if (fds[i].revents != 0 && it != waits_.end()) {
+          ready.push_back(std::move(it->second.callback));
+          waits_.erase(it);
+        }
+      }
+      for (auto it = waits_.begin(); it != waits_.end();) {
+        if (it->second.deadline <= now) {
+          expired.push_back(std::move(it->second.callback));
+          it = waits_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      while (!timers_.empty() && timers_.begin()->first <= now) {
+        due.push_back(std::move(timers_.begin()->second));
+        timers_.erase(timers_.begin());
+      }
+    }
+    for (auto& callback : ready) {
+      callback(true);
+    }
+    for (auto& callback : expired) {
+      callback(false);
+    }
+    for (auto& callback : due) {
+      callback();
+    }
+    ready.clear();
+    expired.clear();
+    due.clear();
+  }
+}
+
+}  // namespace thermal_printer_flutter
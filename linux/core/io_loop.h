@@ -0,0 +1,79 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_IO_LOOP_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_IO_LOOP_H_
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+// A single thread dispatching readiness and timer callbacks, which lets the
+// queue drive every printer's writes without a thread per printer. Both
+// calls may be made from any thread, including from inside a callback.
+// Callbacks run on the loop's thread, one at a time.
+class IoLoop {
+ public:
+  // Stop() must have been called.
+  virtual ~IoLoop() = default;
+
+  // Stops the loop's thread, waiting for a callback that is running to
+  // return; not to be called from one. Callbacks still pending, and those
+  // added from then on, never run. Calling it again does nothing.
+  virtual void Stop() = 0;
+
+  // Calls |callback| once, with true when |fd| is ready for |events| (or
+  // has failed, which the next write reports) and with false if it was not
+  // within |timeout_ms|.
+  virtual void WaitForFd(int fd, short events, int timeout_ms,
+                         std::function<void(bool ready)> callback) = 0;
+
+  // Calls |callback| once after |delay|.
+  virtual void Post(std::chrono::milliseconds delay,
+                    std::function<void()> callback) = 0;
+};
+
+// IoLoop on a thread of its own blocked in poll(), for processes without a
+// GLib main loop such as the print daemon.
+class PollIoLoop : public IoLoop {
+ public:
+  PollIoLoop();
+  ~PollIoLoop() override;
+
+  PollIoLoop(const PollIoLoop&) = delete;
+  PollIoLoop& operator=(const PollIoLoop&) = delete;
+
+  void Stop() override;
+  void WaitForFd(int fd, short events, int timeout_ms,
+                 std::function<void(bool ready)> callback) override;
+  void Post(std::chrono::milliseconds delay,
+            std::function<void()> callback) override;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct FdWait {
+    int fd;
+    short events;
+    Clock::time_point deadline;
+    std::function<void(bool ready)> callback;
+  };
+
+  void Run();
+  void Wake();
+
+  int wake_fd_;
+  std::mutex mutex_;
+  bool stopping_ = false;
+  uint64_t next_wait_id_ = 1;
+  std::map<uint64_t, FdWait> waits_;
+  std::multimap<Clock::time_point, std::function<void()>> timers_;
+  std::thread thread_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_IO_LOOP_H_
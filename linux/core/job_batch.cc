@@ -0,0 +1,89 @@
+#include "job_batch.h"
+
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// The fixed part of a job: printer, flags, copies, key and payload lengths.
+constexpr size_t kJobHeaderSize = 2 + 1 + 1 + 1 + 4;
+
+void PutLittleEndian(std::vector<uint8_t>* out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+uint32_t GetLittleEndian(const uint8_t* data, int bytes) {
+  uint32_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value |= static_cast<uint32_t>(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodeJobBatch(const std::vector<BatchJob>& jobs) {
+  size_t size = 8;
+  for (const BatchJob& job : jobs) {
+    size += kJobHeaderSize + job.key.size() + job.length;
+  }
+  std::vector<uint8_t> out;
+  out.reserve(size);
+  PutLittleEndian(&out, kJobBatchMagic, 4);
+  PutLittleEndian(&out, static_cast<uint32_t>(jobs.size()), 4);
+  for (const BatchJob& job : jobs) {
+    PutLittleEndian(&out, static_cast<uint32_t>(job.printer), 2);
+    out.push_back(static_cast<uint8_t>((job.barrier ? kBatchJobBarrier : 0) |
+                                       (job.optimize ? kBatchJobOptimize : 0)));
+    out.push_back(static_cast<uint8_t>(job.copies));
+    out.push_back(static_cast<uint8_t>(job.key.size()));
+    out.insert(out.end(), job.key.begin(), job.key.end());
+    PutLittleEndian(&out, static_cast<uint32_t>(job.length), 4);
+    out.insert(out.end(), job.data, job.data + job.length);
+  }
+  return out;
+}
+
+bool DecodeJobBatch(const uint8_t* data, size_t length, size_t printers,
+                    std::vector<BatchJob>* jobs) {
+  jobs->clear();
+  if (length < 8 || GetLittleEndian(data, 4) != kJobBatchMagic) {
+    return false;
+  }
+  size_t count = GetLittleEndian(data + 4, 4);
+  size_t offset = 8;
+  if (count > kMaxBatchJobs || count > (length - offset) / kJobHeaderSize) {
+    return false;
+  }
+  jobs->resize(count);
+  for (BatchJob& job : *jobs) {
+    if (length - offset < kJobHeaderSize) {
+      return false;
+    }
+    const uint8_t* header = data + offset;
+    job.printer = GetLittleEndian(header, 2);
+    job.barrier = (header[2] & kBatchJobBarrier) != 0;
+    job.optimize = (header[2] & kBatchJobOptimize) != 0;
+    job.copies = header[3];
+    size_t key_length = header[4];
+    offset += 5;
+    if (job.printer >= printers || job.copies == 0 ||
+        length - offset < key_length + 4) {
+      return false;
+    }
+    job.key.assign(reinterpret_cast<const char*>(data + offset), key_length);
+    offset += key_length;
+    job.length = GetLittleEndian(data + offset, 4);
+    offset += 4;
+    if (job.length > length - offset) {
+      return false;
+    }
+    job.data = data + offset;
+    offset += job.length;
+  }
+  return offset == length;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,50 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_JOB_BATCH_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_JOB_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+// Many jobs in one message, so that a batch costs one platform channel call
+// rather than one per job. The printers are named once, alongside the
+// envelope, and each job refers to one by index. Little-endian:
+//
+//   u32 magic "TPFB" | u32 job count
+//   per job: u16 printer | u8 flags | u8 copies |
+//            u8 key length | key | u32 payload length | payload
+constexpr uint32_t kJobBatchMagic = 0x42465054;  // "TPFB"
+// Keeps the daemon's reply, one job id each, within a packet.
+constexpr size_t kMaxBatchJobs = 4096;
+
+enum BatchJobFlags : uint8_t {
+  kBatchJobBarrier = 1 << 0,
+  kBatchJobOptimize = 1 << 1,
+};
+
+// A job of a decoded batch. |data| points into the envelope, which must
+// outlive it.
+struct BatchJob {
+  size_t printer = 0;
+  const uint8_t* data = nullptr;
+  size_t length = 0;
+  int copies = 1;
+  std::string key;
+  bool barrier = false;
+  // Run through OptimizeEscPos() before queueing.
+  bool optimize = false;
+};
+
+std::vector<uint8_t> EncodeJobBatch(const std::vector<BatchJob>& jobs);
+
+// Decodes the envelope in one pass. Fails on truncation, on more than
+// kMaxBatchJobs jobs, and on jobs naming a printer at or past |printers| or
+// with 0 copies.
+bool DecodeJobBatch(const uint8_t* data, size_t length, size_t printers,
+                    std::vector<BatchJob>* jobs);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_JOB_BATCH_H_
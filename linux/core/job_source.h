@@ -0,0 +1,30 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_JOB_SOURCE_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_JOB_SOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace thermal_printer_flutter {
+
+// A job produced piece by piece while it is being written, for input too
+// large to hold in memory at once.
+class JobSource {
+ public:
+  virtual ~JobSource() = default;
+
+  // Points |data| at the next piece of the job, valid until the following
+  // call. Returns false once the job is exhausted or has failed.
+  virtual bool Next(const uint8_t** data, size_t* length) = 0;
+
+  // True if Next() stopped because of an error rather than the end of the
+  // job.
+  virtual bool failed() const = 0;
+
+  // Sets |length| to the bytes Next() will hand out in all, for sources
+  // that know before producing them. Returns false otherwise.
+  virtual bool TotalLength(uint64_t* length) const { return false; }
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_JOB_SOURCE_H_
@@ -0,0 +1,38 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+
+namespace thermal_printer_flutter {
+
+constexpr int LatencyHistogram::kBuckets;
+
+void LatencyHistogram::Add(std::chrono::milliseconds latency) {
+  uint64_t ms = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+  int bucket = 0;
+  while (bucket < kBuckets - 1 && ms >= (uint64_t{1} << bucket)) {
+    bucket++;
+  }
+  counts[bucket]++;
+  samples++;
+  total_ms += ms;
+  max_ms = std::max(max_ms, ms);
+}
+
+uint64_t LatencyHistogram::PercentileMs(double percent) const {
+  if (samples == 0) {
+    return 0;
+  }
+  // The rank of the sample, counted from 1.
+  uint64_t rank = static_cast<uint64_t>(percent / 100 * samples + 0.5);
+  rank = std::min(std::max<uint64_t>(rank, 1), samples);
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < kBuckets - 1; bucket++) {
+    seen += counts[bucket];
+    if (seen >= rank) {
+      return std::min(uint64_t{1} << bucket, max_ms);
+    }
+  }
+  return max_ms;
+}
+
+}  // namespace thermal_printer_flutter
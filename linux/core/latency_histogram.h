@@ -0,0 +1,46 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LATENCY_HISTOGRAM_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LATENCY_HISTOGRAM_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace thermal_printer_flutter {
+
+// Latencies in power-of-two millisecond buckets: bucket 0 counts those
+// under 1 ms, bucket i those from 2^(i-1) up to 2^i ms, and the last one
+// everything longer.
+struct LatencyHistogram {
+  static constexpr int kBuckets = 16;
+
+  void Add(std::chrono::milliseconds latency);
+  // The upper bound of the bucket holding the |percent|th percentile,
+  // capped at the longest latency seen. 0 without samples.
+  uint64_t PercentileMs(double percent) const;
+
+  uint64_t counts[kBuckets] = {};
+  uint64_t samples = 0;
+  uint64_t total_ms = 0;
+  uint64_t max_ms = 0;
+};
+
+// How long a printer's barrier jobs took, measured from Submit(): until
+// their bytes were handed to the transport, and until the printer answered
+// the status request queued behind them, which it does only once it has
+// processed everything before it.
+struct PrinterLatency {
+  LatencyHistogram handoff;
+  LatencyHistogram completion;
+  // Barrier requests the printer did not answer in time.
+  uint64_t unanswered = 0;
+  // Barriers not sent because the link cannot carry them: an LPD queue
+  // would print the request as a job, and a write-only link never hears
+  // the answer.
+  uint64_t unsupported = 0;
+  // Wall-clock time of the last answer, in milliseconds since the epoch,
+  // or 0.
+  int64_t last_completion_ms = 0;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LATENCY_HISTOGRAM_H_
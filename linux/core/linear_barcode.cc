@@ -0,0 +1,204 @@
+#include "linear_barcode.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// Code 128 symbol values 0-106 as bar, space, bar... widths in modules.
+// Every symbol is 11 modules wide except the 13-module stop.
+constexpr const char* kCode128Patterns[] = {
+    "212222", "222122", "222221", "121223", "121322", "131222", "122213",
+    "122312", "132212", "221213", "221312", "231212", "112232", "122132",
+    "122231", "113222", "123122", "123221", "223211", "221132", "221231",
+    "213212", "223112", "312131", "311222", "321122", "321221", "312212",
+    "322112", "322211", "212123", "212321", "232121", "111323", "131123",
+    "131321", "112313", "132113", "132311", "211313", "231113", "231311",
+    "112133", "112331", "132131", "113123", "113321", "133121", "313121",
+    "211331", "231131", "213113", "213311", "213131", "311123", "311321",
+    "331121", "312113", "312311", "332111", "314111", "221411", "431111",
+    "111224", "111422", "121124", "121421", "141122", "141221", "112214",
+    "112412", "122114", "122411", "142112", "142211", "241211", "221114",
+    "413111", "241112", "134111", "111242", "121142", "121241", "114212",
+    "124112", "124211", "411212", "421112", "421211", "212141", "214121",
+    "412121", "111143", "111341", "131141", "114113", "114311", "411113",
+    "411311", "113141", "114131", "311141", "411131", "211412", "211214",
+    "211232", "2331112",
+};
+
+constexpr int kCodeC = 99;
+constexpr int kCodeB = 100;
+constexpr int kStartB = 104;
+constexpr int kStartC = 105;
+constexpr int kStop = 106;
+
+// EAN digit patterns, 1 for a bar. L codes are odd parity, G the even
+// parity mirror images; R codes, on the right half, are the L codes
+// inverted.
+constexpr uint8_t kEanL[10] = {0x0D, 0x19, 0x13, 0x3D, 0x23,
+                               0x31, 0x2F, 0x3B, 0x37, 0x0B};
+constexpr uint8_t kEanG[10] = {0x27, 0x33, 0x1B, 0x21, 0x1D,
+                               0x39, 0x05, 0x11, 0x09, 0x17};
+// For EAN-13, the first digit is carried by which of the next six use G
+// codes (bit 5 is the second digit).
+constexpr uint8_t kEan13Parity[10] = {0x00, 0x0B, 0x0D, 0x0E, 0x13,
+                                      0x19, 0x1C, 0x15, 0x16, 0x1A};
+
+void AppendPattern(const char* widths, std::vector<uint8_t>* modules) {
+  uint8_t bar = 1;
+  for (const char* width = widths; *width != '\0'; width++) {
+    modules->insert(modules->end(), *width - '0', bar);
+    bar ^= 1;
+  }
+}
+
+void AppendBits(uint32_t bits, int count, std::vector<uint8_t>* modules) {
+  for (int i = count - 1; i >= 0; i--) {
+    modules->push_back((bits >> i) & 1);
+  }
+}
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+size_t DigitRun(const std::string& data, size_t start) {
+  size_t end = start;
+  while (end < data.size() && IsDigit(data[end])) {
+    end++;
+  }
+  return end - start;
+}
+
+bool EncodeCode128(const std::string& data, std::vector<uint8_t>* modules) {
+  if (data.empty()) {
+    return false;
+  }
+  for (char c : data) {
+    if (c < 32 || c > 126) {
+      return false;
+    }
+  }
+  // Code set C packs two digits per symbol; it pays for its switch symbols
+  // on runs of four or more (two or more if that is the whole text).
+  std::vector<int> values;
+  size_t i = 0;
+  bool code_c = DigitRun(data, 0) >= 4 ||
+                (DigitRun(data, 0) == data.size() && data.size() % 2 == 0);
+  values.push_back(code_c ? kStartC : kStartB);
+  while (i < data.size()) {
+    if (code_c) {
+      if (DigitRun(data, i) >= 2) {
+        values.push_back((data[i] - '0') * 10 + (data[i + 1] - '0'));
+        i += 2;
+        continue;
+      }
+      values.push_back(kCodeB);
+      code_c = false;
+    }
+    size_t run = DigitRun(data, i);
+    if (run >= 4) {
+      // An odd run leaves its first digit in code set B.
+      if (run % 2 == 1) {
+        values.push_back(data[i] - 32);
+        i++;
+      }
+      values.push_back(kCodeC);
+      code_c = true;
+      continue;
+    }
+    values.push_back(data[i] - 32);
+    i++;
+  }
+
+  int checksum = values[0];
+  for (size_t position = 1; position < values.size(); position++) {
+    checksum += static_cast<int>(position) * values[position];
+  }
+  values.push_back(checksum % 103);
+  values.push_back(kStop);
+
+  modules->clear();
+  for (int value : values) {
+    AppendPattern(kCode128Patterns[value], modules);
+  }
+  return true;
+}
+
+// Digits of an EAN with |digits| characters, the check digit computed or,
+// if present, verified.
+bool EanDigits(const std::string& data, size_t digits, std::vector<int>* out) {
+  if (data.size() != digits && data.size() != digits - 1) {
+    return false;
+  }
+  out->clear();
+  for (char c : data) {
+    if (!IsDigit(c)) {
+      return false;
+    }
+    out->push_back(c - '0');
+  }
+  // Weights alternate 3, 1 from the digit next to the check digit.
+  int sum = 0;
+  for (size_t i = 0; i + 1 < digits; i++) {
+    sum += (*out)[i] * ((digits - 1 - i) % 2 == 1 ? 3 : 1);
+  }
+  int check = (10 - sum % 10) % 10;
+  if (out->size() == digits) {
+    return out->back() == check;
+  }
+  out->push_back(check);
+  return true;
+}
+
+bool EncodeEan(BarcodeType type, const std::string& data,
+               std::vector<uint8_t>* modules) {
+  const bool ean13 = type == BarcodeType::kEan13;
+  std::vector<int> digits;
+  if (!EanDigits(data, ean13 ? 13 : 8, &digits)) {
+    return false;
+  }
+  // EAN-13 leaves its first digit out of the bars.
+  const size_t first = ean13 ? 1 : 0;
+  const size_t half = ean13 ? 6 : 4;
+  const uint8_t parity = ean13 ? kEan13Parity[digits[0]] : 0;
+  modules->clear();
+  AppendBits(0x5, 3, modules);
+  for (size_t i = 0; i < half; i++) {
+    int digit = digits[first + i];
+    bool even = (parity >> (half - 1 - i)) & 1;
+    AppendBits(even ? kEanG[digit] : kEanL[digit], 7, modules);
+  }
+  AppendBits(0x0A, 5, modules);
+  for (size_t i = 0; i < half; i++) {
+    AppendBits(~kEanL[digits[first + half + i]] & 0x7F, 7, modules);
+  }
+  AppendBits(0x5, 3, modules);
+  return true;
+}
+
+}  // namespace
+
+bool EncodeBarcode(BarcodeType type, const std::string& data,
+                   std::vector<uint8_t>* modules) {
+  if (type == BarcodeType::kCode128) {
+    return EncodeCode128(data, modules);
+  }
+  return EncodeEan(type, data, modules);
+}
+
+void BarcodeQuietZone(BarcodeType type, int* left, int* right) {
+  switch (type) {
+    case BarcodeType::kCode128:
+      *left = 10;
+      *right = 10;
+      return;
+    case BarcodeType::kEan13:
+      *left = 11;
+      *right = 7;
+      return;
+    case BarcodeType::kEan8:
+      *left = 7;
+      *right = 7;
+      return;
+  }
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,29 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LINEAR_BARCODE_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LINEAR_BARCODE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+enum class BarcodeType {
+  // Printable ASCII, switching to code set C for runs of digits.
+  kCode128,
+  // 12 digits, or 13 with a check digit that must match.
+  kEan13,
+  // 7 digits, or 8 with a check digit that must match.
+  kEan8,
+};
+
+// Encodes |data| as a row of modules, 1 for a bar, quiet zones excluded.
+// Returns false if |data| cannot be encoded in |type|.
+bool EncodeBarcode(BarcodeType type, const std::string& data,
+                   std::vector<uint8_t>* modules);
+
+// Minimum light modules on the left and right of a |type| symbol.
+void BarcodeQuietZone(BarcodeType type, int* left, int* right);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LINEAR_BARCODE_H_
@@ -0,0 +1,211 @@
+#include "lpd_transport.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "device_transport.h"
+#include "tcp_transport.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// RFC 1179 limits host and user names in control files to 31 octets.
+constexpr size_t kMaxNameLength = 31;
+
+// How long Flush() waits for the daemon to hang up after the session ends.
+constexpr int kSessionCloseTimeoutMs = 2000;
+
+std::string LocalHostName() {
+  char name[256] = {};
+  if (gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0') {
+    return "localhost";
+  }
+  std::string host(name);
+  return host.substr(0, kMaxNameLength);
+}
+
+std::string UserName() {
+  const char* user = getenv("USER");
+  std::string name = user != nullptr && user[0] != '\0' ? user : "flutter";
+  return name.substr(0, kMaxNameLength);
+}
+
+std::string JobNumber(int number) {
+  std::string digits = std::to_string(number % 1000);
+  return std::string(3 - digits.size(), '0') + digits;
+}
+
+}  // namespace
+
+LpdTransport::LpdTransport(std::string host, int port, std::string queue,
+                           int timeout_ms)
+    : host_(std::move(host)),
+      port_(port),
+      queue_(queue.empty() ? "lp" : std::move(queue)),
+      timeout_ms_(timeout_ms),
+      local_host_(LocalHostName()),
+      user_(UserName()),
+      job_number_(static_cast<int>(getpid() % 1000)) {}
+
+LpdTransport::~LpdTransport() { Close(); }
+
+bool LpdTransport::Open() {
+  if (fd_ >= 0) {
+    return true;
+  }
+  fd_ = ConnectTcp(host_, port_, timeout_ms_);
+  if (fd_ < 0) {
+    return false;
+  }
+  // 02 queue LF: receive a printer job. Its acknowledgement is collected
+  // together with the first job's.
+  std::string command = "\x02" + queue_ + "\n";
+  if (!SendAllNonBlocking(fd_, reinterpret_cast<const uint8_t*>(
+                                   command.data()),
+                          command.size(), timeout_ms_)) {
+    Close();
+    return false;
+  }
+  pending_acks_ = 1;
+  in_job_ = false;
+  sessions_opened_++;
+  return true;
+}
+
+void LpdTransport::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  pending_acks_ = 0;
+  in_job_ = false;
+}
+
+bool LpdTransport::Flush() {
+  if (fd_ < 0) {
+    return true;
+  }
+  bool acked = ReadAcks(pending_acks_);
+  // Ending the session is what tells the daemon to start printing. Wait for
+  // its side to close so the jobs are committed before we report success.
+  shutdown(fd_, SHUT_WR);
+  uint8_t drain[64];
+  while (acked && WaitForFd(fd_, POLLIN, kSessionCloseTimeoutMs) &&
+         read(fd_, drain, sizeof(drain)) > 0) {
+  }
+  Close();
+  return acked;
+}
+
+bool LpdTransport::Write(const uint8_t* data, size_t length) {
+  if (in_job_) {
+    return SendData(data, length);
+  }
+  return BeginJob(length) && SendData(data, length) && EndJob();
+}
+
+bool LpdTransport::BeginJob(uint64_t length) {
+  if (fd_ < 0 || in_job_) {
+    return false;
+  }
+  job_number_ = (job_number_ + 1) % 1000;
+  std::string suffix = JobNumber(job_number_) + local_host_;
+  std::string control_name = "cfA" + suffix;
+  std::string data_name = "dfA" + suffix;
+
+  std::string control_file;
+  control_file += "H" + local_host_ + "\n";
+  control_file += "P" + user_ + "\n";
+  control_file += "Jthermal_printer_flutter\n";
+  // 'l' prints the file as is, control characters included - which is
+  // exactly what an ESC/POS stream needs.
+  control_file += "l" + data_name + "\n";
+  control_file += "U" + data_name + "\n";
+  control_file += "N" + data_name + "\n";
+
+  // 02 count SP name LF, the control file and its NUL terminator, then the
+  // 03 data file header, all in one write.
+  std::string commands;
+  commands += "\x02" + std::to_string(control_file.size()) + " " +
+              control_name + "\n";
+  commands += control_file;
+  commands.push_back('\0');
+  commands += "\x03" + std::to_string(length) + " " + data_name + "\n";
+  if (!SendAllNonBlocking(fd_,
+                          reinterpret_cast<const uint8_t*>(commands.data()),
+                          commands.size(), timeout_ms_)) {
+    return false;
+  }
+  // Control subcommand, control file and data subcommand.
+  pending_acks_ += 3;
+  if (!ReadAcks(pending_acks_)) {
+    return false;
+  }
+  remaining_ = length;
+  in_job_ = true;
+  return true;
+}
+
+bool LpdTransport::SendData(const uint8_t* data, size_t length) {
+  if (!in_job_ || length > remaining_) {
+    return false;
+  }
+  if (!SendAllNonBlocking(fd_, data, length, timeout_ms_)) {
+    return false;
+  }
+  remaining_ -= length;
+  return true;
+}
+
+bool LpdTransport::EndJob() {
+  if (!in_job_ || remaining_ != 0) {
+    return false;
+  }
+  const uint8_t terminator = 0;
+  if (!SendAllNonBlocking(fd_, &terminator, 1, timeout_ms_)) {
+    return false;
+  }
+  in_job_ = false;
+  pending_acks_++;
+  if (!ReadAcks(pending_acks_)) {
+    return false;
+  }
+  jobs_sent_++;
+  return true;
+}
+
+bool LpdTransport::ReadAcks(int count) {
+  while (count > 0) {
+    uint8_t acks[8];
+    size_t wanted = static_cast<size_t>(count) < sizeof(acks)
+                        ? static_cast<size_t>(count)
+                        : sizeof(acks);
+    if (!WaitForFd(fd_, POLLIN, timeout_ms_)) {
+      return false;
+    }
+    ssize_t received;
+    do {
+      received = recv(fd_, acks, wanted, 0);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+      return false;
+    }
+    for (ssize_t i = 0; i < received; i++) {
+      // Anything but a zero octet is a refusal.
+      if (acks[i] != 0) {
+        return false;
+      }
+    }
+    count -= static_cast<int>(received);
+    pending_acks_ -= static_cast<int>(received);
+  }
+  return true;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,71 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LPD_TRANSPORT_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LPD_TRANSPORT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// RFC 1179 (LPD) client for printers that only accept jobs on port 515.
+//
+// One "receive job" session is kept open while jobs keep coming, so a burst
+// of tickets pays for a single connect. Each job's subcommands are
+// pipelined: the control file and the data file header go out in one write
+// and their acknowledgements are collected afterwards, so a job costs two
+// round trips however many subcommands it has. Data file contents are
+// streamed straight from the caller's buffers; nothing is copied or framed
+// around them.
+//
+// Most daemons only start printing when the session ends, so the queue's
+// Flush() closes it once no further job is waiting.
+class LpdTransport : public Transport {
+ public:
+  LpdTransport(std::string host, int port, std::string queue,
+               int timeout_ms = 10000);
+  ~LpdTransport() override;
+
+  LpdTransport(const LpdTransport&) = delete;
+  LpdTransport& operator=(const LpdTransport&) = delete;
+
+  bool Open() override;
+  void Close() override;
+  bool IsOpen() const override { return fd_ >= 0; }
+  // Sends |data| as one job, or as the next piece of the job BeginJob()
+  // started.
+  bool Write(const uint8_t* data, size_t length) override;
+  bool Flush() override;
+
+  // Streaming interface for jobs that are not in memory: announce the exact
+  // size, hand over the contents in any number of pieces, then finish.
+  bool FramesJobs() const override { return true; }
+  bool BeginJob(uint64_t length) override;
+  bool SendData(const uint8_t* data, size_t length);
+  bool EndJob() override;
+
+  uint64_t sessions_opened() const { return sessions_opened_; }
+  uint64_t jobs_sent() const { return jobs_sent_; }
+
+ private:
+  bool ReadAcks(int count);
+
+  std::string host_;
+  int port_;
+  std::string queue_;
+  int timeout_ms_;
+  std::string local_host_;
+  std::string user_;
+  int fd_ = -1;
+  // Acknowledgements owed by the daemon for commands already sent.
+  int pending_acks_ = 0;
+  int job_number_;
+  uint64_t remaining_ = 0;
+  bool in_job_ = false;
+  uint64_t sessions_opened_ = 0;
+  uint64_t jobs_sent_ = 0;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_LPD_TRANSPORT_H_
@@ -0,0 +1,468 @@
+#include "print_daemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#include "file_source.h"
+#include "tcp_transport.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// Members of the daemon's group may print through it too.
+constexpr mode_t kSocketMode = 0660;
+
+bool FillAddress(const std::string& path, struct sockaddr_un* address) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address->sun_path)) {
+    return false;
+  }
+  memcpy(address->sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+// Whether |name| is |prefix| followed by letters and digits only.
+bool IsDeviceName(const std::string& name, const char* prefix) {
+  size_t length = strlen(prefix);
+  if (name.size() <= length || name.compare(0, length, prefix) != 0) {
+    return false;
+  }
+  for (size_t i = length; i < name.size(); i++) {
+    if (!isalnum(static_cast<unsigned char>(name[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether a client may name |printer|: a USB printer, a serial port, a
+// network endpoint, or a printer group as the plugin names them. The queue
+// opens what it is given, so any other path would have the daemon write a
+// client's bytes into a file of the client's choosing.
+bool IsPrinterName(const std::string& printer) {
+  NetworkEndpoint endpoint;
+  return IsDeviceName(printer, "/dev/usb/lp") ||
+         IsDeviceName(printer, "/dev/tty") ||
+         ParseNetworkEndpoint(printer, &endpoint) ||
+         (printer.size() > 6 && printer.compare(0, 6, "group:") == 0);
+}
+
+// Whether every printer |request| names is one IsPrinterName() allows.
+bool NamesOnlyPrinters(const DaemonRequest& request) {
+  if (!request.printer.empty() && !IsPrinterName(request.printer)) {
+    return false;
+  }
+  // Only these calls take printers in |members|.
+  if (request.call == DaemonCall::kSubmitBatch ||
+      request.call == DaemonCall::kGroup ||
+      request.call == DaemonCall::kWarmUp) {
+    for (const std::string& printer : request.members) {
+      if (!IsPrinterName(printer)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Whether |fd| is a regular file its sender opened with |access| (O_RDONLY
+// or O_WRONLY) among its modes, which only a user allowed to could.
+bool IsFileOpenFor(int fd, int access, struct stat* info) {
+  int flags = fd >= 0 ? fcntl(fd, F_GETFL) : -1;
+  if (flags < 0 || (flags & O_PATH) != 0 || fstat(fd, info) != 0 ||
+      !S_ISREG(info->st_mode)) {
+    return false;
+  }
+  return (flags & O_ACCMODE) == access || (flags & O_ACCMODE) == O_RDWR;
+}
+
+// Whether the user |peer| may read the file |spec| names, by its owner,
+// group and mode; the peer's other groups and the directories above are
+// not considered. Pins |spec| to the file that was checked.
+bool PeerMayRead(const struct ucred& peer, FileJobSpec* spec) {
+  struct stat info;
+  if (stat(spec->path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+    return false;
+  }
+  mode_t bit = info.st_uid == peer.uid   ? S_IRUSR
+               : info.st_gid == peer.gid ? S_IRGRP
+                                         : S_IROTH;
+  if (peer.uid != 0 && (info.st_mode & bit) == 0) {
+    return false;
+  }
+  spec->device = info.st_dev;
+  spec->inode = info.st_ino;
+  return true;
+}
+
+}  // namespace
+
+struct PrintDaemon::StatusChanges {
+  StatusChanges() : event_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+  ~StatusChanges() {
+    if (event_fd >= 0) {
+      close(event_fd);
+    }
+  }
+
+  std::mutex mutex;
+  std::set<std::string> printers;
+  // Readable while |printers| is not empty.
+  const int event_fd;
+};
+
+constexpr size_t PrintDaemon::kMaxClients;
+
+PrintDaemon::PrintDaemon(PrintQueue* queue, SerialSettings* serial_settings)
+    : queue_(queue),
+      serial_settings_(serial_settings),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      status_changes_(std::make_shared<StatusChanges>()) {
+  std::shared_ptr<StatusChanges> changes = status_changes_;
+  queue_->SetStatusObserver(
+      [changes](const std::string& printer, const PrinterStatus&) {
+        {
+          std::lock_guard<std::mutex> lock(changes->mutex);
+          // Already pending, so the daemon has been woken for it.
+          if (!changes->printers.insert(printer).second) {
+            return;
+          }
+        }
+        uint64_t one = 1;
+        ssize_t written = write(changes->event_fd, &one, sizeof(one));
+        (void)written;
+      });
+}
+
+PrintDaemon::~PrintDaemon() {
+  queue_->SetStatusObserver(nullptr);
+  for (int client : clients_) {
+    close(client);
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(path_.c_str());
+  }
+  if (wake_fd_ >= 0) {
+    close(wake_fd_);
+  }
+}
+
+bool PrintDaemon::Listen(const std::string& path) {
+  struct sockaddr_un address;
+  if (listen_fd_ >= 0 || wake_fd_ < 0 || status_changes_->event_fd < 0 ||
+      !FillAddress(path, &address)) {
+    return false;
+  }
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  // A socket file nobody accepts on was left by a daemon that died.
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+              sizeof(address)) == 0) {
+    close(fd);
+    return false;
+  }
+  if (errno == ECONNREFUSED) {
+    unlink(path.c_str());
+  }
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      chmod(path.c_str(), kSocketMode) != 0 || listen(fd, 16) != 0) {
+    close(fd);
+    return false;
+  }
+  listen_fd_ = fd;
+  path_ = path;
+  return true;
+}
+
+void PrintDaemon::Stop() {
+  uint64_t one = 1;
+  ssize_t written = write(wake_fd_, &one, sizeof(one));
+  (void)written;
+}
+
+void PrintDaemon::Run() {
+  std::vector<struct pollfd> fds;
+  while (true) {
+    fds.clear();
+    fds.push_back({wake_fd_, POLLIN, 0});
+    fds.push_back({listen_fd_, POLLIN, 0});
+    fds.push_back({status_changes_->event_fd, POLLIN, 0});
+    for (int client : clients_) {
+      fds.push_back({client, POLLIN, 0});
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    if (fds[0].revents != 0) {
+      return;
+    }
+    if ((fds[1].revents & POLLIN) != 0) {
+      int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client >= 0 && clients_.size() >= kMaxClients) {
+        close(client);
+      } else if (client >= 0) {
+        clients_.push_back(client);
+      }
+    }
+    std::vector<int> gone;
+    if ((fds[2].revents & POLLIN) != 0) {
+      PushStatusChanges(&gone);
+    }
+    // |clients_| only grew since |fds| was built, so indexes still match.
+    std::vector<int> remaining;
+    for (size_t i = 3; i < fds.size(); i++) {
+      int client = fds[i].fd;
+      if (std::find(gone.begin(), gone.end(), client) == gone.end() &&
+          (fds[i].revents == 0 || Serve(client))) {
+        remaining.push_back(client);
+      } else {
+        close(client);
+        subscribers_.erase(
+            std::remove(subscribers_.begin(), subscribers_.end(), client),
+            subscribers_.end());
+      }
+    }
+    for (size_t i = fds.size() - 3; i < clients_.size(); i++) {
+      remaining.push_back(clients_[i]);
+    }
+    clients_.swap(remaining);
+  }
+}
+
+bool PrintDaemon::Serve(int client) {
+  std::vector<uint8_t> packet;
+  int fd;
+  DaemonRequest request;
+  if (!ReceivePacket(client, &packet, &fd, 0)) {
+    return false;
+  }
+  bool valid = DecodeDaemonRequest(packet.data(), packet.size(), &request);
+  DaemonReply reply;
+  int reply_fd = -1;
+  if (valid) {
+    reply = Handle(request, fd, client, &reply_fd);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  bool sent =
+      valid && SendPacket(client, EncodeDaemonReply(reply), reply_fd);
+  if (reply_fd >= 0) {
+    close(reply_fd);
+  }
+  return sent;
+}
+
+void PrintDaemon::PushStatusChanges(std::vector<int>* gone) {
+  uint64_t count;
+  ssize_t drained = read(status_changes_->event_fd, &count, sizeof(count));
+  (void)drained;
+  std::set<std::string> printers;
+  {
+    std::lock_guard<std::mutex> lock(status_changes_->mutex);
+    printers.swap(status_changes_->printers);
+  }
+  if (subscribers_.empty()) {
+    return;
+  }
+  DaemonReply reply;
+  reply.ok = true;
+  for (const std::string& printer : printers) {
+    PrinterStatusChange change;
+    change.printer = printer;
+    // The status now, which is the one reported or a later one.
+    queue_->GetStatus(printer, &change.status);
+    reply.statuses.push_back(std::move(change));
+  }
+  std::vector<uint8_t> packet = EncodeDaemonReply(reply);
+  for (int subscriber : subscribers_) {
+    if (!SendPacket(subscriber, packet, -1)) {
+      gone->push_back(subscriber);
+    }
+  }
+}
+
+DaemonReply PrintDaemon::Handle(const DaemonRequest& request, int fd,
+                                int client, int* reply_fd) {
+  DaemonReply reply;
+  reply.ok = NamesOnlyPrinters(request);
+  if (!reply.ok) {
+    return reply;
+  }
+  switch (request.call) {
+    case DaemonCall::kSubmit: {
+      std::vector<uint8_t> data;
+      if (request.printer.empty() || fd < 0 || !ReadSealedBuffer(fd, &data)) {
+        reply.ok = false;
+        break;
+      }
+      size_t length = data.size();
+      reply.job_id = queue_->Submit(request.printer, std::move(data),
+                                    request.copies, request.key,
+                                    request.barrier);
+      reply.resolved = reply.job_id == 0 && !queue_->CanQueue(length);
+      break;
+    }
+    case DaemonCall::kSubmitBatch: {
+      std::vector<uint8_t> envelope;
+      std::vector<BatchJob> jobs;
+      if (fd < 0 || !ReadSealedBuffer(fd, &envelope) ||
+          !DecodeJobBatch(envelope.data(), envelope.size(),
+                          request.members.size(), &jobs)) {
+        reply.ok = false;
+        break;
+      }
+      for (const std::string& printer : request.members) {
+        reply.ok = reply.ok && !printer.empty();
+      }
+      if (reply.ok) {
+        queue_->SubmitBatch(request.members, jobs, &reply.job_ids);
+      }
+      break;
+    }
+    case DaemonCall::kSubmitFile: {
+      // The client opened the file, so it may read it. The job is pinned
+      // to that file, which the path must still name: the daemon opens it
+      // again to print it, after a restart too.
+      FileJobSpec spec;
+      struct stat passed;
+      struct stat named;
+      if (request.printer.empty() ||
+          !ParseFileJobSpec(request.spec.data(), request.spec.size(),
+                            &spec) ||
+          !IsFileOpenFor(fd, O_RDONLY, &passed) ||
+          stat(spec.path.c_str(), &named) != 0 ||
+          named.st_dev != passed.st_dev || named.st_ino != passed.st_ino) {
+        reply.ok = false;
+        break;
+      }
+      spec.device = passed.st_dev;
+      spec.inode = passed.st_ino;
+      reply.job_id = queue_->SubmitFile(request.printer, spec);
+      break;
+    }
+    case DaemonCall::kFlush:
+      queue_->Flush(request.printer);
+      break;
+    case DaemonCall::kStats:
+      reply.stats = queue_->stats();
+      break;
+    case DaemonCall::kProfile:
+      reply.resolved = queue_->GetProfile(request.printer, &reply.profile);
+      break;
+    case DaemonCall::kSerialOptions:
+      if (!IsSerialDevicePath(request.printer) ||
+          (request.serial.baud_rate != 0 &&
+           !IsSupportedBaudRate(request.serial.baud_rate))) {
+        reply.ok = false;
+        break;
+      }
+      serial_settings_->Set(request.printer, request.serial);
+      break;
+    case DaemonCall::kCoalesce:
+      queue_->SetCoalesceOptions(request.coalesce);
+      break;
+    case DaemonCall::kLatency:
+      reply.resolved = queue_->GetLatency(request.printer, &reply.latency);
+      break;
+    case DaemonCall::kStatus:
+      queue_->Watch(request.printer);
+      reply.resolved = queue_->GetStatus(request.printer, &reply.status);
+      break;
+    case DaemonCall::kGroup:
+      reply.ok = queue_->SetGroup(request.printer, request.members);
+      break;
+    case DaemonCall::kGroupStats:
+      reply.ok = queue_->GetGroupStats(request.printer, &reply.members);
+      break;
+    case DaemonCall::kDumpTrace: {
+      // Returned to the client, which writes the file itself.
+      int trace = memfd_create("thermal_printer_trace",
+                               MFD_CLOEXEC | MFD_ALLOW_SEALING);
+      reply.ok = trace >= 0 &&
+                 queue_->flight_recorder()->WriteChromeTrace(trace) &&
+                 SealBuffer(trace);
+      if (reply.ok) {
+        *reply_fd = trace;
+      } else if (trace >= 0) {
+        close(trace);
+      }
+      break;
+    }
+    case DaemonCall::kTraceThreshold: {
+      struct stat info;
+      if (request.trace_threshold_ms == 0) {
+        queue_->flight_recorder()->SetAutoDump(std::chrono::milliseconds(0),
+                                               -1);
+      } else if (IsFileOpenFor(fd, O_WRONLY, &info)) {
+        queue_->flight_recorder()->SetAutoDump(
+            std::chrono::milliseconds(request.trace_threshold_ms), fd);
+      } else {
+        reply.ok = false;
+      }
+      break;
+    }
+    case DaemonCall::kWarmUp: {
+      // Only read ahead, but still as the client's user would.
+      struct ucred peer = {};
+      socklen_t peer_length = sizeof(peer);
+      reply.ok = request.preload.empty() ||
+                 getsockopt(client, SOL_SOCKET, SO_PEERCRED, &peer,
+                            &peer_length) == 0;
+      std::vector<FileJobSpec> preload(request.preload.size());
+      for (size_t i = 0; i < preload.size(); i++) {
+        reply.ok = reply.ok &&
+                   ParseFileJobSpec(request.preload[i].data(),
+                                    request.preload[i].size(), &preload[i]) &&
+                   PeerMayRead(peer, &preload[i]);
+      }
+      for (const std::string& printer : request.members) {
+        reply.ok = reply.ok && !printer.empty();
+      }
+      if (reply.ok) {
+        for (const std::string& printer : request.members) {
+          queue_->WarmUp(printer, preload);
+        }
+      }
+      break;
+    }
+    case DaemonCall::kSubscribe: {
+      // Pushes never block the daemon: a subscriber that stops reading
+      // them is dropped instead of holding up every other client.
+      int flags = fcntl(client, F_GETFL);
+      reply.ok = flags >= 0 &&
+                 fcntl(client, F_SETFL, flags | O_NONBLOCK) == 0;
+      if (reply.ok && std::find(subscribers_.begin(), subscribers_.end(),
+                                client) == subscribers_.end()) {
+        subscribers_.push_back(client);
+      }
+      break;
+    }
+  }
+  return reply;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,77 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINT_DAEMON_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINT_DAEMON_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "daemon_protocol.h"
+#include "print_queue.h"
+#include "serial_transport.h"
+
+namespace thermal_printer_flutter {
+
+// Serves one PrintQueue to the plugin in every app on the machine, so the
+// apps share its printer connections instead of each opening the printers
+// themselves. Clients connect to a Unix domain socket and send the
+// DaemonRequest packets described in daemon_protocol.h.
+//
+// Requests only queue work or read state, so a single thread serves every
+// client; the queue's workers do the printing. The daemon is the queue's
+// StatusObserver: the changes it reports are pushed to the clients that
+// sent kSubscribe, those that arrive while a push is pending going in the
+// same packet.
+class PrintDaemon {
+ public:
+  // |queue| and |serial_settings| must outlive the daemon, which replaces
+  // |queue|'s StatusObserver.
+  PrintDaemon(PrintQueue* queue, SerialSettings* serial_settings);
+  ~PrintDaemon();
+
+  PrintDaemon(const PrintDaemon&) = delete;
+  PrintDaemon& operator=(const PrintDaemon&) = delete;
+
+  // Binds the socket at |path|, replacing one left behind by a daemon that
+  // died. Returns false if another daemon answers there or the socket cannot
+  // be created.
+  bool Listen(const std::string& path);
+
+  // Serves clients until Stop() is called.
+  void Run();
+
+  // Makes Run() return. Safe to call from any thread or a signal handler.
+  void Stop();
+
+  // Clients served at once; further connections are closed straight away.
+  static constexpr size_t kMaxClients = 64;
+
+ private:
+  // Answers one packet from |client|. Returns false if the client is gone
+  // or sent something that is not a request.
+  bool Serve(int client);
+  // |fd| is the descriptor passed with |request|, or -1, and |client| the
+  // socket it came on. |reply_fd| is set to a descriptor to pass back.
+  DaemonReply Handle(const DaemonRequest& request, int fd, int client,
+                     int* reply_fd);
+  // Sends the status changes reported since the last push to every
+  // subscriber. Adds the subscribers that could not take them to |gone|.
+  void PushStatusChanges(std::vector<int>* gone);
+
+  // Printers whose status changed, filled from the queue's threads. Shared
+  // with the observer, which may still run once the daemon is gone.
+  struct StatusChanges;
+
+  PrintQueue* queue_;
+  SerialSettings* serial_settings_;
+  std::string path_;
+  int listen_fd_ = -1;
+  int wake_fd_ = -1;
+  std::vector<int> clients_;
+  // The clients that sent kSubscribe, also in |clients_|.
+  std::vector<int> subscribers_;
+  std::shared_ptr<StatusChanges> status_changes_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINT_DAEMON_H_
@@ -0,0 +1,1897 @@
+#include "print_queue.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <utility>
+
+#include "band_cache.h"
+#include "escpos_optimizer.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// Delay before retrying a job whose printer went away, multiplied by the
+// number of attempts already made.
+constexpr std::chrono::milliseconds kRetryBackoff{250};
+
+// GS r 1, transmit paper sensor status.
+constexpr uint8_t kBarrierRequest[] = {0x1D, 'r', 1};
+
+// Bits 4 and 7 of a GS r answer are always clear, which tells it apart from
+// DLE EOT answers and Automatic Status Back bytes.
+bool IsBarrierReply(uint8_t reply) { return (reply & 0x90) == 0; }
+
+bool WantsBarrier(const std::vector<PrintJob>& batch) {
+  return std::any_of(batch.begin(), batch.end(),
+                     [](const PrintJob& job) { return job.barrier; });
+}
+
+// Drops status bytes left over from earlier requests, so they are not
+// taken for the barrier's answer. Returns false if |transport| cannot read.
+bool DrainReplies(Transport* transport) {
+  uint8_t stale[64];
+  ssize_t count = 0;
+  for (int i = 0;
+       i < 16 && (count = transport->Read(stale, sizeof(stale), 0)) > 0;
+       i++) {
+  }
+  return count >= 0;
+}
+
+// Whether a barrier can be sent over |transport|, draining it if so. LPD
+// would print GS r 1 as a job of its own, and a link that cannot read
+// never hears the answer.
+bool PrepareBarrier(Transport* transport) {
+  return !transport->FramesJobs() && DrainReplies(transport);
+}
+
+}  // namespace
+
+constexpr int PrintQueue::kMaxAttempts;
+constexpr size_t PrintQueue::kMaxJobKeys;
+constexpr int PrintQueue::kBlockingThreads;
+constexpr std::chrono::seconds PrintQueue::kOfflineInterval;
+constexpr std::chrono::seconds PrintQueue::kBarrierTimeout;
+constexpr std::chrono::seconds PrintQueue::kStatusInterval;
+constexpr std::chrono::seconds PrintQueue::kMaxStatusInterval;
+constexpr size_t PrintQueue::kDefaultMemoryLimit;
+
+PrintQueue::PrintQueue(TransportFactory transport_factory,
+                       SpoolJournal* journal)
+    : transport_factory_(std::move(transport_factory)),
+      source_factory_([](const FileJobSpec& spec, const PrinterProfile&) {
+        return OpenFileSource(spec);
+      }),
+      journal_(journal),
+      next_job_id_(journal != nullptr ? journal->next_job_id() : 1) {}
+
+PrintQueue::~PrintQueue() { Shutdown(); }
+
+uint64_t PrintQueue::Submit(const std::string& printer,
+                            std::vector<uint8_t> data, int copies,
+                            const std::string& key, bool barrier) {
+  if (copies < 1 || copies > UINT16_MAX) {
+    return 0;
+  }
+  PrintJob job;
+  job.id = next_job_id_.fetch_add(1);
+  job.data = std::move(data);
+  job.copies = copies;
+  job.key = key;
+  job.barrier = barrier;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!HasRoom(job.data.size())) {
+      stats_.rejected_jobs++;
+      buffers_.Release(std::move(job.data));
+      return 0;
+    }
+    job.printer = InternKey(printer);
+    RouteJob(&job);
+    uint64_t existing;
+    if (!key.empty() && !ClaimKey(&job, &existing)) {
+      stats_.deduplicated_jobs++;
+      return existing;
+    }
+  }
+  if (!JournalJob(job)) {
+    if (!key.empty()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ReleaseKey(job);
+    }
+    return 0;
+  }
+  uint64_t id = job.id;
+  Enqueue(std::move(job));
+  return id;
+}
+
+void PrintQueue::SubmitBatch(const std::vector<std::string>& printers,
+                             const std::vector<BatchJob>& jobs,
+                             std::vector<uint64_t>* ids) {
+  ids->assign(jobs.size(), 0);
+  // Copied before the lock is taken; the jobs refused go back to the pool.
+  std::vector<PrintJob> batch(jobs.size());
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const BatchJob& submitted = jobs[i];
+    if (submitted.printer < printers.size() && submitted.copies >= 1 &&
+        submitted.copies <= UINT16_MAX) {
+      batch[i].data = buffers_.Acquire(submitted.data, submitted.length);
+      batch[i].copies = submitted.copies;
+      batch[i].key = submitted.key;
+      batch[i].barrier = submitted.barrier;
+      // Marks the job to be queued; its id is given under the lock.
+      batch[i].id = 1;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      for (PrintJob& job : batch) {
+        buffers_.Release(std::move(job.data));
+      }
+      return;
+    }
+    bool full = false;
+    for (size_t i = 0; i < batch.size(); i++) {
+      PrintJob& job = batch[i];
+      if (job.id == 0) {
+        continue;
+      }
+      if (full || !HasRoom(job.data.size())) {
+        full = true;
+        stats_.rejected_jobs++;
+        buffers_.Release(std::move(job.data));
+        job.id = 0;
+        continue;
+      }
+      job.id = next_job_id_.fetch_add(1);
+      job.printer = InternKey(printers[jobs[i].printer]);
+      RouteJob(&job);
+      uint64_t existing;
+      if (!job.key.empty() && !ClaimKey(&job, &existing)) {
+        stats_.deduplicated_jobs++;
+        (*ids)[i] = existing;
+        buffers_.Release(std::move(job.data));
+        job.id = 0;
+        continue;
+      }
+      // Counted as queued straight away, so that the rest of the batch is
+      // held to the memory limit and spread over a group with it.
+      WorkerFor(*job.printer)->queued_bytes += job.data.size();
+      (*ids)[i] = job.id;
+    }
+  }
+  for (size_t i = 0; i < batch.size(); i++) {
+    if (batch[i].id != 0 && !JournalJob(batch[i])) {
+      (*ids)[i] = 0;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Worker*> woken;
+  auto now = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < batch.size(); i++) {
+    PrintJob& job = batch[i];
+    if (job.id == 0) {
+      continue;
+    }
+    if (stopping_) {
+      // Shutdown() took the workers while the batch was journaled; the
+      // journal keeps it for the next start.
+      buffers_.Release(std::move(job.data));
+      continue;
+    }
+    Worker* worker = WorkerFor(*job.printer);
+    if ((*ids)[i] == 0) {
+      worker->queued_bytes -= job.data.size();
+      if (!job.key.empty()) {
+        ReleaseKey(job);
+      }
+      buffers_.Release(std::move(job.data));
+      continue;
+    }
+    if (job.group) {
+      worker->routed_jobs++;
+    }
+    job.queued_at = now;
+    stats_.submitted++;
+    recorder_.Record(TraceEventType::kEnqueue, 0, worker->trace_printer,
+                     job.id, static_cast<int64_t>(job.data.size()));
+    worker->jobs.push_back(std::move(job));
+    if (std::find(woken.begin(), woken.end(), worker) == woken.end()) {
+      woken.push_back(worker);
+    }
+  }
+  for (Worker* worker : woken) {
+    worker->cv.notify_one();
+    Schedule(worker);
+  }
+}
+
+uint64_t PrintQueue::SubmitFile(const std::string& printer,
+                                const FileJobSpec& spec) {
+  PrintJob job;
+  job.id = next_job_id_.fetch_add(1);
+  job.data = SerializeFileJobSpec(spec);
+  job.file = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job.printer = InternKey(printer);
+    RouteJob(&job);
+  }
+  if (journal_ != nullptr && journal_->is_open() &&
+      !journal_->AppendFileJob(job.id, *job.printer, job.data.data(),
+                               job.data.size())) {
+    return 0;
+  }
+  uint64_t id = job.id;
+  Enqueue(std::move(job));
+  return id;
+}
+
+uint64_t PrintQueue::Submit(const std::string& printer, const uint8_t* data,
+                            size_t length, int copies,
+                            const std::string& key, bool barrier) {
+  {
+    // Refused before the bytes are copied.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!HasRoom(length)) {
+      stats_.rejected_jobs++;
+      return 0;
+    }
+  }
+  return Submit(printer, buffers_.Acquire(data, length), copies, key,
+                barrier);
+}
+
+void PrintQueue::SetSourceFactory(SourceFactory source_factory) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  source_factory_ = std::move(source_factory);
+}
+
+void PrintQueue::SetIoLoop(std::unique_ptr<IoLoop> loop,
+                           int blocking_threads) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (loop_ || stopping_ || !workers_.empty() || blocking_threads < 1) {
+    return;
+  }
+  loop_ = std::move(loop);
+  for (int i = 0; i < blocking_threads; i++) {
+    blocking_threads_.emplace_back(&PrintQueue::RunBlocking, this);
+  }
+}
+
+void PrintQueue::SetChunkSize(size_t chunk_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  chunk_size_ = chunk_size;
+}
+
+void PrintQueue::SetJobObserver(JobObserver observer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  job_observer_ = std::move(observer);
+}
+
+void PrintQueue::SetStatusObserver(StatusObserver observer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  status_observer_ = std::move(observer);
+}
+
+void PrintQueue::Watch(const std::string& printer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) {
+    return;
+  }
+  Worker* worker = WorkerFor(printer);
+  if (worker->watched) {
+    return;
+  }
+  worker->watched = true;
+  if (loop_) {
+    ScheduleProbe(worker, std::chrono::milliseconds(0));
+  } else {
+    worker->next_probe = std::chrono::steady_clock::now();
+    worker->cv.notify_one();
+  }
+}
+
+void PrintQueue::WarmUp(const std::string& printer,
+                        std::vector<FileJobSpec> preload) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) {
+    return;
+  }
+  // A group's jobs may go to any member, so every member is warmed up.
+  auto group = groups_.find(printer);
+  std::vector<std::string> printers =
+      group != groups_.end() ? group->second
+                             : std::vector<std::string>{printer};
+  for (const std::string& member : printers) {
+    Worker* worker = WorkerFor(member);
+    worker->warm_up = true;
+    worker->preload.insert(worker->preload.end(), preload.begin(),
+                           preload.end());
+    if (loop_) {
+      Schedule(worker);
+    } else {
+      worker->cv.notify_one();
+    }
+  }
+}
+
+bool PrintQueue::GetStatus(const std::string& printer,
+                           PrinterStatus* status) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = statuses_.find(printer);
+  if (it == statuses_.end()) {
+    *status = PrinterStatus();
+    return false;
+  }
+  *status = it->second;
+  return true;
+}
+
+void PrintQueue::SetMemoryLimit(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  memory_limit_ = bytes;
+}
+
+bool PrintQueue::CanQueue(size_t length) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return HasRoom(length);
+}
+
+bool PrintQueue::HasRoom(size_t length) const {
+  if (memory_limit_ == 0) {
+    return true;
+  }
+  size_t queued = 0;
+  for (const auto& entry : workers_) {
+    queued += entry.second->queued_bytes + entry.second->batch_bytes;
+  }
+  return queued == 0 || queued + length <= memory_limit_;
+}
+
+void PrintQueue::SetProfileResolver(ProfileResolver profile_resolver) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  profile_resolver_ = std::move(profile_resolver);
+}
+
+bool PrintQueue::GetLatency(const std::string& printer,
+                            PrinterLatency* latency) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = latencies_.find(printer);
+  if (it == latencies_.end()) {
+    *latency = PrinterLatency();
+    return false;
+  }
+  *latency = it->second;
+  return true;
+}
+
+bool PrintQueue::GetProfile(const std::string& printer,
+                            PrinterProfile* profile) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = profiles_.find(printer);
+  if (it == profiles_.end()) {
+    *profile = PrinterProfile();
+    return false;
+  }
+  *profile = it->second;
+  return true;
+}
+
+void PrintQueue::Restore(std::vector<JournaledJob> jobs,
+                         std::vector<JournaledKey> keys) {
+  auto claim_id = [this](uint64_t id) {
+    uint64_t next = next_job_id_.load();
+    while (id >= next && !next_job_id_.compare_exchange_weak(next, id + 1)) {
+    }
+  };
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (JournaledKey& journaled : keys) {
+      claim_id(journaled.id);
+      if (keys_.count(journaled.key) == 0) {
+        if (key_order_.size() >= kMaxJobKeys) {
+          keys_.erase(key_order_.front());
+          key_order_.pop_front();
+        }
+        key_order_.push_back(journaled.key);
+      }
+      KeyedJob& keyed = keys_[journaled.key];
+      keyed.id = journaled.id;
+      keyed.failed = journaled.failed;
+      keyed.offset = journaled.offset;
+      keyed.length = journaled.length;
+      keyed.hash = journaled.hash;
+    }
+  }
+  for (JournaledJob& journaled : jobs) {
+    claim_id(journaled.id);
+    PrintJob job;
+    job.id = journaled.id;
+    job.data = std::move(journaled.data);
+    job.file = journaled.file;
+    job.copies = journaled.copies;
+    job.key = std::move(journaled.key);
+    job.offset = journaled.offset < job.data.size() ? journaled.offset : 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job.printer = InternKey(journaled.printer);
+      uint64_t existing;
+      if (!job.key.empty()) {
+        ClaimKey(&job, &existing);
+      }
+    }
+    Enqueue(std::move(job));
+  }
+}
+
+bool PrintQueue::ClaimKey(PrintJob* job, uint64_t* existing) {
+  auto it = keys_.find(job->key);
+  if (it == keys_.end()) {
+    if (key_order_.size() >= kMaxJobKeys) {
+      keys_.erase(key_order_.front());
+      key_order_.pop_front();
+    }
+    key_order_.push_back(job->key);
+  } else if (!it->second.failed) {
+    *existing = it->second.id;
+    return false;
+  } else if (job->offset == 0 && it->second.length == job->data.size() &&
+             it->second.hash == HashBytes(job->data.data(),
+                                          job->data.size(), 0)) {
+    // The same bytes again: the printer already has the start of them.
+    job->offset = it->second.offset;
+  }
+  KeyedJob& keyed = keys_[job->key];
+  keyed = KeyedJob();
+  keyed.id = job->id;
+  return true;
+}
+
+void PrintQueue::ReleaseKey(const PrintJob& job) {
+  auto it = keys_.find(job.key);
+  if (it == keys_.end() || it->second.id != job.id) {
+    return;
+  }
+  keys_.erase(it);
+  // Claimed last, so normally at the back.
+  auto order = std::find(key_order_.rbegin(), key_order_.rend(), job.key);
+  if (order != key_order_.rend()) {
+    key_order_.erase(std::next(order).base());
+  }
+}
+
+void PrintQueue::SettleKey(const PrintJob& job, bool success) {
+  auto it = keys_.find(job.key);
+  if (it == keys_.end() || it->second.id != job.id) {
+    return;
+  }
+  it->second.failed = !success;
+  if (!success) {
+    it->second.offset = job.offset;
+    it->second.length = job.data.size();
+    it->second.hash = HashBytes(job.data.data(), job.data.size(), 0);
+  }
+}
+
+void PrintQueue::Enqueue(PrintJob job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) {
+    return;
+  }
+  Worker* worker = WorkerFor(*job.printer);
+  if (job.group) {
+    worker->routed_jobs++;
+  }
+  job.queued_at = std::chrono::steady_clock::now();
+  stats_.submitted++;
+  Push(worker, std::move(job));
+}
+
+bool PrintQueue::JournalJob(const PrintJob& job) {
+  if (journal_ == nullptr || !journal_->is_open()) {
+    return true;
+  }
+  recorder_.BeginStage(TraceStage::kJournal, 0, job.id);
+  bool journaled =
+      journal_->AppendJob(job.id, *job.printer, job.data.data(),
+                          job.data.size()) &&
+      (job.copies == 1 || journal_->AppendCopies(job.id, job.copies)) &&
+      (job.key.empty() || journal_->AppendKey(job.id, job.key)) &&
+      (job.offset == 0 || journal_->AppendProgress(job.id, job.offset));
+  recorder_.EndStage(TraceStage::kJournal, 0, job.id, journaled);
+  return journaled;
+}
+
+void PrintQueue::Push(Worker* worker, PrintJob job) {
+  recorder_.Record(TraceEventType::kEnqueue, 0, worker->trace_printer, job.id,
+                   static_cast<int64_t>(job.data.size()));
+  worker->queued_bytes += job.data.size();
+  worker->jobs.push_back(std::move(job));
+  worker->cv.notify_one();
+  Schedule(worker);
+}
+
+bool PrintQueue::SetGroup(const std::string& group,
+                          std::vector<std::string> printers) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (group.empty()) {
+    return false;
+  }
+  for (const auto& entry : groups_) {
+    if (entry.first != group &&
+        std::find(entry.second.begin(), entry.second.end(), group) !=
+            entry.second.end()) {
+      return false;
+    }
+  }
+  for (const std::string& printer : printers) {
+    if (printer == group || groups_.count(printer) != 0) {
+      return false;
+    }
+  }
+  if (printers.empty()) {
+    groups_.erase(group);
+  } else {
+    groups_[group] = std::move(printers);
+  }
+  return true;
+}
+
+bool PrintQueue::GetGroupStats(const std::string& group,
+                               std::vector<GroupMemberStats>* members) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = groups_.find(group);
+  if (it == groups_.end()) {
+    return false;
+  }
+  auto now = std::chrono::steady_clock::now();
+  members->clear();
+  for (const std::string& printer : it->second) {
+    GroupMemberStats member;
+    member.printer = printer;
+    auto worker = workers_.find(printer);
+    if (worker != workers_.end()) {
+      const Worker* w = worker->second.get();
+      member.queued_bytes = w->queued_bytes + w->batch_bytes;
+      member.bytes_per_second = w->bytes_per_second;
+      auto busy = w->busy_time;
+      if (w->batch_bytes > 0) {
+        busy += now - w->batch_started;
+      }
+      auto lifetime = now - w->created_at;
+      if (lifetime.count() > 0) {
+        member.utilization =
+            std::min(1.0, static_cast<double>(busy.count()) /
+                              static_cast<double>(lifetime.count()));
+      }
+      member.routed_jobs = w->routed_jobs;
+      member.failed_over_jobs = w->failed_over_jobs;
+      member.offline = w->offline_until > now;
+    }
+    members->push_back(std::move(member));
+  }
+  return true;
+}
+
+void PrintQueue::RouteJob(PrintJob* job) {
+  if (stopping_ || groups_.count(*job->printer) == 0) {
+    return;
+  }
+  Worker* member =
+      PickMember(*job->printer, job->data.size(), nullptr, false);
+  job->group = std::move(job->printer);
+  job->printer = member->key;
+}
+
+PrintQueue::Worker* PrintQueue::PickMember(const std::string& group,
+                                           size_t length,
+                                           const Worker* failed,
+                                           bool online_only) {
+  auto now = std::chrono::steady_clock::now();
+  std::vector<Worker*> members;
+  // Members that have not finished a job yet are taken to be as fast as the
+  // fastest that has, so a new printer gets its share straight away.
+  double fastest = 1;
+  for (const std::string& printer : groups_.find(group)->second) {
+    Worker* member = WorkerFor(printer);
+    if (member != failed) {
+      members.push_back(member);
+      fastest = std::max(fastest, member->bytes_per_second);
+    }
+  }
+  Worker* best = nullptr;
+  bool best_online = false;
+  double best_seconds = 0;
+  for (Worker* member : members) {
+    bool online = member->offline_until <= now;
+    double rate =
+        member->bytes_per_second > 0 ? member->bytes_per_second : fastest;
+    double seconds =
+        (member->queued_bytes + member->batch_bytes + length) / rate;
+    if (best == nullptr || (online && !best_online) ||
+        (online == best_online && seconds < best_seconds)) {
+      best = member;
+      best_online = online;
+      best_seconds = seconds;
+    }
+  }
+  if (online_only && !best_online) {
+    return nullptr;
+  }
+  return best;
+}
+
+void PrintQueue::FailOver(Worker* worker, std::vector<PrintJob>* batch) {
+  worker->offline_until = std::chrono::steady_clock::now() + kOfflineInterval;
+  // Moves |job| to another member that is online. Returns false if there
+  // is none, or the job was not submitted to a group.
+  auto move = [&](PrintJob& job) {
+    if (!job.group || groups_.count(*job.group) == 0) {
+      return false;
+    }
+    Worker* member = PickMember(*job.group, job.data.size(), worker, true);
+    if (member == nullptr) {
+      return false;
+    }
+    // The other printer has none of it.
+    job.offset = 0;
+    job.printer = member->key;
+    worker->failed_over_jobs++;
+    member->routed_jobs++;
+    stats_.failed_over_jobs++;
+    Push(member, std::move(job));
+    return true;
+  };
+  std::vector<PrintJob> failed;
+  for (PrintJob& job : *batch) {
+    if (!move(job)) {
+      failed.push_back(std::move(job));
+    }
+  }
+  batch->swap(failed);
+  // Those that stay go round to the back, keeping their order.
+  for (size_t i = worker->jobs.size(); i > 0; i--) {
+    PrintJob job = std::move(worker->jobs.front());
+    worker->jobs.pop_front();
+    size_t length = job.data.size();
+    if (move(job)) {
+      worker->queued_bytes -= length;
+    } else {
+      worker->jobs.push_back(std::move(job));
+    }
+  }
+}
+
+PrintQueue::Worker* PrintQueue::WorkerFor(const std::string& printer) {
+  auto it = workers_.find(printer);
+  if (it != workers_.end()) {
+    return it->second.get();
+  }
+  std::unique_ptr<Worker> worker(new Worker());
+  worker->printer = printer;
+  worker->key = InternKey(printer);
+  worker->trace_printer = recorder_.PrinterIndex(printer);
+  worker->created_at = std::chrono::steady_clock::now();
+  worker->transport = transport_factory_(printer);
+  worker->tuner.Pin(chunk_size_);
+  Worker* raw = worker.get();
+  workers_[printer] = std::move(worker);
+  if (!loop_) {
+    raw->thread = std::thread(&PrintQueue::RunWorker, this, raw);
+  }
+  return raw;
+}
+
+PrinterKey PrintQueue::InternKey(const std::string& printer) {
+  auto it = printer_keys_.find(printer);
+  if (it == printer_keys_.end()) {
+    it = printer_keys_
+             .emplace(printer, std::make_shared<const std::string>(printer))
+             .first;
+  }
+  return it->second;
+}
+
+void PrintQueue::RunWorker(Worker* worker) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Reused, as |worker->batch| is in IoLoop mode.
+  std::vector<PrintJob> batch;
+  while (true) {
+    while (!stopping_ && worker->jobs.empty()) {
+      if (worker->warm_up) {
+        lock.unlock();
+        RunWarmUp(worker);
+        lock.lock();
+      } else if (!worker->watched) {
+        worker->cv.wait(lock);
+      } else if (std::chrono::steady_clock::now() < worker->next_probe) {
+        worker->cv.wait_until(lock, worker->next_probe);
+      } else {
+        lock.unlock();
+        ProbeStatus(worker);
+        lock.lock();
+        worker->next_probe =
+            std::chrono::steady_clock::now() + worker->probe_interval;
+      }
+    }
+    if (stopping_) {
+      break;
+    }
+    batch.clear();
+    TakeBatch(worker, &lock, &batch);
+    if (batch.empty()) {
+      // Shutdown() arrived while the batch was held open.
+      break;
+    }
+    lock.unlock();
+
+    ResolveProfile(worker);
+    size_t length;
+    bool success = WriteBatch(worker, &batch, &length);
+    if (success) {
+      AwaitBarrier(worker, batch);
+    }
+    bool finished = FinishBatch(worker, &batch, success, length);
+    lock.lock();
+    if (!finished) {
+      break;
+    }
+  }
+  if (worker->transport) {
+    worker->transport->Close();
+  }
+}
+
+bool PrintQueue::WriteBatch(Worker* worker, std::vector<PrintJob>* batch,
+                            size_t* length) {
+  PrintJob& front = batch->front();
+  *length = front.data.size();
+  if (front.file) {
+    return WriteFileJob(worker, front, length);
+  }
+  if (front.copies > 1) {
+    return WriteCopies(worker, front, length);
+  }
+  if (batch->size() == 1) {
+    return WriteJob(worker, front.data.data(), *length, &front.offset);
+  }
+  std::vector<uint8_t>& merged = worker->merged;
+  merged.clear();
+  for (const PrintJob& job : *batch) {
+    merged.insert(merged.end(), job.data.begin(), job.data.end());
+  }
+  *length = merged.size();
+  size_t offset = 0;
+  return WriteJob(worker, merged.data(), *length, &offset);
+}
+
+bool PrintQueue::FinishBatch(Worker* worker, std::vector<PrintJob>* batch,
+                             bool success, size_t length) {
+  bool interrupted;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interrupted = !success && stopping_;
+  }
+  if (interrupted) {
+    // Interrupted by Shutdown(); leave it in the journal for next start,
+    // along with how much of it the printer already has.
+    if (batch->size() == 1 && batch->front().offset > 0 &&
+        journal_ != nullptr && journal_->is_open()) {
+      journal_->AppendProgress(batch->front().id, batch->front().offset);
+    }
+    return false;
+  }
+  for (const PrintJob& job : *batch) {
+    recorder_.Record(TraceEventType::kFinish, 0, worker->trace_printer,
+                     job.id, success);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = now - worker->batch_started;
+    worker->busy_time += elapsed;
+    worker->batch_bytes = 0;
+    if (success && length > 0 && elapsed.count() > 0) {
+      double rate =
+          length / std::chrono::duration<double>(elapsed).count();
+      // Smoothed, so one job that found the printer's buffer empty does not
+      // make it look several times faster than it is.
+      worker->bytes_per_second = worker->bytes_per_second > 0
+                                     ? (3 * worker->bytes_per_second + rate) / 4
+                                     : rate;
+    }
+    if (!success) {
+      FailOver(worker, batch);
+    }
+  }
+  if (journal_ != nullptr && journal_->is_open()) {
+    recorder_.BeginStage(TraceStage::kJournal, worker->trace_printer,
+                         worker->trace_job);
+    for (const PrintJob& job : *batch) {
+      // Before the completion, so a restart finds the key settled: its
+      // resubmissions are dropped, or resume where a failed job stopped.
+      if (!job.key.empty()) {
+        journal_->AppendSettledKey(
+            job.id, job.key, !success, success ? 0 : job.offset,
+            success ? 0 : job.data.size(),
+            success ? 0 : HashBytes(job.data.data(), job.data.size(), 0));
+      }
+      journal_->AppendCompletion(job.id, success);
+    }
+    recorder_.EndStage(TraceStage::kJournal, worker->trace_printer,
+                       worker->trace_job, true);
+  }
+
+  bool idle;
+  JobObserver observer;
+  PrinterStatus status;
+  std::chrono::steady_clock::time_point started_at;
+  std::chrono::steady_clock::time_point queued_at;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const PrintJob& job : *batch) {
+      if (!job.key.empty()) {
+        SettleKey(job, success);
+      }
+      if (queued_at == std::chrono::steady_clock::time_point() ||
+          job.queued_at < queued_at) {
+        queued_at = job.queued_at;
+      }
+    }
+    worker->trace_job = 0;
+    observer = job_observer_;
+    started_at = worker->batch_started;
+    if (success) {
+      stats_.completed += batch->size();
+      stats_.bytes_written += length;
+    } else {
+      stats_.failed += batch->size();
+    }
+    if (batch->size() > 1) {
+      stats_.coalesced_writes++;
+      stats_.coalesced_jobs += batch->size() - 1;
+    }
+    idle = worker->jobs.empty() && worker->transport;
+    SaveTuning(worker);
+    // A printer that took a job is there; one that failed it is taken to
+    // be gone until a probe says otherwise.
+    status = statuses_[worker->printer];
+    status.connected = success;
+    status.online = success;
+    status.ready = success && (worker->profiled || !profile_resolver_);
+  }
+  ReportStatus(worker, status);
+  if (idle) {
+    worker->transport->Flush();
+  }
+  if (observer) {
+    JobEvent event;
+    event.printer = worker->printer;
+    event.success = success;
+    event.started_at = started_at;
+    event.finished_at = std::chrono::steady_clock::now();
+    for (const PrintJob& job : *batch) {
+      event.id = job.id;
+      event.length = job.file ? 0 : job.data.size();
+      event.queued_at = job.queued_at;
+      observer(event);
+    }
+  }
+  for (PrintJob& job : *batch) {
+    buffers_.Release(std::move(job.data));
+  }
+  // The slowest job of the batch, whether it printed or not.
+  if (queued_at != std::chrono::steady_clock::time_point()) {
+    recorder_.NoteLatency(std::chrono::steady_clock::now() - queued_at);
+  }
+  return true;
+}
+
+void PrintQueue::ProbeStatus(Worker* worker) {
+  Transport* transport = worker->transport.get();
+  PrinterStatus status;
+  bool identified;
+  bool answers_probes;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    status = statuses_[worker->printer];
+    identified = worker->profiled || !profile_resolver_;
+    answers_probes = worker->answers_probes;
+  }
+  recorder_.BeginStage(TraceStage::kProbe, worker->trace_printer, 0);
+  status.connected = transport != nullptr && Connect(worker);
+  uint8_t reply;
+  if (status.connected) {
+    DrainReplies(transport);
+  }
+  bool answered = status.connected && ReadStatus(worker, &reply, 1);
+  if (answered) {
+    status.online = !IsOfflineStatus(reply);
+    if (ReadStatus(worker, &reply, 4)) {
+      status.paper = IsPaperOutStatus(reply)       ? PaperState::kOut
+                     : IsPaperNearEndStatus(reply) ? PaperState::kNearEnd
+                                                   : PaperState::kPresent;
+    }
+  } else {
+    if (status.connected && answers_probes && transport->StreamFd() >= 0) {
+      // A printer that used to answer and now does not may have gone away
+      // with the link left open since the last job; reopening tells.
+      // Printers without a back channel never answer, and reopening them
+      // every probe would only contend with their jobs.
+      transport->Close();
+      recorder_.Record(TraceEventType::kReconnect, 0, worker->trace_printer,
+                       0, 1);
+      status.connected = Connect(worker);
+    }
+    status.online = status.connected;
+  }
+  if (!status.connected) {
+    status.paper = PaperState::kUnknown;
+  }
+  status.ready = status.connected && identified;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (answered) {
+      worker->answers_probes = true;
+      worker->probe_interval = kStatusInterval;
+    } else if (status.connected && !worker->answers_probes) {
+      // All a probe can tell of it is that its link is still open.
+      worker->probe_interval = std::min<std::chrono::milliseconds>(
+          worker->probe_interval * 2, kMaxStatusInterval);
+    } else {
+      worker->probe_interval = kStatusInterval;
+    }
+  }
+  recorder_.EndStage(TraceStage::kProbe, worker->trace_printer, 0,
+                     status.connected);
+  ReportStatus(worker, status);
+}
+
+void PrintQueue::RunWarmUp(Worker* worker) {
+  std::vector<FileJobSpec> preload;
+  SourceFactory source_factory;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    worker->warm_up = false;
+    preload.swap(worker->preload);
+    source_factory = source_factory_;
+  }
+  recorder_.BeginStage(TraceStage::kWarmUp, worker->trace_printer, 0);
+  ResolveProfile(worker);
+  // Read with the printer's profile, as its jobs will be, so what a
+  // caching factory keeps matches what they ask for.
+  for (const FileJobSpec& spec : preload) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) {
+        break;
+      }
+    }
+    std::unique_ptr<JobSource> source = source_factory(spec, worker->profile);
+    const uint8_t* data;
+    size_t piece;
+    while (source && source->Next(&data, &piece)) {
+    }
+  }
+  // Last, so the printer is reported ready only once all of it is done.
+  ProbeStatus(worker);
+  PrinterStatus status;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    status = statuses_[worker->printer];
+  }
+  recorder_.EndStage(TraceStage::kWarmUp, worker->trace_printer, 0,
+                     status.ready);
+}
+
+void PrintQueue::ReportStatus(Worker* worker, const PrinterStatus& status) {
+  StatusObserver observer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = statuses_.find(worker->printer);
+    if (it != statuses_.end() && it->second == status) {
+      return;
+    }
+    statuses_[worker->printer] = status;
+    observer = status_observer_;
+  }
+  if (observer) {
+    observer(worker->printer, status);
+  }
+}
+
+void PrintQueue::ResolveProfile(Worker* worker) {
+  ProfileResolver profile_resolver;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    profile_resolver = profile_resolver_;
+  }
+  Transport* transport = worker->transport.get();
+  if (worker->profiled || !profile_resolver || transport == nullptr ||
+      !Connect(worker)) {
+    return;
+  }
+  // Only this worker touches its profile and |macros|.
+  recorder_.BeginStage(TraceStage::kIdentify, worker->trace_printer,
+                       worker->trace_job);
+  worker->profile = profile_resolver(transport);
+  recorder_.EndStage(TraceStage::kIdentify, worker->trace_printer,
+                     worker->trace_job, true);
+  worker->profiled = true;
+  worker->macros = worker->profile.macros;
+  if (worker->profile.chunk_size > 0) {
+    worker->tuner.Seed(
+        worker->profile.chunk_size,
+        std::chrono::microseconds(worker->profile.chunk_pacing_us));
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  profiles_[worker->printer] = worker->profile;
+}
+
+void PrintQueue::TakeBatch(Worker* worker,
+                           std::unique_lock<std::mutex>* lock,
+                           std::vector<PrintJob>* batch) {
+  std::chrono::steady_clock::time_point deadline;
+  if (HoldBatch(worker, &deadline)) {
+    std::chrono::steady_clock::time_point unused;
+    worker->cv.wait_until(*lock, deadline, [&] {
+      return stopping_ || !HoldBatch(worker, &unused);
+    });
+    if (stopping_) {
+      return;
+    }
+  }
+  TakeJobs(worker, batch);
+}
+
+bool PrintQueue::HoldBatch(
+    const Worker* worker,
+    std::chrono::steady_clock::time_point* deadline) const {
+  // File jobs are already as large as a batch could get, and jobs with
+  // copies are written on their own.
+  const PrintJob& front = worker->jobs.front();
+  if (!coalesce_.enabled || worker->flush_requested || front.file ||
+      front.copies != 1 || front.data.size() >= coalesce_.max_bytes ||
+      worker->queued_bytes >= coalesce_.max_bytes) {
+    return false;
+  }
+  *deadline = front.queued_at + coalesce_.window;
+  return true;
+}
+
+void PrintQueue::TakeJobs(Worker* worker, std::vector<PrintJob>* batch) {
+  worker->flush_requested = false;
+  worker->batch_started = std::chrono::steady_clock::now();
+  worker->trace_job = worker->jobs.front().id;
+  size_t batch_bytes = 0;
+  do {
+    recorder_.Record(TraceEventType::kDequeue, 0, worker->trace_printer,
+                     worker->jobs.front().id,
+                     static_cast<int64_t>(worker->jobs.front().data.size()));
+    batch_bytes += worker->jobs.front().data.size();
+    worker->queued_bytes -= worker->jobs.front().data.size();
+    batch->push_back(std::move(worker->jobs.front()));
+    worker->jobs.pop_front();
+  } while (coalesce_.enabled && !batch->front().file &&
+           batch->front().copies == 1 && !worker->jobs.empty() &&
+           !worker->jobs.front().file && worker->jobs.front().copies == 1 &&
+           batch_bytes + worker->jobs.front().data.size() <=
+               coalesce_.max_bytes);
+  worker->batch_bytes = batch_bytes;
+}
+
+bool PrintQueue::WriteJob(Worker* worker, const uint8_t* data,
+                          size_t length, size_t* offset) {
+  Transport* transport = worker->transport.get();
+  if (transport == nullptr) {
+    return false;
+  }
+  for (int attempt = 1; attempt <= kMaxAttempts; attempt++) {
+    if (attempt > 1 || *offset > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (attempt > 1) {
+        stats_.resent_bytes += length - *offset;
+      }
+      stats_.resumed_bytes += *offset;
+    }
+    if (attempt > 1) {
+      recorder_.Record(TraceEventType::kReconnect, 0, worker->trace_printer,
+                       worker->trace_job, attempt);
+    }
+    bool open = Connect(worker);
+    size_t position = *offset;
+    if (open && WriteChunks(worker, data, length, &position)) {
+      return true;
+    }
+    if (open) {
+      // Whatever follows the last whole command the printer received is
+      // written again; a command cut in half would print as garbage.
+      *offset = CommandBoundary(data, length,
+                                position + transport->Acknowledged());
+    }
+    transport->Close();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (worker->cv.wait_for(lock, kRetryBackoff * attempt,
+                              [&] { return stopping_; })) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+bool PrintQueue::WriteChunks(Worker* worker, const uint8_t* data,
+                             size_t length, size_t* position) {
+  Transport* transport = worker->transport.get();
+  if (transport->StreamFd() < 0) {
+    // LPD sends each Write() as a job of its own, so a job in memory goes
+    // in one; WriteFileJob() frames the pieces of a file job instead.
+    return Write(worker, data + *position, length - *position);
+  }
+  ChunkTuner& tuner = worker->tuner;
+  while (*position < length) {
+    size_t chunk = std::min(tuner.chunk_size(), length - *position);
+    auto start = std::chrono::steady_clock::now();
+    if (!Write(worker, data + *position, chunk)) {
+      uint8_t status;
+      tuner.OnStall(ReadStatus(worker, &status, 1) &&
+                    IsOfflineStatus(status));
+      return false;
+    }
+    tuner.OnWritten(chunk,
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start));
+    *position += chunk;
+    if (*position < length && tuner.pacing().count() > 0) {
+      std::this_thread::sleep_for(tuner.pacing());
+    }
+  }
+  return true;
+}
+
+bool PrintQueue::Connect(Worker* worker) {
+  Transport* transport = worker->transport.get();
+  if (transport->IsOpen()) {
+    return true;
+  }
+  recorder_.BeginStage(TraceStage::kConnect, worker->trace_printer,
+                       worker->trace_job);
+  bool open = transport->Open();
+  recorder_.EndStage(TraceStage::kConnect, worker->trace_printer,
+                     worker->trace_job, open);
+  return open;
+}
+
+bool PrintQueue::Write(Worker* worker, const uint8_t* data, size_t length) {
+  recorder_.BeginStage(TraceStage::kWrite, worker->trace_printer,
+                       worker->trace_job, static_cast<int64_t>(length));
+  bool written = worker->transport->Write(data, length);
+  recorder_.EndStage(TraceStage::kWrite, worker->trace_printer,
+                     worker->trace_job,
+                     written ? static_cast<int64_t>(length) : -1);
+  return written;
+}
+
+ssize_t PrintQueue::WriteSome(Worker* worker, const uint8_t* data,
+                              size_t length) {
+  recorder_.BeginStage(TraceStage::kWrite, worker->trace_printer,
+                       worker->trace_job, static_cast<int64_t>(length));
+  ssize_t count = worker->transport->WriteSome(data, length);
+  recorder_.EndStage(TraceStage::kWrite, worker->trace_printer,
+                     worker->trace_job, count);
+  return count;
+}
+
+bool PrintQueue::ReadStatus(Worker* worker, uint8_t* reply,
+                            uint8_t function) {
+  bool answered = ReadPrinterStatus(worker->transport.get(), reply, function);
+  recorder_.Record(TraceEventType::kStatusReply, function,
+                   worker->trace_printer, worker->trace_job,
+                   answered ? *reply : -1);
+  return answered;
+}
+
+void PrintQueue::SaveTuning(Worker* worker) {
+  auto it = profiles_.find(worker->printer);
+  if (!worker->tuner.converged() || it == profiles_.end()) {
+    return;
+  }
+  it->second.chunk_size = static_cast<int>(worker->tuner.chunk_size());
+  it->second.chunk_pacing_us =
+      static_cast<int>(worker->tuner.pacing().count());
+}
+
+void PrintQueue::AwaitBarrier(Worker* worker,
+                              const std::vector<PrintJob>& batch) {
+  if (!WantsBarrier(batch)) {
+    return;
+  }
+  Transport* transport = worker->transport.get();
+  auto handoff = std::chrono::steady_clock::now();
+  auto deadline = handoff + kBarrierTimeout;
+  if (!PrepareBarrier(transport)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RecordLatency(worker, batch, handoff, false, false, handoff);
+    return;
+  }
+  recorder_.BeginStage(TraceStage::kBarrier, worker->trace_printer,
+                       worker->trace_job);
+  bool answered = false;
+  uint8_t reply;
+  if (Write(worker, kBarrierRequest, sizeof(kBarrierRequest))) {
+    while (!answered) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+          break;
+        }
+      }
+      // In slices, so Shutdown() is not held up by a printer that never
+      // answers.
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0) {
+        break;
+      }
+      ssize_t count = transport->Read(
+          &reply, 1, static_cast<int>(std::min<int64_t>(left.count(), 500)));
+      if (count < 0) {
+        break;
+      }
+      answered = count == 1 && IsBarrierReply(reply);
+    }
+  }
+  recorder_.Record(TraceEventType::kStatusReply, 'r', worker->trace_printer,
+                   worker->trace_job, answered ? reply : -1);
+  recorder_.EndStage(TraceStage::kBarrier, worker->trace_printer,
+                     worker->trace_job, answered);
+  std::lock_guard<std::mutex> lock(mutex_);
+  RecordLatency(worker, batch, handoff, true, answered,
+                std::chrono::steady_clock::now());
+}
+
+void PrintQueue::RecordLatency(
+    Worker* worker, const std::vector<PrintJob>& batch,
+    std::chrono::steady_clock::time_point handoff, bool sent, bool answered,
+    std::chrono::steady_clock::time_point completed) {
+  using std::chrono::duration_cast;
+  using std::chrono::milliseconds;
+  PrinterLatency& latency = latencies_[worker->printer];
+  for (const PrintJob& job : batch) {
+    if (!job.barrier) {
+      continue;
+    }
+    latency.handoff.Add(duration_cast<milliseconds>(handoff - job.queued_at));
+    if (answered) {
+      latency.completion.Add(
+          duration_cast<milliseconds>(completed - job.queued_at));
+    } else if (sent) {
+      latency.unanswered++;
+    } else {
+      latency.unsupported++;
+    }
+  }
+  if (answered) {
+    latency.last_completion_ms =
+        duration_cast<milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+  }
+}
+
+bool PrintQueue::WriteCopies(Worker* worker, const PrintJob& job,
+                             size_t* length) {
+  const uint8_t* data = job.data.data();
+  const size_t size = job.data.size();
+  Transport* transport = worker->transport.get();
+  if (transport != nullptr && job.copies <= 255 && FitsInMacro(data, size)) {
+    // Only this worker touches |macros|.
+    if (worker->macros == MacroSupport::kUnknown && Connect(worker)) {
+      worker->macros = ProbeMacroSupport(transport);
+    }
+    if (worker->macros == MacroSupport::kSupported) {
+      std::vector<uint8_t> macro = WrapInMacro(data, size, job.copies);
+      *length = macro.size();
+      size_t offset = 0;
+      if (!WriteJob(worker, macro.data(), macro.size(), &offset)) {
+        return false;
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_.macro_copies += job.copies - 1;
+      return true;
+    }
+  }
+  // The encoded job is written as it is for every copy; a failed copy is
+  // retried on its own.
+  *length = 0;
+  for (int copy = 0; copy < job.copies; copy++) {
+    size_t offset = 0;
+    if (!WriteJob(worker, data, size, &offset)) {
+      return false;
+    }
+    *length += size;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.resent_copies += job.copies - 1;
+  return true;
+}
+
+bool PrintQueue::WriteFileJob(Worker* worker, const PrintJob& job,
+                              size_t* length) {
+  Transport* transport = worker->transport.get();
+  FileJobSpec spec;
+  if (transport == nullptr ||
+      !ParseFileJobSpec(job.data.data(), job.data.size(), &spec)) {
+    return false;
+  }
+  SourceFactory source_factory;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    source_factory = source_factory_;
+  }
+  for (int attempt = 1; attempt <= kMaxAttempts; attempt++) {
+    // A retry starts the file over; the source holds no state worth keeping.
+    std::unique_ptr<JobSource> source = source_factory(spec, worker->profile);
+    if (!source) {
+      return false;
+    }
+    *length = 0;
+    if (attempt > 1) {
+      recorder_.Record(TraceEventType::kReconnect, 0, worker->trace_printer,
+                       worker->trace_job, attempt);
+    }
+    bool written = Connect(worker);
+    const uint8_t* data;
+    size_t piece;
+    uint64_t total = 0;
+    if (transport->FramesJobs() && !source->TotalLength(&total)) {
+      // The job's length has to be announced before it, so it is read in
+      // full first and sent as one job.
+      std::vector<uint8_t> job_bytes;
+      while (source->Next(&data, &piece)) {
+        job_bytes.insert(job_bytes.end(), data, data + piece);
+      }
+      if (source->failed()) {
+        return false;
+      }
+      written = written && Write(worker, job_bytes.data(), job_bytes.size());
+      *length = job_bytes.size();
+      if (written) {
+        return true;
+      }
+    } else {
+      // Framed, the pieces reach the printer as one job, which it keeps
+      // only once EndJob() succeeds, so a retry never prints part twice.
+      bool framed = transport->FramesJobs();
+      written = written && (!framed || transport->BeginJob(total));
+      while (written && source->Next(&data, &piece)) {
+        written = Write(worker, data, piece);
+        *length += piece;
+      }
+      if (source->failed()) {
+        if (framed) {
+          // Abandons the job the printer has part of.
+          transport->Close();
+        }
+        return false;
+      }
+      if (written && (!framed || transport->EndJob())) {
+        return true;
+      }
+    }
+    transport->Close();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (worker->cv.wait_for(lock, kRetryBackoff * attempt,
+                              [&] { return stopping_; })) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+void PrintQueue::Schedule(Worker* worker) {
+  if (stopping_ || !loop_ || worker->busy) {
+    return;
+  }
+  if (worker->jobs.empty()) {
+    if (worker->warm_up) {
+      worker->busy = true;
+      warm_ups_.push_back([this, worker] {
+        RunWarmUp(worker);
+        std::lock_guard<std::mutex> lock(mutex_);
+        worker->busy = false;
+        Schedule(worker);
+      });
+      // One thread per printer warming up at once, kept for the next.
+      if (idle_warm_up_threads_ < warm_ups_.size()) {
+        warm_up_threads_.emplace_back(&PrintQueue::RunWarmUps, this);
+      } else {
+        warm_up_cv_.notify_one();
+      }
+    }
+    return;
+  }
+  std::chrono::steady_clock::time_point deadline;
+  auto now = std::chrono::steady_clock::now();
+  if (HoldBatch(worker, &deadline) && now < deadline) {
+    if (!worker->window_timer) {
+      worker->window_timer = true;
+      auto delay =
+          std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+      loop_->Post(delay + std::chrono::milliseconds(1), [this, worker] {
+        std::lock_guard<std::mutex> lock(mutex_);
+        worker->window_timer = false;
+        Schedule(worker);
+      });
+    }
+    return;
+  }
+  worker->busy = true;
+  blocking_.push_back([this, worker] { StartBatch(worker); });
+  blocking_cv_.notify_one();
+}
+
+void PrintQueue::ScheduleProbe(Worker* worker,
+                               std::chrono::milliseconds delay) {
+  loop_->Post(delay, [this, worker] {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    // A printer busy with a batch shows how it is doing by how that ends.
+    if (!worker->busy && worker->jobs.empty()) {
+      worker->busy = true;
+      blocking_.push_back([this, worker] {
+        ProbeStatus(worker);
+        std::lock_guard<std::mutex> lock(mutex_);
+        worker->busy = false;
+        Schedule(worker);
+      });
+      blocking_cv_.notify_one();
+    }
+    ScheduleProbe(worker, worker->probe_interval);
+  });
+}
+
+void PrintQueue::RunBlocking() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    blocking_cv_.wait(lock, [&] { return stopping_ || !blocking_.empty(); });
+    if (stopping_) {
+      break;
+    }
+    std::function<void()> task = std::move(blocking_.front());
+    blocking_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+void PrintQueue::RunWarmUps() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    idle_warm_up_threads_++;
+    warm_up_cv_.wait(lock, [&] { return stopping_ || !warm_ups_.empty(); });
+    idle_warm_up_threads_--;
+    if (stopping_) {
+      break;
+    }
+    std::function<void()> task = std::move(warm_ups_.front());
+    warm_ups_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+void PrintQueue::StartBatch(Worker* worker) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    worker->batch.clear();
+    TakeJobs(worker, &worker->batch);
+  }
+  ResolveProfile(worker);
+  if (StartStream(worker)) {
+    StreamStep(worker);
+    return;
+  }
+  size_t length;
+  bool success = WriteBatch(worker, &worker->batch, &length);
+  if (success) {
+    AwaitBarrier(worker, worker->batch);
+  }
+  if (!FinishBatch(worker, &worker->batch, success, length)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  worker->busy = false;
+  Schedule(worker);
+}
+
+bool PrintQueue::StartStream(Worker* worker) {
+  Transport* transport = worker->transport.get();
+  const PrintJob& front = worker->batch.front();
+  if (transport == nullptr || front.file || !Connect(worker) ||
+      transport->StreamFd() < 0) {
+    return false;
+  }
+  ResetStream(worker);
+  Stream& stream = worker->stream;
+  if (front.copies > 1) {
+    if (front.copies <= 255 &&
+        FitsInMacro(front.data.data(), front.data.size())) {
+      if (worker->macros == MacroSupport::kUnknown) {
+        worker->macros = ProbeMacroSupport(transport);
+      }
+      if (worker->macros == MacroSupport::kSupported) {
+        stream.buffer =
+            WrapInMacro(front.data.data(), front.data.size(), front.copies);
+        stream.macro = true;
+      }
+    }
+    if (!stream.macro) {
+      stream.copies_left = front.copies - 1;
+    }
+  } else if (worker->batch.size() > 1) {
+    for (const PrintJob& job : worker->batch) {
+      stream.buffer.insert(stream.buffer.end(), job.data.begin(),
+                           job.data.end());
+    }
+  } else {
+    stream.offset = front.offset;
+  }
+  bool buffered = stream.macro || worker->batch.size() > 1;
+  stream.data = buffered ? stream.buffer.data() : front.data.data();
+  stream.length = buffered ? stream.buffer.size() : front.data.size();
+  stream.active = true;
+  BeginAttempt(worker);
+  return true;
+}
+
+void PrintQueue::BeginAttempt(Worker* worker) {
+  Stream& stream = worker->stream;
+  stream.attempt++;
+  stream.start = stream.offset;
+  stream.sent_before = worker->transport->BytesSent();
+  if (stream.attempt > 1 || stream.offset > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stream.attempt > 1) {
+      stats_.resent_bytes += stream.length - stream.offset;
+    }
+    stats_.resumed_bytes += stream.offset;
+  }
+}
+
+void PrintQueue::StreamStep(Worker* worker) {
+  Stream& stream = worker->stream;
+  Transport* transport = worker->transport.get();
+  ChunkTuner& tuner = worker->tuner;
+  auto resume = [this, worker](bool ready) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) {
+        return;
+      }
+    }
+    if (ready) {
+      StreamStep(worker);
+    } else {
+      StreamFailed(worker);
+    }
+  };
+  while (true) {
+    if (stream.offset == stream.length) {
+      if (stream.copies_left == 0) {
+        EndStream(worker, true);
+        return;
+      }
+      // The next copy, which like a copy written with Write() gets
+      // attempts of its own.
+      stream.copies_left--;
+      stream.offset = 0;
+      stream.attempt = 0;
+      BeginAttempt(worker);
+    }
+    size_t chunk = std::min(tuner.chunk_size(), stream.length - stream.offset);
+    ssize_t count = WriteSome(worker, stream.data + stream.offset, chunk);
+    if (count < 0) {
+      StreamFailed(worker);
+      return;
+    }
+    stream.offset += static_cast<size_t>(count);
+    if (static_cast<size_t>(count) < chunk) {
+      tuner.OnBlocked();
+      break;
+    }
+    tuner.OnWritten(chunk, std::chrono::microseconds(0));
+    if (stream.offset < stream.length && tuner.pacing().count() > 0) {
+      // Rounded up to the loop's millisecond timers.
+      loop_->Post(std::chrono::duration_cast<std::chrono::milliseconds>(
+                      tuner.pacing() + std::chrono::microseconds(999)),
+                  [resume] { resume(true); });
+      return;
+    }
+  }
+  loop_->WaitForFd(transport->StreamFd(), POLLOUT,
+                   transport->write_timeout_ms(), resume);
+}
+
+size_t PrintQueue::DeliveredOffset(Worker* worker) const {
+  const Stream& stream = worker->stream;
+  Transport* transport = worker->transport.get();
+  size_t delivered = 0;
+  if (transport->IsOpen() && transport->BytesDelivered() > stream.sent_before) {
+    delivered = std::min(transport->BytesDelivered() - stream.sent_before,
+                         stream.offset - stream.start);
+  }
+  return CommandBoundary(stream.data, stream.length, stream.start + delivered);
+}
+
+void PrintQueue::StreamFailed(Worker* worker) {
+  Stream& stream = worker->stream;
+  // As in WriteJob(), the retry starts at the last whole command the
+  // printer received.
+  stream.offset = DeliveredOffset(worker);
+  worker->transport->Close();
+  if (stream.attempt >= kMaxAttempts) {
+    EndStream(worker, false);
+    return;
+  }
+  loop_->Post(kRetryBackoff * stream.attempt, [this, worker] {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    blocking_.push_back([this, worker] { ReopenStream(worker); });
+    blocking_cv_.notify_one();
+  });
+}
+
+void PrintQueue::ReopenStream(Worker* worker) {
+  BeginAttempt(worker);
+  recorder_.Record(TraceEventType::kReconnect, 0, worker->trace_printer,
+                   worker->trace_job, worker->stream.attempt);
+  if (Connect(worker) && worker->transport->StreamFd() >= 0) {
+    StreamStep(worker);
+  } else {
+    StreamFailed(worker);
+  }
+}
+
+void PrintQueue::EndStream(Worker* worker, bool success) {
+  Stream& stream = worker->stream;
+  if (success && !stream.barrier_sent && WantsBarrier(worker->batch)) {
+    stream.barrier_sent = true;
+    stream.handoff = std::chrono::steady_clock::now();
+    if (PrepareBarrier(worker->transport.get())) {
+      stream.barrier_deadline = stream.handoff + kBarrierTimeout;
+      SendBarrier(worker);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    RecordLatency(worker, worker->batch, stream.handoff, false, false,
+                  stream.handoff);
+  }
+  PrintJob& front = worker->batch.front();
+  size_t length = stream.length;
+  if (front.copies > 1) {
+    if (!stream.macro) {
+      length *= front.copies;
+    }
+    if (success) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stream.macro) {
+        stats_.macro_copies += front.copies - 1;
+      } else {
+        stats_.resent_copies += front.copies - 1;
+      }
+    }
+  } else if (worker->batch.size() == 1 && !success) {
+    front.offset = stream.offset;
+  }
+  stream.active = false;
+  if (!FinishBatch(worker, &worker->batch, success, length)) {
+    return;
+  }
+  worker->batch.clear();
+  ResetStream(worker);
+  std::lock_guard<std::mutex> lock(mutex_);
+  worker->busy = false;
+  Schedule(worker);
+}
+
+void PrintQueue::ResetStream(Worker* worker) {
+  std::vector<uint8_t> buffer;
+  buffer.swap(worker->stream.buffer);
+  worker->stream = Stream();
+  buffer.clear();
+  worker->stream.buffer.swap(buffer);
+}
+
+void PrintQueue::SendBarrier(Worker* worker) {
+  Stream& stream = worker->stream;
+  Transport* transport = worker->transport.get();
+  ssize_t count =
+      WriteSome(worker, kBarrierRequest + stream.barrier_offset,
+                sizeof(kBarrierRequest) - stream.barrier_offset);
+  if (count < 0) {
+    EndBarrier(worker, false);
+    return;
+  }
+  stream.barrier_offset += static_cast<size_t>(count);
+  if (stream.barrier_offset < sizeof(kBarrierRequest)) {
+    loop_->WaitForFd(transport->StreamFd(), POLLOUT,
+                     transport->write_timeout_ms(), [this, worker](bool ready) {
+                       {
+                         std::lock_guard<std::mutex> lock(mutex_);
+                         if (stopping_) {
+                           return;
+                         }
+                       }
+                       if (ready) {
+                         SendBarrier(worker);
+                       } else {
+                         EndBarrier(worker, false);
+                       }
+                     });
+    return;
+  }
+  WaitForBarrier(worker);
+}
+
+void PrintQueue::WaitForBarrier(Worker* worker) {
+  Stream& stream = worker->stream;
+  Transport* transport = worker->transport.get();
+  auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      stream.barrier_deadline - std::chrono::steady_clock::now());
+  if (left.count() <= 0) {
+    EndBarrier(worker, false);
+    return;
+  }
+  loop_->WaitForFd(
+      transport->StreamFd(), POLLIN, static_cast<int>(left.count()),
+      [this, worker](bool ready) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (stopping_) {
+            return;
+          }
+        }
+        uint8_t reply;
+        ssize_t count = ready ? worker->transport->Read(&reply, 1, 0) : -1;
+        if (count < 0) {
+          EndBarrier(worker, false);
+        } else if (count == 1 && IsBarrierReply(reply)) {
+          recorder_.Record(TraceEventType::kStatusReply, 'r',
+                           worker->trace_printer, worker->trace_job, reply);
+          EndBarrier(worker, true);
+        } else {
+          WaitForBarrier(worker);
+        }
+      });
+}
+
+void PrintQueue::EndBarrier(Worker* worker, bool answered) {
+  if (!answered) {
+    recorder_.Record(TraceEventType::kStatusReply, 'r', worker->trace_printer,
+                     worker->trace_job, -1);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RecordLatency(worker, worker->batch, worker->stream.handoff, true,
+                  answered, std::chrono::steady_clock::now());
+  }
+  EndStream(worker, true);
+}
+
+void PrintQueue::SetCoalesceOptions(const CoalesceOptions& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  coalesce_ = options;
+  // Wakes workers holding a batch so turning coalescing off releases it.
+  for (auto& entry : workers_) {
+    entry.second->cv.notify_all();
+    Schedule(entry.second.get());
+  }
+}
+
+CoalesceOptions PrintQueue::coalesce_options() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return coalesce_;
+}
+
+void PrintQueue::Flush(const std::string& printer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : workers_) {
+    if (printer.empty() || entry.first == printer) {
+      if (!entry.second->jobs.empty()) {
+        entry.second->flush_requested = true;
+      }
+      entry.second->cv.notify_all();
+      Schedule(entry.second.get());
+    }
+  }
+}
+
+void PrintQueue::Shutdown() {
+  std::map<std::string, std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> blocking_threads;
+  std::vector<std::thread> warm_up_threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    for (auto& entry : workers_) {
+      entry.second->cv.notify_all();
+    }
+    blocking_cv_.notify_all();
+    warm_up_cv_.notify_all();
+    workers.swap(workers_);
+    blocking_threads.swap(blocking_threads_);
+    warm_up_threads.swap(warm_up_threads_);
+  }
+  for (auto& entry : workers) {
+    if (entry.second->thread.joinable()) {
+      entry.second->thread.join();
+    }
+  }
+  for (std::thread& thread : blocking_threads) {
+    thread.join();
+  }
+  for (std::thread& thread : warm_up_threads) {
+    thread.join();
+  }
+  if (!loop_) {
+    return;
+  }
+  // Stopped before it is destroyed: a callback still finishing on the
+  // loop's thread may use it once more.
+  loop_->Stop();
+  loop_.reset();
+  for (auto& entry : workers) {
+    Worker* worker = entry.second.get();
+    if (worker->stream.barrier_sent) {
+      // Written in full; only the printer's answer was still to come.
+      FinishBatch(worker, &worker->batch, true, worker->stream.length);
+    } else if (worker->stream.active) {
+      // Cut off mid-stream; recorded like an interrupted Write().
+      if (worker->transport->IsOpen()) {
+        worker->stream.offset = DeliveredOffset(worker);
+      }
+      if (worker->batch.size() == 1 && worker->batch.front().copies == 1) {
+        worker->batch.front().offset = worker->stream.offset;
+      }
+      FinishBatch(worker, &worker->batch, false, 0);
+    }
+    if (worker->transport) {
+      worker->transport->Close();
+    }
+  }
+}
+
+PrintQueueStats PrintQueue::stats() const {
+  BufferPoolStats buffers = buffers_.stats();
+  std::lock_guard<std::mutex> lock(mutex_);
+  PrintQueueStats stats = stats_;
+  for (const auto& entry : workers_) {
+    stats.queued_bytes +=
+        entry.second->queued_bytes + entry.second->batch_bytes;
+  }
+  stats.buffer_allocations = buffers.allocations;
+  stats.buffer_reuses = buffers.reuses;
+  return stats;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,645 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINT_QUEUE_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINT_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "chunk_tuner.h"
+#include "file_source.h"
+#include "flight_recorder.h"
+#include "io_loop.h"
+#include "job_batch.h"
+#include "job_source.h"
+#include "latency_histogram.h"
+#include "printer_macro.h"
+#include "printer_profile.h"
+#include "ring_buffer.h"
+#include "spool_journal.h"
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// A printer or group name, shared by every job queued for it so that queuing
+// a job copies no string.
+using PrinterKey = std::shared_ptr<const std::string>;
+
+struct PrintJob {
+  uint64_t id = 0;
+  PrinterKey printer;
+  std::vector<uint8_t> data;
+  // |data| is a serialized FileJobSpec and the job is streamed from the
+  // file when it is written.
+  bool file = false;
+  // Times the job is printed. Copies of a small job are recorded once as a
+  // printer macro; otherwise the same bytes are written again per copy.
+  int copies = 1;
+  // Idempotency key from the caller, or empty.
+  std::string key;
+  // Bytes of |data| the printer already has from an earlier attempt.
+  size_t offset = 0;
+  // Followed by a status request whose answer marks when the printer has
+  // processed the job; see PrinterLatency.
+  bool barrier = false;
+  // The printer group the job was submitted to, if any; |printer| is the
+  // member it was given to, which may change if that member fails.
+  PrinterKey group;
+  std::chrono::steady_clock::time_point queued_at;
+};
+
+// Merging of consecutive small jobs for the same printer into one write, so
+// a ticket sent as header, lines and cut costs a single transport round trip.
+struct CoalesceOptions {
+  bool enabled = false;
+  // How long a job may wait, from when it was queued, for more jobs to join
+  // it.
+  std::chrono::milliseconds window{30};
+  // A batch is written as soon as it holds this many bytes. Jobs at least
+  // this large are never held back.
+  size_t max_bytes = 16 * 1024;
+};
+
+// The print daemon sends these to plugins; EncodeDaemonReply() lists every
+// field.
+struct PrintQueueStats {
+  uint64_t submitted = 0;
+  uint64_t completed = 0;
+  uint64_t failed = 0;
+  uint64_t bytes_written = 0;
+  // Writes that carried more than one job, and the jobs that rode along in
+  // another job's write.
+  uint64_t coalesced_writes = 0;
+  uint64_t coalesced_jobs = 0;
+  // Extra copies replayed by the printer from a macro, and extra copies
+  // written out again.
+  uint64_t macro_copies = 0;
+  uint64_t resent_copies = 0;
+  // Bytes written again by retries after a transport failure, and bytes
+  // retries skipped because the printer already had them.
+  uint64_t resent_bytes = 0;
+  uint64_t resumed_bytes = 0;
+  // Submissions dropped because their key belonged to a job already queued
+  // or printed.
+  uint64_t deduplicated_jobs = 0;
+  // Group jobs moved to another member after their printer failed.
+  uint64_t failed_over_jobs = 0;
+  // Job bytes queued or being written, and submissions refused because
+  // they would have taken that over the memory limit.
+  uint64_t queued_bytes = 0;
+  uint64_t rejected_jobs = 0;
+  // Job buffers allocated, and those recycled from finished jobs instead.
+  uint64_t buffer_allocations = 0;
+  uint64_t buffer_reuses = 0;
+};
+
+// How one member of a printer group is keeping up.
+struct GroupMemberStats {
+  std::string printer;
+  // Queued bytes, including the batch being written.
+  uint64_t queued_bytes = 0;
+  // Measured from the jobs the member finished; 0 until the first one.
+  double bytes_per_second = 0;
+  // Share of the time since the member's first job spent writing, 0 to 1.
+  double utilization = 0;
+  uint64_t routed_jobs = 0;
+  uint64_t failed_over_jobs = 0;
+  // Failed recently, so the group sends its jobs to other members.
+  bool offline = false;
+};
+
+// How a job ended, as passed to a JobObserver.
+struct JobEvent {
+  uint64_t id = 0;
+  // The printer that wrote it, which for a group job is a member.
+  std::string printer;
+  bool success = false;
+  // Bytes of the job, per copy; 0 for file jobs.
+  size_t length = 0;
+  std::chrono::steady_clock::time_point queued_at;
+  // When the batch it was written in was taken off the queue.
+  std::chrono::steady_clock::time_point started_at;
+  std::chrono::steady_clock::time_point finished_at;
+};
+
+// The paper roll, as the printer's DLE EOT 4 answer describes it.
+enum class PaperState : uint8_t {
+  kUnknown = 0,
+  kPresent = 1,
+  kNearEnd = 2,
+  kOut = 3,
+};
+
+// What the queue last learned of a printer's connection and paper.
+struct PrinterStatus {
+  // The transport opened, and the last job or probe did not fail.
+  bool connected = false;
+  // Connected and not reporting itself offline (cover open, paper out,
+  // feeding). Printers that do not answer DLE EOT count as online.
+  bool online = false;
+  PaperState paper = PaperState::kUnknown;
+  // Connected and identified, so a job would be written straight away
+  // instead of first opening the link and reading the printer's device ID.
+  bool ready = false;
+
+  bool operator==(const PrinterStatus& other) const {
+    return connected == other.connected && online == other.online &&
+           paper == other.paper && ready == other.ready;
+  }
+  bool operator!=(const PrinterStatus& other) const {
+    return !(*this == other);
+  }
+};
+
+// Per-printer FIFO of jobs, each drained by its own worker thread so a slow
+// or offline printer never holds up the others.
+//
+// With an IoLoop set, the worker threads give way to the loop: it streams
+// each batch to every printer whose transport has a StreamFd(), and a pool
+// of kBlockingThreads takes the steps that block (connecting, identifying
+// the printer, file jobs and transports without a descriptor), however many
+// printers there are. Warm-ups run on threads of their own instead, one per
+// printer warming up at once, so they neither wait for each other nor hold
+// up the pool.
+//
+// Byte-stream transports are written in chunks sized, and paced, by a
+// ChunkTuner per printer, which learns how fast the printer drains. What
+// it learns is kept in the printer's profile.
+//
+// A write that fails partway is retried from the last command boundary the
+// printer is known to have received, as reported by the transport, rather
+// than from the start of the job.
+//
+// Jobs submitted to a printer group go to the member expected to finish
+// them first, from the bytes it has queued and the rate it has been
+// draining them. A member whose write fails is skipped for
+// kOfflineInterval and its group jobs move to the other members.
+//
+// Each printer's PrinterStatus is kept from how its jobs end and, for
+// printers passed to Watch(), from DLE EOT 1 and 4 probes every
+// kStatusInterval while it has nothing to print. A printer that has never
+// answered a probe is taken to have no back channel: its link is only
+// reopened when it is closed, and it is probed less and less often, up to
+// kMaxStatusInterval. Changes go to the
+// StatusObserver, so callers need not ask.
+//
+// A job submitted with a barrier is followed by GS r 1. Unlike the DLE EOT
+// real-time requests, the printer answers it only once it has processed
+// what came before, so the answer times the job end to end; the worker
+// waits for it, up to kBarrierTimeout, before the printer's next batch.
+//
+// Job bytes live in buffers recycled through a BufferPool, and each
+// printer's jobs in a RingBuffer, so once warm a job submitted with the
+// pointer Submit() and written without coalescing, copies, a key, a
+// barrier or a journal costs no allocation on the queue's side. The job
+// bytes queued are capped by SetMemoryLimit().
+//
+// WarmUp() does ahead of a printer's first job what that job would
+// otherwise wait for: opening its link, identifying it and reading its
+// status, and reading the files it is expected to print. It runs where the
+// printer's batches do, after any jobs already queued.
+//
+// Every job's way through the queue, the stages that write it and the
+// printer's status replies are kept in a FlightRecorder, so that a job
+// that took far longer than the rest can be traced afterwards.
+//
+// When a journal is attached every job is appended to it before Submit()
+// returns and marked complete once it has been written, so jobs that were
+// still queued when the process died can be handed back to Restore() on the
+// next start.
+class PrintQueue {
+ public:
+  using TransportFactory =
+      std::function<std::unique_ptr<Transport>(const std::string& printer)>;
+  // Opens file jobs for a printer with |profile|. Defaults to
+  // OpenFileSource().
+  using SourceFactory = std::function<std::unique_ptr<JobSource>(
+      const FileJobSpec& spec, const PrinterProfile& profile)>;
+  // Identifies the printer behind an open transport.
+  using ProfileResolver = std::function<PrinterProfile(Transport* transport)>;
+  // Told of every job that printed or failed; not of jobs left queued by
+  // Shutdown(). Runs on a worker thread, or the IoLoop's, without the
+  // queue's lock held.
+  using JobObserver = std::function<void(const JobEvent& event)>;
+  // Told when a printer's status changes, on the thread that noticed,
+  // without the queue's lock held.
+  using StatusObserver = std::function<void(const std::string& printer,
+                                            const PrinterStatus& status)>;
+
+  // |journal| may be null, in which case jobs only live in memory.
+  PrintQueue(TransportFactory transport_factory, SpoolJournal* journal);
+  ~PrintQueue();
+
+  PrintQueue(const PrintQueue&) = delete;
+  PrintQueue& operator=(const PrintQueue&) = delete;
+
+  // Queues |data| for |printer| to be printed |copies| times and returns the
+  // job id, or 0 if the job could not be journaled.
+  //
+  // A non-empty |key| makes the submission idempotent: while a job with the
+  // same key is queued or after it printed, its id is returned and nothing
+  // is queued. Resubmitting a job that failed with the same key and bytes
+  // resumes it where the printer left off.
+  //
+  // With |barrier| the job's latency is recorded for GetLatency().
+  //
+  // Returns 0 as well, without queuing it, if the job would take the bytes
+  // queued over the memory limit; see CanQueue().
+  uint64_t Submit(const std::string& printer, std::vector<uint8_t> data,
+                  int copies = 1, const std::string& key = std::string(),
+                  bool barrier = false);
+
+  // Submit() for bytes the caller keeps, copied into a pooled buffer.
+  uint64_t Submit(const std::string& printer, const uint8_t* data,
+                  size_t length, int copies = 1,
+                  const std::string& key = std::string(),
+                  bool barrier = false);
+
+  // Queues the file described by |spec|. Only the spec is journaled and
+  // held in memory; the file is mapped and streamed in bands when the job
+  // is written, and must stay in place until then.
+  uint64_t SubmitFile(const std::string& printer, const FileJobSpec& spec);
+
+  // Submits |jobs|, each to printers[job.printer], and sets |ids| to what
+  // Submit() would have returned for each. The queue's lock is taken twice
+  // for the whole batch and each printer woken once, rather than for every
+  // job. Jobs are held to the memory limit in order: once one is refused,
+  // so are the rest, and the caller can resend from the first 0.
+  // |optimize| is ignored; jobs are queued as they are.
+  void SubmitBatch(const std::vector<std::string>& printers,
+                   const std::vector<BatchJob>& jobs,
+                   std::vector<uint64_t>* ids);
+
+  void SetSourceFactory(SourceFactory source_factory);
+
+  // Drives the queue from |loop| instead of a thread per printer, with
+  // |blocking_threads| for the steps that block. Must be called before the
+  // first job is submitted or restored.
+  void SetIoLoop(std::unique_ptr<IoLoop> loop,
+                 int blocking_threads = kBlockingThreads);
+
+  // Each printer's profile is resolved once, before its first job is
+  // written. Without a resolver every printer keeps the generic profile.
+  void SetProfileResolver(ProfileResolver profile_resolver);
+
+  // Sets |profile| to the one resolved for |printer|. Returns false, with
+  // the generic profile, until the printer has been identified.
+  bool GetProfile(const std::string& printer, PrinterProfile* profile) const;
+
+  // Writes byte streams in chunks of |chunk_size| instead of what each
+  // printer's tuner learns; 0 goes back to learning. Applies to printers
+  // the queue has not written to yet.
+  void SetChunkSize(size_t chunk_size);
+
+  void SetJobObserver(JobObserver observer);
+
+  void SetStatusObserver(StatusObserver observer);
+
+  // Probes |printer|'s status now and every kStatusInterval it is idle
+  // from then on, until Shutdown(); printers that never answer are probed
+  // at longer intervals.
+  void Watch(const std::string& printer);
+
+  // Connects to |printer|, identifies it and probes its status in the
+  // background, then reads each of |preload| through the source factory
+  // with the printer's profile, so a factory that caches what it renders
+  // has them ready. The outcome is reported to the StatusObserver, with
+  // PrinterStatus::ready set if the printer's next job will not have to
+  // wait for its link or its profile.
+  void WarmUp(const std::string& printer,
+              std::vector<FileJobSpec> preload = std::vector<FileJobSpec>());
+
+  // Sets |status| to what is known of |printer|. Returns false, with it
+  // empty, if the printer has not been watched, warmed up or written to.
+  bool GetStatus(const std::string& printer, PrinterStatus* status) const;
+
+  // Caps the job bytes queued or being written; 0, the default, leaves
+  // them unbounded. A job that would go over is refused, unless nothing
+  // is queued, so that one larger than the limit can still print.
+  void SetMemoryLimit(size_t bytes);
+
+  // False if a job of |length| bytes would be refused for the memory limit
+  // right now.
+  bool CanQueue(size_t length) const;
+
+  // Makes |group| a name jobs can be submitted to, printed by whichever of
+  // |printers| should finish them first. An empty list removes the group.
+  // Returns false if |group| is empty or a member of a group, or if one of
+  // |printers| is a group. Jobs are journaled under the member they were
+  // given to.
+  bool SetGroup(const std::string& group, std::vector<std::string> printers);
+
+  // Fills |members| for |group|. Returns false if there is no such group.
+  bool GetGroupStats(const std::string& group,
+                     std::vector<GroupMemberStats>* members) const;
+
+  // Sets |latency| to what |printer|'s barrier jobs measured. Returns false,
+  // with it empty, if it has had none.
+  bool GetLatency(const std::string& printer, PrinterLatency* latency) const;
+
+  // Re-queues jobs recovered from the journal. They are already journaled,
+  // so only their completion will be recorded. |keys| are the settled keys
+  // it recovered, remembered as if their jobs had just finished here.
+  void Restore(std::vector<JournaledJob> jobs,
+               std::vector<JournaledKey> keys = {});
+
+  // Applies to batches started after the call.
+  void SetCoalesceOptions(const CoalesceOptions& options);
+  CoalesceOptions coalesce_options() const;
+
+  // Ends the coalescing window for jobs already queued for |printer|, or for
+  // every printer when it is empty, so they are written without waiting.
+  void Flush(const std::string& printer);
+
+  // Stops the workers after their current job. Jobs still queued stay in the
+  // journal for the next start.
+  void Shutdown();
+
+  PrintQueueStats stats() const;
+
+  // Always on; dump it to see where a slow job spent its time.
+  FlightRecorder* flight_recorder() { return &recorder_; }
+
+  // Attempts made for a job before it is reported as failed.
+  static constexpr int kMaxAttempts = 3;
+  // Keys remembered for deduplication, oldest forgotten first.
+  static constexpr size_t kMaxJobKeys = 1024;
+  // Threads running the blocking steps when an IoLoop is set.
+  static constexpr int kBlockingThreads = 2;
+  // How long a group member whose write failed gets no new jobs.
+  static constexpr std::chrono::seconds kOfflineInterval{30};
+  // How long a barrier waits for the printer to answer.
+  static constexpr std::chrono::seconds kBarrierTimeout{30};
+  // How often a watched printer with nothing to print is probed.
+  static constexpr std::chrono::seconds kStatusInterval{2};
+  // How far apart probes of a printer that never answers them get.
+  static constexpr std::chrono::seconds kMaxStatusInterval{30};
+  // The memory limit the plugin and the print daemon start with.
+  static constexpr size_t kDefaultMemoryLimit = 64 * 1024 * 1024;
+
+ private:
+  // A batch being written by the IoLoop, one WriteSome() at a time.
+  struct Stream {
+    // The batch's bytes, in |buffer| when they were merged or wrapped in a
+    // macro and otherwise in the job.
+    std::vector<uint8_t> buffer;
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+    size_t offset = 0;
+    // Where the current attempt started, and the transport's BytesSent()
+    // then.
+    size_t start = 0;
+    size_t sent_before = 0;
+    int attempt = 0;
+    // Copies still to write after this one, for jobs without a macro.
+    int copies_left = 0;
+    bool macro = false;
+    bool active = false;
+    // The batch is written and its barrier is waiting for the printer.
+    bool barrier_sent = false;
+    size_t barrier_offset = 0;
+    std::chrono::steady_clock::time_point handoff;
+    std::chrono::steady_clock::time_point barrier_deadline;
+  };
+
+  struct Worker {
+    std::string printer;
+    // |printer|, as the jobs given to the worker hold it.
+    PrinterKey key;
+    // The printer's index in the flight recorder's events, and the first
+    // job of the batch being written, or 0.
+    uint16_t trace_printer = 0;
+    uint64_t trace_job = 0;
+    std::unique_ptr<Transport> transport;
+    RingBuffer<PrintJob> jobs;
+    size_t queued_bytes = 0;
+    bool flush_requested = false;
+    bool profiled = false;
+    PrinterProfile profile;
+    // From the profile, or else probed the first time a job with copies
+    // fits a macro.
+    MacroSupport macros = MacroSupport::kUnknown;
+    ChunkTuner tuner;
+    std::condition_variable cv;
+    std::thread thread;
+    // IoLoop mode: a batch is in progress, and the batch itself, which
+    // |stream| points into.
+    bool busy = false;
+    bool window_timer = false;
+    std::vector<PrintJob> batch;
+    Stream stream;
+    // Coalesced batches written with Write(), kept to be reused.
+    std::vector<uint8_t> merged;
+    // What printer groups route on: the batch being written, and how fast
+    // and how busy the printer has been.
+    size_t batch_bytes = 0;
+    std::chrono::steady_clock::time_point batch_started;
+    std::chrono::steady_clock::time_point created_at;
+    std::chrono::steady_clock::duration busy_time{};
+    double bytes_per_second = 0;
+    std::chrono::steady_clock::time_point offline_until;
+    uint64_t routed_jobs = 0;
+    uint64_t failed_over_jobs = 0;
+    // Probed for its status while idle; the next probe is due then, and
+    // the one after |probe_interval| later. Guarded by |mutex_|.
+    bool watched = false;
+    std::chrono::steady_clock::time_point next_probe;
+    std::chrono::milliseconds probe_interval{kStatusInterval};
+    // The printer has answered a probe, so one it leaves unanswered means
+    // the link may have gone.
+    bool answers_probes = false;
+    // WarmUp() was called, and the files it is to read.
+    bool warm_up = false;
+    std::vector<FileJobSpec> preload;
+  };
+
+  struct KeyedJob {
+    uint64_t id = 0;
+    bool failed = false;
+    // Where a resubmission of the failed job resumes, if its bytes match.
+    size_t offset = 0;
+    size_t length = 0;
+    uint64_t hash = 0;
+  };
+
+  // Registers |job|'s key. Returns false, setting |existing|, if the key
+  // belongs to a job that has not failed. Called with |mutex_| held.
+  bool ClaimKey(PrintJob* job, uint64_t* existing);
+  // Drops the key |job| claimed, for a job that was not queued after all.
+  // Called with |mutex_| held.
+  void ReleaseKey(const PrintJob& job);
+  // Records how a keyed job ended. Called with |mutex_| held.
+  void SettleKey(const PrintJob& job, bool success);
+
+  Worker* WorkerFor(const std::string& printer);
+  // The key jobs for |printer| share. Called with |mutex_| held.
+  PrinterKey InternKey(const std::string& printer);
+  void Enqueue(PrintJob job);
+  // Appends |job| and what it was submitted with to the journal, if there
+  // is one.
+  bool JournalJob(const PrintJob& job);
+  // Whether |length| more bytes fit under the memory limit. Called with
+  // |mutex_| held.
+  bool HasRoom(size_t length) const;
+  // Appends |job| to |worker|'s queue. Called with |mutex_| held.
+  void Push(Worker* worker, PrintJob job);
+  // Gives |job|, if it was submitted to a group, to the member that should
+  // finish it first. Called with |mutex_| held.
+  void RouteJob(PrintJob* job);
+  // The member of |group| expected to finish |length| more bytes first,
+  // other than |failed|. Members offline are only picked when every other
+  // one is too, and never if |online_only|. Called with |mutex_| held.
+  Worker* PickMember(const std::string& group, size_t length,
+                     const Worker* failed, bool online_only);
+  // Takes |worker| offline and moves its group jobs, those in |batch| and
+  // those still queued, to the other members. Called with |mutex_| held.
+  void FailOver(Worker* worker, std::vector<PrintJob>* batch);
+  void RunWorker(Worker* worker);
+  // Resolves |worker|'s profile if a resolver is set and it has not been.
+  void ResolveProfile(Worker* worker);
+  // Waits out the coalescing window and moves the next batch off |worker|'s
+  // queue. Called with |mutex_| held.
+  void TakeBatch(Worker* worker, std::unique_lock<std::mutex>* lock,
+                 std::vector<PrintJob>* batch);
+  // Returns true, setting |deadline| to when the window closes, if the job
+  // at the front of |worker|'s queue may wait for more to join it. Called
+  // with |mutex_| held.
+  bool HoldBatch(const Worker* worker,
+                 std::chrono::steady_clock::time_point* deadline) const;
+  // Moves the next batch off |worker|'s queue. Called with |mutex_| held.
+  void TakeJobs(Worker* worker, std::vector<PrintJob>* batch);
+  // Writes |batch| with the transport's blocking Write(), setting |length|
+  // to the bytes written.
+  bool WriteBatch(Worker* worker, std::vector<PrintJob>* batch,
+                  size_t* length);
+  // Journals and counts how |batch| ended. Returns false if it was cut
+  // short by Shutdown(), in which case it stays in the journal.
+  bool FinishBatch(Worker* worker, std::vector<PrintJob>* batch,
+                   bool success, size_t length);
+  // Writes |data| from |*offset|, retrying from the last command boundary
+  // the printer is known to have received. |offset| is left there if every
+  // attempt fails.
+  bool WriteJob(Worker* worker, const uint8_t* data, size_t length,
+                size_t* offset);
+  // Writes |data| from |*position| in the tuner's chunks, advancing
+  // |position| past each chunk written. Transports that are not a byte
+  // stream get it in one Write().
+  bool WriteChunks(Worker* worker, const uint8_t* data, size_t length,
+                   size_t* position);
+  // Opens |worker|'s transport unless it is open.
+  bool Connect(Worker* worker);
+  // The transport's Write() and WriteSome(), and ReadPrinterStatus(),
+  // traced.
+  bool Write(Worker* worker, const uint8_t* data, size_t length);
+  ssize_t WriteSome(Worker* worker, const uint8_t* data, size_t length);
+  bool ReadStatus(Worker* worker, uint8_t* reply, uint8_t function);
+  // Copies what |worker|'s tuner has learned into its profile. Called with
+  // |mutex_| held.
+  void SaveTuning(Worker* worker);
+  // Sends GS r 1 after |batch| if a job in it asked for a barrier, waits for
+  // the answer and records the latencies.
+  void AwaitBarrier(Worker* worker, const std::vector<PrintJob>& batch);
+  // Records the latencies of |batch|'s barrier jobs, answered at
+  // |completed| or not at all. A barrier that was not |sent| counts as
+  // unsupported. Called with |mutex_| held.
+  void RecordLatency(Worker* worker, const std::vector<PrintJob>& batch,
+                     std::chrono::steady_clock::time_point handoff, bool sent,
+                     bool answered,
+                     std::chrono::steady_clock::time_point completed);
+  // Asks |worker|'s printer for its status and reports it. Runs where the
+  // printer's batches do, while it has none.
+  void ProbeStatus(Worker* worker);
+  // Runs the warm-up WarmUp() asked for while the printer has no batch: on
+  // its worker thread, or in IoLoop mode on a warm-up thread.
+  void RunWarmUp(Worker* worker);
+  // Stores |status| for |worker|'s printer and tells the observer if it
+  // changed. Called without |mutex_| held.
+  void ReportStatus(Worker* worker, const PrinterStatus& status);
+  // IoLoop mode. Queues ProbeStatus() on the blocking pool after |delay|,
+  // and again every |probe_interval|. Called with |mutex_| held.
+  void ScheduleProbe(Worker* worker, std::chrono::milliseconds delay);
+  // Writes every copy of |job|, setting |length| to the bytes written.
+  bool WriteCopies(Worker* worker, const PrintJob& job, size_t* length);
+  // Streams a file job, setting |length| to the bytes written.
+  bool WriteFileJob(Worker* worker, const PrintJob& job, size_t* length);
+
+  // IoLoop mode. Hands |worker|'s next batch to the blocking pool once its
+  // coalescing window closes, or its warm-up if it has no jobs, unless a
+  // batch is already in progress. Called with |mutex_| held.
+  void Schedule(Worker* worker);
+  void RunBlocking();
+  void RunWarmUps();
+  // Runs on the pool: takes the batch and writes it, or sets up |stream|
+  // and passes it to the loop.
+  void StartBatch(Worker* worker);
+  // Sets up |worker->stream| for its batch. Returns false if the batch has
+  // to be written with Write() instead.
+  bool StartStream(Worker* worker);
+  void BeginAttempt(Worker* worker);
+  // Runs on the loop: writes what the transport takes and waits for it to
+  // take more.
+  void StreamStep(Worker* worker);
+  void StreamFailed(Worker* worker);
+  // Runs on the pool: reconnects after a failed attempt.
+  void ReopenStream(Worker* worker);
+  void EndStream(Worker* worker, bool success);
+  // Clears |worker->stream| for the next batch, keeping the capacity of
+  // its buffer.
+  void ResetStream(Worker* worker);
+  // Runs on the loop: AwaitBarrier() without blocking it.
+  void SendBarrier(Worker* worker);
+  void WaitForBarrier(Worker* worker);
+  void EndBarrier(Worker* worker, bool answered);
+  // The offset in the stream the printer is known to have.
+  size_t DeliveredOffset(Worker* worker) const;
+
+  TransportFactory transport_factory_;
+  SourceFactory source_factory_;
+  ProfileResolver profile_resolver_;
+  JobObserver job_observer_;
+  StatusObserver status_observer_;
+  SpoolJournal* journal_;
+  std::unique_ptr<IoLoop> loop_;
+  std::atomic<uint64_t> next_job_id_;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<Worker>> workers_;
+  // Like the workers, never removed; printers and groups are few.
+  std::map<std::string, PrinterKey> printer_keys_;
+  // Outlives the workers, which Shutdown() discards.
+  std::map<std::string, PrinterProfile> profiles_;
+  std::map<std::string, std::vector<std::string>> groups_;
+  // Like |profiles_|, outlives the workers.
+  std::map<std::string, PrinterLatency> latencies_;
+  std::map<std::string, PrinterStatus> statuses_;
+  bool stopping_ = false;
+  size_t chunk_size_ = 0;
+  size_t memory_limit_ = 0;
+  BufferPool buffers_;
+  CoalesceOptions coalesce_;
+  PrintQueueStats stats_;
+  FlightRecorder recorder_;
+  std::map<std::string, KeyedJob> keys_;
+  std::deque<std::string> key_order_;
+  // IoLoop mode.
+  RingBuffer<std::function<void()>> blocking_;
+  std::condition_variable blocking_cv_;
+  std::vector<std::thread> blocking_threads_;
+  RingBuffer<std::function<void()>> warm_ups_;
+  std::condition_variable warm_up_cv_;
+  std::vector<std::thread> warm_up_threads_;
+  size_t idle_warm_up_threads_ = 0;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINT_QUEUE_H_
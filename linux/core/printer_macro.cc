@@ -0,0 +1,51 @@
+#include "printer_macro.h"
+
+#include <algorithm>
+
+#include "printer_profile.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr uint8_t kGs = 0x1D;
+
+}  // namespace
+
+MacroSupport ProbeMacroSupport(Transport* transport) {
+  return ResolvePrinterProfile(transport).macros;
+}
+
+bool FitsInMacro(const uint8_t* data, size_t length) {
+  // The two markers around the job count against the buffer on some models.
+  if (length + 4 > kMacroCapacity) {
+    return false;
+  }
+  for (size_t i = 0; i + 1 < length; i++) {
+    if (data[i] == kGs && (data[i + 1] == ':' || data[i + 1] == '^')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<uint8_t> WrapInMacro(const uint8_t* data, size_t length,
+                                 int copies) {
+  std::vector<uint8_t> wrapped;
+  wrapped.reserve(length + 9);
+  wrapped.push_back(kGs);
+  wrapped.push_back(':');
+  wrapped.insert(wrapped.end(), data, data + length);
+  wrapped.push_back(kGs);
+  wrapped.push_back(':');
+  // GS ^ r t m: run r times, t * 100 ms apart, without waiting for the
+  // feed button.
+  wrapped.push_back(kGs);
+  wrapped.push_back('^');
+  wrapped.push_back(static_cast<uint8_t>(std::min(copies, 255)));
+  wrapped.push_back(0);
+  wrapped.push_back(0);
+  return wrapped;
+}
+
+}  // namespace thermal_printer_flutter
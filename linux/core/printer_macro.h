@@ -0,0 +1,40 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINTER_MACRO_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINTER_MACRO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// Whether a printer can record a job with GS : and replay it with GS ^.
+enum class MacroSupport {
+  kUnknown,
+  kSupported,
+  kUnsupported,
+};
+
+// Macro buffer every ESC/POS printer with macros provides. Larger jobs are
+// sent once per copy.
+constexpr size_t kMacroCapacity = 2048;
+
+// Identifies the printer as ResolvePrinterProfile() does and returns what
+// its table entry says. Printers with no entry, or that cannot be
+// identified, are assumed not to have macros. Nothing is written to a
+// transport that cannot read or that frames jobs.
+MacroSupport ProbeMacroSupport(Transport* transport);
+
+// True if |data| can be recorded as a macro: it fits the macro buffer and
+// does not itself define or run one.
+bool FitsInMacro(const uint8_t* data, size_t length);
+
+// |data| recorded as a macro followed by the command that prints it
+// |copies| times.
+std::vector<uint8_t> WrapInMacro(const uint8_t* data, size_t length,
+                                 int copies);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINTER_MACRO_H_
@@ -0,0 +1,195 @@
+#include "printer_profile.h"
+
+#include <strings.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr uint8_t kGs = 0x1D;
+// GS I n: 66 is the maker name, 67 the model name.
+constexpr uint8_t kMakerName = 66;
+constexpr uint8_t kModelName = 67;
+constexpr uint8_t kReplyHeader = 0x5F;
+constexpr int kReplyTimeoutMs = 500;
+
+struct ProfileEntry {
+  // Empty matches any manufacturer; |model| is a prefix of the model name.
+  const char* manufacturer;
+  const char* model;
+  int paper_width;
+  int band_height;
+  MacroSupport macros;
+};
+
+// Printers seen in the field. Cheap 58 mm printers buffer about 4 KB, so
+// their bands are kept to 64 rows of 48 bytes.
+const ProfileEntry kProfiles[] = {
+    {"EPSON", "TM-T88", 576, 256, MacroSupport::kSupported},
+    {"EPSON", "TM-T20", 576, 256, MacroSupport::kSupported},
+    {"EPSON", "TM-T70", 576, 256, MacroSupport::kSupported},
+    {"EPSON", "TM-m30", 576, 256, MacroSupport::kSupported},
+    {"EPSON", "TM-P20", 384, 128, MacroSupport::kSupported},
+    {"BIXOLON", "SRP-350", 512, 128, MacroSupport::kUnknown},
+    {"CITIZEN", "CT-S310", 576, 128, MacroSupport::kUnknown},
+    {"", "XP-58", 384, 64, MacroSupport::kUnsupported},
+    {"", "XP-80", 576, 128, MacroSupport::kUnsupported},
+    {"", "POS58", 384, 64, MacroSupport::kUnsupported},
+    {"", "POS-58", 384, 64, MacroSupport::kUnsupported},
+    {"", "POS80", 576, 128, MacroSupport::kUnsupported},
+    {"", "POS-80", 576, 128, MacroSupport::kUnsupported},
+    {"", "PT-210", 384, 64, MacroSupport::kUnsupported},
+};
+
+std::string Trim(const std::string& text) {
+  size_t begin = text.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+  size_t end = text.find_last_not_of(" \t\r\n");
+  return text.substr(begin, end - begin + 1);
+}
+
+bool StartsWithIgnoringCase(const std::string& text, const char* prefix) {
+  return strncasecmp(text.c_str(), prefix, strlen(prefix)) == 0;
+}
+
+}  // namespace
+
+bool ParseDeviceId(const std::string& text, DeviceId* id) {
+  *id = DeviceId();
+  size_t offset = 0;
+  while (offset < text.size()) {
+    size_t end = text.find(';', offset);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const std::string field = text.substr(offset, end - offset);
+    offset = end + 1;
+    size_t colon = field.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    const std::string key = Trim(field.substr(0, colon));
+    const std::string value = Trim(field.substr(colon + 1));
+    if (strcasecmp(key.c_str(), "MFG") == 0 ||
+        strcasecmp(key.c_str(), "MANUFACTURER") == 0) {
+      id->manufacturer = value;
+    } else if (strcasecmp(key.c_str(), "MDL") == 0 ||
+               strcasecmp(key.c_str(), "MODEL") == 0) {
+      id->model = value;
+    } else if (strcasecmp(key.c_str(), "CMD") == 0 ||
+               strcasecmp(key.c_str(), "COMMAND SET") == 0) {
+      id->command_set = value;
+    }
+  }
+  return !id->manufacturer.empty() || !id->model.empty();
+}
+
+bool LookupProfile(const DeviceId& id, PrinterProfile* profile) {
+  *profile = PrinterProfile();
+  profile->id = id;
+  for (const ProfileEntry& entry : kProfiles) {
+    if (entry.manufacturer[0] != '\0' &&
+        !StartsWithIgnoringCase(id.manufacturer, entry.manufacturer)) {
+      continue;
+    }
+    // Some printers repeat the maker in the model name.
+    std::string model = id.model;
+    if (entry.manufacturer[0] != '\0' &&
+        StartsWithIgnoringCase(model, entry.manufacturer)) {
+      model = Trim(model.substr(strlen(entry.manufacturer)));
+    }
+    if (!StartsWithIgnoringCase(model, entry.model)) {
+      continue;
+    }
+    profile->name = entry.manufacturer[0] != '\0'
+                        ? std::string(entry.manufacturer) + " " + entry.model
+                        : std::string(entry.model);
+    profile->paper_width = entry.paper_width;
+    profile->band_height = entry.band_height;
+    profile->macros = entry.macros;
+    return true;
+  }
+  return false;
+}
+
+bool ReadPrinterInfo(Transport* transport, std::string* value) {
+  uint8_t reply[96];
+  size_t received = 0;
+  while (received < sizeof(reply)) {
+    ssize_t count = transport->Read(reply + received, sizeof(reply) - received,
+                                    kReplyTimeoutMs);
+    if (count <= 0) {
+      return false;
+    }
+    received += static_cast<size_t>(count);
+    uint8_t* end = reply + received;
+    uint8_t* header = std::find(reply, end, kReplyHeader);
+    uint8_t* nul = std::find(header, end, 0);
+    if (header != end && nul != end) {
+      value->assign(header + 1, nul);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool QueryPrinterInfo(Transport* transport, uint8_t request,
+                      std::string* value) {
+  const uint8_t query[] = {kGs, 'I', request};
+  return transport->Write(query, sizeof(query)) &&
+         ReadPrinterInfo(transport, value);
+}
+
+namespace {
+
+PrinterProfile IdentifyPrinter(Transport* transport) {
+  PrinterProfile profile;
+  std::string text;
+  DeviceId id;
+  if (transport->ReadDeviceId(&text) && ParseDeviceId(text, &id) &&
+      LookupProfile(id, &profile)) {
+    return profile;
+  }
+  // A zero timeout read tells a transport that cannot read from an idle one.
+  // A transport that frames jobs (LPD) would print each query as a job.
+  uint8_t stale[64];
+  if (transport->FramesJobs() ||
+      transport->Read(stale, sizeof(stale), 0) < 0) {
+    LookupProfile(id, &profile);
+    return profile;
+  }
+  std::string maker;
+  if (!QueryPrinterInfo(transport, kMakerName, &maker)) {
+    LookupProfile(id, &profile);
+    return profile;
+  }
+  std::string model;
+  QueryPrinterInfo(transport, kModelName, &model);
+  if (id.manufacturer.empty()) {
+    id.manufacturer = maker;
+  }
+  if (id.model.empty()) {
+    id.model = model;
+  }
+  LookupProfile(id, &profile);
+  return profile;
+}
+
+}  // namespace
+
+PrinterProfile ResolvePrinterProfile(Transport* transport) {
+  PrinterProfile profile = IdentifyPrinter(transport);
+  // Answering GS I says nothing about GS : support, and a printer without
+  // it prints the recorded job instead of storing it.
+  if (profile.macros != MacroSupport::kSupported) {
+    profile.macros = MacroSupport::kUnsupported;
+  }
+  return profile;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,61 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINTER_PROFILE_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINTER_PROFILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "printer_macro.h"
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// The fields of an IEEE 1284 device ID ("MFG:EPSON;MDL:TM-T20II;...") that
+// identify a printer.
+struct DeviceId {
+  std::string manufacturer;
+  std::string model;
+  std::string command_set;
+};
+
+// Reads the MFG/MANUFACTURER, MDL/MODEL and CMD/COMMAND SET keys. Returns
+// false if there is neither a manufacturer nor a model.
+bool ParseDeviceId(const std::string& text, DeviceId* id);
+
+// What the encoder and the queue need to know about a printer.
+struct PrinterProfile {
+  // Name of the table entry that matched, or "generic".
+  std::string name = "generic";
+  DeviceId id;
+  // Dots across the print head.
+  int paper_width = 576;
+  // Rows per GS v 0 band. Printers with a small receive buffer drop or
+  // garble bands larger than it.
+  int band_height = 128;
+  MacroSupport macros = MacroSupport::kUnknown;
+  // Learned by the queue's ChunkTuner as jobs are written; 0 until then.
+  int chunk_size = 0;
+  int chunk_pacing_us = 0;
+};
+
+// Fills |profile| from the built-in table entry for |id|. Returns false,
+// leaving the generic values, if no entry matches.
+bool LookupProfile(const DeviceId& id, PrinterProfile* profile);
+
+// Reads the "_" + text + NUL reply to a GS I request into |value|. Status
+// bytes sent ahead of it are skipped. Returns false if no reply came.
+bool ReadPrinterInfo(Transport* transport, std::string* value);
+
+// Sends GS I |request| and reads its reply. Returns false if the write
+// failed or no reply came.
+bool QueryPrinterInfo(Transport* transport, uint8_t request,
+                      std::string* value);
+
+// Identifies the printer behind the open |transport|: by the device ID its
+// link reports, or else by the maker and model it answers to GS I. Only
+// printers whose table entry says so are taken to have macros. Transports
+// that cannot read, or that frame jobs, are not queried.
+PrinterProfile ResolvePrinterProfile(Transport* transport);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_PRINTER_PROFILE_H_
@@ -0,0 +1,544 @@
+#include "qr_code.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr int kMinVersion = 1;
+constexpr int kMaxVersion = 40;
+
+// ISO/IEC 18004 table 9, indexed by level (L, M, Q, H) and version.
+constexpr int8_t kEccPerBlock[4][41] = {
+    {-1, 7,  10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26,
+     30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30,
+     30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22,
+     24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28,
+     28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+    {-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24,
+     20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30,
+     30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22,
+     24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30,
+     30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+};
+
+constexpr int8_t kBlocks[4][41] = {
+    {-1, 1, 1, 1,  1,  1,  2,  2,  2,  2,  4,  4,  4,  4,
+     4,  6, 6, 6,  6,  7,  8,  8,  9,  9,  10, 12, 12, 12,
+     13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+    {-1, 1,  1,  1,  2,  2,  4,  4,  4,  5,  5,  5,  8,  9,
+     9,  10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25,
+     26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+    {-1, 1,  1,  2,  2,  4,  4,  6,  6,  8,  8,  8,  10, 12,
+     16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34,
+     35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+    {-1, 1,  1,  2,  4,  4,  4,  5,  6,  8,  8,  11, 11, 16,
+     16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40,
+     42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},
+};
+
+// Format information encodes L, M, Q, H as 01, 00, 11, 10.
+constexpr int kFormatLevelBits[4] = {1, 0, 3, 2};
+
+constexpr char kAlphanumeric[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+
+enum class Mode {
+  kNumeric = 1,
+  kAlphanumeric = 2,
+  kByte = 4,
+};
+
+int Level(QrEcc ecc) { return static_cast<int>(ecc); }
+
+// Modules left for codewords once the function patterns are drawn.
+int RawDataModules(int version) {
+  int modules = (16 * version + 128) * version + 64;
+  if (version >= 2) {
+    int alignments = version / 7 + 2;
+    modules -= (25 * alignments - 10) * alignments - 55;
+    if (version >= 7) {
+      modules -= 36;
+    }
+  }
+  return modules;
+}
+
+int DataCodewords(int version, QrEcc ecc) {
+  return RawDataModules(version) / 8 -
+         kEccPerBlock[Level(ecc)][version] * kBlocks[Level(ecc)][version];
+}
+
+std::vector<int> AlignmentPositions(int version) {
+  std::vector<int> positions;
+  if (version == 1) {
+    return positions;
+  }
+  int count = version / 7 + 2;
+  int step = (version * 8 + count * 3 + 5) / (count * 4 - 4) * 2;
+  positions.resize(count);
+  positions[0] = 6;
+  for (int i = count - 1, position = version * 4 + 10; i >= 1;
+       i--, position -= step) {
+    positions[i] = position;
+  }
+  return positions;
+}
+
+int CountBits(Mode mode, int version) {
+  int range = version <= 9 ? 0 : version <= 26 ? 1 : 2;
+  switch (mode) {
+    case Mode::kNumeric:
+      return 10 + 2 * range;
+    case Mode::kAlphanumeric:
+      return 9 + 2 * range;
+    case Mode::kByte:
+      break;
+  }
+  return range == 0 ? 8 : 16;
+}
+
+int AlphanumericValue(char c) {
+  const char* found = c != '\0' ? strchr(kAlphanumeric, c) : nullptr;
+  return found != nullptr ? static_cast<int>(found - kAlphanumeric) : -1;
+}
+
+Mode ChooseMode(const std::string& text) {
+  bool numeric = true;
+  bool alphanumeric = true;
+  for (char c : text) {
+    numeric = numeric && c >= '0' && c <= '9';
+    alphanumeric = alphanumeric && AlphanumericValue(c) >= 0;
+  }
+  return numeric ? Mode::kNumeric
+                 : alphanumeric ? Mode::kAlphanumeric : Mode::kByte;
+}
+
+// Payload bits of |length| characters, headers excluded.
+size_t PayloadBits(Mode mode, size_t length) {
+  switch (mode) {
+    case Mode::kNumeric:
+      return length / 3 * 10 + (length % 3 == 2 ? 7 : length % 3 == 1 ? 4 : 0);
+    case Mode::kAlphanumeric:
+      return length / 2 * 11 + (length % 2) * 6;
+    case Mode::kByte:
+      break;
+  }
+  return length * 8;
+}
+
+class BitWriter {
+ public:
+  void Append(uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+      if (bits_ % 8 == 0) {
+        bytes_.push_back(0);
+      }
+      if ((value >> i) & 1) {
+        bytes_.back() |= static_cast<uint8_t>(0x80 >> (bits_ % 8));
+      }
+      bits_++;
+    }
+  }
+
+  size_t bits() const { return bits_; }
+  std::vector<uint8_t>& bytes() { return bytes_; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+  size_t bits_ = 0;
+};
+
+uint8_t GfMultiply(uint8_t x, uint8_t y) {
+  int z = 0;
+  for (int i = 7; i >= 0; i--) {
+    z = (z << 1) ^ ((z >> 7) * 0x11D);
+    z ^= ((y >> i) & 1) * x;
+  }
+  return static_cast<uint8_t>(z);
+}
+
+// Generator polynomial of degree |degree|, leading 1 dropped, highest
+// power first.
+std::vector<uint8_t> Generator(int degree) {
+  std::vector<uint8_t> result(degree, 0);
+  result[degree - 1] = 1;
+  uint8_t root = 1;
+  for (int i = 0; i < degree; i++) {
+    for (int j = 0; j < degree; j++) {
+      result[j] = GfMultiply(result[j], root);
+      if (j + 1 < degree) {
+        result[j] ^= result[j + 1];
+      }
+    }
+    root = GfMultiply(root, 0x02);
+  }
+  return result;
+}
+
+}  // namespace
+
+std::vector<uint8_t> QrErrorCorrection(const std::vector<uint8_t>& data,
+                                       int ecc_length) {
+  std::vector<uint8_t> generator = Generator(ecc_length);
+  std::vector<uint8_t> remainder(ecc_length, 0);
+  for (uint8_t byte : data) {
+    uint8_t factor = byte ^ remainder[0];
+    remainder.erase(remainder.begin());
+    remainder.push_back(0);
+    for (int i = 0; i < ecc_length; i++) {
+      remainder[i] ^= GfMultiply(generator[i], factor);
+    }
+  }
+  return remainder;
+}
+
+bool QrCode::Encode(const std::string& text, QrEcc ecc, QrCode* code) {
+  const Mode mode = ChooseMode(text);
+  int version = kMinVersion;
+  for (; version <= kMaxVersion; version++) {
+    int count_bits = CountBits(mode, version);
+    size_t bits = 4 + count_bits + PayloadBits(mode, text.size());
+    if (text.size() < (size_t{1} << count_bits) &&
+        bits <= static_cast<size_t>(DataCodewords(version, ecc)) * 8) {
+      break;
+    }
+  }
+  if (version > kMaxVersion) {
+    return false;
+  }
+
+  BitWriter writer;
+  writer.Append(static_cast<uint32_t>(mode), 4);
+  writer.Append(static_cast<uint32_t>(text.size()), CountBits(mode, version));
+  switch (mode) {
+    case Mode::kNumeric:
+      for (size_t i = 0; i < text.size(); i += 3) {
+        size_t digits = std::min<size_t>(3, text.size() - i);
+        uint32_t value = 0;
+        for (size_t j = 0; j < digits; j++) {
+          value = value * 10 + static_cast<uint32_t>(text[i + j] - '0');
+        }
+        writer.Append(value, static_cast<int>(digits * 3 + 1));
+      }
+      break;
+    case Mode::kAlphanumeric:
+      for (size_t i = 0; i + 1 < text.size(); i += 2) {
+        writer.Append(static_cast<uint32_t>(AlphanumericValue(text[i]) * 45 +
+                                            AlphanumericValue(text[i + 1])),
+                      11);
+      }
+      if (text.size() % 2 == 1) {
+        writer.Append(static_cast<uint32_t>(AlphanumericValue(text.back())),
+                      6);
+      }
+      break;
+    case Mode::kByte:
+      for (char c : text) {
+        writer.Append(static_cast<uint8_t>(c), 8);
+      }
+      break;
+  }
+
+  // Terminator, byte alignment, then the alternating pad codewords.
+  const size_t capacity = static_cast<size_t>(DataCodewords(version, ecc)) * 8;
+  writer.Append(0, static_cast<int>(std::min<size_t>(4, capacity -
+                                                            writer.bits())));
+  writer.Append(0, static_cast<int>((8 - writer.bits() % 8) % 8));
+  for (uint8_t pad = 0xEC; writer.bits() < capacity; pad ^= 0xEC ^ 0x11) {
+    writer.Append(pad, 8);
+  }
+
+  code->version_ = version;
+  code->size_ = version * 4 + 17;
+  code->Build(writer.bytes(), ecc);
+  return true;
+}
+
+void QrCode::Build(const std::vector<uint8_t>& data, QrEcc ecc) {
+  modules_.assign(static_cast<size_t>(size_) * size_, 0);
+  function_.assign(modules_.size(), 0);
+
+  // Split into blocks, append each block's error correction, interleave.
+  const int blocks = kBlocks[Level(ecc)][version_];
+  const int block_ecc = kEccPerBlock[Level(ecc)][version_];
+  const int raw = RawDataModules(version_) / 8;
+  const int short_blocks = blocks - raw % blocks;
+  const int short_length = raw / blocks;
+  const int short_data = short_length - block_ecc;
+  std::vector<std::vector<uint8_t>> all(blocks);
+  size_t offset = 0;
+  for (int i = 0; i < blocks; i++) {
+    size_t length = short_data + (i < short_blocks ? 0 : 1);
+    all[i].assign(data.begin() + offset, data.begin() + offset + length);
+    offset += length;
+    std::vector<uint8_t> correction = QrErrorCorrection(all[i], block_ecc);
+    all[i].insert(all[i].end(), correction.begin(), correction.end());
+  }
+  std::vector<uint8_t> codewords;
+  codewords.reserve(raw);
+  for (int i = 0; i <= short_length; i++) {
+    for (int j = 0; j < blocks; j++) {
+      int index = i;
+      if (j < short_blocks) {
+        // Short blocks have no codeword in the last data column.
+        if (i == short_data) {
+          continue;
+        }
+        index = i < short_data ? i : i - 1;
+      }
+      if (index < static_cast<int>(all[j].size())) {
+        codewords.push_back(all[j][index]);
+      }
+    }
+  }
+
+  DrawFunctionPatterns();
+  DrawCodewords(codewords);
+
+  int best_mask = 0;
+  int best_penalty = INT_MAX;
+  for (int mask = 0; mask < 8; mask++) {
+    ApplyMask(mask);
+    DrawFormat(ecc, mask);
+    int penalty = Penalty();
+    if (penalty < best_penalty) {
+      best_penalty = penalty;
+      best_mask = mask;
+    }
+    // Masks are XORs, so applying one again undoes it.
+    ApplyMask(mask);
+  }
+  ApplyMask(best_mask);
+  DrawFormat(ecc, best_mask);
+}
+
+void QrCode::SetFunction(int x, int y, bool dark) {
+  size_t index = static_cast<size_t>(y) * size_ + x;
+  modules_[index] = dark ? 1 : 0;
+  function_[index] = 1;
+}
+
+void QrCode::DrawFunctionPatterns() {
+  for (int i = 0; i < size_; i++) {
+    SetFunction(6, i, i % 2 == 0);
+    SetFunction(i, 6, i % 2 == 0);
+  }
+  DrawFinder(3, 3);
+  DrawFinder(size_ - 4, 3);
+  DrawFinder(3, size_ - 4);
+  std::vector<int> positions = AlignmentPositions(version_);
+  const int count = static_cast<int>(positions.size());
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < count; j++) {
+      // Those three would overlap the finders.
+      if ((i == 0 && j == 0) || (i == 0 && j == count - 1) ||
+          (i == count - 1 && j == 0)) {
+        continue;
+      }
+      DrawAlignment(positions[i], positions[j]);
+    }
+  }
+  // Reserve the format area; the real bits go in once the mask is known.
+  DrawFormat(QrEcc::kLow, 0);
+  DrawVersion();
+}
+
+void QrCode::DrawFinder(int cx, int cy) {
+  for (int dy = -4; dy <= 4; dy++) {
+    for (int dx = -4; dx <= 4; dx++) {
+      int x = cx + dx;
+      int y = cy + dy;
+      if (x < 0 || x >= size_ || y < 0 || y >= size_) {
+        continue;
+      }
+      int distance = std::max(std::abs(dx), std::abs(dy));
+      SetFunction(x, y, distance != 2 && distance != 4);
+    }
+  }
+}
+
+void QrCode::DrawAlignment(int cx, int cy) {
+  for (int dy = -2; dy <= 2; dy++) {
+    for (int dx = -2; dx <= 2; dx++) {
+      SetFunction(cx + dx, cy + dy, std::max(std::abs(dx), std::abs(dy)) != 1);
+    }
+  }
+}
+
+void QrCode::DrawFormat(QrEcc ecc, int mask) {
+  int data = kFormatLevelBits[Level(ecc)] << 3 | mask;
+  int remainder = data;
+  for (int i = 0; i < 10; i++) {
+    remainder = (remainder << 1) ^ ((remainder >> 9) * 0x537);
+  }
+  int bits = (data << 10 | remainder) ^ 0x5412;
+  auto bit = [bits](int i) { return ((bits >> i) & 1) != 0; };
+
+  // Around the top left finder.
+  for (int i = 0; i <= 5; i++) {
+    SetFunction(8, i, bit(i));
+  }
+  SetFunction(8, 7, bit(6));
+  SetFunction(8, 8, bit(7));
+  SetFunction(7, 8, bit(8));
+  for (int i = 9; i < 15; i++) {
+    SetFunction(14 - i, 8, bit(i));
+  }
+  // Split between the other two finders.
+  for (int i = 0; i < 8; i++) {
+    SetFunction(size_ - 1 - i, 8, bit(i));
+  }
+  for (int i = 8; i < 15; i++) {
+    SetFunction(8, size_ - 15 + i, bit(i));
+  }
+  SetFunction(8, size_ - 8, true);
+}
+
+void QrCode::DrawVersion() {
+  if (version_ < 7) {
+    return;
+  }
+  int remainder = version_;
+  for (int i = 0; i < 12; i++) {
+    remainder = (remainder << 1) ^ ((remainder >> 11) * 0x1F25);
+  }
+  long bits = static_cast<long>(version_) << 12 | remainder;
+  for (int i = 0; i < 18; i++) {
+    bool dark = ((bits >> i) & 1) != 0;
+    int a = size_ - 11 + i % 3;
+    int b = i / 3;
+    SetFunction(a, b, dark);
+    SetFunction(b, a, dark);
+  }
+}
+
+void QrCode::DrawCodewords(const std::vector<uint8_t>& codewords) {
+  const size_t total_bits = codewords.size() * 8;
+  size_t i = 0;
+  // Two-module columns from the right, alternating upwards and downwards,
+  // stepping over the vertical timing pattern.
+  for (int right = size_ - 1; right >= 1; right -= 2) {
+    if (right == 6) {
+      right = 5;
+    }
+    const bool upward = ((right + 1) & 2) == 0;
+    for (int step = 0; step < size_; step++) {
+      int y = upward ? size_ - 1 - step : step;
+      for (int j = 0; j < 2; j++) {
+        int x = right - j;
+        size_t index = static_cast<size_t>(y) * size_ + x;
+        if (function_[index] || i >= total_bits) {
+          continue;
+        }
+        modules_[index] = (codewords[i >> 3] >> (7 - (i & 7))) & 1;
+        i++;
+      }
+    }
+  }
+}
+
+void QrCode::ApplyMask(int mask) {
+  for (int y = 0; y < size_; y++) {
+    for (int x = 0; x < size_; x++) {
+      bool invert = false;
+      switch (mask) {
+        case 0:
+          invert = (x + y) % 2 == 0;
+          break;
+        case 1:
+          invert = y % 2 == 0;
+          break;
+        case 2:
+          invert = x % 3 == 0;
+          break;
+        case 3:
+          invert = (x + y) % 3 == 0;
+          break;
+        case 4:
+          invert = (x / 3 + y / 2) % 2 == 0;
+          break;
+        case 5:
+          invert = x * y % 2 + x * y % 3 == 0;
+          break;
+        case 6:
+          invert = (x * y % 2 + x * y % 3) % 2 == 0;
+          break;
+        default:
+          invert = ((x + y) % 2 + x * y % 3) % 2 == 0;
+          break;
+      }
+      size_t index = static_cast<size_t>(y) * size_ + x;
+      if (invert && !function_[index]) {
+        modules_[index] ^= 1;
+      }
+    }
+  }
+}
+
+int QrCode::Penalty() const {
+  int penalty = 0;
+  std::vector<uint8_t> line(size_);
+  auto dark = [&line, this](int i) {
+    return i >= 0 && i < size_ && line[i] != 0;
+  };
+  for (int pass = 0; pass < 2; pass++) {
+    for (int a = 0; a < size_; a++) {
+      for (int b = 0; b < size_; b++) {
+        line[b] = pass == 0 ? module(b, a) : module(a, b);
+      }
+      // Runs of five or more of one colour.
+      int run = 1;
+      for (int i = 1; i <= size_; i++) {
+        if (i < size_ && line[i] == line[i - 1]) {
+          run++;
+          continue;
+        }
+        if (run >= 5) {
+          penalty += run - 2;
+        }
+        run = 1;
+      }
+      // 1:1:3:1:1 finder lookalikes with four light modules on a side;
+      // the quiet zone counts as light.
+      for (int i = 0; i + 7 <= size_; i++) {
+        if (!(dark(i) && !dark(i + 1) && dark(i + 2) && dark(i + 3) &&
+              dark(i + 4) && !dark(i + 5) && dark(i + 6))) {
+          continue;
+        }
+        bool light_before = !dark(i - 1) && !dark(i - 2) && !dark(i - 3) &&
+                            !dark(i - 4);
+        bool light_after = !dark(i + 7) && !dark(i + 8) && !dark(i + 9) &&
+                           !dark(i + 10);
+        if (light_before || light_after) {
+          penalty += 40;
+        }
+      }
+    }
+  }
+  // 2x2 blocks of one colour.
+  for (int y = 0; y + 1 < size_; y++) {
+    for (int x = 0; x + 1 < size_; x++) {
+      bool color = module(x, y);
+      if (color == module(x + 1, y) && color == module(x, y + 1) &&
+          color == module(x + 1, y + 1)) {
+        penalty += 3;
+      }
+    }
+  }
+  // Every 5% away from an even balance of dark and light.
+  int dark_modules = 0;
+  for (uint8_t m : modules_) {
+    dark_modules += m;
+  }
+  int total = size_ * size_;
+  penalty += std::abs(dark_modules * 20 - total * 10) / total * 10;
+  return penalty;
+}
+
+}  // namespace thermal_printer_flutter
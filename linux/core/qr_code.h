@@ -0,0 +1,64 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_QR_CODE_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_QR_CODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+// Error correction level: roughly 7%, 15%, 25% and 30% of the symbol can be
+// lost and still read.
+enum class QrEcc {
+  kLow,
+  kMedium,
+  kQuartile,
+  kHigh,
+};
+
+// QR Code model 2 symbol (ISO/IEC 18004), versions 1 to 40.
+//
+// The text is encoded as one numeric, alphanumeric or byte segment,
+// whichever is the most compact that can hold all of it, in the smallest
+// version that fits at the requested level. The mask is chosen by the
+// standard's penalty rules.
+class QrCode {
+ public:
+  // Returns false if |text| does not fit in a version 40 symbol.
+  static bool Encode(const std::string& text, QrEcc ecc, QrCode* code);
+
+  int version() const { return version_; }
+  // Modules per side, quiet zone excluded.
+  int size() const { return size_; }
+  // True for dark modules. |x| is the column, |y| the row.
+  bool module(int x, int y) const {
+    return modules_[static_cast<size_t>(y) * size_ + x] != 0;
+  }
+
+ private:
+  void Build(const std::vector<uint8_t>& codewords, QrEcc ecc);
+  void DrawFunctionPatterns();
+  void DrawFinder(int cx, int cy);
+  void DrawAlignment(int cx, int cy);
+  void DrawFormat(QrEcc ecc, int mask);
+  void DrawVersion();
+  void DrawCodewords(const std::vector<uint8_t>& codewords);
+  void ApplyMask(int mask);
+  int Penalty() const;
+  void SetFunction(int x, int y, bool dark);
+
+  int version_ = 0;
+  int size_ = 0;
+  std::vector<uint8_t> modules_;
+  std::vector<uint8_t> function_;
+};
+
+// Reed-Solomon error correction codewords for |data| over GF(256) with the
+// QR polynomial 0x11D. Exposed for tests.
+std::vector<uint8_t> QrErrorCorrection(const std::vector<uint8_t>& data,
+                                       int ecc_length);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_QR_CODE_H_
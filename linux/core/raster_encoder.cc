@@ -0,0 +1,297 @@
+#include "raster_encoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// GS v 0 m xL xH yL yH: print raster bit image, normal density.
+constexpr size_t kBandHeaderSize = 8;
+
+void WriteBandHeader(uint8_t* header, size_t bytes_per_row, int rows) {
+  header[0] = 0x1D;
+  header[1] = 0x76;
+  header[2] = 0x30;
+  header[3] = 0x00;
+  header[4] = static_cast<uint8_t>(bytes_per_row & 0xFF);
+  header[5] = static_cast<uint8_t>(bytes_per_row >> 8);
+  header[6] = static_cast<uint8_t>(rows & 0xFF);
+  header[7] = static_cast<uint8_t>(rows >> 8);
+}
+
+}  // namespace
+
+void AppendRasterBands(const uint8_t* rows, size_t bytes_per_row, int height,
+                       int band_height, std::vector<uint8_t>* output) {
+  band_height = std::max(1, std::min(band_height, 0xFFFF));
+  for (int row = 0; row < height; row += band_height) {
+    int count = std::min(band_height, height - row);
+    size_t length = bytes_per_row * count;
+    size_t offset = output->size();
+    output->resize(offset + kBandHeaderSize + length);
+    WriteBandHeader(output->data() + offset, bytes_per_row, count);
+    memcpy(output->data() + offset + kBandHeaderSize,
+           rows + bytes_per_row * row, length);
+  }
+}
+
+int RasterEncoder::ScaledHeight(int source_width, int source_height,
+                                int width) {
+  if (source_width <= 0 || source_height <= 0) {
+    return 0;
+  }
+  int64_t height =
+      (static_cast<int64_t>(source_height) * width + source_width / 2) /
+      source_width;
+  return static_cast<int>(std::max<int64_t>(height, 1));
+}
+
+RasterEncoder::RasterEncoder(int source_width, int source_height,
+                             const RasterOptions& options, Sink sink)
+    : source_width_(std::max(source_width, 1)),
+      source_height_(std::max(source_height, 1)),
+      options_(options),
+      sink_(std::move(sink)),
+      buffered_(options.rotation != Rotation::k0) {
+  options_.band_height = std::max(1, std::min(options_.band_height, 0xFFFF));
+  const int paper_width = std::max(options.width / 8 * 8, 8);
+  if (IsQuarterTurn(options_.rotation)) {
+    height_ = paper_width;
+    width_ = ScaledHeight(source_height_, source_width_, paper_width);
+  } else {
+    width_ = paper_width;
+    height_ = ScaledHeight(source_width_, source_height_, paper_width);
+  }
+  bytes_per_row_ = PackedStride(width_);
+  RotatedSize(width_, height_, options_.rotation, &output_width_,
+              &output_height_);
+  output_stride_ = PackedStride(output_width_);
+  kernels_ = &RasterKernelsFor(width_);
+
+  // Output column x spans [x * source_width, (x + 1) * source_width) and
+  // source column j spans [j * width, (j + 1) * width) in a common integer
+  // space, so the overlaps are exact.
+  column_start_.resize(width_);
+  column_count_.resize(width_);
+  column_offset_.resize(width_);
+  const int64_t span = source_width_;
+  for (int x = 0; x < width_; x++) {
+    int64_t begin = x * span;
+    int64_t end = begin + span;
+    int first = static_cast<int>(begin / width_);
+    int last = static_cast<int>((end - 1) / width_);
+    column_start_[x] = first;
+    column_count_[x] = last - first + 1;
+    column_offset_[x] = static_cast<int>(column_weights_.size());
+    for (int j = first; j <= last; j++) {
+      int64_t overlap = std::min<int64_t>(end, (j + 1) * int64_t{width_}) -
+                        std::max<int64_t>(begin, j * int64_t{width_});
+      column_weights_.push_back(static_cast<float>(overlap) /
+                                static_cast<float>(span));
+    }
+  }
+
+  luminance_.resize(source_width_);
+  resampled_.resize(width_);
+  accumulator_.assign(width_, 0.0f);
+  error_current_.assign(width_ + 2, 0.0f);
+  error_next_.assign(width_ + 2, 0.0f);
+  band_.resize(kBandHeaderSize + output_stride_ * options_.band_height);
+  if (buffered_) {
+    image_.resize(bytes_per_row_ * height_);
+  }
+}
+
+void RasterEncoder::ToLuminance(const uint8_t* pixels, int channels) {
+  for (int x = 0; x < source_width_; x++) {
+    const uint8_t* p = pixels + x * channels;
+    int luma;
+    int alpha = 255;
+    if (channels >= 3) {
+      // ITU-R BT.601 weights in 8.8 fixed point.
+      luma = (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+      if (channels == 4) {
+        alpha = p[3];
+      }
+    } else {
+      luma = p[0];
+      if (channels == 2) {
+        alpha = p[1];
+      }
+    }
+    // Transparent areas are paper.
+    luminance_[x] =
+        static_cast<uint8_t>(255 - ((255 - luma) * alpha + 127) / 255);
+  }
+}
+
+void RasterEncoder::ResampleRow() {
+  for (int x = 0; x < width_; x++) {
+    const uint8_t* source = luminance_.data() + column_start_[x];
+    const float* weights = column_weights_.data() + column_offset_[x];
+    float sum = 0.0f;
+    for (int i = 0; i < column_count_[x]; i++) {
+      sum += weights[i] * source[i];
+    }
+    resampled_[x] = sum;
+  }
+}
+
+bool RasterEncoder::PushRow(const uint8_t* pixels, int channels) {
+  if (source_row_ >= source_height_ || channels < 1 || channels > 4) {
+    return false;
+  }
+  ToLuminance(pixels, channels);
+  ResampleRow();
+
+  // Same scheme vertically: output row y spans [y * source_height,
+  // (y + 1) * source_height) and this source row spans [row * height,
+  // (row + 1) * height). Upscaling emits several rows per source row.
+  const int64_t span = source_height_;
+  const int64_t row_begin = source_row_ * int64_t{height_};
+  const int64_t row_end = row_begin + height_;
+  while (output_row_ < height_) {
+    int64_t out_begin = output_row_ * span;
+    int64_t out_end = out_begin + span;
+    int64_t overlap =
+        std::min(out_end, row_end) - std::max(out_begin, row_begin);
+    if (overlap > 0) {
+      float weight = static_cast<float>(overlap) / static_cast<float>(span);
+      kernels_->accumulate(resampled_.data(), width_, weight,
+                           accumulator_.data());
+    }
+    if (out_end > row_end) {
+      break;
+    }
+    if (!EmitRow(accumulator_.data())) {
+      return false;
+    }
+    std::fill(accumulator_.begin(), accumulator_.end(), 0.0f);
+    output_row_++;
+  }
+  source_row_++;
+  return true;
+}
+
+void RasterEncoder::SetBandCache(BandCache* cache) {
+  if (buffered_ || source_row_ > 0) {
+    return;
+  }
+  cache_ = cache;
+  band_gray_.resize(cache ? static_cast<size_t>(width_) *
+                                options_.band_height
+                          : 0);
+}
+
+void RasterEncoder::DitherRow(const float* gray, uint8_t* packed) {
+  const float threshold = static_cast<float>(options_.threshold);
+  if (options_.dither == DitherMode::kFloydSteinberg) {
+    // Every cell of the next row's error is written, so it needs no
+    // clearing once swapped in.
+    kernels_->dither(gray, width_, threshold, error_current_.data() + 1,
+                     error_next_.data() + 1, packed);
+    error_current_.swap(error_next_);
+  } else {
+    kernels_->threshold(gray, width_, threshold, packed);
+  }
+}
+
+bool RasterEncoder::EmitRow(const float* gray) {
+  if (cache_ != nullptr) {
+    std::copy(gray, gray + width_,
+              band_gray_.begin() + static_cast<size_t>(band_rows_) * width_);
+  } else {
+    uint8_t* packed =
+        buffered_ ? image_.data() + static_cast<size_t>(output_row_) *
+                                        bytes_per_row_
+                  : band_.data() + kBandHeaderSize +
+                        static_cast<size_t>(band_rows_) * bytes_per_row_;
+    DitherRow(gray, packed);
+    if (buffered_) {
+      return true;
+    }
+    if (options_.mirror) {
+      MirrorRow(packed, width_);
+    }
+  }
+  band_rows_++;
+  return band_rows_ < options_.band_height || FlushBand();
+}
+
+void RasterEncoder::EncodeBand() {
+  // Everything that decides the band's dots goes into the key.
+  const uint32_t shape[] = {
+      static_cast<uint32_t>(width_), static_cast<uint32_t>(band_rows_),
+      static_cast<uint32_t>(options_.threshold),
+      static_cast<uint32_t>(options_.dither),
+      static_cast<uint32_t>(options_.mirror)};
+  uint64_t key = HashBytes(shape, sizeof(shape), 0);
+  key = HashBytes(band_gray_.data(),
+                  sizeof(float) * width_ * static_cast<size_t>(band_rows_),
+                  key);
+  uint8_t* rows = band_.data() + kBandHeaderSize;
+  const size_t length = bytes_per_row_ * band_rows_;
+  band_stats_.bands++;
+  if (cache_->Lookup(key, rows, length)) {
+    band_stats_.reused++;
+    return;
+  }
+  std::fill(error_current_.begin(), error_current_.end(), 0.0f);
+  std::fill(error_next_.begin(), error_next_.end(), 0.0f);
+  for (int row = 0; row < band_rows_; row++) {
+    uint8_t* packed = rows + bytes_per_row_ * row;
+    DitherRow(band_gray_.data() + static_cast<size_t>(row) * width_, packed);
+    if (options_.mirror) {
+      MirrorRow(packed, width_);
+    }
+  }
+  cache_->Insert(key, rows, length);
+}
+
+bool RasterEncoder::FlushBand() {
+  if (band_rows_ == 0) {
+    return true;
+  }
+  if (cache_ != nullptr) {
+    EncodeBand();
+  }
+  WriteBandHeader(band_.data(), output_stride_, band_rows_);
+  size_t length = kBandHeaderSize + output_stride_ * band_rows_;
+  band_rows_ = 0;
+  return sink_(band_.data(), length);
+}
+
+bool RasterEncoder::Finish() {
+  // A decoder that stopped short leaves the rest of the image blank rather
+  // than shifting the next job up.
+  while (output_row_ < height_) {
+    std::fill(accumulator_.begin(), accumulator_.end(), 255.0f);
+    if (!EmitRow(accumulator_.data())) {
+      return false;
+    }
+    output_row_++;
+  }
+  if (buffered_) {
+    for (int row = 0; row < output_height_; row += options_.band_height) {
+      band_rows_ = std::min(options_.band_height, output_height_ - row);
+      TransformBitmap(image_.data(), width_, height_, options_.rotation,
+                      options_.mirror, row, band_rows_,
+                      band_.data() + kBandHeaderSize);
+      if (!FlushBand()) {
+        return false;
+      }
+    }
+  }
+  if (!FlushBand()) {
+    return false;
+  }
+  if (cache_ != nullptr) {
+    cache_->RecordJob(band_stats_);
+  }
+  return true;
+}
+
+}  // namespace thermal_printer_flutter
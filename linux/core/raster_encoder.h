@@ -0,0 +1,143 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RASTER_ENCODER_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RASTER_ENCODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "band_cache.h"
+#include "bitmap_transform.h"
+#include "raster_kernels.h"
+
+namespace thermal_printer_flutter {
+
+enum class DitherMode {
+  kThreshold,
+  kFloydSteinberg,
+};
+
+struct RasterOptions {
+  // Output width in dots, rounded down to a whole byte. 576 is 80 mm paper
+  // at 203 dpi, 384 is 58 mm.
+  int width = 576;
+  // Luminance (0-255) below which a dot is printed.
+  int threshold = 128;
+  DitherMode dither = DitherMode::kFloydSteinberg;
+  // Rows per GS v 0 command. Printers buffer a limited amount per command.
+  int band_height = 128;
+  // Applied to the dithered image before it is printed: quarter turns put
+  // the source's height across the paper, so |width| is then the width of
+  // the rotated image.
+  Rotation rotation = Rotation::k0;
+  bool mirror = false;
+};
+
+// Streaming image to ESC/POS raster converter.
+//
+// Source rows go in one at a time and leave as GS v 0 bands: each row is
+// converted to luminance (alpha composited over white paper), box-filtered
+// to the output width, accumulated vertically into the output row it
+// covers, dithered and packed to 1bpp. Memory use is a few rows plus one
+// band, whatever the size of the source image. Rotations other than a
+// plain mirror need every row before the first band, so they keep the
+// packed image, one bit per dot, and turn it band by band in Finish().
+class RasterEncoder {
+ public:
+  // Receives each encoded band, header included. Returning false aborts the
+  // encode.
+  using Sink = std::function<bool(const uint8_t* data, size_t length)>;
+
+  RasterEncoder(int source_width, int source_height,
+                const RasterOptions& options, Sink sink);
+
+  RasterEncoder(const RasterEncoder&) = delete;
+  RasterEncoder& operator=(const RasterEncoder&) = delete;
+
+  // |pixels| holds source_width pixels of |channels| 8-bit samples: 1 gray,
+  // 2 gray + alpha, 3 RGB, 4 RGBA.
+  bool PushRow(const uint8_t* pixels, int channels);
+
+  // Emits the last, partial band. Rows never pushed are left blank.
+  bool Finish();
+
+  // Reuses bands found in |cache| and stores the rest. Must be called
+  // before the first PushRow(). Floyd-Steinberg error is then not carried
+  // from one band into the next, so that a band's dots depend only on its
+  // own rows. Rotated output is not memoized.
+  void SetBandCache(BandCache* cache);
+  const BandStats& band_stats() const { return band_stats_; }
+
+  // Of the printed raster, after rotation.
+  int width() const { return output_width_; }
+  int height() const { return output_height_; }
+  size_t bytes_per_row() const { return output_stride_; }
+
+  // Output height for a source of the given size scaled to |width| dots.
+  static int ScaledHeight(int source_width, int source_height, int width);
+
+ private:
+  void ToLuminance(const uint8_t* pixels, int channels);
+  void ResampleRow();
+  bool EmitRow(const float* gray);
+  void DitherRow(const float* gray, uint8_t* packed);
+  void EncodeBand();
+  bool FlushBand();
+
+  int source_width_;
+  int source_height_;
+  RasterOptions options_;
+  Sink sink_;
+  // The raster as it is dithered, in the source's orientation.
+  int width_;
+  int height_;
+  size_t bytes_per_row_;
+  int output_width_;
+  int output_height_;
+  size_t output_stride_;
+
+  // Horizontal box filter: output column x reads |column_count_[x]| source
+  // columns from |column_start_[x]|, weighted by |column_weights_| starting
+  // at |column_offset_[x]|.
+  std::vector<int> column_start_;
+  std::vector<int> column_count_;
+  std::vector<int> column_offset_;
+  std::vector<float> column_weights_;
+
+  // Specialized for |width_| when it is a standard paper width.
+  const RasterKernels* kernels_;
+
+  std::vector<uint8_t> luminance_;
+  std::vector<float> resampled_;
+  std::vector<float> accumulator_;
+  int source_row_ = 0;
+  int output_row_ = 0;
+
+  // Floyd-Steinberg error carried into the current and next output rows,
+  // with one guard cell on either side.
+  std::vector<float> error_current_;
+  std::vector<float> error_next_;
+
+  // GS v 0 header followed by up to band_height packed rows.
+  std::vector<uint8_t> band_;
+  int band_rows_ = 0;
+
+  // The whole packed image, when the rotation needs it.
+  bool buffered_;
+  std::vector<uint8_t> image_;
+
+  // Gray rows of the current band, kept until it is complete so the band
+  // can be looked up before it is dithered.
+  BandCache* cache_ = nullptr;
+  std::vector<float> band_gray_;
+  BandStats band_stats_;
+};
+
+// Appends |height| packed rows, |bytes_per_row| apart, to |output| as GS v 0
+// commands of at most |band_height| rows each.
+void AppendRasterBands(const uint8_t* rows, size_t bytes_per_row, int height,
+                       int band_height, std::vector<uint8_t>* output);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RASTER_ENCODER_H_
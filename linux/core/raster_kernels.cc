@@ -0,0 +1,113 @@
+#include "raster_kernels.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// kWidth is the row length in dots, a multiple of 8, or 0 for the generic
+// kernels, which take it from |width| and pack a partial last byte.
+
+template <int kWidth>
+void Accumulate(const float* row, int width, float weight, float* sum) {
+  const int length = kWidth != 0 ? kWidth : width;
+  for (int x = 0; x < length; x++) {
+    sum[x] += weight * row[x];
+  }
+}
+
+template <int kWidth>
+void Threshold(const float* gray, int width, float threshold,
+               uint8_t* packed) {
+  static_assert(kWidth % 8 == 0, "fixed widths are whole bytes");
+  const int length = kWidth != 0 ? kWidth : width;
+  const int bytes = length / 8;
+  for (int i = 0; i < bytes; i++) {
+    const float* dots = gray + i * 8;
+    packed[i] = static_cast<uint8_t>(
+        (dots[0] < threshold) << 7 | (dots[1] < threshold) << 6 |
+        (dots[2] < threshold) << 5 | (dots[3] < threshold) << 4 |
+        (dots[4] < threshold) << 3 | (dots[5] < threshold) << 2 |
+        (dots[6] < threshold) << 1 | (dots[7] < threshold));
+  }
+  if (kWidth == 0 && length % 8 != 0) {
+    uint8_t last = 0;
+    for (int x = bytes * 8; x < length; x++) {
+      last |= static_cast<uint8_t>((gray[x] < threshold) << (7 - x % 8));
+    }
+    packed[bytes] = last;
+  }
+}
+
+// One dot of Floyd-Steinberg. The error owed to the right neighbour and to
+// the two cells of |next| not yet final are kept in registers rather than
+// stored and reloaded; the sums are formed in the same order as adding
+// into the arrays would, so the dots are the same.
+inline bool DitherDot(float gray, float current, float threshold,
+                      float* carry, float* below_left, float* below,
+                      float* next_left) {
+  float value = gray + (current + *carry);
+  bool black = value < threshold;
+  float error = value - (black ? 0.0f : 255.0f);
+  *carry = error * (7.0f / 16.0f);
+  *next_left = *below_left + error * (3.0f / 16.0f);
+  *below_left = *below + error * (5.0f / 16.0f);
+  *below = 0.0f + error * (1.0f / 16.0f);
+  return black;
+}
+
+template <int kWidth>
+void Dither(const float* gray, int width, float threshold,
+            const float* current, float* next, uint8_t* packed) {
+  static_assert(kWidth % 8 == 0, "fixed widths are whole bytes");
+  const int length = kWidth != 0 ? kWidth : width;
+  const int bytes = length / 8;
+  float carry = 0.0f;
+  float below_left = 0.0f;
+  float below = 0.0f;
+  for (int i = 0; i < bytes; i++) {
+    uint8_t bits = 0;
+    for (int bit = 0; bit < 8; bit++) {
+      int x = i * 8 + bit;
+      bool black = DitherDot(gray[x], current[x], threshold, &carry,
+                             &below_left, &below, &next[x - 1]);
+      bits |= static_cast<uint8_t>(black << (7 - bit));
+    }
+    packed[i] = bits;
+  }
+  if (kWidth == 0 && length % 8 != 0) {
+    uint8_t last = 0;
+    for (int x = bytes * 8; x < length; x++) {
+      bool black = DitherDot(gray[x], current[x], threshold, &carry,
+                             &below_left, &below, &next[x - 1]);
+      last |= static_cast<uint8_t>(black << (7 - x % 8));
+    }
+    packed[bytes] = last;
+  }
+  next[length - 1] = below_left;
+  next[length] = below;
+}
+
+template <int kWidth>
+constexpr RasterKernels KernelsFor() {
+  return {kWidth, &Accumulate<kWidth>, &Threshold<kWidth>, &Dither<kWidth>};
+}
+
+constexpr RasterKernels kGeneric = KernelsFor<0>();
+// 58 mm and 80 mm paper at 203 dpi.
+constexpr RasterKernels kFixed[] = {KernelsFor<384>(), KernelsFor<512>(),
+                                    KernelsFor<576>()};
+
+}  // namespace
+
+const RasterKernels& RasterKernelsFor(int width) {
+  for (const RasterKernels& kernels : kFixed) {
+    if (kernels.fixed_width == width) {
+      return kernels;
+    }
+  }
+  return kGeneric;
+}
+
+const RasterKernels& GenericRasterKernels() { return kGeneric; }
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,40 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RASTER_KERNELS_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RASTER_KERNELS_H_
+
+#include <cstdint>
+
+namespace thermal_printer_flutter {
+
+// The per-row loops of the raster encoder. Nearly every job is 384, 512 or
+// 576 dots wide, so those widths get copies compiled with the row length
+// as a constant, which the compiler unrolls and vectorizes; other widths
+// use the same code with the length read at run time. Every variant gives
+// the same dots. |width| is ignored by the fixed-width variants.
+struct RasterKernels {
+  // The width these kernels were compiled for, or 0 for any.
+  int fixed_width;
+
+  // sum[x] += weight * row[x].
+  void (*accumulate)(const float* row, int width, float weight, float* sum);
+
+  // Packs a dot for each gray value below |threshold|, most significant bit
+  // first, into PackedStride(width) bytes.
+  void (*threshold)(const float* gray, int width, float threshold,
+                    uint8_t* packed);
+
+  // Floyd-Steinberg: as threshold(), with the error of each dot carried
+  // from |current| into its right neighbour and into |next|. Both hold
+  // width + 2 values and are passed from their second, so that x - 1 and
+  // x + 1 stay inside. |next| is overwritten rather than added to.
+  void (*dither)(const float* gray, int width, float threshold,
+                 const float* current, float* next, uint8_t* packed);
+};
+
+// The kernels specialized for |width|, or the generic ones.
+const RasterKernels& RasterKernelsFor(int width);
+
+const RasterKernels& GenericRasterKernels();
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RASTER_KERNELS_H_
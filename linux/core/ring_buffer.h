@@ -0,0 +1,60 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RING_BUFFER_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RING_BUFFER_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+// FIFO over a circular array that doubles when full and never shrinks, so
+// unlike std::deque, which allocates and frees a block every few elements,
+// a queue that keeps about the same length stops allocating. Not
+// thread-safe.
+template <typename T>
+class RingBuffer {
+ public:
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  T& front() { return slots_[head_]; }
+  const T& front() const { return slots_[head_]; }
+  // The |index|th element from the front.
+  T& operator[](size_t index) {
+    return slots_[(head_ + index) % slots_.size()];
+  }
+
+  void push_back(T value) {
+    if (size_ == slots_.size()) {
+      Grow();
+    }
+    slots_[(head_ + size_) % slots_.size()] = std::move(value);
+    size_++;
+  }
+
+  // Resets the front slot, so what it held is released now rather than
+  // when the slot is reused.
+  void pop_front() {
+    slots_[head_] = T();
+    head_ = (head_ + 1) % slots_.size();
+    size_--;
+  }
+
+ private:
+  void Grow() {
+    std::vector<T> slots(slots_.empty() ? 8 : slots_.size() * 2);
+    for (size_t i = 0; i < size_; i++) {
+      slots[i] = std::move((*this)[i]);
+    }
+    slots_.swap(slots);
+    head_ = 0;
+  }
+
+  std::vector<T> slots_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_RING_BUFFER_H_
@@ -0,0 +1,278 @@
+#include "serial_transport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <utility>
+
+#include "device_transport.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+struct BaudRate {
+  int rate;
+  speed_t speed;
+};
+
+const BaudRate kBaudRates[] = {
+    {1200, B1200},       {2400, B2400},     {4800, B4800},
+    {9600, B9600},       {19200, B19200},   {38400, B38400},
+    {57600, B57600},     {115200, B115200}, {230400, B230400},
+    {460800, B460800},   {921600, B921600},
+};
+
+bool SpeedFor(int rate, speed_t* speed) {
+  for (const BaudRate& baud : kBaudRates) {
+    if (baud.rate == rate) {
+      *speed = baud.speed;
+      return true;
+    }
+  }
+  return false;
+}
+
+// How long the probe waits for a status reply at each rate.
+constexpr int kProbeReplyTimeoutMs = 150;
+// Fallback when nothing answers the probe.
+constexpr int kDefaultBaudRate = 9600;
+
+// DLE EOT 1: transmit printer status. Every ESC/POS printer answers with
+// one byte whose bits 1 and 4 are set and bits 0 and 7 are clear, which is
+// unlikely to come out of a line running at the wrong rate.
+const uint8_t kStatusRequest[] = {0x10, 0x04, 0x01};
+
+bool IsPrinterStatusByte(uint8_t status) { return (status & 0x93) == 0x12; }
+
+}  // namespace
+
+bool IsSupportedBaudRate(int baud_rate) {
+  speed_t speed;
+  return SpeedFor(baud_rate, &speed);
+}
+
+bool ParseFlowControl(const char* name, FlowControl* flow_control) {
+  if (strcmp(name, "none") == 0) {
+    *flow_control = FlowControl::kNone;
+  } else if (strcmp(name, "rtscts") == 0) {
+    *flow_control = FlowControl::kRtsCts;
+  } else if (strcmp(name, "xonxoff") == 0) {
+    *flow_control = FlowControl::kXonXoff;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void SerialSettings::Set(const std::string& path,
+                         const SerialOptions& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_[path] = options;
+}
+
+SerialOptions SerialSettings::Get(const std::string& path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = options_.find(path);
+  return it != options_.end() ? it->second : SerialOptions();
+}
+
+bool IsSerialDevicePath(const std::string& path) {
+  return path.compare(0, 8, "/dev/tty") == 0;
+}
+
+const std::vector<int>& SerialTransport::ProbeRates() {
+  static const std::vector<int> rates = {9600,   19200,  38400,  115200, 57600,
+                                         4800,   230400, 460800, 921600};
+  return rates;
+}
+
+SerialTransport::SerialTransport(std::string path, OptionsProvider options)
+    : path_(std::move(path)), options_provider_(std::move(options)) {}
+
+SerialTransport::~SerialTransport() { Close(); }
+
+bool SerialTransport::Open() {
+  if (fd_ >= 0) {
+    return true;
+  }
+  fd_ = open(path_.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd_ < 0) {
+    return false;
+  }
+  sent_ = 0;
+  if (!Configure(options_provider_())) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void SerialTransport::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool SerialTransport::Configure(const SerialOptions& options) {
+  struct termios tio;
+  if (tcgetattr(fd_, &tio) != 0) {
+    return false;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | PARENB | CSIZE | CRTSCTS);
+  tio.c_cflag |= CS8;
+  tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+  switch (options.flow_control) {
+    case FlowControl::kRtsCts:
+      tio.c_cflag |= CRTSCTS;
+      break;
+    case FlowControl::kXonXoff:
+      tio.c_iflag |= IXON | IXOFF;
+      tio.c_cc[VSTART] = 0x11;
+      tio.c_cc[VSTOP] = 0x13;
+      break;
+    case FlowControl::kNone:
+      break;
+  }
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+
+  int baud_rate = options.baud_rate;
+  if (baud_rate == 0 && probed_baud_rate_ != 0) {
+    baud_rate = probed_baud_rate_;
+  }
+  speed_t speed;
+  if (!SpeedFor(baud_rate != 0 ? baud_rate : kDefaultBaudRate, &speed)) {
+    return false;
+  }
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  if (tcsetattr(fd_, TCSANOW, &tio) != 0) {
+    return false;
+  }
+  applied_ = options;
+  active_baud_rate_ = baud_rate != 0 ? baud_rate : kDefaultBaudRate;
+
+  if (baud_rate == 0) {
+    probed_baud_rate_ = ProbeBaudRate();
+    active_baud_rate_ =
+        probed_baud_rate_ != 0 ? probed_baud_rate_ : kDefaultBaudRate;
+    if (!SetBaudRate(active_baud_rate_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SerialTransport::SetBaudRate(int baud_rate) {
+  speed_t speed;
+  struct termios tio;
+  if (!SpeedFor(baud_rate, &speed) || tcgetattr(fd_, &tio) != 0) {
+    return false;
+  }
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  return tcsetattr(fd_, TCSANOW, &tio) == 0;
+}
+
+int SerialTransport::ProbeBaudRate() {
+  for (int rate : ProbeRates()) {
+    if (!SetBaudRate(rate)) {
+      continue;
+    }
+    tcflush(fd_, TCIOFLUSH);
+    if (!WriteAllNonBlocking(fd_, kStatusRequest, sizeof(kStatusRequest),
+                             kProbeReplyTimeoutMs)) {
+      continue;
+    }
+    uint8_t reply[8];
+    ssize_t received = Read(reply, sizeof(reply), kProbeReplyTimeoutMs);
+    // A single clean status byte; noise at a wrong rate tends to be longer.
+    if (received == 1 && IsPrinterStatusByte(reply[0])) {
+      return rate;
+    }
+  }
+  return 0;
+}
+
+bool SerialTransport::Write(const uint8_t* data, size_t length) {
+  acknowledged_ = 0;
+  if (fd_ < 0) {
+    return false;
+  }
+  SerialOptions options = options_provider_();
+  if (options != applied_) {
+    tcdrain(fd_);
+    if (!Configure(options)) {
+      return false;
+    }
+  }
+  size_t written = 0;
+  bool complete = WriteAllNonBlocking(fd_, data, length,
+                                      applied_.write_timeout_ms, &written);
+  sent_ += written;
+  if (complete) {
+    return true;
+  }
+  // Stalled by flow control, usually: what the UART has not shifted out is
+  // still queued. A port that is gone answers nothing and counts for none.
+  int queued = 0;
+  if (ioctl(fd_, TIOCOUTQ, &queued) == 0 && queued >= 0 &&
+      static_cast<size_t>(queued) <= written) {
+    acknowledged_ = written - static_cast<size_t>(queued);
+  }
+  return false;
+}
+
+ssize_t SerialTransport::WriteSome(const uint8_t* data, size_t length) {
+  if (fd_ < 0) {
+    return -1;
+  }
+  SerialOptions options = options_provider_();
+  int queued = 0;
+  if (options != applied_ && ioctl(fd_, TIOCOUTQ, &queued) == 0 &&
+      queued == 0 && !Configure(options)) {
+    return -1;
+  }
+  ssize_t count = WriteNonBlocking(fd_, data, length);
+  if (count > 0) {
+    sent_ += static_cast<size_t>(count);
+  }
+  return count;
+}
+
+size_t SerialTransport::BytesDelivered() const {
+  int queued = 0;
+  if (fd_ < 0 || ioctl(fd_, TIOCOUTQ, &queued) != 0 || queued < 0 ||
+      static_cast<size_t>(queued) > sent_) {
+    return 0;
+  }
+  return sent_ - static_cast<size_t>(queued);
+}
+
+ssize_t SerialTransport::Read(uint8_t* data, size_t length, int timeout_ms) {
+  if (fd_ < 0) {
+    return -1;
+  }
+  if (!WaitForFd(fd_, POLLIN, timeout_ms)) {
+    return 0;
+  }
+  ssize_t ret;
+  do {
+    ret = read(fd_, data, length);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 0;
+  }
+  return ret;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,117 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SERIAL_TRANSPORT_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SERIAL_TRANSPORT_H_
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+enum class FlowControl {
+  kNone,
+  kRtsCts,
+  kXonXoff,
+};
+
+struct SerialOptions {
+  // 0 probes the printer for its rate on the first Open().
+  int baud_rate = 9600;
+  FlowControl flow_control = FlowControl::kNone;
+  // A printer holding CTS low or sending XOFF pauses writes; this long
+  // without progress fails the job.
+  int write_timeout_ms = 10000;
+
+  bool operator==(const SerialOptions& other) const {
+    return baud_rate == other.baud_rate &&
+           flow_control == other.flow_control &&
+           write_timeout_ms == other.write_timeout_ms;
+  }
+  bool operator!=(const SerialOptions& other) const {
+    return !(*this == other);
+  }
+};
+
+// Returns true for the rates accepted in SerialOptions::baud_rate.
+bool IsSupportedBaudRate(int baud_rate);
+
+// Parses "none", "rtscts" or "xonxoff". Unknown names leave |flow_control|
+// untouched and return false.
+bool ParseFlowControl(const char* name, FlowControl* flow_control);
+
+// Raw 8N1 transport for RS-232 and USB-serial adapters (/dev/ttyS*,
+// /dev/ttyUSB*, /dev/ttyACM*). The port is non-blocking and writes wait on
+// poll(), so flow control simply stalls the write loop instead of a thread.
+class SerialTransport : public Transport {
+ public:
+  // Called before each open and write; returning different options
+  // reconfigures the port in place.
+  using OptionsProvider = std::function<SerialOptions()>;
+
+  SerialTransport(std::string path, OptionsProvider options);
+  ~SerialTransport() override;
+
+  SerialTransport(const SerialTransport&) = delete;
+  SerialTransport& operator=(const SerialTransport&) = delete;
+
+  bool Open() override;
+  void Close() override;
+  bool IsOpen() const override { return fd_ >= 0; }
+  bool Write(const uint8_t* data, size_t length) override;
+  // What write() accepted, less what is still in the tty's output queue.
+  size_t Acknowledged() const override { return acknowledged_; }
+  int StreamFd() const override { return fd_; }
+  // Changed options are applied once the output queue has drained, so a
+  // stream never waits in tcdrain().
+  ssize_t WriteSome(const uint8_t* data, size_t length) override;
+  size_t BytesSent() const override { return sent_; }
+  size_t BytesDelivered() const override;
+  int write_timeout_ms() const override { return applied_.write_timeout_ms; }
+  ssize_t Read(uint8_t* data, size_t length, int timeout_ms) override;
+
+  // The rate in use, after probing when the options asked for it.
+  int baud_rate() const { return active_baud_rate_; }
+  int fd() const { return fd_; }
+
+  // Candidate rates tried by the probe, most common thermal printer rates
+  // first.
+  static const std::vector<int>& ProbeRates();
+
+ private:
+  bool Configure(const SerialOptions& options);
+  bool SetBaudRate(int baud_rate);
+  int ProbeBaudRate();
+
+  std::string path_;
+  OptionsProvider options_provider_;
+  SerialOptions applied_;
+  int active_baud_rate_ = 0;
+  // Rate found by an earlier probe, reused on reconnect.
+  int probed_baud_rate_ = 0;
+  int fd_ = -1;
+  size_t acknowledged_ = 0;
+  // Bytes Write() and WriteSome() have written since Open().
+  size_t sent_ = 0;
+};
+
+// Per-port options shared between the channel handler, which updates them
+// from writebytes arguments, and the transports that read them.
+class SerialSettings {
+ public:
+  void Set(const std::string& path, const SerialOptions& options);
+  SerialOptions Get(const std::string& path) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, SerialOptions> options_;
+};
+
+// True for device paths served by SerialTransport rather than the lp driver.
+bool IsSerialDevicePath(const std::string& path);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SERIAL_TRANSPORT_H_
@@ -0,0 +1,755 @@
+#include "spool_journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "crc32c.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+constexpr uint32_t kFileMagic = 0x4A465054;  // "TPFJ"
+constexpr uint32_t kFileVersion = 1;
+constexpr uint32_t kRecordMagic = 0x52465054;  // "TPFR"
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t reserved;
+};
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t length;
+  uint32_t crc;
+  uint8_t type;
+  uint8_t reserved[3];
+  uint64_t job_id;
+};
+
+// Payload of a settled key record, followed by the key.
+struct SettledKeyRecord {
+  uint64_t offset;
+  uint64_t length;
+  uint64_t hash;
+  uint8_t failed;
+  uint8_t reserved[7];
+};
+
+static_assert(sizeof(FileHeader) == 16, "unexpected FileHeader layout");
+static_assert(sizeof(RecordHeader) == 24, "unexpected RecordHeader layout");
+static_assert(sizeof(SettledKeyRecord) == 32,
+              "unexpected SettledKeyRecord layout");
+
+// The checksum covers everything after the crc field.
+constexpr size_t kCrcOffset = offsetof(RecordHeader, type);
+
+size_t AlignRecord(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+// The header of a record made of |prefix| followed by |payload|, with the
+// checksum of both.
+RecordHeader FrameRecord(uint8_t type, uint64_t id, const void* prefix,
+                         size_t prefix_length, const void* payload,
+                         size_t length) {
+  RecordHeader header = {};
+  header.magic = kRecordMagic;
+  header.length = static_cast<uint32_t>(prefix_length + length);
+  header.type = type;
+  header.job_id = id;
+  uint32_t crc =
+      Crc32c(0, reinterpret_cast<const uint8_t*>(&header) + kCrcOffset,
+             sizeof(RecordHeader) - kCrcOffset);
+  crc = Crc32c(crc, prefix, prefix_length);
+  crc = Crc32c(crc, payload, length);
+  header.crc = crc;
+  return header;
+}
+
+size_t PageSize() {
+  static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return page_size;
+}
+
+bool WriteAll(int fd, const uint8_t* data, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fd, data, length);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    length -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+std::string DirectoryOf(const std::string& path) {
+  size_t slash = path.rfind('/');
+  if (slash == std::string::npos) {
+    return ".";
+  }
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+}  // namespace
+
+SpoolJournal::SpoolJournal(SpoolJournalOptions options) : options_(options) {}
+
+SpoolJournal::~SpoolJournal() { Close(); }
+
+bool SpoolJournal::Open(const std::string& path,
+                        std::vector<JournaledJob>* pending,
+                        std::vector<JournaledKey>* keys) {
+  Close();
+  path_ = path;
+  temp_path_ = path + ".compact";
+  directory_ = DirectoryOf(path);
+  stats_ = SpoolJournalStats();
+  next_job_id_ = 1;
+
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    return false;
+  }
+  struct stat st = {};
+  if (fstat(fd_, &st) != 0) {
+    Close();
+    return false;
+  }
+  size_t file_size = static_cast<size_t>(st.st_size);
+  if (!MapFile(std::max(file_size, options_.initial_capacity))) {
+    Close();
+    return false;
+  }
+
+  bool needs_compaction = false;
+  std::vector<JournaledJob> recovered;
+  std::vector<JournaledKey> recovered_keys;
+  if (file_size >= sizeof(FileHeader)) {
+    if (!Replay(&recovered, &recovered_keys, &needs_compaction)) {
+      // Not a journal we understand; start over rather than refuse to print.
+      needs_compaction = true;
+      recovered.clear();
+      recovered_keys.clear();
+    }
+  } else {
+    needs_compaction = true;
+  }
+
+  if (needs_compaction && !Compact(path, recovered, recovered_keys)) {
+    Close();
+    return false;
+  }
+
+  synced_offset_ = write_offset_;
+  sync_requested_ = 0;
+  compacted_size_ = write_offset_;
+  settled_ = false;
+  stopping_ = false;
+  flusher_ = std::thread(&SpoolJournal::FlushLoop, this);
+
+  if (pending != nullptr) {
+    *pending = std::move(recovered);
+  }
+  if (keys != nullptr) {
+    *keys = std::move(recovered_keys);
+  }
+  return true;
+}
+
+void SpoolJournal::Close() {
+  if (flusher_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    flush_cv_.notify_one();
+    flusher_.join();
+  }
+  if (map_ != nullptr) {
+    munmap(map_, capacity_);
+    map_ = nullptr;
+    capacity_ = 0;
+  }
+  if (fd_ >= 0) {
+    // Drop the sparse tail so the file on disk is only as big as its data.
+    if (write_offset_ > 0 && ftruncate(fd_, write_offset_) == 0) {
+      fdatasync(fd_);
+    }
+    close(fd_);
+    fd_ = -1;
+  }
+  synced_cv_.notify_all();
+  write_offset_ = 0;
+  synced_offset_ = 0;
+}
+
+bool SpoolJournal::MapFile(size_t capacity) {
+  capacity = (capacity + PageSize() - 1) & ~(PageSize() - 1);
+  struct stat st = {};
+  if (fstat(fd_, &st) != 0) {
+    return false;
+  }
+  if (static_cast<size_t>(st.st_size) < capacity &&
+      ftruncate(fd_, static_cast<off_t>(capacity)) != 0) {
+    return false;
+  }
+  void* map =
+      mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  map_ = static_cast<uint8_t*>(map);
+  capacity_ = capacity;
+  return true;
+}
+
+bool SpoolJournal::EnsureCapacity(size_t needed) {
+  if (needed <= capacity_) {
+    return true;
+  }
+  size_t new_capacity = capacity_;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+  std::lock_guard<std::mutex> remap_lock(remap_mutex_);
+  if (ftruncate(fd_, static_cast<off_t>(new_capacity)) != 0) {
+    return false;
+  }
+  void* map = mremap(map_, capacity_, new_capacity, MREMAP_MAYMOVE);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  map_ = static_cast<uint8_t*>(map);
+  capacity_ = new_capacity;
+  return true;
+}
+
+bool SpoolJournal::Replay(std::vector<JournaledJob>* pending,
+                          std::vector<JournaledKey>* keys,
+                          bool* needs_compaction) {
+  FileHeader file_header;
+  memcpy(&file_header, map_, sizeof(file_header));
+  if (file_header.magic != kFileMagic || file_header.version != kFileVersion) {
+    return false;
+  }
+
+  std::vector<JournaledJob> jobs;
+  std::unordered_map<uint64_t, size_t> index;
+  std::vector<bool> done;
+  std::vector<JournaledKey> settled;
+  size_t offset = sizeof(FileHeader);
+  while (offset + sizeof(RecordHeader) <= capacity_) {
+    RecordHeader header;
+    memcpy(&header, map_ + offset, sizeof(header));
+    if (header.magic != kRecordMagic ||
+        header.length > capacity_ - offset - sizeof(RecordHeader)) {
+      break;
+    }
+    const uint8_t* payload = map_ + offset + sizeof(RecordHeader);
+    uint32_t crc = Crc32c(0, reinterpret_cast<const uint8_t*>(&header) +
+                                 kCrcOffset,
+                          sizeof(RecordHeader) - kCrcOffset);
+    crc = Crc32c(crc, payload, header.length);
+    if (crc != header.crc) {
+      break;
+    }
+    stats_.replayed_records++;
+    next_job_id_ = std::max(next_job_id_, header.job_id + 1);
+
+    if ((header.type == kRecordJob || header.type == kRecordFileJob) &&
+        header.length >= sizeof(uint16_t)) {
+      uint16_t name_length;
+      memcpy(&name_length, payload, sizeof(name_length));
+      if (sizeof(uint16_t) + name_length <= header.length) {
+        JournaledJob job;
+        job.id = header.job_id;
+        job.printer.assign(
+            reinterpret_cast<const char*>(payload + sizeof(uint16_t)),
+            name_length);
+        const uint8_t* data = payload + sizeof(uint16_t) + name_length;
+        job.data.assign(data, payload + header.length);
+        job.file = header.type == kRecordFileJob;
+        index[job.id] = jobs.size();
+        jobs.push_back(std::move(job));
+        done.push_back(false);
+      }
+    } else if (header.type == kRecordCopies &&
+               header.length >= sizeof(uint16_t)) {
+      auto it = index.find(header.job_id);
+      if (it != index.end()) {
+        uint16_t copies;
+        memcpy(&copies, payload, sizeof(copies));
+        jobs[it->second].copies = std::max<int>(copies, 1);
+      }
+    } else if (header.type == kRecordKey) {
+      auto it = index.find(header.job_id);
+      if (it != index.end()) {
+        jobs[it->second].key.assign(reinterpret_cast<const char*>(payload),
+                                    header.length);
+      }
+    } else if (header.type == kRecordProgress &&
+               header.length >= sizeof(uint64_t)) {
+      auto it = index.find(header.job_id);
+      if (it != index.end()) {
+        memcpy(&jobs[it->second].offset, payload, sizeof(uint64_t));
+      }
+    } else if (header.type == kRecordSettledKey &&
+               header.length >= sizeof(SettledKeyRecord)) {
+      SettledKeyRecord record;
+      memcpy(&record, payload, sizeof(record));
+      JournaledKey key;
+      key.key.assign(
+          reinterpret_cast<const char*>(payload + sizeof(record)),
+          header.length - sizeof(record));
+      key.id = header.job_id;
+      key.failed = record.failed != 0;
+      key.offset = record.offset;
+      key.length = record.length;
+      key.hash = record.hash;
+      settled.push_back(std::move(key));
+    } else if (header.type == kRecordCompletion) {
+      auto it = index.find(header.job_id);
+      if (it != index.end()) {
+        done[it->second] = true;
+      }
+      *needs_compaction = true;
+    }
+    offset += AlignRecord(sizeof(RecordHeader) + header.length);
+  }
+
+  // Anything after the last good record is a torn append.
+  if (offset + sizeof(uint32_t) <= capacity_) {
+    uint32_t trailing;
+    memcpy(&trailing, map_ + offset, sizeof(trailing));
+    if (trailing != 0) {
+      *needs_compaction = true;
+    }
+  }
+  write_offset_ = offset;
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!done[i]) {
+      pending->push_back(std::move(jobs[i]));
+    } else {
+      stats_.compacted_records++;
+    }
+  }
+  // The latest outcome of each key, for the most recent |max_keys| keys.
+  std::unordered_set<std::string> seen;
+  for (auto it = settled.rbegin();
+       it != settled.rend() && keys->size() < options_.max_keys; ++it) {
+    if (seen.insert(it->key).second) {
+      keys->push_back(std::move(*it));
+    }
+  }
+  std::reverse(keys->begin(), keys->end());
+  if (keys->size() < settled.size()) {
+    *needs_compaction = true;
+  }
+  return true;
+}
+
+bool SpoolJournal::Compact(const std::string& path,
+                           const std::vector<JournaledJob>& pending,
+                           const std::vector<JournaledKey>& keys) {
+  munmap(map_, capacity_);
+  map_ = nullptr;
+  capacity_ = 0;
+  close(fd_);
+
+  std::string temp_path = path + ".compact";
+  fd_ = open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    return false;
+  }
+  size_t live_bytes = sizeof(FileHeader) + sizeof(RecordHeader);
+  for (const JournaledKey& key : keys) {
+    live_bytes += AlignRecord(sizeof(RecordHeader) + sizeof(SettledKeyRecord) +
+                              key.key.size());
+  }
+  for (const JournaledJob& job : pending) {
+    live_bytes += AlignRecord(sizeof(RecordHeader) + sizeof(uint16_t) +
+                              job.printer.size() + job.data.size());
+    if (job.copies > 1) {
+      live_bytes += AlignRecord(sizeof(RecordHeader) + sizeof(uint16_t));
+    }
+    if (!job.key.empty()) {
+      live_bytes += AlignRecord(sizeof(RecordHeader) + job.key.size());
+    }
+    if (job.offset > 0) {
+      live_bytes += AlignRecord(sizeof(RecordHeader) + sizeof(uint64_t));
+    }
+  }
+  if (!MapFile(std::max(options_.initial_capacity, live_bytes * 2))) {
+    return false;
+  }
+
+  FileHeader file_header = {kFileMagic, kFileVersion, 0};
+  memcpy(map_, &file_header, sizeof(file_header));
+  write_offset_ = sizeof(FileHeader);
+  uint64_t appends = stats_.appends;
+  uint64_t bytes_appended = stats_.bytes_appended;
+  if (!Append(kRecordHighWater, next_job_id_ - 1, nullptr, 0, nullptr, 0)) {
+    return false;
+  }
+  for (const JournaledKey& key : keys) {
+    if (!AppendSettledKey(key.id, key.key, key.failed, key.offset,
+                          key.length, key.hash)) {
+      return false;
+    }
+  }
+  for (const JournaledJob& job : pending) {
+    if (!AppendJobRecord(job.file ? kRecordFileJob : kRecordJob, job.id,
+                         job.printer, job.data.data(), job.data.size()) ||
+        (job.copies > 1 && !AppendCopies(job.id, job.copies)) ||
+        (!job.key.empty() && !AppendKey(job.id, job.key)) ||
+        (job.offset > 0 && !AppendProgress(job.id, job.offset))) {
+      return false;
+    }
+  }
+  stats_.appends = appends;
+  stats_.bytes_appended = bytes_appended;
+
+  if (msync(map_, write_offset_, MS_SYNC) != 0 || fdatasync(fd_) != 0) {
+    return false;
+  }
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    return false;
+  }
+  int dir_fd = open(DirectoryOf(path).c_str(), O_RDONLY | O_DIRECTORY |
+                                                   O_CLOEXEC);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return true;
+}
+
+bool SpoolJournal::AppendJob(uint64_t id, const std::string& printer,
+                             const uint8_t* data, size_t length) {
+  return AppendJobRecord(kRecordJob, id, printer, data, length);
+}
+
+bool SpoolJournal::AppendFileJob(uint64_t id, const std::string& printer,
+                                 const uint8_t* spec, size_t length) {
+  return AppendJobRecord(kRecordFileJob, id, printer, spec, length);
+}
+
+bool SpoolJournal::AppendJobRecord(RecordType type, uint64_t id,
+                                   const std::string& printer,
+                                   const uint8_t* data, size_t length) {
+  if (printer.size() > UINT16_MAX) {
+    return false;
+  }
+  uint8_t prefix[sizeof(uint16_t) + UINT8_MAX + 1];
+  uint16_t name_length = static_cast<uint16_t>(printer.size());
+  if (printer.size() > UINT8_MAX) {
+    // Unusually long names take the slow path through a temporary buffer.
+    std::vector<uint8_t> long_prefix(sizeof(uint16_t) + printer.size());
+    memcpy(long_prefix.data(), &name_length, sizeof(name_length));
+    memcpy(long_prefix.data() + sizeof(uint16_t), printer.data(),
+           printer.size());
+    return Append(type, id, long_prefix.data(), long_prefix.size(), data,
+                  length);
+  }
+  memcpy(prefix, &name_length, sizeof(name_length));
+  memcpy(prefix + sizeof(uint16_t), printer.data(), printer.size());
+  return Append(type, id, prefix, sizeof(uint16_t) + printer.size(), data,
+                length);
+}
+
+bool SpoolJournal::AppendCopies(uint64_t id, int copies) {
+  if (copies < 1 || copies > UINT16_MAX) {
+    return false;
+  }
+  uint16_t value = static_cast<uint16_t>(copies);
+  return Append(kRecordCopies, id, &value, sizeof(value), nullptr, 0);
+}
+
+bool SpoolJournal::AppendKey(uint64_t id, const std::string& key) {
+  return Append(kRecordKey, id, key.data(), key.size(), nullptr, 0);
+}
+
+bool SpoolJournal::AppendProgress(uint64_t id, uint64_t offset) {
+  return Append(kRecordProgress, id, &offset, sizeof(offset), nullptr, 0);
+}
+
+bool SpoolJournal::AppendCompletion(uint64_t id, bool success) {
+  uint8_t status = success ? 1 : 0;
+  return Append(kRecordCompletion, id, &status, sizeof(status), nullptr, 0);
+}
+
+bool SpoolJournal::AppendSettledKey(uint64_t id, const std::string& key,
+                                    bool failed, uint64_t offset,
+                                    uint64_t length, uint64_t hash) {
+  SettledKeyRecord record = {};
+  record.offset = offset;
+  record.length = length;
+  record.hash = hash;
+  record.failed = failed ? 1 : 0;
+  return Append(kRecordSettledKey, id, &record, sizeof(record), key.data(),
+                key.size());
+}
+
+bool SpoolJournal::Append(RecordType type, uint64_t id, const void* prefix,
+                          size_t prefix_length, const void* payload,
+                          size_t length) {
+  size_t payload_length = prefix_length + length;
+  if (payload_length > UINT32_MAX) {
+    return false;
+  }
+  // Checksum outside the lock; only the copy is serialized.
+  RecordHeader header =
+      FrameRecord(type, id, prefix, prefix_length, payload, length);
+
+  size_t record_size = AlignRecord(sizeof(RecordHeader) + payload_length);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0 || !EnsureCapacity(write_offset_ + record_size)) {
+    return false;
+  }
+  uint8_t* out = map_ + write_offset_;
+  memcpy(out, &header, sizeof(header));
+  if (prefix_length > 0) {
+    memcpy(out + sizeof(header), prefix, prefix_length);
+  }
+  if (length > 0) {
+    memcpy(out + sizeof(header) + prefix_length, payload, length);
+  }
+  bool was_clean = write_offset_ == synced_offset_;
+  write_offset_ += record_size;
+  settled_ = settled_ || type == kRecordCompletion;
+  stats_.appends++;
+  stats_.bytes_appended += record_size;
+  if (was_clean || write_offset_ - synced_offset_ >= options_.commit_bytes) {
+    flush_cv_.notify_one();
+  }
+  return true;
+}
+
+void SpoolJournal::Sync() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (synced_offset_ >= write_offset_ || !flusher_.joinable()) {
+    return;
+  }
+  sync_requested_ = std::max(sync_requested_, write_offset_);
+  flush_cv_.notify_one();
+  // A rewrite moves the records back by what it dropped before them.
+  uint64_t target = rewritten_bytes_ + write_offset_;
+  synced_cv_.wait(lock, [&] {
+    return rewritten_bytes_ + synced_offset_ >= target || stopping_;
+  });
+}
+
+void SpoolJournal::FlushLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Sleep until there is something to commit, then give other appends
+    // |commit_interval| to join the same commit unless enough bytes are
+    // already waiting or someone asked for a synchronous commit.
+    flush_cv_.wait(lock,
+                   [&] { return stopping_ || write_offset_ > synced_offset_; });
+    flush_cv_.wait_for(lock, options_.commit_interval, [&] {
+      return stopping_ ||
+             write_offset_ - synced_offset_ >= options_.commit_bytes ||
+             sync_requested_ > synced_offset_;
+    });
+    if (write_offset_ > synced_offset_) {
+      size_t from = synced_offset_ & ~(PageSize() - 1);
+      size_t to = write_offset_;
+      lock.unlock();
+      {
+        std::lock_guard<std::mutex> remap_lock(remap_mutex_);
+        msync(map_ + from, to - from, MS_SYNC);
+      }
+      lock.lock();
+      synced_offset_ = to;
+      stats_.commits++;
+      synced_cv_.notify_all();
+    }
+    if (!stopping_ && CompactionDue()) {
+      settled_ = false;
+      if (!CompactLive(&lock)) {
+        // Tried again once the log has doubled once more.
+        compacted_size_ = write_offset_;
+      }
+      synced_cv_.notify_all();
+    }
+    if (stopping_ && write_offset_ == synced_offset_) {
+      break;
+    }
+  }
+}
+
+bool SpoolJournal::CompactionDue() const {
+  return settled_ && write_offset_ >= options_.compact_bytes &&
+         write_offset_ >= 2 * compacted_size_;
+}
+
+bool SpoolJournal::CompactLive(std::unique_lock<std::mutex>* lock) {
+  // Every record up to |write_offset_| was framed by Append(), so none of
+  // them needs checking.
+  auto header_at = [this](size_t offset) {
+    RecordHeader header;
+    memcpy(&header, map_ + offset, sizeof(header));
+    return header;
+  };
+  size_t end = write_offset_;
+  finished_.clear();
+  settled_keys_.clear();
+  uint64_t high_water = 0;
+  for (size_t offset = sizeof(FileHeader); offset < end;) {
+    RecordHeader header = header_at(offset);
+    high_water = std::max(high_water, header.job_id);
+    if (header.type == kRecordCompletion) {
+      finished_.push_back(header.job_id);
+    } else if (header.type == kRecordSettledKey) {
+      const uint8_t* key =
+          map_ + offset + sizeof(RecordHeader) + sizeof(SettledKeyRecord);
+      settled_keys_.emplace_back(
+          Crc32c(0, key, header.length - sizeof(SettledKeyRecord)), offset);
+    }
+    offset += AlignRecord(sizeof(RecordHeader) + header.length);
+  }
+  std::sort(finished_.begin(), finished_.end());
+  SelectSettledKeys();
+
+  // The records to keep are copied out after a new high-water record that
+  // replaces the old one, and written without the lock.
+  RecordHeader high_water_record =
+      FrameRecord(kRecordHighWater, high_water, nullptr, 0, nullptr, 0);
+  const uint8_t* high_water_bytes =
+      reinterpret_cast<const uint8_t*>(&high_water_record);
+  compact_buffer_.assign(map_, map_ + sizeof(FileHeader));
+  compact_buffer_.insert(compact_buffer_.end(), high_water_bytes,
+                         high_water_bytes + sizeof(high_water_record));
+  uint64_t dropped_jobs = 0;
+  for (size_t offset = sizeof(FileHeader); offset < end;) {
+    RecordHeader header = header_at(offset);
+    size_t size = AlignRecord(sizeof(RecordHeader) + header.length);
+    bool keep;
+    if (header.type == kRecordSettledKey) {
+      keep = std::binary_search(kept_keys_.begin(), kept_keys_.end(), offset);
+    } else {
+      keep = header.type != kRecordHighWater &&
+             !std::binary_search(finished_.begin(), finished_.end(),
+                                 header.job_id);
+    }
+    if (keep) {
+      compact_buffer_.insert(compact_buffer_.end(), map_ + offset,
+                             map_ + offset + size);
+    } else if (header.type == kRecordJob || header.type == kRecordFileJob) {
+      dropped_jobs++;
+    }
+    offset += size;
+  }
+  size_t live_bytes = compact_buffer_.size();
+  size_t capacity = std::max(options_.initial_capacity, live_bytes * 2);
+  capacity = (capacity + PageSize() - 1) & ~(PageSize() - 1);
+
+  lock->unlock();
+  int fd = open(temp_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0600);
+  void* map = MAP_FAILED;
+  if (fd >= 0 && WriteAll(fd, compact_buffer_.data(), live_bytes) &&
+      ftruncate(fd, static_cast<off_t>(capacity)) == 0 && fdatasync(fd) == 0) {
+    map = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  lock->lock();
+
+  // Records appended meanwhile went to the old log and are carried over;
+  // if they do not fit, the old log is kept and the rewrite tried later.
+  size_t tail = write_offset_ - end;
+  if (map == MAP_FAILED || live_bytes + tail > capacity ||
+      rename(temp_path_.c_str(), path_.c_str()) != 0) {
+    if (map != MAP_FAILED) {
+      munmap(map, capacity);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    unlink(temp_path_.c_str());
+    return false;
+  }
+  memcpy(static_cast<uint8_t*>(map) + live_bytes, map_ + end, tail);
+  {
+    std::lock_guard<std::mutex> remap_lock(remap_mutex_);
+    munmap(map_, capacity_);
+    close(fd_);
+    fd_ = fd;
+    map_ = static_cast<uint8_t*>(map);
+    capacity_ = capacity;
+  }
+  // Everything before |end| is durable in the new log; the carried records
+  // are committed like any other append.
+  rewritten_bytes_ += end - live_bytes;
+  write_offset_ = live_bytes + tail;
+  synced_offset_ = live_bytes;
+  sync_requested_ =
+      sync_requested_ > end ? sync_requested_ - end + live_bytes : 0;
+  compacted_size_ = live_bytes;
+  stats_.compacted_records += dropped_jobs;
+
+  // The rename is made durable before the flusher commits anything else
+  // to the new log.
+  lock->unlock();
+  int dir_fd = open(directory_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  lock->lock();
+  return true;
+}
+
+void SpoolJournal::SelectSettledKeys() {
+  auto key_at = [this](size_t offset, size_t* length) {
+    RecordHeader header;
+    memcpy(&header, map_ + offset, sizeof(header));
+    *length = header.length - sizeof(SettledKeyRecord);
+    return map_ + offset + sizeof(RecordHeader) + sizeof(SettledKeyRecord);
+  };
+  // Sorted by crc, then offset: a record is superseded by a later one in
+  // its group with the same key, told apart from collisions by its bytes.
+  std::sort(settled_keys_.begin(), settled_keys_.end());
+  kept_keys_.clear();
+  for (size_t i = 0; i < settled_keys_.size(); i++) {
+    size_t length;
+    const uint8_t* key = key_at(settled_keys_[i].second, &length);
+    bool superseded = false;
+    for (size_t j = i + 1; !superseded && j < settled_keys_.size() &&
+                           settled_keys_[j].first == settled_keys_[i].first;
+         j++) {
+      size_t other_length;
+      const uint8_t* other = key_at(settled_keys_[j].second, &other_length);
+      superseded = other_length == length && memcmp(other, key, length) == 0;
+    }
+    if (!superseded) {
+      kept_keys_.push_back(settled_keys_[i].second);
+    }
+  }
+  std::sort(kept_keys_.begin(), kept_keys_.end());
+  if (kept_keys_.size() > options_.max_keys) {
+    kept_keys_.erase(kept_keys_.begin(),
+                     kept_keys_.end() - options_.max_keys);
+  }
+}
+
+SpoolJournalStats SpoolJournal::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace thermal_printer_flutter
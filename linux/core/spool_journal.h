@@ -0,0 +1,205 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SPOOL_JOURNAL_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SPOOL_JOURNAL_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace thermal_printer_flutter {
+
+struct SpoolJournalOptions {
+  // Unsynced bytes that trigger an immediate group commit.
+  size_t commit_bytes = 64 * 1024;
+  // Upper bound on how long an append waits before it is made durable.
+  std::chrono::milliseconds commit_interval{5};
+  // Initial size of the (sparse) journal file and its mapping.
+  size_t initial_capacity = 1 << 20;
+  // Once a job has finished and the log has grown past this, and to twice
+  // its size after it was last rewritten, it is rewritten without the
+  // finished jobs while in use, so a long-running queue keeps a small file.
+  size_t compact_bytes = 512 * 1024;
+  // Settled keys kept across restarts and rewrites, the most recent ones;
+  // as PrintQueue::kMaxJobKeys.
+  size_t max_keys = 1024;
+};
+
+// A job that was submitted but never completed, recovered by Open().
+struct JournaledJob {
+  uint64_t id = 0;
+  std::string printer;
+  std::vector<uint8_t> data;
+  // |data| is a serialized FileJobSpec naming the file to print rather than
+  // the bytes themselves.
+  bool file = false;
+  int copies = 1;
+  // The caller's idempotency key, if it gave one.
+  std::string key;
+  // Bytes of |data| the printer had received when the job was interrupted.
+  uint64_t offset = 0;
+};
+
+// How a job submitted with an idempotency key ended, recovered by Open() so
+// that a restarted queue still drops resubmissions of a printed job, and
+// resumes those of a failed one.
+struct JournaledKey {
+  std::string key;
+  uint64_t id = 0;
+  bool failed = false;
+  // For a failed job: the bytes the printer had received, and the length
+  // and HashBytes() of the job, to recognise a resubmission of it.
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  uint64_t hash = 0;
+};
+
+struct SpoolJournalStats {
+  uint64_t appends = 0;
+  uint64_t commits = 0;
+  uint64_t bytes_appended = 0;
+  uint64_t replayed_records = 0;
+  uint64_t compacted_records = 0;
+};
+
+// Append-only, memory-mapped log of print jobs.
+//
+// Every record is framed as [magic | length | crc32c | type | job id] and
+// followed by its payload, so a torn tail left by a crash is detected on
+// replay and cut off. Appends are a memcpy into the shared mapping: the data
+// survives a process crash as soon as the call returns. Durability against
+// power loss comes from a background thread that msync()s everything written
+// since the last commit, either every |commit_interval| or as soon as
+// |commit_bytes| are pending, so many tickets share one flush. The same
+// thread rewrites the log once enough of it belongs to finished jobs.
+class SpoolJournal {
+ public:
+  explicit SpoolJournal(SpoolJournalOptions options = SpoolJournalOptions());
+  ~SpoolJournal();
+
+  SpoolJournal(const SpoolJournal&) = delete;
+  SpoolJournal& operator=(const SpoolJournal&) = delete;
+
+  // Opens or creates the journal at |path|. Jobs that were never completed
+  // are returned in |pending| in submission order, and the latest outcome
+  // of each settled key in |keys|, oldest first. If the log holds finished
+  // jobs it is rewritten with only the pending ones and the settled keys
+  // before being mapped.
+  bool Open(const std::string& path, std::vector<JournaledJob>* pending,
+            std::vector<JournaledKey>* keys = nullptr);
+
+  // Commits outstanding appends and unmaps the journal.
+  void Close();
+
+  bool is_open() const { return fd_ >= 0; }
+
+  bool AppendJob(uint64_t id, const std::string& printer, const uint8_t* data,
+                 size_t length);
+  // Journals a job printed from a file: only its FileJobSpec is stored.
+  bool AppendFileJob(uint64_t id, const std::string& printer,
+                     const uint8_t* spec, size_t length);
+  // Records that job |id| prints |copies| times. Appended after the job.
+  bool AppendCopies(uint64_t id, int copies);
+  // Records the idempotency key job |id| was submitted with.
+  bool AppendKey(uint64_t id, const std::string& key);
+  // Records that the printer has received the first |offset| bytes of job
+  // |id|, which a later attempt can skip.
+  bool AppendProgress(uint64_t id, uint64_t offset);
+  bool AppendCompletion(uint64_t id, bool success);
+  // Records how keyed job |id| ended, as JournaledKey describes. Kept when
+  // the job's other records are compacted away.
+  bool AppendSettledKey(uint64_t id, const std::string& key, bool failed,
+                        uint64_t offset, uint64_t length, uint64_t hash);
+
+  // Blocks until every append made before the call is durable.
+  void Sync();
+
+  // One past the highest job id found in the journal.
+  uint64_t next_job_id() const { return next_job_id_; }
+
+  SpoolJournalStats stats() const;
+
+ private:
+  enum RecordType : uint8_t {
+    kRecordJob = 1,
+    kRecordCompletion = 2,
+    kRecordFileJob = 3,
+    kRecordCopies = 4,
+    kRecordKey = 5,
+    kRecordProgress = 6,
+    kRecordSettledKey = 7,
+    // The highest job id the log has held, written first by every rewrite
+    // so ids keep rising after the records that carried them are dropped.
+    kRecordHighWater = 8,
+  };
+
+  bool AppendJobRecord(RecordType type, uint64_t id,
+                       const std::string& printer, const uint8_t* data,
+                       size_t length);
+  bool Append(RecordType type, uint64_t id, const void* prefix,
+              size_t prefix_length, const void* payload, size_t length);
+  bool EnsureCapacity(size_t needed);
+  bool Replay(std::vector<JournaledJob>* pending,
+              std::vector<JournaledKey>* keys, bool* needs_compaction);
+  bool Compact(const std::string& path,
+               const std::vector<JournaledJob>& pending,
+               const std::vector<JournaledKey>& keys);
+  // Sets |kept_keys_| to the offsets of the settled key records to keep:
+  // the latest for each key, at most |max_keys| of them. Called with
+  // |mutex_| held.
+  void SelectSettledKeys();
+  // Whether the log is due to be rewritten. Called with |mutex_| held.
+  bool CompactionDue() const;
+  // Rewrites the open log without the records of finished jobs, but for
+  // the settled keys SelectSettledKeys() keeps, copying the others as they
+  // are. Called by the flusher with |lock| held on |mutex_|; appends only
+  // wait while the records are copied out and the new log is swapped in,
+  // not while it is written and synced.
+  bool CompactLive(std::unique_lock<std::mutex>* lock);
+  bool MapFile(size_t capacity);
+  void FlushLoop();
+
+  SpoolJournalOptions options_;
+  std::string path_;
+  // Where CompactLive() writes the new log, and the directory it syncs.
+  std::string temp_path_;
+  std::string directory_;
+  int fd_ = -1;
+  uint8_t* map_ = nullptr;
+  size_t capacity_ = 0;
+  uint64_t next_job_id_ = 1;
+
+  // Guards the append cursor and the commit bookkeeping.
+  mutable std::mutex mutex_;
+  // Held while the mapping is in use by msync() or being moved by mremap().
+  std::mutex remap_mutex_;
+  std::condition_variable flush_cv_;
+  std::condition_variable synced_cv_;
+  size_t write_offset_ = 0;
+  size_t synced_offset_ = 0;
+  size_t sync_requested_ = 0;
+  // What the log held after it was last rewritten, and whether a job has
+  // finished since.
+  size_t compacted_size_ = 0;
+  bool settled_ = false;
+  // How many bytes the rewrites so far dropped from before the records
+  // still in the log, so Sync() can compare offsets across a rewrite.
+  uint64_t rewritten_bytes_ = 0;
+  // CompactLive()'s list of finished jobs, of settled keys as (crc of the
+  // key, record offset), and the records it keeps, kept to be reused.
+  std::vector<uint64_t> finished_;
+  std::vector<std::pair<uint32_t, size_t>> settled_keys_;
+  std::vector<size_t> kept_keys_;
+  std::vector<uint8_t> compact_buffer_;
+  bool stopping_ = false;
+  std::thread flusher_;
+  SpoolJournalStats stats_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SPOOL_JOURNAL_H_
@@ -0,0 +1,156 @@
+#include "symbol_raster.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bitmap_transform.h"
+#include "raster_encoder.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+// Light modules around a QR symbol.
+constexpr int kQrQuietZone = 4;
+
+// Sets dots [begin, end) of a packed row.
+void SetRun(uint8_t* row, int begin, int end) {
+  while (begin < end && begin % 8 != 0) {
+    row[begin / 8] |= static_cast<uint8_t>(0x80 >> (begin % 8));
+    begin++;
+  }
+  if (end - begin >= 8) {
+    memset(row + begin / 8, 0xFF, (end - begin) / 8);
+    begin += (end - begin) / 8 * 8;
+  }
+  while (begin < end) {
+    row[begin / 8] |= static_cast<uint8_t>(0x80 >> (begin % 8));
+    begin++;
+  }
+}
+
+// The requested module size, or the largest that fits |modules| across
+// max_width. 0 if none does.
+int FitScale(int modules, const SymbolOptions& options) {
+  return std::min(std::max(options.module_size, 1),
+                  options.max_width / std::max(modules, 1));
+}
+
+bool RenderQrCode(const std::string& data, const SymbolOptions& options,
+                  std::vector<uint8_t>* output) {
+  QrCode code;
+  if (!QrCode::Encode(data, options.ecc, &code)) {
+    return false;
+  }
+  const int modules = code.size() + 2 * kQrQuietZone;
+  const int scale = FitScale(modules, options);
+  if (scale < 1) {
+    return false;
+  }
+  const int width = modules * scale;
+  const size_t stride = PackedStride(width);
+  std::vector<uint8_t> bitmap(stride * width, 0);
+  for (int y = 0; y < code.size(); y++) {
+    uint8_t* row =
+        bitmap.data() + stride * static_cast<size_t>((y + kQrQuietZone) * scale);
+    for (int x = 0; x < code.size(); x++) {
+      if (code.module(x, y)) {
+        int begin = (x + kQrQuietZone) * scale;
+        SetRun(row, begin, begin + scale);
+      }
+    }
+    for (int copy = 1; copy < scale; copy++) {
+      memcpy(row + stride * copy, row, stride);
+    }
+  }
+  AppendRasterBands(bitmap.data(), stride, width, options.band_height, output);
+  return true;
+}
+
+bool RenderBarcode(const std::string& data, BarcodeType type,
+                   const SymbolOptions& options, std::vector<uint8_t>* output) {
+  std::vector<uint8_t> bars;
+  if (!EncodeBarcode(type, data, &bars) || options.height < 1) {
+    return false;
+  }
+  int left;
+  int right;
+  BarcodeQuietZone(type, &left, &right);
+  const int modules = left + static_cast<int>(bars.size()) + right;
+  const int scale = FitScale(modules, options);
+  if (scale < 1) {
+    return false;
+  }
+  const size_t stride = PackedStride(modules * scale);
+  std::vector<uint8_t> bitmap(stride * options.height, 0);
+  for (size_t i = 0; i < bars.size(); i++) {
+    if (bars[i]) {
+      int begin = (left + static_cast<int>(i)) * scale;
+      SetRun(bitmap.data(), begin, begin + scale);
+    }
+  }
+  for (int y = 1; y < options.height; y++) {
+    memcpy(bitmap.data() + stride * y, bitmap.data(), stride);
+  }
+  AppendRasterBands(bitmap.data(), stride, options.height, options.band_height,
+                    output);
+  return true;
+}
+
+std::string CacheKey(const std::string& data, const SymbolOptions& options) {
+  std::string key;
+  key.reserve(data.size() + 32);
+  for (int value : {static_cast<int>(options.type), static_cast<int>(options.ecc),
+                    options.module_size, options.height, options.max_width,
+                    options.band_height}) {
+    key += std::to_string(value);
+    key += ',';
+  }
+  key += data;
+  return key;
+}
+
+}  // namespace
+
+bool RenderSymbol(const std::string& data, const SymbolOptions& options,
+                  std::vector<uint8_t>* output) {
+  switch (options.type) {
+    case SymbolType::kQrCode:
+      return RenderQrCode(data, options, output);
+    case SymbolType::kCode128:
+      return RenderBarcode(data, BarcodeType::kCode128, options, output);
+    case SymbolType::kEan13:
+      return RenderBarcode(data, BarcodeType::kEan13, options, output);
+    case SymbolType::kEan8:
+      return RenderBarcode(data, BarcodeType::kEan8, options, output);
+  }
+  return false;
+}
+
+SymbolCache::SymbolCache(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+std::shared_ptr<const std::vector<uint8_t>> SymbolCache::Get(
+    const std::string& data, const SymbolOptions& options) {
+  std::string key = CacheKey(data, options);
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    stats_.hits++;
+    entries_.splice(entries_.begin(), entries_, found->second);
+    return found->second->second;
+  }
+  stats_.misses++;
+  std::shared_ptr<std::vector<uint8_t>> bands =
+      std::make_shared<std::vector<uint8_t>>();
+  if (!RenderSymbol(data, options, bands.get())) {
+    return nullptr;
+  }
+  entries_.emplace_front(key, bands);
+  index_[key] = entries_.begin();
+  if (entries_.size() > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  return bands;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,80 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SYMBOL_RASTER_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SYMBOL_RASTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "linear_barcode.h"
+#include "qr_code.h"
+
+namespace thermal_printer_flutter {
+
+enum class SymbolType {
+  kQrCode,
+  kCode128,
+  kEan13,
+  kEan8,
+};
+
+struct SymbolOptions {
+  SymbolType type = SymbolType::kQrCode;
+  // QR only.
+  QrEcc ecc = QrEcc::kMedium;
+  // Dots per QR module or per narrow bar. Lowered as far as needed for the
+  // symbol to fit |max_width|.
+  int module_size = 4;
+  // Bar height in dots, 1D symbols only.
+  int height = 80;
+  int max_width = 576;
+  int band_height = 128;
+};
+
+// Renders |data| as GS v 0 raster bands, quiet zones included: modules are
+// drawn straight into packed 1bpp rows, and identical rows are copied
+// rather than drawn again. Returns false if |data| cannot be encoded or the
+// symbol is wider than max_width even at one dot per module.
+bool RenderSymbol(const std::string& data, const SymbolOptions& options,
+                  std::vector<uint8_t>* output);
+
+struct SymbolCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+// Least recently used cache of rendered symbols, for the payment and URL
+// codes that appear on every ticket. Not thread-safe.
+class SymbolCache {
+ public:
+  explicit SymbolCache(size_t capacity = 64);
+
+  SymbolCache(const SymbolCache&) = delete;
+  SymbolCache& operator=(const SymbolCache&) = delete;
+
+  // Returns the bands for |data|, rendering them on a miss, or null if the
+  // symbol cannot be rendered.
+  std::shared_ptr<const std::vector<uint8_t>> Get(
+      const std::string& data, const SymbolOptions& options);
+
+  size_t size() const { return entries_.size(); }
+  const SymbolCacheStats& stats() const { return stats_; }
+
+ private:
+  using Entry =
+      std::pair<std::string, std::shared_ptr<const std::vector<uint8_t>>>;
+
+  size_t capacity_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+  SymbolCacheStats stats_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_SYMBOL_RASTER_H_
@@ -0,0 +1,263 @@
+#include "tcp_transport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <linux/tcp.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "device_transport.h"
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+const char kRawScheme[] = "tcp://";
+const char kLpdScheme[] = "lpd://";
+
+bool HasPrefix(const std::string& value, const char* prefix) {
+  return value.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Bytes of the connection's payload the peer has acknowledged so far.
+bool BytesAcked(int fd, uint64_t* acked) {
+  struct tcp_info info = {};
+  socklen_t length = sizeof(info);
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &length) != 0 ||
+      length < offsetof(struct tcp_info, tcpi_bytes_acked) +
+                   sizeof(info.tcpi_bytes_acked)) {
+    return false;
+  }
+  *acked = info.tcpi_bytes_acked;
+  return true;
+}
+
+}  // namespace
+
+std::string NetworkEndpoint::ToString() const {
+  std::string host_part =
+      host.find(':') != std::string::npos ? "[" + host + "]" : host;
+  std::string result = (protocol == Protocol::kLpd ? kLpdScheme : kRawScheme) +
+                       host_part + ":" + std::to_string(port);
+  if (protocol == Protocol::kLpd) {
+    result += "/" + queue;
+  }
+  return result;
+}
+
+bool ParseNetworkEndpoint(const std::string& printer,
+                          NetworkEndpoint* endpoint) {
+  std::string rest;
+  if (HasPrefix(printer, kRawScheme)) {
+    endpoint->protocol = NetworkEndpoint::Protocol::kRaw;
+    rest = printer.substr(strlen(kRawScheme));
+  } else if (HasPrefix(printer, kLpdScheme)) {
+    endpoint->protocol = NetworkEndpoint::Protocol::kLpd;
+    rest = printer.substr(strlen(kLpdScheme));
+  } else {
+    return false;
+  }
+
+  endpoint->queue.clear();
+  size_t slash = rest.find('/');
+  if (slash != std::string::npos) {
+    endpoint->queue = rest.substr(slash + 1);
+    rest.resize(slash);
+  }
+
+  size_t colon;
+  if (!rest.empty() && rest[0] == '[') {
+    size_t bracket = rest.find(']');
+    if (bracket == std::string::npos) {
+      return false;
+    }
+    endpoint->host = rest.substr(1, bracket - 1);
+    colon = rest.find(':', bracket);
+  } else {
+    colon = rest.rfind(':');
+    endpoint->host = rest.substr(0, colon);
+  }
+  endpoint->port =
+      endpoint->protocol == NetworkEndpoint::Protocol::kLpd ? 515 : 9100;
+  if (colon != std::string::npos) {
+    char* end = nullptr;
+    long port = strtol(rest.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || port <= 0 || port > 65535) {
+      return false;
+    }
+    endpoint->port = static_cast<int>(port);
+  }
+  return !endpoint->host.empty();
+}
+
+int ConnectTcp(const std::string& host, int port, int timeout_ms) {
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  std::string service = std::to_string(port);
+  if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0) {
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo* ai = addresses; ai != nullptr && fd < 0;
+       ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    int ret = connect(fd, ai->ai_addr, ai->ai_addrlen);
+    if (ret != 0 && errno == EINPROGRESS && WaitForFd(fd, POLLOUT, timeout_ms)) {
+      int error = 0;
+      socklen_t error_length = sizeof(error);
+      getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length);
+      ret = error == 0 ? 0 : -1;
+    }
+    if (ret != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+
+  if (fd >= 0) {
+    // Printers that lose power never send a FIN; keepalive notices.
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+  }
+  return fd;
+}
+
+bool SendAllNonBlocking(int fd, const uint8_t* data, size_t length,
+                        int timeout_ms, size_t* sent) {
+  size_t offset = 0;
+  bool complete = true;
+  while (offset < length) {
+    ssize_t count = send(fd, data + offset, length - offset, MSG_NOSIGNAL);
+    if (count > 0) {
+      offset += static_cast<size_t>(count);
+      continue;
+    }
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if ((count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ||
+        !WaitForFd(fd, POLLOUT, timeout_ms)) {
+      complete = false;
+      break;
+    }
+  }
+  if (sent != nullptr) {
+    *sent = offset;
+  }
+  return complete;
+}
+
+TcpTransport::TcpTransport(std::string host, int port, int connect_timeout_ms,
+                           int write_timeout_ms)
+    : host_(std::move(host)),
+      port_(port),
+      connect_timeout_ms_(connect_timeout_ms),
+      write_timeout_ms_(write_timeout_ms) {}
+
+TcpTransport::~TcpTransport() { Close(); }
+
+bool TcpTransport::Open() {
+  if (fd_ < 0) {
+    fd_ = ConnectTcp(host_, port_, connect_timeout_ms_);
+    sent_ = 0;
+    counted_ = fd_ >= 0 && BytesAcked(fd_, &acked_at_open_);
+  }
+  return fd_ >= 0;
+}
+
+void TcpTransport::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool TcpTransport::Write(const uint8_t* data, size_t length) {
+  acknowledged_ = 0;
+  if (fd_ < 0) {
+    return false;
+  }
+  // Earlier writes may still be in flight: they end where everything
+  // acknowledged or queued before this one does.
+  uint64_t start = 0;
+  int queued = 0;
+  bool counted = BytesAcked(fd_, &start) && ioctl(fd_, SIOCOUTQ, &queued) == 0;
+  size_t sent = 0;
+  bool complete =
+      SendAllNonBlocking(fd_, data, length, write_timeout_ms_, &sent);
+  sent_ += sent;
+  if (complete) {
+    return true;
+  }
+  uint64_t acked;
+  if (counted && BytesAcked(fd_, &acked)) {
+    start += static_cast<uint64_t>(queued);
+    acknowledged_ = acked > start ? std::min<uint64_t>(acked - start, sent) : 0;
+  }
+  return false;
+}
+
+ssize_t TcpTransport::WriteSome(const uint8_t* data, size_t length) {
+  if (fd_ < 0) {
+    return -1;
+  }
+  ssize_t count;
+  do {
+    count = send(fd_, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+  } while (count < 0 && errno == EINTR);
+  if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 0;
+  }
+  if (count > 0) {
+    sent_ += static_cast<size_t>(count);
+  }
+  return count;
+}
+
+size_t TcpTransport::BytesDelivered() const {
+  uint64_t acked;
+  if (!counted_ || fd_ < 0 || !BytesAcked(fd_, &acked) ||
+      acked < acked_at_open_) {
+    return 0;
+  }
+  return std::min<uint64_t>(acked - acked_at_open_, sent_);
+}
+
+ssize_t TcpTransport::Read(uint8_t* data, size_t length, int timeout_ms) {
+  if (fd_ < 0) {
+    return -1;
+  }
+  if (!WaitForFd(fd_, POLLIN, timeout_ms)) {
+    return 0;
+  }
+  ssize_t ret;
+  do {
+    ret = recv(fd_, data, length, 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+    return 0;
+  }
+  // An orderly shutdown by the printer is a broken transport, not a timeout.
+  return ret == 0 ? -1 : ret;
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,78 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TCP_TRANSPORT_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TCP_TRANSPORT_H_
+
+#include <string>
+
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// A network printer as queued: "tcp://host:port" for raw (JetDirect) printing
+// or "lpd://host:port/queue" for RFC 1179 line printer daemons.
+struct NetworkEndpoint {
+  enum class Protocol { kRaw, kLpd };
+
+  Protocol protocol = Protocol::kRaw;
+  std::string host;
+  int port = 9100;
+  std::string queue;
+
+  std::string ToString() const;
+};
+
+bool ParseNetworkEndpoint(const std::string& printer, NetworkEndpoint* endpoint);
+
+// Connects to |host|:|port|, giving up after |timeout_ms|. Returns a
+// non-blocking socket or -1.
+int ConnectTcp(const std::string& host, int port, int timeout_ms);
+
+// send()s all of |data| on the non-blocking socket |fd| without raising
+// SIGPIPE, failing if the peer stops reading for |timeout_ms|. |sent|, if
+// given, is set to the bytes send() accepted.
+bool SendAllNonBlocking(int fd, const uint8_t* data, size_t length,
+                        int timeout_ms, size_t* sent = nullptr);
+
+// Raw TCP printing, usually to port 9100.
+class TcpTransport : public Transport {
+ public:
+  TcpTransport(std::string host, int port, int connect_timeout_ms = 5000,
+               int write_timeout_ms = 10000);
+  ~TcpTransport() override;
+
+  TcpTransport(const TcpTransport&) = delete;
+  TcpTransport& operator=(const TcpTransport&) = delete;
+
+  bool Open() override;
+  void Close() override;
+  bool IsOpen() const override { return fd_ >= 0; }
+  bool Write(const uint8_t* data, size_t length) override;
+  // Counted from the bytes the printer's TCP stack acknowledged, which
+  // survives a reset connection.
+  size_t Acknowledged() const override { return acknowledged_; }
+  int StreamFd() const override { return fd_; }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override;
+  size_t BytesSent() const override { return sent_; }
+  size_t BytesDelivered() const override;
+  int write_timeout_ms() const override { return write_timeout_ms_; }
+  ssize_t Read(uint8_t* data, size_t length, int timeout_ms) override;
+
+  int fd() const { return fd_; }
+
+ private:
+  std::string host_;
+  int port_;
+  int connect_timeout_ms_;
+  int write_timeout_ms_;
+  int fd_ = -1;
+  size_t acknowledged_ = 0;
+  // Bytes Write() and WriteSome() have sent since Open(), and the
+  // connection's acknowledged byte count when it opened, if the kernel
+  // reports it.
+  size_t sent_ = 0;
+  bool counted_ = false;
+  uint64_t acked_at_open_ = 0;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TCP_TRANSPORT_H_
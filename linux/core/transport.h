@@ -0,0 +1,77 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TRANSPORT_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TRANSPORT_H_
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace thermal_printer_flutter {
+
+// A byte pipe to a single printer. Implementations are used from one worker
+// thread at a time and report failures through their return values; the
+// queue decides whether to reconnect and retry.
+class Transport {
+ public:
+  virtual ~Transport() = default;
+
+  virtual bool Open() = 0;
+  virtual void Close() = 0;
+  virtual bool IsOpen() const = 0;
+
+  // Writes all |length| bytes, returning false if the printer went away.
+  virtual bool Write(const uint8_t* data, size_t length) = 0;
+
+  // Bytes of the last failed Write() the printer is known to have received,
+  // so a retry can skip them. Transports that cannot tell report 0 and the
+  // whole write is sent again.
+  virtual size_t Acknowledged() const { return 0; }
+
+  // Non-blocking writes, for a queue that waits on StreamFd() in an IoLoop
+  // instead of blocking a thread in Write(). Transports without a pollable
+  // descriptor while open return -1 and are only written through Write().
+  virtual int StreamFd() const { return -1; }
+
+  // Writes what the descriptor takes without blocking. Returns the number
+  // of bytes accepted, 0 if it is full and -1 if the printer went away.
+  virtual ssize_t WriteSome(const uint8_t* data, size_t length) {
+    return -1;
+  }
+
+  // Bytes Write() and WriteSome() have accepted since Open(), and how many
+  // of those the printer is known to have received: what a stream uses in
+  // place of Acknowledged().
+  virtual size_t BytesSent() const { return 0; }
+  virtual size_t BytesDelivered() const { return 0; }
+
+  // How long StreamFd() may stay unwritable before the stream fails, which
+  // is what Write() waits at most.
+  virtual int write_timeout_ms() const { return 10000; }
+
+  // Reads up to |length| bytes, waiting at most |timeout_ms|. Returns the
+  // number of bytes read, 0 on timeout and -1 if the transport cannot read.
+  virtual ssize_t Read(uint8_t* data, size_t length, int timeout_ms) {
+    return -1;
+  }
+
+  // Reads the IEEE 1284 device ID the printer reports over its link, for
+  // transports that have one. Returns false otherwise.
+  virtual bool ReadDeviceId(std::string* id) { return false; }
+
+  // Called by the queue whenever it has no further job for this printer.
+  // Transports that hold work back for the next job (an open LPD session,
+  // for instance) must finish it here. Returns false if that failed.
+  virtual bool Flush() { return true; }
+
+  // Whether each Write() reaches the printer as a job of its own (LPD). A
+  // job written in pieces is then framed: BeginJob() announces its exact
+  // length, the pieces follow in Write() calls and EndJob() commits it.
+  virtual bool FramesJobs() const { return false; }
+  virtual bool BeginJob(uint64_t length) { return false; }
+  virtual bool EndJob() { return false; }
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TRANSPORT_H_
@@ -0,0 +1,29 @@
+#include "transport_factory.h"
+
+#include "device_transport.h"
+#include "lpd_transport.h"
+#include "tcp_transport.h"
+
+namespace thermal_printer_flutter {
+
+std::unique_ptr<Transport> CreatePrinterTransport(
+    const std::string& printer, SerialSettings* serial_settings) {
+  NetworkEndpoint endpoint;
+  if (ParseNetworkEndpoint(printer, &endpoint)) {
+    if (endpoint.protocol == NetworkEndpoint::Protocol::kLpd) {
+      return std::unique_ptr<Transport>(
+          new LpdTransport(endpoint.host, endpoint.port, endpoint.queue));
+    }
+    return std::unique_ptr<Transport>(
+        new TcpTransport(endpoint.host, endpoint.port));
+  }
+  if (IsSerialDevicePath(printer)) {
+    return std::unique_ptr<Transport>(
+        new SerialTransport(printer, [serial_settings, printer] {
+          return serial_settings->Get(printer);
+        }));
+  }
+  return std::unique_ptr<Transport>(new DeviceTransport(printer));
+}
+
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,21 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TRANSPORT_FACTORY_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TRANSPORT_FACTORY_H_
+
+#include <memory>
+#include <string>
+
+#include "serial_transport.h"
+#include "transport.h"
+
+namespace thermal_printer_flutter {
+
+// The transport for a printer key: LPD or raw TCP for a NetworkEndpoint
+// string, SerialTransport for a serial port and DeviceTransport for a USB
+// printer device. Serial ports read their options from |serial_settings|,
+// which must outlive the transport.
+std::unique_ptr<Transport> CreatePrinterTransport(
+    const std::string& printer, SerialSettings* serial_settings);
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_CORE_TRANSPORT_FACTORY_H_
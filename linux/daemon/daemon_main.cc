@@ -0,0 +1,126 @@
+// Shared print daemon: owns the printer connections and queues for every
+// app on the machine that uses the plugin. The plugin connects to it
+// automatically when it is running.
+//
+// $ thermal_printer_flutter_daemon [--socket PATH] [--journal PATH]
+//       [--memory-limit BYTES]
+//
+// The socket defaults to $XDG_RUNTIME_DIR/thermal_printer_flutter.sock (see
+// DefaultDaemonSocketPath()), and the journal to daemon.journal in the same
+// cache directory the plugin spools to. Jobs that would take the bytes
+// queued past --memory-limit (PrintQueue::kDefaultMemoryLimit; 0 for none)
+// are refused, and the app told so. SIGINT and SIGTERM stop it; jobs still
+// queued are printed on the next start.
+
+#include <glib.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/band_cache.h"
+#include "core/daemon_protocol.h"
+#include "core/io_loop.h"
+#include "core/print_daemon.h"
+#include "core/print_queue.h"
+#include "core/printer_profile.h"
+#include "core/serial_transport.h"
+#include "core/spool_journal.h"
+#include "core/transport_factory.h"
+#include "image_decoder.h"
+
+namespace thermal_printer_flutter {
+namespace {
+
+void PrintUsage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [--socket PATH] [--journal PATH] [--memory-limit BYTES]"
+          "\n",
+          program);
+}
+
+int RunDaemon(int argc, char** argv) {
+  std::string socket_path = DefaultDaemonSocketPath();
+  g_autofree gchar* spool_dir = g_build_filename(
+      g_get_user_cache_dir(), "thermal_printer_flutter", nullptr);
+  g_autofree gchar* default_journal =
+      g_build_filename(spool_dir, "daemon.journal", nullptr);
+  std::string journal_path = default_journal;
+  size_t memory_limit = PrintQueue::kDefaultMemoryLimit;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+      journal_path = argv[++i];
+    } else if (strcmp(argv[i], "--memory-limit") == 0 && i + 1 < argc) {
+      memory_limit = strtoull(argv[++i], nullptr, 10);
+    } else {
+      PrintUsage(argv[0]);
+      return 2;
+    }
+  }
+
+  // Blocked before any thread starts, so only sigwait() below sees them.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  std::vector<JournaledJob> pending;
+  std::vector<JournaledKey> settled_keys;
+  SpoolJournal journal;
+  g_autofree gchar* journal_dir = g_path_get_dirname(journal_path.c_str());
+  if (g_mkdir_with_parents(journal_dir, 0700) != 0 ||
+      !journal.Open(journal_path, &pending, &settled_keys)) {
+    fprintf(stderr, "Print spool journal unavailable at %s; jobs will not "
+            "survive a restart\n", journal_path.c_str());
+  }
+  BandCache bands;
+  SerialSettings serial_settings;
+  PrintQueue queue(
+      [&serial_settings](const std::string& printer) {
+        return CreatePrinterTransport(printer, &serial_settings);
+      },
+      &journal);
+  // Serving every app's printers, the daemon is where thread-per-printer
+  // would cost the most.
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  queue.SetSourceFactory(
+      [&bands](const FileJobSpec& spec, const PrinterProfile& profile) {
+        return open_print_file_source(spec, profile, &bands);
+      });
+  queue.SetProfileResolver(ResolvePrinterProfile);
+  queue.SetMemoryLimit(memory_limit);
+
+  PrintDaemon daemon(&queue, &serial_settings);
+  if (!daemon.Listen(socket_path)) {
+    fprintf(stderr, "Cannot listen on %s; is another daemon running?\n",
+            socket_path.c_str());
+    return 1;
+  }
+  queue.Restore(std::move(pending), std::move(settled_keys));
+  fprintf(stderr, "Serving printers on %s\n", socket_path.c_str());
+
+  std::thread server([&daemon] { daemon.Run(); });
+  int signal_number = 0;
+  sigwait(&signals, &signal_number);
+  daemon.Stop();
+  server.join();
+  queue.Shutdown();
+  return 0;
+}
+
+}  // namespace
+}  // namespace thermal_printer_flutter
+
+int main(int argc, char** argv) {
+  return thermal_printer_flutter::RunDaemon(argc, argv);
+}
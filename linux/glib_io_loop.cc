@@ -0,0 +1,107 @@
+#include "glib_io_loop.h"
+
+#include <glib-unix.h>
+#include <poll.h>
+
+#include <utility>
+
+namespace thermal_printer_flutter {
+
+namespace {
+
+using FdCallback = std::function<void(bool ready)>;
+using TimerCallback = std::function<void()>;
+
+gboolean fd_source_dispatch(gint fd, GIOCondition condition,
+                            gpointer user_data) {
+  // A source that reached its ready time without the fd becoming ready is
+  // dispatched with no condition.
+  (*static_cast<FdCallback*>(user_data))(condition != 0);
+  return G_SOURCE_REMOVE;
+}
+
+void fd_callback_free(gpointer user_data) {
+  delete static_cast<FdCallback*>(user_data);
+}
+
+gboolean timer_source_dispatch(gpointer user_data) {
+  (*static_cast<TimerCallback*>(user_data))();
+  return G_SOURCE_REMOVE;
+}
+
+void timer_callback_free(gpointer user_data) {
+  delete static_cast<TimerCallback*>(user_data);
+}
+
+gboolean quit_loop(gpointer user_data) {
+  g_main_loop_quit(static_cast<GMainLoop*>(user_data));
+  return G_SOURCE_REMOVE;
+}
+
+GIOCondition io_condition(short events) {
+  int condition = 0;
+  if ((events & POLLIN) != 0) {
+    condition |= G_IO_IN;
+  }
+  if ((events & POLLOUT) != 0) {
+    condition |= G_IO_OUT;
+  }
+  // Errors end the wait too, so the next write can report them.
+  return static_cast<GIOCondition>(condition | G_IO_ERR | G_IO_HUP);
+}
+
+}  // namespace
+
+GlibIoLoop::GlibIoLoop()
+    : context_(g_main_context_new()),
+      loop_(g_main_loop_new(context_, FALSE)),
+      thread_([this] {
+        g_main_context_push_thread_default(context_);
+        g_main_loop_run(loop_);
+        g_main_context_pop_thread_default(context_);
+      }) {}
+
+GlibIoLoop::~GlibIoLoop() {
+  Stop();
+  g_main_loop_unref(loop_);
+  g_main_context_unref(context_);
+}
+
+void GlibIoLoop::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  // Quitting from inside the loop cannot race g_main_loop_run() starting.
+  GSource* source = g_idle_source_new();
+  g_source_set_callback(source, quit_loop, loop_, nullptr);
+  g_source_attach(source, context_);
+  g_source_unref(source);
+  thread_.join();
+}
+
+void GlibIoLoop::WaitForFd(int fd, short events, int timeout_ms,
+                           std::function<void(bool ready)> callback) {
+  GSource* source = g_unix_fd_source_new(fd, io_condition(events));
+  g_source_set_ready_time(
+      source, g_get_monotonic_time() + timeout_ms * G_GINT64_CONSTANT(1000));
+  g_source_set_callback(source,
+                        reinterpret_cast<GSourceFunc>(fd_source_dispatch),
+                        new FdCallback(std::move(callback)), fd_callback_free);
+  g_source_attach(source, context_);
+  g_source_unref(source);
+}
+
+void GlibIoLoop::Post(std::chrono::milliseconds delay,
+                      std::function<void()> callback) {
+  GSource* source =
+      delay.count() > 0
+          ? g_timeout_source_new(static_cast<guint>(delay.count()))
+          : g_idle_source_new();
+  g_source_set_callback(source, timer_source_dispatch,
+                        new TimerCallback(std::move(callback)),
+                        timer_callback_free);
+  g_source_attach(source, context_);
+  g_source_unref(source);
+}
+
+}  // namespace thermal_printer_flutter
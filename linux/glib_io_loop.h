@@ -0,0 +1,43 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_GLIB_IO_LOOP_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_GLIB_IO_LOOP_H_
+
+#include <gtk/gtk.h>
+
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "core/io_loop.h"
+
+namespace thermal_printer_flutter {
+
+// IoLoop on a GMainContext of its own, run by one thread. Printer fds are
+// watched with g_unix_fd_source_new() and timers are GSources on the same
+// context, so none of the queue's work lands on the GTK main loop that
+// serves the method channel.
+class GlibIoLoop : public IoLoop {
+ public:
+  GlibIoLoop();
+  // Drops the context, destroying the sources still attached to it.
+  ~GlibIoLoop() override;
+
+  GlibIoLoop(const GlibIoLoop&) = delete;
+  GlibIoLoop& operator=(const GlibIoLoop&) = delete;
+
+  // Quits the loop; sources attached afterwards are never dispatched.
+  void Stop() override;
+
+  void WaitForFd(int fd, short events, int timeout_ms,
+                 std::function<void(bool ready)> callback) override;
+  void Post(std::chrono::milliseconds delay,
+            std::function<void()> callback) override;
+
+ private:
+  GMainContext* context_;
+  GMainLoop* loop_;
+  std::thread thread_;
+};
+
+}  // namespace thermal_printer_flutter
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_GLIB_IO_LOOP_H_
@@ -0,0 +1,291 @@
+#include "image_decoder.h"
+
+#include <gtk/gtk.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace {
+
+// Bytes handed to the loader per write, so rows reach the encoder while the
+// rest of the file is still being decoded.
+constexpr size_t kLoaderChunkSize = 64 * 1024;
+
+struct DecodeState {
+  thermal_printer_flutter::RasterOptions options;
+  int max_width = 0;
+  bool multipass = false;
+  std::vector<uint8_t>* output = nullptr;
+  thermal_printer_flutter::BandCache* bands = nullptr;
+  std::unique_ptr<thermal_printer_flutter::RasterEncoder> encoder;
+  int rows_encoded = 0;
+  bool failed = false;
+};
+
+// Feeds rows [rows_encoded, end) of |pixbuf| to the encoder, creating it on
+// the first call once the final pixbuf size is known.
+void encode_rows(DecodeState* state, GdkPixbuf* pixbuf, int end) {
+  if (state->failed || pixbuf == nullptr) {
+    return;
+  }
+  if (!state->encoder) {
+    std::vector<uint8_t>* output = state->output;
+    state->encoder.reset(new thermal_printer_flutter::RasterEncoder(
+        gdk_pixbuf_get_width(pixbuf), gdk_pixbuf_get_height(pixbuf),
+        state->options, [output](const uint8_t* data, size_t length) {
+          output->insert(output->end(), data, data + length);
+          return true;
+        }));
+    if (state->bands != nullptr) {
+      state->encoder->SetBandCache(state->bands);
+    }
+  }
+  const guint8* pixels = gdk_pixbuf_read_pixels(pixbuf);
+  int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+  int channels = gdk_pixbuf_get_n_channels(pixbuf);
+  end = std::min(end, gdk_pixbuf_get_height(pixbuf));
+  for (; state->rows_encoded < end; state->rows_encoded++) {
+    if (!state->encoder->PushRow(
+            pixels + static_cast<size_t>(state->rows_encoded) * rowstride,
+            channels)) {
+      state->failed = true;
+      return;
+    }
+  }
+}
+
+void size_prepared_cb(GdkPixbufLoader* loader, gint width, gint height,
+                      gpointer user_data) {
+  DecodeState* state = static_cast<DecodeState*>(user_data);
+  // A quarter turn puts the image's height across the paper.
+  const bool quarter = thermal_printer_flutter::IsQuarterTurn(
+      state->options.rotation);
+  const int across = quarter ? height : width;
+  int output_width = state->options.width > 0
+                         ? state->options.width
+                         : std::min(across, state->max_width);
+  state->options.width = std::max(output_width / 8 * 8, 8);
+
+  // libjpeg can decode at 1/2, 1/4 or 1/8 scale for free; asking for the
+  // output size lets the loader pick the smallest of those that fits.
+  GdkPixbufFormat* format = gdk_pixbuf_loader_get_format(loader);
+  g_autofree gchar* format_name =
+      format != nullptr ? gdk_pixbuf_format_get_name(format) : nullptr;
+  if (format_name != nullptr && strcmp(format_name, "jpeg") == 0 &&
+      across > state->options.width) {
+    const int target = state->options.width;
+    if (quarter) {
+      gdk_pixbuf_loader_set_size(
+          loader,
+          thermal_printer_flutter::RasterEncoder::ScaledHeight(height, width,
+                                                               target),
+          target);
+    } else {
+      gdk_pixbuf_loader_set_size(
+          loader, target,
+          thermal_printer_flutter::RasterEncoder::ScaledHeight(width, height,
+                                                               target));
+    }
+  }
+}
+
+void area_updated_cb(GdkPixbufLoader* loader, gint x, gint y, gint width,
+                     gint height, gpointer user_data) {
+  DecodeState* state = static_cast<DecodeState*>(user_data);
+  // Only contiguous, final rows can be encoded early.
+  if (state->multipass || y > state->rows_encoded) {
+    return;
+  }
+  encode_rows(state, gdk_pixbuf_loader_get_pixbuf(loader), y + height);
+}
+
+// Creates a loader that encodes into |state| as it decodes.
+GdkPixbufLoader* new_raster_loader(DecodeState* state) {
+  GdkPixbufLoader* loader = gdk_pixbuf_loader_new();
+  g_signal_connect(loader, "size-prepared", G_CALLBACK(size_prepared_cb),
+                   state);
+  g_signal_connect(loader, "area-updated", G_CALLBACK(area_updated_cb),
+                   state);
+  return loader;
+}
+
+// Closes |loader| and encodes whatever it held back (later passes, or a
+// scaled result), which is final now.
+bool finish_raster_loader(DecodeState* state, GdkPixbufLoader* loader) {
+  g_autoptr(GError) error = nullptr;
+  if (!gdk_pixbuf_loader_close(loader, &error)) {
+    g_warning("Failed to decode image: %s", error->message);
+    return false;
+  }
+  GdkPixbuf* pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+  if (pixbuf == nullptr) {
+    return false;
+  }
+  encode_rows(state, pixbuf, gdk_pixbuf_get_height(pixbuf));
+  if (state->failed || !state->encoder || !state->encoder->Finish()) {
+    return false;
+  }
+  if (state->bands != nullptr) {
+    const thermal_printer_flutter::BandStats& stats =
+        state->encoder->band_stats();
+    g_debug("Raster job reused %d of %d bands", stats.reused, stats.bands);
+  }
+  return true;
+}
+
+// Decodes a mapped image file a loader chunk at a time, handing out the
+// bands each chunk produced. Consumed parts of the file are released as it
+// goes.
+class ImageFileSource : public thermal_printer_flutter::JobSource {
+ public:
+  ImageFileSource(std::unique_ptr<thermal_printer_flutter::MappedFile> file,
+                  const thermal_printer_flutter::RasterOptions& options,
+                  int max_width, thermal_printer_flutter::BandCache* bands)
+      : file_(std::move(file)) {
+    state_.options = options;
+    state_.max_width = max_width;
+    state_.bands = bands;
+    state_.multipass = is_multipass_image(file_->data(), file_->size());
+    state_.output = &output_;
+    loader_ = new_raster_loader(&state_);
+  }
+
+  ~ImageFileSource() override {
+    if (!done_) {
+      gdk_pixbuf_loader_close(loader_, nullptr);
+    }
+    g_object_unref(loader_);
+  }
+
+  bool Next(const uint8_t** data, size_t* length) override {
+    output_.clear();
+    while (output_.empty() && !done_ && !state_.failed) {
+      if (offset_ < file_->size()) {
+        size_t chunk = std::min(kLoaderChunkSize, file_->size() - offset_);
+        g_autoptr(GError) error = nullptr;
+        if (!gdk_pixbuf_loader_write(loader_, file_->data() + offset_, chunk,
+                                     &error)) {
+          g_warning("Failed to decode image: %s", error->message);
+          state_.failed = true;
+          break;
+        }
+        offset_ += chunk;
+        file_->Release(offset_);
+      } else {
+        done_ = true;
+        state_.failed = !finish_raster_loader(&state_, loader_);
+      }
+    }
+    if (output_.empty() || state_.failed) {
+      return false;
+    }
+    *data = output_.data();
+    *length = output_.size();
+    return true;
+  }
+
+  bool failed() const override { return state_.failed; }
+
+ private:
+  std::unique_ptr<thermal_printer_flutter::MappedFile> file_;
+  DecodeState state_;
+  GdkPixbufLoader* loader_;
+  std::vector<uint8_t> output_;
+  size_t offset_ = 0;
+  bool done_ = false;
+};
+
+}  // namespace
+
+bool is_multipass_image(const uint8_t* data, size_t length) {
+  static const uint8_t kPngSignature[] = {0x89, 'P', 'N', 'G',
+                                          '\r', '\n', 0x1A, '\n'};
+  if (length >= 29 && memcmp(data, kPngSignature, 8) == 0 &&
+      memcmp(data + 12, "IHDR", 4) == 0) {
+    // Signature, chunk length and type, then width, height, bit depth,
+    // colour type, compression and filter precede the interlace method.
+    return data[28] != 0;
+  }
+  if (length < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+  // Walk the JPEG markers up to the first frame header.
+  size_t offset = 2;
+  while (offset + 4 <= length) {
+    if (data[offset] != 0xFF) {
+      return false;
+    }
+    uint8_t marker = data[offset + 1];
+    if (marker == 0xFF) {
+      offset++;
+      continue;
+    }
+    if (marker == 0xC2 || marker == 0xC6 || marker == 0xCA || marker == 0xCE) {
+      return true;
+    }
+    if ((marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+         marker != 0xC8 && marker != 0xCC) ||
+        marker == 0xDA) {
+      return false;
+    }
+    offset += 2 + ((data[offset + 2] << 8) | data[offset + 3]);
+  }
+  return false;
+}
+
+bool decode_image_to_raster(const uint8_t* data, size_t length,
+                            thermal_printer_flutter::RasterOptions options,
+                            int max_width,
+                            thermal_printer_flutter::BandCache* bands,
+                            std::vector<uint8_t>* output) {
+  DecodeState state;
+  state.options = options;
+  state.max_width = max_width;
+  state.bands = bands;
+  state.multipass = is_multipass_image(data, length);
+  state.output = output;
+
+  g_autoptr(GdkPixbufLoader) loader = new_raster_loader(&state);
+  g_autoptr(GError) error = nullptr;
+  for (size_t offset = 0; offset < length && !state.failed;
+       offset += kLoaderChunkSize) {
+    size_t chunk = std::min(kLoaderChunkSize, length - offset);
+    if (!gdk_pixbuf_loader_write(loader, data + offset, chunk, &error)) {
+      break;
+    }
+  }
+  if (error != nullptr || state.failed) {
+    gdk_pixbuf_loader_close(loader, nullptr);
+    if (error != nullptr) {
+      g_warning("Failed to decode image: %s", error->message);
+    }
+    return false;
+  }
+  return finish_raster_loader(&state, loader);
+}
+
+std::unique_ptr<thermal_printer_flutter::JobSource> open_image_file_source(
+    const thermal_printer_flutter::FileJobSpec& spec, int max_width,
+    thermal_printer_flutter::BandCache* bands) {
+  std::unique_ptr<thermal_printer_flutter::MappedFile> file(
+      new thermal_printer_flutter::MappedFile());
+  if (!file->Open(spec.path, spec.device, spec.inode) || file->size() == 0) {
+    return nullptr;
+  }
+  return std::unique_ptr<thermal_printer_flutter::JobSource>(
+      new ImageFileSource(std::move(file), spec.raster, max_width, bands));
+}
+
+std::unique_ptr<thermal_printer_flutter::JobSource> open_print_file_source(
+    const thermal_printer_flutter::FileJobSpec& spec,
+    const thermal_printer_flutter::PrinterProfile& profile,
+    thermal_printer_flutter::BandCache* bands) {
+  thermal_printer_flutter::FileJobSpec tuned = spec;
+  tuned.raster.band_height = profile.band_height;
+  if (spec.format == thermal_printer_flutter::FileFormat::kImage) {
+    return open_image_file_source(tuned, profile.paper_width, bands);
+  }
+  return thermal_printer_flutter::OpenFileSource(tuned);
+}
@@ -0,0 +1,49 @@
+#ifndef FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_IMAGE_DECODER_H_
+#define FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_IMAGE_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/file_source.h"
+#include "core/job_source.h"
+#include "core/printer_profile.h"
+#include "core/raster_encoder.h"
+
+// Decodes PNG or JPEG |data| with gdk-pixbuf and appends it to |output| as
+// GS v 0 raster bands. A |options.width| of 0 prints the image at its own
+// width, capped at |max_width| dots.
+//
+// Rows are handed to the raster encoder as the loader produces them, so
+// scaling, dithering and packing overlap with decoding and the only full
+// size buffer is gdk-pixbuf's own. JPEGs wider than the output are decoded
+// at a reduced DCT scale, which keeps that buffer small too.
+//
+// Bands already in |bands|, if given, are copied rather than dithered.
+bool decode_image_to_raster(const uint8_t* data, size_t length,
+                            thermal_printer_flutter::RasterOptions options,
+                            int max_width,
+                            thermal_printer_flutter::BandCache* bands,
+                            std::vector<uint8_t>* output);
+
+// Streams a PNG or JPEG file as raster bands: the file is mapped and fed to
+// the decoder a chunk at a time, so it never has to be read into memory.
+// Returns null if the file cannot be mapped.
+std::unique_ptr<thermal_printer_flutter::JobSource> open_image_file_source(
+    const thermal_printer_flutter::FileJobSpec& spec, int max_width,
+    thermal_printer_flutter::BandCache* bands);
+
+// Opens a queued file job for |profile|'s printer: images through
+// open_image_file_source(), other formats through OpenFileSource(), with
+// bands sized for the printer either way.
+std::unique_ptr<thermal_printer_flutter::JobSource> open_print_file_source(
+    const thermal_printer_flutter::FileJobSpec& spec,
+    const thermal_printer_flutter::PrinterProfile& profile,
+    thermal_printer_flutter::BandCache* bands);
+
+// True for interlaced PNGs and progressive JPEGs, whose early rows are
+// rewritten by later passes and so cannot be encoded as they arrive.
+bool is_multipass_image(const uint8_t* data, size_t length);
+
+#endif  // FLUTTER_PLUGIN_THERMAL_PRINTER_FLUTTER_IMAGE_DECODER_H_
@@ -0,0 +1,516 @@
+// Load generator: replays recorded jobs through the native print queue, with
+// no Flutter or GTK, and reports throughput, queueing delay and latency.
+//
+// $ thermal_printer_flutter_loadgen --corpus DIR_OR_FILE[@WEIGHT] ...
+//       [--printer KEY ...] [--stand-ins N] [--drain-rate BYTES_PER_SECOND]
+//       [--jobs N | --duration SECONDS] [--rate JOBS_PER_SECOND]
+//       [--concurrency N] [--group] [--chunk-size N] [--workers N]
+//       [--sweep chunk-size=N,N,... | --sweep workers=N,N,...] [--seed N]
+//
+// The corpus is raw job bytes, ESC/POS or raster alike, one job per file: a
+// capture of what the app sent, for instance. Each job picks a file at
+// random, weighted by the WEIGHT of the --corpus it came from. Jobs go to
+// real printers (--printer, any key the plugin takes) or to stand-ins: a
+// socketpair drained at --drain-rate, for measuring the queue itself.
+//
+// Jobs arrive --rate per second, or back to back when it is 0, with at most
+// --concurrency of them queued or printing; --group submits them to a group
+// of every printer instead of to each printer in turn. --workers 0 runs a
+// thread per printer and N drives the queue from an IoLoop with N blocking
+// threads. --chunk-size 0 lets each printer's tuner learn it. Every --sweep
+// value, and every combination of two sweeps, is one run with a fresh queue
+// and printers, reported on a row of its own.
+//
+// Latency runs from when a job was due to arrive, not when it was
+// submitted, so a run that falls behind its rate is not flattered by it.
+// Queueing delay runs from submission until the job's batch was taken off
+// the queue.
+
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/device_transport.h"
+#include "core/io_loop.h"
+#include "core/print_queue.h"
+#include "core/serial_transport.h"
+#include "core/transport_factory.h"
+
+namespace thermal_printer_flutter {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// About a 150 mm/s printer printing raster the full width of 80 mm paper.
+constexpr size_t kDefaultDrainRate = 96 * 1024;
+// What a stand-in buffers before its writer has to wait, like a printer's
+// input buffer.
+constexpr int kStandInBuffer = 16 * 1024;
+constexpr char kGroup[] = "loadgen";
+
+struct CorpusJob {
+  std::string path;
+  std::vector<uint8_t> data;
+  double weight = 1;
+};
+
+struct Options {
+  std::vector<CorpusJob> corpus;
+  std::vector<std::string> printers;
+  int stand_ins = 0;
+  size_t drain_rate = kDefaultDrainRate;
+  int jobs = 200;
+  double duration = 0;
+  double rate = 0;
+  int concurrency = 4;
+  bool group = false;
+  std::vector<size_t> chunk_sizes = {0};
+  std::vector<int> workers = {0};
+  unsigned seed = 1;
+};
+
+struct RunResult {
+  int completed = 0;
+  int failed = 0;
+  uint64_t bytes = 0;
+  double seconds = 0;
+  // In milliseconds, of the jobs that printed.
+  std::vector<double> queueing;
+  std::vector<double> latency;
+};
+
+// The printer end of a socketpair, taking bytes at a fixed rate.
+class StandInPrinter {
+ public:
+  explicit StandInPrinter(size_t drain_rate) : drain_rate_(drain_rate) {
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                   fds_) != 0) {
+      fds_[0] = fds_[1] = -1;
+      return;
+    }
+    setsockopt(fds_[0], SOL_SOCKET, SO_SNDBUF, &kStandInBuffer,
+               sizeof(kStandInBuffer));
+    setsockopt(fds_[1], SOL_SOCKET, SO_RCVBUF, &kStandInBuffer,
+               sizeof(kStandInBuffer));
+    thread_ = std::thread(&StandInPrinter::Drain, this);
+  }
+
+  ~StandInPrinter() {
+    done_ = true;
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  StandInPrinter(const StandInPrinter&) = delete;
+  StandInPrinter& operator=(const StandInPrinter&) = delete;
+
+  int fd() const { return fds_[0]; }
+
+ private:
+  void Drain() {
+    std::vector<uint8_t> buffer(64 * 1024);
+    Clock::time_point start = Clock::now();
+    uint64_t drained = 0;
+    while (!done_) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      double elapsed =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      uint64_t allowed = static_cast<uint64_t>(elapsed * drain_rate_);
+      // An idle printer does not bank time to print faster later.
+      if (allowed > drained + kStandInBuffer) {
+        drained = allowed - kStandInBuffer;
+      }
+      while (drained < allowed) {
+        ssize_t count =
+            read(fds_[1], buffer.data(),
+                 std::min<uint64_t>(allowed - drained, buffer.size()));
+        if (count <= 0) {
+          drained = allowed;
+          break;
+        }
+        drained += count;
+      }
+    }
+  }
+
+  size_t drain_rate_;
+  int fds_[2];
+  std::atomic<bool> done_{false};
+  std::thread thread_;
+};
+
+class StandInTransport : public Transport {
+ public:
+  explicit StandInTransport(int fd) : fd_(fd) {}
+
+  bool Open() override {
+    open_ = fd_ >= 0;
+    sent_ = 0;
+    return open_;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override {
+    size_t written = 0;
+    bool success =
+        WriteAllNonBlocking(fd_, data, length, write_timeout_ms(), &written);
+    sent_ += written;
+    return success;
+  }
+  int StreamFd() const override { return open_ ? fd_ : -1; }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override {
+    ssize_t written = WriteNonBlocking(fd_, data, length);
+    if (written > 0) {
+      sent_ += written;
+    }
+    return written;
+  }
+  size_t BytesSent() const override { return sent_; }
+
+ private:
+  int fd_;
+  bool open_ = false;
+  size_t sent_ = 0;
+};
+
+void PrintUsage(const char* program) {
+  fprintf(stderr,
+          "usage: %s --corpus DIR_OR_FILE[@WEIGHT] ... [--printer KEY ...]\n"
+          "    [--stand-ins N] [--drain-rate BYTES_PER_SECOND]\n"
+          "    [--jobs N | --duration SECONDS] [--rate JOBS_PER_SECOND]\n"
+          "    [--concurrency N] [--group] [--chunk-size N] [--workers N]\n"
+          "    [--sweep chunk-size=N,... | --sweep workers=N,...] [--seed N]\n",
+          program);
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return !data->empty();
+}
+
+// Adds the file, or every file in the directory, |argument| names.
+bool LoadCorpus(const std::string& argument, std::vector<CorpusJob>* corpus) {
+  std::string path = argument;
+  double weight = 1;
+  size_t at = argument.rfind('@');
+  if (at != std::string::npos) {
+    char* end;
+    weight = strtod(argument.c_str() + at + 1, &end);
+    if (*end != '\0' || !(weight > 0)) {
+      return false;
+    }
+    path = argument.substr(0, at);
+  }
+  std::vector<std::string> paths;
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return false;
+  }
+  if (S_ISDIR(info.st_mode)) {
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr) {
+      return false;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+      std::string child = path + "/" + entry->d_name;
+      if (entry->d_name[0] != '.' && stat(child.c_str(), &info) == 0 &&
+          S_ISREG(info.st_mode)) {
+        paths.push_back(child);
+      }
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+  } else {
+    paths.push_back(path);
+  }
+  for (const std::string& file : paths) {
+    CorpusJob job;
+    job.path = file;
+    job.weight = weight;
+    if (ReadFile(file, &job.data)) {
+      corpus->push_back(std::move(job));
+    }
+  }
+  return !paths.empty();
+}
+
+// Parses a comma-separated list of non-negative integers.
+bool ParseList(const char* text, std::vector<long>* values) {
+  values->clear();
+  while (true) {
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (end == text || value < 0) {
+      return false;
+    }
+    values->push_back(value);
+    if (*end == '\0') {
+      return true;
+    }
+    if (*end != ',') {
+      return false;
+    }
+    text = end + 1;
+  }
+}
+
+bool ParseSweep(const char* text, Options* options) {
+  const char* equals = strchr(text, '=');
+  std::vector<long> values;
+  if (equals == nullptr || !ParseList(equals + 1, &values)) {
+    return false;
+  }
+  std::string name(text, equals);
+  if (name == "chunk-size") {
+    options->chunk_sizes.assign(values.begin(), values.end());
+    return true;
+  }
+  if (name == "workers") {
+    options->workers.assign(values.begin(), values.end());
+    return true;
+  }
+  return false;
+}
+
+// The value |percent| of the way through |values|, which it sorts.
+double Percentile(std::vector<double>* values, double percent) {
+  if (values->empty()) {
+    return 0;
+  }
+  std::sort(values->begin(), values->end());
+  size_t rank = static_cast<size_t>(percent / 100 * values->size() + 0.999);
+  return (*values)[std::min(std::max<size_t>(rank, 1), values->size()) - 1];
+}
+
+double Milliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+bool Run(const Options& options, size_t chunk_size, int workers,
+         RunResult* result) {
+  std::map<std::string, std::unique_ptr<StandInPrinter>> stand_ins;
+  std::vector<std::string> printers = options.printers;
+  for (int i = 0; i < options.stand_ins; i++) {
+    std::string key = "stand-in-" + std::to_string(i);
+    stand_ins[key].reset(new StandInPrinter(options.drain_rate));
+    printers.push_back(key);
+  }
+
+  SerialSettings serial_settings;
+  PrintQueue queue(
+      [&](const std::string& printer) {
+        auto it = stand_ins.find(printer);
+        if (it != stand_ins.end()) {
+          return std::unique_ptr<Transport>(
+              new StandInTransport(it->second->fd()));
+        }
+        return CreatePrinterTransport(printer, &serial_settings);
+      },
+      nullptr);
+  if (workers > 0) {
+    queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()), workers);
+  }
+  queue.SetChunkSize(chunk_size);
+  if (options.group && !queue.SetGroup(kGroup, printers)) {
+    return false;
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  int outstanding = 0;
+  // When each job was due, by id.
+  std::map<uint64_t, Clock::time_point> due;
+  Clock::time_point last_finish;
+  queue.SetJobObserver([&](const JobEvent& event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = due.find(event.id);
+    if (it == due.end()) {
+      return;
+    }
+    if (event.success) {
+      result->completed++;
+      result->bytes += event.length;
+      result->queueing.push_back(
+          Milliseconds(event.started_at - event.queued_at));
+      result->latency.push_back(Milliseconds(event.finished_at - it->second));
+    } else {
+      result->failed++;
+    }
+    last_finish = std::max(last_finish, event.finished_at);
+    due.erase(it);
+    outstanding--;
+    cv.notify_all();
+  });
+
+  std::vector<double> weights;
+  for (const CorpusJob& job : options.corpus) {
+    weights.push_back(job.weight);
+  }
+  std::mt19937 random(options.seed);
+  std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+  auto interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(options.rate > 0 ? 1 / options.rate : 0));
+  auto duration = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(options.duration));
+
+  Clock::time_point start = Clock::now();
+  last_finish = start;
+  for (int i = 0; options.duration > 0 || i < options.jobs; i++) {
+    Clock::time_point when = start + interval * i;
+    if (options.duration > 0 && when - start >= duration) {
+      break;
+    }
+    std::this_thread::sleep_until(when);
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return outstanding < options.concurrency; });
+    const CorpusJob& job = options.corpus[pick(random)];
+    const std::string& printer =
+        options.group ? std::string(kGroup) : printers[i % printers.size()];
+    Clock::time_point submitted = Clock::now();
+    // Held across Submit(), so the observer cannot hear of the job before
+    // it is in |due|.
+    uint64_t id = queue.Submit(printer, job.data);
+    if (id == 0) {
+      result->failed++;
+      continue;
+    }
+    due[id] = options.rate > 0 ? when : submitted;
+    outstanding++;
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return outstanding == 0; });
+    result->seconds =
+        std::chrono::duration<double>(last_finish - start).count();
+  }
+  queue.Shutdown();
+  return true;
+}
+
+int RunLoadGenerator(int argc, char** argv) {
+  Options options;
+  bool stand_ins_set = false;
+  int sweeps = 0;
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--corpus") == 0 && has_value) {
+      if (!LoadCorpus(argv[++i], &options.corpus)) {
+        fprintf(stderr, "Cannot read corpus %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--printer") == 0 && has_value) {
+      options.printers.push_back(argv[++i]);
+    } else if (strcmp(argv[i], "--stand-ins") == 0 && has_value) {
+      options.stand_ins = atoi(argv[++i]);
+      stand_ins_set = true;
+    } else if (strcmp(argv[i], "--drain-rate") == 0 && has_value) {
+      options.drain_rate = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--jobs") == 0 && has_value) {
+      options.jobs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--duration") == 0 && has_value) {
+      options.duration = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--rate") == 0 && has_value) {
+      options.rate = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--concurrency") == 0 && has_value) {
+      options.concurrency = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--group") == 0) {
+      options.group = true;
+    } else if (strcmp(argv[i], "--chunk-size") == 0 && has_value) {
+      options.chunk_sizes = {strtoul(argv[++i], nullptr, 10)};
+    } else if (strcmp(argv[i], "--workers") == 0 && has_value) {
+      options.workers = {atoi(argv[++i])};
+    } else if (strcmp(argv[i], "--sweep") == 0 && has_value) {
+      if (!ParseSweep(argv[++i], &options)) {
+        PrintUsage(argv[0]);
+        return 2;
+      }
+      sweeps++;
+    } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+      options.seed = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+    } else {
+      PrintUsage(argv[0]);
+      return 2;
+    }
+  }
+  if (!stand_ins_set && options.printers.empty()) {
+    options.stand_ins = 1;
+  }
+  if (options.corpus.empty() || options.stand_ins < 0 ||
+      options.stand_ins + options.printers.size() == 0 ||
+      options.drain_rate == 0 || options.concurrency < 1 ||
+      options.rate < 0 || (options.duration <= 0 && options.jobs < 1) ||
+      sweeps > 2) {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  uint64_t corpus_bytes = 0;
+  for (const CorpusJob& job : options.corpus) {
+    corpus_bytes += job.data.size();
+  }
+  fprintf(stderr, "%zu jobs in the corpus, %llu bytes; %zu printers, %d "
+          "stand-ins at %zu bytes/s\n",
+          options.corpus.size(),
+          static_cast<unsigned long long>(corpus_bytes),
+          options.printers.size(), options.stand_ins, options.drain_rate);
+  printf("%8s %7s %6s %6s %8s %9s %9s %9s %9s %9s %9s\n", "chunk", "workers",
+         "jobs", "failed", "jobs/s", "KiB/s", "queue50", "queue99", "lat50",
+         "lat99", "lat999");
+  for (size_t chunk_size : options.chunk_sizes) {
+    for (int workers : options.workers) {
+      RunResult result;
+      if (!Run(options, chunk_size, workers, &result)) {
+        fprintf(stderr, "Cannot group the printers\n");
+        return 1;
+      }
+      double seconds = std::max(result.seconds, 1e-9);
+      printf("%8s %7s %6d %6d %8.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+             chunk_size > 0 ? std::to_string(chunk_size).c_str() : "tuned",
+             workers > 0 ? std::to_string(workers).c_str() : "threads",
+             result.completed, result.failed, result.completed / seconds,
+             result.bytes / seconds / 1024,
+             Percentile(&result.queueing, 50), Percentile(&result.queueing, 99),
+             Percentile(&result.latency, 50), Percentile(&result.latency, 99),
+             Percentile(&result.latency, 99.9));
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace thermal_printer_flutter
+
+int main(int argc, char** argv) {
+  return thermal_printer_flutter::RunLoadGenerator(argc, argv);
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "core/band_cache.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+TEST(BandCache, CopiesStoredBands) {
+  BandCache cache;
+  const std::vector<uint8_t> band = {1, 2, 3, 4};
+  std::vector<uint8_t> rows(4);
+  EXPECT_FALSE(cache.Lookup(7, rows.data(), rows.size()));
+  cache.Insert(7, band.data(), band.size());
+  ASSERT_TRUE(cache.Lookup(7, rows.data(), rows.size()));
+  EXPECT_EQ(rows, band);
+  // A band of another size under the same key is not a match.
+  std::vector<uint8_t> longer(8);
+  EXPECT_FALSE(cache.Lookup(7, longer.data(), longer.size()));
+}
+
+TEST(BandCache, EvictsTheLeastRecentlyUsedBeyondItsCapacity) {
+  BandCache cache(8);
+  const std::vector<uint8_t> band(4, 0xAA);
+  std::vector<uint8_t> rows(4);
+  cache.Insert(1, band.data(), band.size());
+  cache.Insert(2, band.data(), band.size());
+  ASSERT_TRUE(cache.Lookup(1, rows.data(), rows.size()));
+  cache.Insert(3, band.data(), band.size());  // Evicts 2.
+  EXPECT_TRUE(cache.Lookup(1, rows.data(), rows.size()));
+  EXPECT_FALSE(cache.Lookup(2, rows.data(), rows.size()));
+  EXPECT_TRUE(cache.Lookup(3, rows.data(), rows.size()));
+
+  // Bands larger than the whole cache are not kept.
+  const std::vector<uint8_t> huge(16);
+  cache.Insert(4, huge.data(), huge.size());
+  EXPECT_TRUE(cache.Lookup(1, rows.data(), rows.size()));
+}
+
+TEST(BandCache, AccumulatesJobStats) {
+  BandCache cache;
+  BandStats job;
+  job.bands = 10;
+  job.reused = 4;
+  cache.RecordJob(job);
+  job.bands = 6;
+  job.reused = 6;
+  cache.RecordJob(job);
+  EXPECT_EQ(cache.stats().bands, 16u);
+  EXPECT_EQ(cache.stats().reused, 10u);
+  EXPECT_EQ(cache.stats().last_job.bands, 6);
+  EXPECT_EQ(cache.stats().last_job.reused, 6);
+}
+
+TEST(BandCache, HashDependsOnEveryByteAndTheSeed) {
+  std::vector<uint8_t> data(37, 0x5A);
+  const uint64_t base = HashBytes(data.data(), data.size(), 0);
+  EXPECT_EQ(HashBytes(data.data(), data.size(), 0), base);
+  EXPECT_NE(HashBytes(data.data(), data.size(), 1), base);
+  EXPECT_NE(HashBytes(data.data(), data.size() - 1, 0), base);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] ^= 1;
+    EXPECT_NE(HashBytes(data.data(), data.size(), 0), base) << i;
+    data[i] ^= 1;
+  }
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "core/bitmap_transform.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+bool Dot(const std::vector<uint8_t>& bitmap, int width, int x, int y) {
+  return (bitmap[y * PackedStride(width) + x / 8] >> (7 - x % 8)) & 1;
+}
+
+void SetDot(std::vector<uint8_t>* bitmap, int width, int x, int y) {
+  (*bitmap)[y * PackedStride(width) + x / 8] |=
+      static_cast<uint8_t>(0x80 >> (x % 8));
+}
+
+// Pseudo-random dots with white padding.
+std::vector<uint8_t> Pattern(int width, int height) {
+  std::vector<uint8_t> bitmap(PackedStride(width) * height, 0);
+  uint32_t state = 12345;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      state = state * 1103515245u + 12345u;
+      if (state & 0x10000) {
+        SetDot(&bitmap, width, x, y);
+      }
+    }
+  }
+  return bitmap;
+}
+
+// Dot by dot, straight from the definition of each transform.
+std::vector<uint8_t> Reference(const std::vector<uint8_t>& src, int width,
+                               int height, Rotation rotation, bool mirror) {
+  int out_width;
+  int out_height;
+  RotatedSize(width, height, rotation, &out_width, &out_height);
+  std::vector<uint8_t> out(PackedStride(out_width) * out_height, 0);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      if (!Dot(src, width, x, y)) {
+        continue;
+      }
+      int ox = x;
+      int oy = y;
+      switch (rotation) {
+        case Rotation::k0:
+          break;
+        case Rotation::k90:
+          ox = height - 1 - y;
+          oy = x;
+          break;
+        case Rotation::k180:
+          ox = width - 1 - x;
+          oy = height - 1 - y;
+          break;
+        case Rotation::k270:
+          ox = y;
+          oy = width - 1 - x;
+          break;
+      }
+      if (mirror) {
+        ox = out_width - 1 - ox;
+      }
+      SetDot(&out, out_width, ox, oy);
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(BitmapTransform, MirrorsRowsWithPadding) {
+  std::vector<uint8_t> row = {0xC0, 0x20};  // Dots 0, 1 and 10 of 11.
+  MirrorRow(row.data(), 11);
+  EXPECT_EQ(row, std::vector<uint8_t>({0x80, 0x60}));  // Dots 0, 9 and 10.
+}
+
+TEST(BitmapTransform, MatchesReferenceForEveryOrientation) {
+  const int sizes[][2] = {{8, 8}, {13, 21}, {40, 17}, {100, 3}, {576, 130}};
+  const Rotation rotations[] = {Rotation::k0, Rotation::k90, Rotation::k180,
+                                Rotation::k270};
+  for (const auto& size : sizes) {
+    std::vector<uint8_t> src = Pattern(size[0], size[1]);
+    for (Rotation rotation : rotations) {
+      for (bool mirror : {false, true}) {
+        int out_width;
+        int out_height;
+        RotatedSize(size[0], size[1], rotation, &out_width, &out_height);
+        std::vector<uint8_t> out(PackedStride(out_width) * out_height, 0xAA);
+        TransformBitmap(src.data(), size[0], size[1], rotation, mirror, 0,
+                        out_height, out.data());
+        EXPECT_EQ(out, Reference(src, size[0], size[1], rotation, mirror))
+            << size[0] << "x" << size[1] << " rotation "
+            << static_cast<int>(rotation) << " mirror " << mirror;
+      }
+    }
+  }
+}
+
+TEST(BitmapTransform, WritesOnlyTheRequestedRows) {
+  const int width = 50;
+  const int height = 30;
+  std::vector<uint8_t> src = Pattern(width, height);
+  for (bool mirror : {false, true}) {
+    std::vector<uint8_t> whole =
+        Reference(src, width, height, Rotation::k270, mirror);
+    const size_t stride = PackedStride(height);
+    // Rows 7 to 26 of the 50, which start and end mid-byte in the source.
+    std::vector<uint8_t> part(stride * 20, 0);
+    TransformBitmap(src.data(), width, height, Rotation::k270, mirror, 7, 20,
+                    part.data());
+    EXPECT_EQ(part, std::vector<uint8_t>(whole.begin() + 7 * stride,
+                                         whole.begin() + 27 * stride));
+  }
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "core/buffer_pool.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+TEST(BufferPool, ReusesReleasedBuffersOfTheSameClass) {
+  BufferPool pool;
+  const std::vector<uint8_t> bytes(600, 7);
+  std::vector<uint8_t> buffer = pool.Acquire(bytes.data(), 300);
+  EXPECT_EQ(buffer, std::vector<uint8_t>(300, 7));
+  EXPECT_EQ(buffer.capacity(), 512u);
+  const uint8_t* storage = buffer.data();
+  pool.Release(std::move(buffer));
+  EXPECT_EQ(pool.stats().cached_bytes, 512u);
+
+  // Too large for it.
+  std::vector<uint8_t> larger = pool.Acquire(bytes.data(), 600);
+  EXPECT_EQ(pool.stats().allocations, 2u);
+  std::vector<uint8_t> smaller = pool.Acquire(bytes.data(), 260);
+  EXPECT_EQ(smaller.data(), storage);
+  EXPECT_EQ(smaller.size(), 260u);
+  EXPECT_EQ(pool.stats().reuses, 1u);
+  EXPECT_EQ(pool.stats().cached_bytes, 0u);
+}
+
+TEST(BufferPool, KeepsABoundedNumberOfBuffers) {
+  BufferPool pool;
+  const uint8_t byte = 1;
+  for (size_t i = 0; i < BufferPool::kBuffersPerClass + 2; i++) {
+    pool.Release(pool.Acquire(&byte, 1));
+    pool.Release(std::vector<uint8_t>(BufferPool::kMinClass));
+  }
+  EXPECT_EQ(pool.stats().cached_bytes,
+            BufferPool::kBuffersPerClass * BufferPool::kMinClass);
+  // Past the largest class, and under the smallest.
+  pool.Release(std::vector<uint8_t>(BufferPool::kMinClass
+                                    << BufferPool::kClasses));
+  pool.Release(std::vector<uint8_t>(10));
+  EXPECT_EQ(pool.stats().cached_bytes,
+            BufferPool::kBuffersPerClass * BufferPool::kMinClass);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
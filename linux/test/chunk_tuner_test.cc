@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "core/chunk_tuner.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+constexpr std::chrono::microseconds kFast{100};
+
+}  // namespace
+
+TEST(ChunkTuner, GrowsAdditivelyAndHalvesOnStalls) {
+  ChunkTuner tuner;
+  EXPECT_EQ(tuner.chunk_size(), ChunkTuner::kInitialChunk);
+  tuner.OnWritten(tuner.chunk_size(), kFast);
+  EXPECT_EQ(tuner.chunk_size(),
+            ChunkTuner::kInitialChunk + ChunkTuner::kIncrease);
+  // A short tail of a job is not a full chunk.
+  tuner.OnWritten(10, kFast);
+  EXPECT_EQ(tuner.chunk_size(),
+            ChunkTuner::kInitialChunk + ChunkTuner::kIncrease);
+  tuner.OnBlocked();
+  EXPECT_EQ(tuner.chunk_size(),
+            (ChunkTuner::kInitialChunk + ChunkTuner::kIncrease) / 2);
+  tuner.OnWritten(tuner.chunk_size(), ChunkTuner::kSlowWrite * 2);
+  EXPECT_EQ(tuner.chunk_size(),
+            (ChunkTuner::kInitialChunk + ChunkTuner::kIncrease) / 4);
+  EXPECT_EQ(tuner.pacing().count(), 0);
+}
+
+TEST(ChunkTuner, PacesOnceChunksAreAsSmallAsTheyGo) {
+  ChunkTuner tuner;
+  while (tuner.chunk_size() > ChunkTuner::kMinChunk) {
+    tuner.OnBlocked();
+  }
+  tuner.OnBlocked();
+  EXPECT_EQ(tuner.pacing(), ChunkTuner::kPacingStep);
+  tuner.OnBlocked();
+  EXPECT_EQ(tuner.pacing(), ChunkTuner::kPacingStep * 2);
+  for (int i = 0; i < 20; i++) {
+    tuner.OnBlocked();
+  }
+  EXPECT_EQ(tuner.pacing(), ChunkTuner::kMaxPacing);
+  // Chunks taken promptly win the pacing back a step at a time.
+  tuner.OnWritten(tuner.chunk_size(), kFast);
+  EXPECT_EQ(tuner.pacing(), ChunkTuner::kMaxPacing - ChunkTuner::kPacingStep);
+  EXPECT_EQ(tuner.chunk_size(),
+            ChunkTuner::kMinChunk + ChunkTuner::kIncrease);
+}
+
+TEST(ChunkTuner, ConvergesAfterAFewStalls) {
+  ChunkTuner tuner;
+  EXPECT_FALSE(tuner.converged());
+  for (int i = 0; i < ChunkTuner::kSettledStalls; i++) {
+    tuner.OnWritten(tuner.chunk_size(), kFast);
+    tuner.OnBlocked();
+  }
+  EXPECT_TRUE(tuner.converged());
+
+  ChunkTuner seeded;
+  seeded.Seed(1 << 20, std::chrono::microseconds(-5));
+  EXPECT_TRUE(seeded.converged());
+  EXPECT_EQ(seeded.chunk_size(), ChunkTuner::kMaxChunk);
+  EXPECT_EQ(seeded.pacing().count(), 0);
+}
+
+TEST(ChunkTuner, IgnoresStallsOfAnOfflinePrinter) {
+  ChunkTuner tuner;
+  tuner.OnStall(true);
+  EXPECT_EQ(tuner.chunk_size(), ChunkTuner::kInitialChunk);
+  tuner.OnStall(false);
+  EXPECT_EQ(tuner.chunk_size(), ChunkTuner::kInitialChunk / 2);
+  EXPECT_TRUE(IsOfflineStatus(0x1A));
+  EXPECT_FALSE(IsOfflineStatus(0x12));
+}
+
+TEST(ChunkTuner, KeepsAPinnedSize) {
+  ChunkTuner tuner;
+  tuner.Pin(2048);
+  tuner.OnBlocked();
+  tuner.OnWritten(2048, kFast);
+  tuner.Seed(512, std::chrono::microseconds(0));
+  EXPECT_EQ(tuner.chunk_size(), 2048u);
+  EXPECT_FALSE(tuner.converged());
+  tuner.Pin(0);
+  tuner.OnBlocked();
+  EXPECT_EQ(tuner.chunk_size(), 1024u);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
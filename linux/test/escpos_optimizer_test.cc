@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "core/escpos_optimizer.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+Bytes Optimize(const Bytes& input, EscPosStats* stats = nullptr,
+               bool* complete = nullptr) {
+  Bytes output;
+  bool parsed = OptimizeEscPos(input.data(), input.size(), &output, stats);
+  if (complete != nullptr) {
+    *complete = parsed;
+  }
+  return output;
+}
+
+Bytes Join(std::initializer_list<Bytes> parts) {
+  Bytes joined;
+  for (const Bytes& part : parts) {
+    joined.insert(joined.end(), part.begin(), part.end());
+  }
+  return joined;
+}
+
+const Bytes kCenter = {0x1B, 'a', 1};
+const Bytes kLeft = {0x1B, 'a', 0};
+const Bytes kBold = {0x1B, 'E', 1};
+const Bytes kPlain = {0x1B, '!', 0};
+const Bytes kInit = {0x1B, '@'};
+const Bytes kLf = {0x0A};
+
+}  // namespace
+
+TEST(EscPosOptimizer, DropsModeChangesThatRepeatTheCurrentSetting) {
+  EscPosStats stats;
+  bool complete = false;
+  Bytes output = Optimize(
+      Join({kCenter, {'A'}, kLf, kCenter, {'B'}, kCenter, kLf, kLeft, {'C'}}),
+      &stats, &complete);
+  EXPECT_TRUE(complete);
+  // The text either side of a dropped command becomes one run.
+  EXPECT_EQ(output, Join({kCenter, {'A'}, kLf, {'B'}, kLf, kLeft, {'C'}}));
+  EXPECT_EQ(stats.commands_removed, 2);
+  EXPECT_EQ(stats.bytes_in, 17u);
+  EXPECT_EQ(stats.bytes_out, 11u);
+  EXPECT_EQ(stats.parsed, 17u);
+}
+
+TEST(EscPosOptimizer, KeepsChangesWhoseEffectIsNotKnown) {
+  // ESC @ restores configurable defaults, so the next setting is sent.
+  EXPECT_EQ(Optimize(Join({kCenter, kInit, kCenter})),
+            Join({kCenter, kInit, kCenter}));
+  // ESC ! rewrites the emphasis bit and ESC E changes ESC !'s result.
+  EXPECT_EQ(Optimize(Join({kBold, kPlain, kBold, kPlain})),
+            Join({kBold, kPlain, kBold, kPlain}));
+  // Line spacing: ESC 2 is the default, apart from any ESC 3 n.
+  const Bytes spacing = {0x1B, '3', 30};
+  const Bytes default_spacing = {0x1B, '2'};
+  EXPECT_EQ(Optimize(Join({default_spacing, spacing, spacing,
+                           default_spacing, default_spacing})),
+            Join({default_spacing, spacing, default_spacing}));
+}
+
+TEST(EscPosOptimizer, MergesConsecutiveFeeds) {
+  EXPECT_EQ(Optimize(Join({{'A'}, kLf, kLf, kLf, kLf, kLf})),
+            Bytes({'A', 0x1B, 'd', 5}));
+  EXPECT_EQ(Optimize(Join({{'A'}, kLf, kLf})), Bytes({'A', 0x0A, 0x0A}));
+  // Line feeds merge across dropped commands but not kept ones.
+  EXPECT_EQ(Optimize(Join({kCenter, kLf, kLf, kCenter, {0x1B, 'd', 3}})),
+            Join({kCenter, {0x1B, 'd', 5}}));
+  EXPECT_EQ(Optimize(Join({kLf, kLf, kCenter, kLf, kLf})),
+            Join({kLf, kLf, kCenter, kLf, kLf}));
+  // Dot feeds are split at the parameter's limit.
+  EXPECT_EQ(Optimize({0x1B, 'J', 200, 0x1B, 'J', 100}),
+            Bytes({0x1B, 'J', 255, 0x1B, 'J', 45}));
+  EXPECT_EQ(Optimize({0x0A, 0x1B, 'J', 10, 0x0A}),
+            Bytes({0x0A, 0x1B, 'J', 10, 0x0A}));
+}
+
+TEST(EscPosOptimizer, SkipsOverCommandData) {
+  // Image and barcode data that looks like commands is left alone.
+  const Bytes raster = Join({{0x1D, 'v', '0', 0, 3, 0, 1, 0}, kCenter});
+  const Bytes qr = Join({{0x1D, '(', 'k', 6, 0, 49, 80, 48}, kCenter});
+  const Bytes barcode = {0x1D, 'k', 4, 'A', 0x1B, 'a', 1, 0};
+  Bytes input = Join({kCenter, raster, kCenter, qr, kCenter, barcode, kCenter});
+  EXPECT_EQ(Optimize(input), Join({kCenter, raster, qr, barcode}));
+}
+
+TEST(EscPosOptimizer, PassesThroughFromTheFirstCommandItCannotParse) {
+  EscPosStats stats;
+  bool complete = true;
+  // ESC Z is not part of the command set.
+  const Bytes unknown = {0x1B, 'Z', 1, 2};
+  Bytes input = Join({kCenter, kCenter, unknown, kCenter, kCenter});
+  EXPECT_EQ(Optimize(input, &stats, &complete),
+            Join({kCenter, unknown, kCenter, kCenter}));
+  EXPECT_FALSE(complete);
+  EXPECT_EQ(stats.parsed, 6u);
+
+  // A raster command that claims more data than the stream holds.
+  const Bytes truncated = {0x1D, 'v', '0', 0, 2, 0, 2, 0, 0xFF, 0xFF};
+  input = Join({kLf, kLf, kLf, kLf, truncated});
+  EXPECT_EQ(Optimize(input, &stats, &complete),
+            Join({{0x1B, 'd', 4}, truncated}));
+  EXPECT_FALSE(complete);
+  EXPECT_EQ(stats.parsed, 4u);
+}
+
+TEST(EscPosOptimizer, FindsTheCommandBoundaryBeforeAnOffset) {
+  const Bytes raster = {0x1D, 'v', '0', 0, 1, 0, 2, 0, 0xFF, 0xFF};
+  const Bytes input = Join({{'A', 'B'}, kBold, raster, {'C'}});
+  // Text can be resent from any byte; commands only from their start.
+  EXPECT_EQ(CommandBoundary(input.data(), input.size(), 1), 1u);
+  EXPECT_EQ(CommandBoundary(input.data(), input.size(), 3), 2u);
+  EXPECT_EQ(CommandBoundary(input.data(), input.size(), 5), 5u);
+  EXPECT_EQ(CommandBoundary(input.data(), input.size(), 14), 5u);
+  EXPECT_EQ(CommandBoundary(input.data(), input.size(), 16), 16u);
+  EXPECT_EQ(CommandBoundary(input.data(), input.size(), 99), 16u);
+
+  // Nothing past a command that cannot be parsed is trusted.
+  const Bytes unknown = Join({kCenter, {0x1B, 'Z', 1, 2}, {'D'}});
+  EXPECT_EQ(CommandBoundary(unknown.data(), unknown.size(), 7), 3u);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
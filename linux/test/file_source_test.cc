@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "core/file_source.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+class FileSourceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char path_template[] = "/tmp/tpf_file_source_XXXXXX";
+    int fd = mkstemp(path_template);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path_ = path_template;
+  }
+
+  void TearDown() override { unlink(path_.c_str()); }
+
+  void WriteFile(const std::vector<uint8_t>& contents) {
+    FILE* file = fopen(path_.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fwrite(contents.data(), 1, contents.size(), file);
+    fclose(file);
+  }
+
+  std::vector<uint8_t> Drain(JobSource* source, int* pieces) {
+    std::vector<uint8_t> out;
+    const uint8_t* data;
+    size_t length;
+    *pieces = 0;
+    while (source->Next(&data, &length)) {
+      out.insert(out.end(), data, data + length);
+      (*pieces)++;
+    }
+    EXPECT_FALSE(source->failed());
+    return out;
+  }
+
+  std::string path_;
+};
+
+}  // namespace
+
+TEST_F(FileSourceTest, SpecRoundTrips) {
+  FileJobSpec spec;
+  spec.path = "/var/spool/report.bin";
+  spec.format = FileFormat::kBitmap;
+  spec.bitmap_width = 576;
+  spec.raster.band_height = 64;
+  spec.raster.threshold = 90;
+  spec.raster.dither = DitherMode::kThreshold;
+  spec.raster.rotation = Rotation::k270;
+  spec.raster.mirror = true;
+  spec.device = 0x803;
+  spec.inode = 1234567;
+  std::vector<uint8_t> bytes = SerializeFileJobSpec(spec);
+  FileJobSpec parsed;
+  ASSERT_TRUE(ParseFileJobSpec(bytes.data(), bytes.size(), &parsed));
+  EXPECT_EQ(parsed.path, spec.path);
+  EXPECT_EQ(parsed.format, FileFormat::kBitmap);
+  EXPECT_EQ(parsed.bitmap_width, 576);
+  EXPECT_EQ(parsed.raster.band_height, 64);
+  EXPECT_EQ(parsed.raster.threshold, 90);
+  EXPECT_EQ(parsed.raster.dither, DitherMode::kThreshold);
+  EXPECT_EQ(parsed.raster.rotation, Rotation::k270);
+  EXPECT_TRUE(parsed.raster.mirror);
+  EXPECT_EQ(parsed.device, 0x803u);
+  EXPECT_EQ(parsed.inode, 1234567u);
+  EXPECT_FALSE(ParseFileJobSpec(bytes.data(), 4, &parsed));
+}
+
+TEST_F(FileSourceTest, OpensOnlyThePinnedFile) {
+  WriteFile({0x1B, '@'});
+  struct stat info;
+  ASSERT_EQ(stat(path_.c_str(), &info), 0);
+  FileJobSpec spec;
+  spec.path = path_;
+  spec.device = info.st_dev;
+  spec.inode = info.st_ino;
+  EXPECT_TRUE(OpenFileSource(spec));
+  // What a path swapped for another file after submission looks like.
+  spec.inode = info.st_ino + 1;
+  EXPECT_FALSE(OpenFileSource(spec));
+}
+
+TEST_F(FileSourceTest, StreamsEscPosFilesInChunks) {
+  std::vector<uint8_t> contents(kFileChunkSize * 2 + 100);
+  for (size_t i = 0; i < contents.size(); i++) {
+    contents[i] = static_cast<uint8_t>(i * 7);
+  }
+  WriteFile(contents);
+  FileJobSpec spec;
+  spec.path = path_;
+  std::unique_ptr<JobSource> source = OpenFileSource(spec);
+  ASSERT_TRUE(source);
+  uint64_t total;
+  ASSERT_TRUE(source->TotalLength(&total));
+  EXPECT_EQ(total, contents.size());
+  int pieces;
+  EXPECT_EQ(Drain(source.get(), &pieces), contents);
+  EXPECT_EQ(pieces, 3);
+}
+
+TEST_F(FileSourceTest, FramesBitmapRowsAsRasterBands) {
+  // Five 16-dot rows.
+  std::vector<uint8_t> rows = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  WriteFile(rows);
+  FileJobSpec spec;
+  spec.path = path_;
+  spec.format = FileFormat::kBitmap;
+  spec.bitmap_width = 16;
+  spec.raster.band_height = 2;
+  std::unique_ptr<JobSource> source = OpenFileSource(spec);
+  ASSERT_TRUE(source);
+  uint64_t total;
+  ASSERT_TRUE(source->TotalLength(&total));
+  int pieces;
+  std::vector<uint8_t> out = Drain(source.get(), &pieces);
+  EXPECT_EQ(total, out.size());
+  EXPECT_EQ(pieces, 6);
+  EXPECT_EQ(out, std::vector<uint8_t>({
+                     0x1D, 0x76, 0x30, 0, 2, 0, 2, 0, 1, 2, 3, 4,
+                     0x1D, 0x76, 0x30, 0, 2, 0, 2, 0, 5, 6, 7, 8,
+                     0x1D, 0x76, 0x30, 0, 2, 0, 1, 0, 9, 10,
+                 }));
+}
+
+TEST_F(FileSourceTest, RejectsMissingFilesAndImages) {
+  FileJobSpec spec;
+  spec.path = path_ + ".missing";
+  EXPECT_FALSE(OpenFileSource(spec));
+  spec.path = path_;
+  spec.format = FileFormat::kImage;
+  EXPECT_FALSE(OpenFileSource(spec));
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,193 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/flight_recorder.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+std::string TracePath() {
+  return "/tmp/tpf_trace_test_" + std::to_string(getpid()) + ".json";
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// The trace is written in the background.
+bool WaitForFile(const std::string& path) {
+  for (int i = 0; i < 500; i++) {
+    if (access(path.c_str(), F_OK) == 0) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(FlightRecorder, MergesThreadsInTimeOrder) {
+  FlightRecorder recorder;
+  uint16_t printer = recorder.PrinterIndex("lp0");
+  EXPECT_EQ(printer, 1);
+  EXPECT_EQ(recorder.PrinterIndex("lp0"), 1);
+  EXPECT_EQ(recorder.PrinterIndex("lp1"), 2);
+
+  recorder.Record(TraceEventType::kEnqueue, 0, printer, 1, 10);
+  std::thread([&] {
+    recorder.Record(TraceEventType::kDequeue, 0, printer, 1, 10);
+  }).join();
+  recorder.Record(TraceEventType::kFinish, 0, printer, 1, 1);
+
+  std::vector<TraceEvent> events;
+  recorder.Snapshot(&events);
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].type, TraceEventType::kEnqueue);
+  EXPECT_EQ(events[1].type, TraceEventType::kDequeue);
+  EXPECT_EQ(events[2].type, TraceEventType::kFinish);
+  EXPECT_EQ(events[0].thread, events[2].thread);
+  EXPECT_NE(events[0].thread, events[1].thread);
+  EXPECT_LE(events[0].timestamp_ns, events[1].timestamp_ns);
+  EXPECT_LE(events[1].timestamp_ns, events[2].timestamp_ns);
+}
+
+TEST(FlightRecorder, KeepsTheLastEventsOfEachThread) {
+  FlightRecorder recorder;
+  for (uint64_t job = 1; job <= FlightRecorder::kEventsPerThread + 10;
+       job++) {
+    recorder.Record(TraceEventType::kEnqueue, 0, 0, job, 0);
+  }
+  std::vector<TraceEvent> events;
+  recorder.Snapshot(&events);
+  ASSERT_EQ(events.size(), FlightRecorder::kEventsPerThread);
+  EXPECT_EQ(events.front().job, 11u);
+  EXPECT_EQ(events.back().job, FlightRecorder::kEventsPerThread + 10);
+}
+
+TEST(FlightRecorder, SnapshotsWhileThreadsRecord) {
+  FlightRecorder recorder;
+  std::atomic<bool> done(false);
+  std::thread writer([&] {
+    for (uint64_t job = 1; job <= 200000; job++) {
+      recorder.Record(TraceEventType::kEnqueue, 0, 0, job,
+                      static_cast<int64_t>(job));
+    }
+    done = true;
+  });
+  std::vector<TraceEvent> events;
+  int snapshots = 0;
+  while (!done || snapshots == 0) {
+    recorder.Snapshot(&events);
+    snapshots++;
+    // Nothing torn: every event is whole, and they come in the order they
+    // were recorded.
+    for (size_t i = 0; i < events.size(); i++) {
+      ASSERT_EQ(events[i].value, static_cast<int64_t>(events[i].job));
+      if (i > 0) {
+        ASSERT_GT(events[i].job, events[i - 1].job);
+      }
+    }
+    ASSERT_LE(events.size(), FlightRecorder::kEventsPerThread);
+  }
+  writer.join();
+}
+
+TEST(FlightRecorder, WritesAChromeTrace) {
+  FlightRecorder recorder;
+  uint16_t printer = recorder.PrinterIndex("tcp://\"front\"");
+  recorder.Record(TraceEventType::kEnqueue, 0, printer, 7, 3);
+  recorder.Record(TraceEventType::kDequeue, 0, printer, 7, 3);
+  recorder.BeginStage(TraceStage::kWrite, printer, 7, 3);
+  recorder.EndStage(TraceStage::kWrite, printer, 7, 3);
+  recorder.Record(TraceEventType::kStatusReply, 4, printer, 0, 0x12);
+  recorder.Record(TraceEventType::kFinish, 0, printer, 7, 1);
+  // Its beginning was not recorded, so it is left out.
+  recorder.EndStage(TraceStage::kConnect, printer, 0, 1);
+
+  std::string path = TracePath();
+  ASSERT_TRUE(recorder.WriteChromeTrace(path));
+  std::string trace = ReadFile(path);
+  unlink(path.c_str());
+  EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0u);
+  EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+  EXPECT_NE(trace.find("\"name\":\"queued\",\"cat\":\"job\",\"ph\":\"b\","
+                       "\"id\":7"),
+            std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"printing\",\"cat\":\"job\",\"ph\":\"e\","
+                       "\"id\":7"),
+            std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"write\",\"cat\":\"stage\",\"ph\":\"B\""),
+            std::string::npos);
+  EXPECT_NE(trace.find("\"args\":{\"written\":3}"), std::string::npos);
+  EXPECT_NE(trace.find("\"request\":4,\"reply\":18"), std::string::npos);
+  EXPECT_NE(trace.find("\"printer\":\"tcp://\\\"front\\\"\""),
+            std::string::npos);
+  EXPECT_EQ(trace.find("\"ok\":"), std::string::npos);
+  EXPECT_FALSE(recorder.WriteChromeTrace("/nonexistent/trace.json"));
+}
+
+TEST(FlightRecorder, DumpsWhenAJobCrossesTheThreshold) {
+  FlightRecorder recorder;
+  std::string path = TracePath();
+  unlink(path.c_str());
+  recorder.Record(TraceEventType::kEnqueue, 0, 0, 1, 0);
+  EXPECT_FALSE(recorder.NoteLatency(std::chrono::seconds(10)));
+
+  recorder.SetAutoDump(std::chrono::milliseconds(500), path);
+  EXPECT_FALSE(recorder.NoteLatency(std::chrono::milliseconds(400)));
+  EXPECT_NE(access(path.c_str(), F_OK), 0);
+  EXPECT_TRUE(recorder.NoteLatency(std::chrono::seconds(8)));
+  EXPECT_TRUE(WaitForFile(path));
+  // Not again until kAutoDumpInterval has passed.
+  EXPECT_FALSE(recorder.NoteLatency(std::chrono::seconds(8)));
+  unlink(path.c_str());
+
+  recorder.SetAutoDump(std::chrono::milliseconds(0), path);
+  EXPECT_FALSE(recorder.NoteLatency(std::chrono::seconds(8)));
+}
+
+TEST(FlightRecorder, DumpsThroughADescriptor) {
+  FlightRecorder recorder;
+  std::string path = TracePath();
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  ASSERT_GE(fd, 0);
+  // What is there is overwritten, not appended to.
+  std::string stale(100000, 'x');
+  ASSERT_EQ(write(fd, stale.data(), stale.size()),
+            static_cast<ssize_t>(stale.size()));
+  recorder.Record(TraceEventType::kEnqueue, 0, 0, 1, 0);
+  recorder.SetAutoDump(std::chrono::milliseconds(500), fd);
+  // The recorder keeps a copy of its own.
+  close(fd);
+  EXPECT_TRUE(recorder.NoteLatency(std::chrono::seconds(8)));
+  std::string trace;
+  for (int i = 0; i < 500; i++) {
+    trace = ReadFile(path);
+    if (trace.size() > 4 && trace.substr(trace.size() - 4) == "\n]}\n") {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  unlink(path.c_str());
+  EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0u);
+  EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "image_decoder.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+// 16x2 8-bit grayscale PNG: the left half of each row black, the right half
+// white.
+const uint8_t kHalfBlackPng[] = {
+    0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x02,
+    0x08, 0x00, 0x00, 0x00, 0x00, 0x74, 0x86, 0x03, 0x2D, 0x00, 0x00, 0x00,
+    0x11, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9C, 0x63, 0x60, 0x80, 0x82, 0xFF,
+    0x50, 0xC0, 0x80, 0x2E, 0x00, 0x00, 0xCF, 0x52, 0x0F, 0xF1, 0xC6, 0x85,
+    0x20, 0x3D, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42,
+    0x60, 0x82,
+};
+
+}  // namespace
+
+TEST(ImageDecoder, DecodesPngToRasterBands) {
+  RasterOptions options;
+  options.width = 0;
+  options.dither = DitherMode::kThreshold;
+  std::vector<uint8_t> raster;
+  ASSERT_TRUE(decode_image_to_raster(kHalfBlackPng, sizeof(kHalfBlackPng),
+                                     options, 576, nullptr, &raster));
+  EXPECT_EQ(raster, std::vector<uint8_t>({0x1D, 0x76, 0x30, 0x00, 2, 0, 2, 0,
+                                          0xFF, 0x00, 0xFF, 0x00}));
+}
+
+TEST(ImageDecoder, RejectsGarbage) {
+  const uint8_t garbage[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  std::vector<uint8_t> raster;
+  EXPECT_FALSE(decode_image_to_raster(garbage, sizeof(garbage),
+                                      RasterOptions(), 576, nullptr,
+                                      &raster));
+}
+
+TEST(ImageDecoder, DetectsMultipassImages) {
+  std::vector<uint8_t> png(kHalfBlackPng,
+                           kHalfBlackPng + sizeof(kHalfBlackPng));
+  EXPECT_FALSE(is_multipass_image(png.data(), png.size()));
+  png[28] = 1;  // Adam7.
+  EXPECT_TRUE(is_multipass_image(png.data(), png.size()));
+
+  // SOI, an APP0 segment, then a baseline or progressive frame header.
+  std::vector<uint8_t> jpeg = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x04,
+                               0x00, 0x00, 0xFF, 0xC0, 0x00, 0x02};
+  EXPECT_FALSE(is_multipass_image(jpeg.data(), jpeg.size()));
+  jpeg[9] = 0xC2;
+  EXPECT_TRUE(is_multipass_image(jpeg.data(), jpeg.size()));
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
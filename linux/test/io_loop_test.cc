@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/io_loop.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+bool WaitFor(const std::function<bool()>& condition) {
+  for (int i = 0; i < 500; i++) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(PollIoLoop, RunsPostedCallbacksInDelayOrder) {
+  PollIoLoop loop;
+  std::mutex mutex;
+  std::vector<int> order;
+  auto record = [&](int value) {
+    return [&, value] {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(value);
+    };
+  };
+  loop.Post(std::chrono::milliseconds(60), record(3));
+  loop.Post(std::chrono::milliseconds(0), record(1));
+  loop.Post(std::chrono::milliseconds(20), record(2));
+  ASSERT_TRUE(WaitFor([&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return order.size() == 3;
+  }));
+  EXPECT_EQ(order, std::vector<int>({1, 2, 3}));
+}
+
+TEST(PollIoLoop, ReportsReadinessAndTimeouts) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  PollIoLoop loop;
+  std::atomic<int> timed_out(0);
+  std::atomic<int> ready(0);
+  loop.WaitForFd(fds[0], POLLIN, 20, [&](bool is_ready) {
+    (is_ready ? ready : timed_out)++;
+  });
+  ASSERT_TRUE(WaitFor([&] { return timed_out == 1; }));
+
+  // Registered from a callback, as a stream waiting for more room does.
+  loop.Post(std::chrono::milliseconds(0), [&] {
+    loop.WaitForFd(fds[0], POLLIN, 5000, [&](bool is_ready) {
+      (is_ready ? ready : timed_out)++;
+    });
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(ready, 0);
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  ASSERT_TRUE(WaitFor([&] { return ready == 1; }));
+  EXPECT_EQ(timed_out, 1);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(PollIoLoop, DropsPendingCallbacksWhenDestroyed) {
+  std::atomic<int> calls(0);
+  {
+    PollIoLoop loop;
+    loop.Post(std::chrono::milliseconds(60000), [&] { calls++; });
+  }
+  EXPECT_EQ(calls, 0);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "core/job_batch.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+std::vector<BatchJob> TwoJobs(const std::vector<uint8_t>& first,
+                              const std::vector<uint8_t>& second) {
+  std::vector<BatchJob> jobs(2);
+  jobs[0].printer = 1;
+  jobs[0].data = first.data();
+  jobs[0].length = first.size();
+  jobs[0].copies = 3;
+  jobs[0].key = "order-17";
+  jobs[0].barrier = true;
+  jobs[1].data = second.data();
+  jobs[1].length = second.size();
+  jobs[1].optimize = true;
+  return jobs;
+}
+
+}  // namespace
+
+TEST(JobBatch, RoundTrips) {
+  const std::vector<uint8_t> first = {0x1B, 0x40, 'A'};
+  const std::vector<uint8_t> second;
+  std::vector<uint8_t> envelope = EncodeJobBatch(TwoJobs(first, second));
+  std::vector<BatchJob> jobs;
+  ASSERT_TRUE(DecodeJobBatch(envelope.data(), envelope.size(), 2, &jobs));
+  ASSERT_EQ(jobs.size(), 2u);
+  EXPECT_EQ(jobs[0].printer, 1u);
+  EXPECT_EQ(std::vector<uint8_t>(jobs[0].data, jobs[0].data + jobs[0].length),
+            first);
+  EXPECT_EQ(jobs[0].copies, 3);
+  EXPECT_EQ(jobs[0].key, "order-17");
+  EXPECT_TRUE(jobs[0].barrier);
+  EXPECT_FALSE(jobs[0].optimize);
+  EXPECT_EQ(jobs[1].printer, 0u);
+  EXPECT_EQ(jobs[1].length, 0u);
+  EXPECT_EQ(jobs[1].copies, 1);
+  EXPECT_TRUE(jobs[1].key.empty());
+  EXPECT_FALSE(jobs[1].barrier);
+  EXPECT_TRUE(jobs[1].optimize);
+  // The payload is read in place.
+  EXPECT_GE(jobs[0].data, envelope.data());
+  EXPECT_LT(jobs[0].data, envelope.data() + envelope.size());
+}
+
+TEST(JobBatch, RejectsMalformedEnvelopes) {
+  const std::vector<uint8_t> first = {1, 2, 3};
+  const std::vector<uint8_t> second = {4};
+  std::vector<uint8_t> envelope = EncodeJobBatch(TwoJobs(first, second));
+  std::vector<BatchJob> jobs;
+  // Every truncation, and trailing bytes.
+  for (size_t length = 0; length < envelope.size(); length++) {
+    EXPECT_FALSE(DecodeJobBatch(envelope.data(), length, 2, &jobs)) << length;
+  }
+  std::vector<uint8_t> longer = envelope;
+  longer.push_back(0);
+  EXPECT_FALSE(DecodeJobBatch(longer.data(), longer.size(), 2, &jobs));
+  // A printer index past the printers named.
+  EXPECT_FALSE(DecodeJobBatch(envelope.data(), envelope.size(), 1, &jobs));
+  // No copies.
+  std::vector<BatchJob> none = TwoJobs(first, second);
+  none[1].copies = 0;
+  std::vector<uint8_t> zero = EncodeJobBatch(none);
+  EXPECT_FALSE(DecodeJobBatch(zero.data(), zero.size(), 2, &jobs));
+  // A job count no envelope could hold.
+  std::vector<uint8_t> counted = envelope;
+  counted[4] = 0xFF;
+  counted[5] = 0xFF;
+  EXPECT_FALSE(DecodeJobBatch(counted.data(), counted.size(), 2, &jobs));
+  EXPECT_TRUE(jobs.empty());
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
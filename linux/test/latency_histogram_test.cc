@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "core/latency_histogram.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+TEST(LatencyHistogram, BucketsByPowersOfTwo) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.PercentileMs(50), 0u);
+  histogram.Add(std::chrono::milliseconds(0));
+  histogram.Add(std::chrono::milliseconds(1));
+  histogram.Add(std::chrono::milliseconds(3));
+  histogram.Add(std::chrono::milliseconds(100));
+  EXPECT_EQ(histogram.counts[0], 1u);
+  EXPECT_EQ(histogram.counts[1], 1u);
+  EXPECT_EQ(histogram.counts[2], 1u);
+  EXPECT_EQ(histogram.counts[7], 1u);
+  EXPECT_EQ(histogram.samples, 4u);
+  EXPECT_EQ(histogram.total_ms, 104u);
+  EXPECT_EQ(histogram.max_ms, 100u);
+
+  histogram.Add(std::chrono::hours(1));
+  EXPECT_EQ(histogram.counts[LatencyHistogram::kBuckets - 1], 1u);
+}
+
+TEST(LatencyHistogram, ReportsBucketBoundsAsPercentiles) {
+  LatencyHistogram histogram;
+  for (int i = 0; i < 90; i++) {
+    histogram.Add(std::chrono::milliseconds(40));
+  }
+  for (int i = 0; i < 10; i++) {
+    histogram.Add(std::chrono::milliseconds(700));
+  }
+  EXPECT_EQ(histogram.PercentileMs(50), 64u);
+  EXPECT_EQ(histogram.PercentileMs(90), 64u);
+  // Capped at the longest latency rather than the bucket's 1024 ms.
+  EXPECT_EQ(histogram.PercentileMs(99), 700u);
+  EXPECT_EQ(histogram.PercentileMs(100), 700u);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
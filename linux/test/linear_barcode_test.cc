@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/linear_barcode.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+std::vector<uint8_t> Modules(const std::string& bits) {
+  std::vector<uint8_t> modules;
+  for (char c : bits) {
+    modules.push_back(c == '1' ? 1 : 0);
+  }
+  return modules;
+}
+
+}  // namespace
+
+TEST(LinearBarcode, AddsAndChecksEanCheckDigits) {
+  std::vector<uint8_t> computed;
+  std::vector<uint8_t> given;
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kEan13, "400638133393", &computed));
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kEan13, "4006381333931", &given));
+  EXPECT_EQ(computed, given);
+  EXPECT_EQ(computed.size(), 95u);
+  EXPECT_FALSE(EncodeBarcode(BarcodeType::kEan13, "4006381333932", &given));
+  EXPECT_FALSE(EncodeBarcode(BarcodeType::kEan13, "40063813339A", &given));
+
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kEan8, "9638507", &computed));
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kEan8, "96385074", &given));
+  EXPECT_EQ(computed, given);
+  EXPECT_EQ(computed.size(), 67u);
+}
+
+TEST(LinearBarcode, EncodesEan8Digits) {
+  std::vector<uint8_t> modules;
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kEan8, "96385074", &modules));
+  // Guard, 9 6 3 8 as L codes, centre guard, 5 0 7 4 as R codes, guard.
+  EXPECT_EQ(modules, Modules("101"
+                             "0001011"
+                             "0101111"
+                             "0111101"
+                             "0110111"
+                             "01010"
+                             "1001110"
+                             "1110010"
+                             "1000100"
+                             "1011100"
+                             "101"));
+}
+
+TEST(LinearBarcode, Code128SwitchesToCodeSetCForDigitRuns) {
+  std::vector<uint8_t> modules;
+  // Start B, "PJJ123C" one symbol per character, checksum, stop.
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kCode128, "PJJ123C", &modules));
+  EXPECT_EQ(modules.size(), 9u * 11 + 13);
+  EXPECT_EQ(std::vector<uint8_t>(modules.begin(), modules.begin() + 11),
+            Modules("11010010000"));  // Start B.
+  // Start C, four digit pairs, checksum, stop.
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kCode128, "12345678", &modules));
+  EXPECT_EQ(modules.size(), 6u * 11 + 13);
+  EXPECT_EQ(std::vector<uint8_t>(modules.begin(), modules.begin() + 11),
+            Modules("11010011100"));  // Start C.
+  EXPECT_EQ(std::vector<uint8_t>(modules.end() - 13, modules.end()),
+            Modules("1100011101011"));  // Stop.
+  // Start B, A, B, 1, Code C, 23 45 67, checksum, stop.
+  ASSERT_TRUE(EncodeBarcode(BarcodeType::kCode128, "AB1234567", &modules));
+  EXPECT_EQ(modules.size(), 9u * 11 + 13);
+
+  EXPECT_FALSE(EncodeBarcode(BarcodeType::kCode128, "", &modules));
+  EXPECT_FALSE(EncodeBarcode(BarcodeType::kCode128, "tab\there", &modules));
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
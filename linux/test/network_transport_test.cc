@@ -0,0 +1,275 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/file_source.h"
+#include "core/lpd_transport.h"
+#include "core/print_queue.h"
+#include "core/tcp_transport.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+// Listens on an ephemeral loopback port and hands each accepted connection
+// to |handler| on a background thread.
+class LoopbackServer {
+ public:
+  template <typename Handler>
+  explicit LoopbackServer(Handler handler) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+         sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+                &length);
+    port_ = ntohs(address.sin_port);
+    listen(listen_fd_, 4);
+    thread_ = std::thread([this, handler] {
+      while (!stopping_) {
+        struct pollfd pfd = {listen_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 20) <= 0) {
+          continue;
+        }
+        int client = accept(listen_fd_, nullptr, nullptr);
+        if (client >= 0) {
+          connections_++;
+          handler(client);
+          close(client);
+        }
+      }
+    });
+  }
+
+  ~LoopbackServer() {
+    stopping_ = true;
+    thread_.join();
+    close(listen_fd_);
+  }
+
+  int port() const { return port_; }
+  int connections() const { return connections_; }
+
+ private:
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::atomic<bool> stopping_{false};
+  std::atomic<int> connections_{0};
+  std::thread thread_;
+};
+
+bool ReadExactly(int fd, void* buffer, size_t length) {
+  uint8_t* out = static_cast<uint8_t*>(buffer);
+  while (length > 0) {
+    ssize_t n = read(fd, out, length);
+    if (n <= 0) {
+      return false;
+    }
+    out += n;
+    length -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool ReadLine(int fd, std::string* line) {
+  line->clear();
+  char c;
+  while (ReadExactly(fd, &c, 1)) {
+    if (c == '\n') {
+      return true;
+    }
+    line->push_back(c);
+  }
+  return false;
+}
+
+// The smallest LPD that still checks the protocol: accepts one queue, acks
+// every subcommand and file, and records the data files it receives.
+struct FakeLpd {
+  std::mutex mutex;
+  std::string queue;
+  std::vector<std::string> control_files;
+  std::vector<std::vector<uint8_t>> data_files;
+
+  void Serve(int fd) {
+    const uint8_t ack = 0;
+    std::string line;
+    if (!ReadLine(fd, &line) || line.empty() || line[0] != '\x02') {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue = line.substr(1);
+    }
+    if (write(fd, &ack, 1) != 1) {
+      return;
+    }
+    while (ReadLine(fd, &line) && !line.empty()) {
+      char subcommand = line[0];
+      size_t length = std::stoul(line.substr(1, line.find(' ') - 1));
+      if (write(fd, &ack, 1) != 1) {
+        return;
+      }
+      std::vector<uint8_t> contents(length + 1);
+      if (!ReadExactly(fd, contents.data(), contents.size()) ||
+          contents.back() != 0) {
+        return;
+      }
+      contents.pop_back();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (subcommand == '\x02') {
+          control_files.emplace_back(contents.begin(), contents.end());
+        } else if (subcommand == '\x03') {
+          data_files.push_back(contents);
+        }
+      }
+      if (write(fd, &ack, 1) != 1) {
+        return;
+      }
+    }
+  }
+};
+
+}  // namespace
+
+TEST(NetworkEndpoint, ParsesQueueKeys) {
+  NetworkEndpoint endpoint;
+  ASSERT_TRUE(ParseNetworkEndpoint("lpd://192.168.0.20/kitchen", &endpoint));
+  EXPECT_EQ(endpoint.protocol, NetworkEndpoint::Protocol::kLpd);
+  EXPECT_EQ(endpoint.host, "192.168.0.20");
+  EXPECT_EQ(endpoint.port, 515);
+  EXPECT_EQ(endpoint.queue, "kitchen");
+
+  ASSERT_TRUE(ParseNetworkEndpoint("tcp://[fe80::1]:9101", &endpoint));
+  EXPECT_EQ(endpoint.protocol, NetworkEndpoint::Protocol::kRaw);
+  EXPECT_EQ(endpoint.host, "fe80::1");
+  EXPECT_EQ(endpoint.port, 9101);
+  EXPECT_EQ(endpoint.ToString(), "tcp://[fe80::1]:9101");
+
+  EXPECT_FALSE(ParseNetworkEndpoint("/dev/usb/lp0", &endpoint));
+  EXPECT_FALSE(ParseNetworkEndpoint("tcp://host:99999", &endpoint));
+}
+
+TEST(TcpTransport, WritesRawBytes) {
+  std::vector<uint8_t> received;
+  LoopbackServer server([&](int fd) {
+    uint8_t buffer[256];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+      received.insert(received.end(), buffer, buffer + n);
+    }
+  });
+  {
+    TcpTransport transport("127.0.0.1", server.port());
+    ASSERT_TRUE(transport.Open());
+    std::vector<uint8_t> job = {0x1b, 0x40, 'h', 'i', 0x1d, 0x56, 0x00};
+    ASSERT_TRUE(transport.Write(job.data(), job.size()));
+  }
+  for (int i = 0; i < 100 && received.size() < 7; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(received.size(), 7u);
+}
+
+TEST(LpdTransport, SendsBackToBackJobsOnOneConnection) {
+  FakeLpd lpd;
+  LoopbackServer server([&](int fd) { lpd.Serve(fd); });
+  LpdTransport transport("127.0.0.1", server.port(), "thermal");
+  ASSERT_TRUE(transport.Open());
+
+  std::vector<uint8_t> first = {0x1b, 0x40, 0x00, 'A', '\n'};
+  std::vector<uint8_t> second(10000, 0x5a);
+  ASSERT_TRUE(transport.Write(first.data(), first.size()));
+  // The streaming interface accepts the contents in pieces.
+  ASSERT_TRUE(transport.BeginJob(second.size()));
+  ASSERT_TRUE(transport.SendData(second.data(), 4000));
+  ASSERT_TRUE(transport.SendData(second.data() + 4000, 6000));
+  ASSERT_TRUE(transport.EndJob());
+  ASSERT_TRUE(transport.Flush());
+  EXPECT_FALSE(transport.IsOpen());
+
+  std::lock_guard<std::mutex> lock(lpd.mutex);
+  EXPECT_EQ(server.connections(), 1);
+  EXPECT_EQ(transport.sessions_opened(), 1u);
+  EXPECT_EQ(lpd.queue, "thermal");
+  ASSERT_EQ(lpd.data_files.size(), 2u);
+  EXPECT_EQ(lpd.data_files[0], first);
+  EXPECT_EQ(lpd.data_files[1], second);
+  ASSERT_EQ(lpd.control_files.size(), 2u);
+  EXPECT_NE(lpd.control_files[0].find("\nldfA"), std::string::npos);
+}
+
+TEST(LpdTransport, RejectsShortStreamedJob) {
+  FakeLpd lpd;
+  LoopbackServer server([&](int fd) { lpd.Serve(fd); });
+  LpdTransport transport("127.0.0.1", server.port(), "lp");
+  ASSERT_TRUE(transport.Open());
+  uint8_t data[4] = {1, 2, 3, 4};
+  ASSERT_TRUE(transport.BeginJob(8));
+  ASSERT_TRUE(transport.SendData(data, sizeof(data)));
+  EXPECT_FALSE(transport.EndJob());
+  EXPECT_FALSE(transport.SendData(data, 8));
+}
+
+TEST(LpdTransport, ReceivesAFileJobAsOneJob) {
+  FakeLpd lpd;
+  LoopbackServer server([&](int fd) { lpd.Serve(fd); });
+  // Five 16-dot rows in bands of two: three raster headers, each a piece
+  // of its own.
+  char path[] = "/tmp/tpf_lpd_file_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> rows = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  ASSERT_EQ(write(fd, rows.data(), rows.size()),
+            static_cast<ssize_t>(rows.size()));
+  close(fd);
+  FileJobSpec spec;
+  spec.path = path;
+  spec.format = FileFormat::kBitmap;
+  spec.bitmap_width = 16;
+  spec.raster.band_height = 2;
+
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(
+            new LpdTransport("127.0.0.1", server.port(), "thermal"));
+      },
+      nullptr);
+  ASSERT_NE(queue.SubmitFile("lpd://kitchen", spec), 0u);
+  for (int i = 0; i < 200 && queue.stats().completed == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  queue.Shutdown();
+  unlink(path);
+
+  EXPECT_EQ(queue.stats().completed, 1u);
+  std::lock_guard<std::mutex> lock(lpd.mutex);
+  ASSERT_EQ(lpd.data_files.size(), 1u);
+  EXPECT_EQ(lpd.data_files[0], std::vector<uint8_t>({
+                                   0x1D, 0x76, 0x30, 0, 2, 0, 2, 0, 1, 2,
+                                   3, 4, 0x1D, 0x76, 0x30, 0, 2, 0, 2, 0,
+                                   5, 6, 7, 8, 0x1D, 0x76, 0x30, 0, 2, 0,
+                                   1, 0, 9, 10,
+                               }));
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,538 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/daemon_client.h"
+#include "core/daemon_protocol.h"
+#include "core/device_transport.h"
+#include "core/print_daemon.h"
+#include "core/print_queue.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+struct FakePrinter {
+  std::mutex mutex;
+  std::vector<uint8_t> received;
+};
+
+class FakeTransport : public Transport {
+ public:
+  explicit FakeTransport(std::shared_ptr<FakePrinter> printer)
+      : printer_(std::move(printer)) {}
+
+  bool Open() override {
+    open_ = true;
+    return true;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override {
+    std::lock_guard<std::mutex> lock(printer_->mutex);
+    printer_->received.insert(printer_->received.end(), data, data + length);
+    return true;
+  }
+
+ private:
+  std::shared_ptr<FakePrinter> printer_;
+  bool open_ = false;
+};
+
+std::string TempSocketPath() {
+  return "/tmp/tpf_daemon_test_" + std::to_string(getpid()) + ".sock";
+}
+
+// A daemon serving a queue of FakeTransports on its own thread.
+class DaemonFixture {
+ public:
+  DaemonFixture()
+      : printer(std::make_shared<FakePrinter>()),
+        queue(
+            [this](const std::string&) {
+              return std::unique_ptr<Transport>(new FakeTransport(printer));
+            },
+            nullptr),
+        daemon(&queue, &serial_settings) {}
+
+  bool Start(const std::string& path) {
+    if (!daemon.Listen(path)) {
+      return false;
+    }
+    thread = std::thread([this] { daemon.Run(); });
+    return true;
+  }
+
+  ~DaemonFixture() {
+    if (thread.joinable()) {
+      daemon.Stop();
+      thread.join();
+    }
+    queue.Shutdown();
+  }
+
+  std::shared_ptr<FakePrinter> printer;
+  SerialSettings serial_settings;
+  PrintQueue queue;
+  PrintDaemon daemon;
+  std::thread thread;
+};
+
+bool WaitFor(const std::function<bool()>& condition) {
+  for (int i = 0; i < 500; i++) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(DaemonProtocol, RoundTripsRequestsAndReplies) {
+  DaemonRequest request;
+  request.call = DaemonCall::kSerialOptions;
+  request.printer = "/dev/ttyUSB0";
+  request.key = "order-17";
+  request.barrier = true;
+  request.serial.baud_rate = 115200;
+  request.serial.flow_control = FlowControl::kRtsCts;
+  request.members = {"/dev/usb/lp0", "tcp://10.0.0.7:9100"};
+  request.trace_threshold_ms = 5000;
+  request.preload = {{1, 2, 3}, {}};
+  std::vector<uint8_t> packet = EncodeDaemonRequest(request);
+  DaemonRequest decoded;
+  ASSERT_TRUE(DecodeDaemonRequest(packet.data(), packet.size(), &decoded));
+  EXPECT_EQ(decoded.call, DaemonCall::kSerialOptions);
+  EXPECT_EQ(decoded.printer, "/dev/ttyUSB0");
+  EXPECT_EQ(decoded.key, "order-17");
+  EXPECT_TRUE(decoded.barrier);
+  EXPECT_EQ(decoded.serial, request.serial);
+  EXPECT_EQ(decoded.members, request.members);
+  EXPECT_EQ(decoded.trace_threshold_ms, 5000u);
+  EXPECT_EQ(decoded.preload, request.preload);
+  EXPECT_FALSE(DecodeDaemonRequest(packet.data(), packet.size() - 1,
+                                   &decoded));
+
+  DaemonReply reply;
+  reply.ok = true;
+  reply.stats.resent_bytes = 7;
+  reply.stats.buffer_reuses = 9;
+  reply.resolved = true;
+  reply.profile.name = "EPSON TM-P20";
+  reply.profile.paper_width = 384;
+  reply.profile.macros = MacroSupport::kSupported;
+  reply.profile.chunk_size = 1536;
+  reply.latency.completion.Add(std::chrono::milliseconds(300));
+  reply.latency.unanswered = 2;
+  reply.latency.unsupported = 3;
+  reply.status.connected = true;
+  reply.status.paper = PaperState::kNearEnd;
+  reply.status.ready = true;
+  reply.job_ids = {4, 0, 5};
+  GroupMemberStats member;
+  member.printer = "/dev/usb/lp1";
+  member.utilization = 0.5;
+  member.offline = true;
+  reply.members.push_back(member);
+  PrinterStatusChange change;
+  change.printer = "tcp://10.0.0.7:9100";
+  change.status.online = true;
+  change.status.paper = PaperState::kOut;
+  reply.statuses.push_back(change);
+  packet = EncodeDaemonReply(reply);
+  DaemonReply decoded_reply;
+  ASSERT_TRUE(
+      DecodeDaemonReply(packet.data(), packet.size(), &decoded_reply));
+  EXPECT_TRUE(decoded_reply.ok);
+  EXPECT_EQ(decoded_reply.stats.resent_bytes, 7u);
+  EXPECT_EQ(decoded_reply.stats.buffer_reuses, 9u);
+  EXPECT_EQ(decoded_reply.profile.name, "EPSON TM-P20");
+  EXPECT_EQ(decoded_reply.profile.paper_width, 384);
+  EXPECT_EQ(decoded_reply.profile.macros, MacroSupport::kSupported);
+  EXPECT_EQ(decoded_reply.profile.chunk_size, 1536);
+  EXPECT_EQ(decoded_reply.latency.completion.counts[9], 1u);
+  EXPECT_EQ(decoded_reply.latency.completion.max_ms, 300u);
+  EXPECT_EQ(decoded_reply.latency.unanswered, 2u);
+  EXPECT_EQ(decoded_reply.latency.unsupported, 3u);
+  EXPECT_TRUE(decoded_reply.status.connected);
+  EXPECT_FALSE(decoded_reply.status.online);
+  EXPECT_EQ(decoded_reply.status.paper, PaperState::kNearEnd);
+  EXPECT_TRUE(decoded_reply.status.ready);
+  EXPECT_EQ(decoded_reply.job_ids, reply.job_ids);
+  ASSERT_EQ(decoded_reply.members.size(), 1u);
+  EXPECT_EQ(decoded_reply.members[0].printer, "/dev/usb/lp1");
+  EXPECT_EQ(decoded_reply.members[0].utilization, 0.5);
+  EXPECT_TRUE(decoded_reply.members[0].offline);
+  ASSERT_EQ(decoded_reply.statuses.size(), 1u);
+  EXPECT_EQ(decoded_reply.statuses[0].printer, "tcp://10.0.0.7:9100");
+  EXPECT_EQ(decoded_reply.statuses[0].status, change.status);
+}
+
+TEST(DaemonProtocol, PassesJobBytesInASealedMemfd) {
+  const std::vector<uint8_t> bytes = {0x1B, '@', 'h', 'i', 0x0A};
+  int fd = CreateSealedBuffer(bytes.data(), bytes.size());
+  ASSERT_GE(fd, 0);
+  // The seals keep the sender from changing the bytes after handing them
+  // over.
+  EXPECT_LT(write(fd, "x", 1), 0);
+  std::vector<uint8_t> read;
+  ASSERT_TRUE(ReadSealedBuffer(fd, &read));
+  EXPECT_EQ(read, bytes);
+  close(fd);
+}
+
+TEST(PrintDaemon, PrintsJobsFromClients) {
+  const std::string path = TempSocketPath();
+  DaemonFixture fixture;
+  ASSERT_TRUE(fixture.Start(path));
+
+  DaemonClient first(path);
+  DaemonClient second(path);
+  uint64_t id;
+  ASSERT_TRUE(first.Submit("/dev/usb/lp0", std::vector<uint8_t>{1, 2}.data(),
+                           2, 1, "", &id));
+  EXPECT_EQ(id, 1u);
+  ASSERT_TRUE(second.Submit("/dev/usb/lp0", std::vector<uint8_t>{3}.data(),
+                            1, 1, "order-9", &id));
+  EXPECT_EQ(id, 2u);
+  // The key is the daemon's, so another app resubmitting it is dropped.
+  ASSERT_TRUE(first.Submit("/dev/usb/lp0", std::vector<uint8_t>{3}.data(), 1,
+                           1, "order-9", &id));
+  EXPECT_EQ(id, 2u);
+
+  PrintQueueStats stats;
+  ASSERT_TRUE(WaitFor([&] {
+    return second.GetStats(&stats) && stats.completed == 2;
+  }));
+  EXPECT_EQ(stats.deduplicated_jobs, 1u);
+  std::lock_guard<std::mutex> lock(fixture.printer->mutex);
+  EXPECT_EQ(fixture.printer->received, std::vector<uint8_t>({1, 2, 3}));
+}
+
+TEST(PrintDaemon, PrintsBatchesFromClients) {
+  const std::string path = TempSocketPath();
+  DaemonFixture fixture;
+  ASSERT_TRUE(fixture.Start(path));
+  DaemonClient client(path);
+
+  const std::vector<uint8_t> first = {1, 2};
+  const std::vector<uint8_t> second = {3};
+  std::vector<BatchJob> jobs(2);
+  jobs[0].data = first.data();
+  jobs[0].length = first.size();
+  jobs[1].data = second.data();
+  jobs[1].length = second.size();
+  std::vector<uint8_t> envelope = EncodeJobBatch(jobs);
+  std::vector<uint64_t> ids;
+  ASSERT_TRUE(client.SubmitBatch({"/dev/usb/lp0"}, envelope.data(),
+                                 envelope.size(), &ids));
+  EXPECT_EQ(ids, std::vector<uint64_t>({1, 2}));
+  // Jobs naming a printer the request does not.
+  EXPECT_FALSE(client.SubmitBatch({}, envelope.data(), envelope.size(), &ids));
+
+  PrintQueueStats stats;
+  ASSERT_TRUE(WaitFor([&] {
+    return client.GetStats(&stats) && stats.completed == 2;
+  }));
+  std::lock_guard<std::mutex> lock(fixture.printer->mutex);
+  EXPECT_EQ(fixture.printer->received, std::vector<uint8_t>({1, 2, 3}));
+}
+
+TEST(PrintDaemon, AppliesSettingsForClients) {
+  const std::string path = TempSocketPath();
+  DaemonFixture fixture;
+  ASSERT_TRUE(fixture.Start(path));
+  DaemonClient client(path);
+
+  SerialOptions options;
+  options.baud_rate = 19200;
+  ASSERT_TRUE(client.SetSerialOptions("/dev/ttyUSB0", options));
+  EXPECT_EQ(fixture.serial_settings.Get("/dev/ttyUSB0").baud_rate, 19200);
+  options.baud_rate = 12345;
+  EXPECT_FALSE(client.SetSerialOptions("/dev/ttyUSB0", options));
+
+  CoalesceOptions coalesce;
+  coalesce.enabled = true;
+  coalesce.window = std::chrono::milliseconds(80);
+  ASSERT_TRUE(client.SetCoalesceOptions(coalesce));
+  EXPECT_TRUE(fixture.queue.coalesce_options().enabled);
+  EXPECT_EQ(fixture.queue.coalesce_options().window.count(), 80);
+
+  PrinterProfile profile;
+  bool resolved = true;
+  ASSERT_TRUE(client.GetProfile("/dev/usb/lp0", &profile, &resolved));
+  EXPECT_FALSE(resolved);
+  EXPECT_EQ(profile.name, "generic");
+
+  // The first request has the daemon watch the printer.
+  PrinterStatus status;
+  bool known = false;
+  ASSERT_TRUE(WaitFor([&] {
+    return client.GetStatus("/dev/usb/lp0", &status, &known) && known;
+  }));
+  EXPECT_TRUE(status.connected);
+
+  // The daemon's own queue is traced; it hands the trace back and the
+  // client writes the file.
+  const std::string trace = path + ".json";
+  ASSERT_TRUE(client.DumpTrace(trace));
+  EXPECT_EQ(access(trace.c_str(), F_OK), 0);
+  unlink(trace.c_str());
+  EXPECT_FALSE(client.DumpTrace("/nonexistent/trace.json"));
+  ASSERT_TRUE(client.SetTraceThreshold(std::chrono::seconds(5), trace));
+  ASSERT_TRUE(client.SetTraceThreshold(std::chrono::seconds(0), ""));
+  unlink(trace.c_str());
+
+  ASSERT_TRUE(client.WarmUp({"/dev/usb/lp1"}, {}));
+  EXPECT_TRUE(WaitFor([&] {
+    return client.GetStatus("/dev/usb/lp1", &status, &known) && known &&
+           status.ready;
+  }));
+  EXPECT_FALSE(client.WarmUp({""}, {}));
+}
+
+TEST(PrintDaemon, PrintsOnlyFilesTheClientOpened) {
+  const std::string path = TempSocketPath();
+  DaemonFixture fixture;
+  ASSERT_TRUE(fixture.Start(path));
+  DaemonClient client(path);
+  const std::string file = path + ".bin";
+  const std::string other = path + ".other";
+  for (const std::string& name : {file, other}) {
+    int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "\x1b@", 2), 2);
+    close(fd);
+  }
+  FileJobSpec spec;
+  spec.path = file;
+  uint64_t id = 0;
+  ASSERT_TRUE(client.SubmitFile("/dev/usb/lp0", spec, &id));
+  EXPECT_NE(id, 0u);
+  PrintQueueStats stats;
+  EXPECT_TRUE(WaitFor([&] {
+    return client.GetStats(&stats) && stats.completed == 1;
+  }));
+  {
+    std::lock_guard<std::mutex> lock(fixture.printer->mutex);
+    EXPECT_EQ(fixture.printer->received, std::vector<uint8_t>({0x1B, '@'}));
+  }
+  spec.path = path + ".missing";
+  EXPECT_FALSE(client.SubmitFile("/dev/usb/lp0", spec, &id));
+  EXPECT_FALSE(client.WarmUp({"/dev/usb/lp0"}, {spec}));
+
+  // A request that names a file without passing it, or passes another
+  // one, is refused.
+  int socket_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  ASSERT_EQ(connect(socket_fd, reinterpret_cast<struct sockaddr*>(&address),
+                    sizeof(address)),
+            0);
+  DaemonRequest request;
+  request.call = DaemonCall::kSubmitFile;
+  request.printer = "/dev/usb/lp0";
+  spec.path = file;
+  request.spec = SerializeFileJobSpec(spec);
+  int passed = open(other.c_str(), O_RDONLY | O_CLOEXEC);
+  for (int fd : {-1, passed}) {
+    ASSERT_TRUE(SendPacket(socket_fd, EncodeDaemonRequest(request), fd));
+    std::vector<uint8_t> packet;
+    int reply_fd;
+    ASSERT_TRUE(ReceivePacket(socket_fd, &packet, &reply_fd, 5000));
+    DaemonReply reply;
+    ASSERT_TRUE(DecodeDaemonReply(packet.data(), packet.size(), &reply));
+    EXPECT_FALSE(reply.ok);
+  }
+  close(passed);
+  close(socket_fd);
+  unlink(file.c_str());
+  unlink(other.c_str());
+}
+
+TEST(PrintDaemon, RefusesPrintersThatAreNotDevices) {
+  const std::string path = TempSocketPath();
+  DaemonFixture fixture;
+  ASSERT_TRUE(fixture.Start(path));
+  DaemonClient client(path);
+  const std::string file = path + ".victim";
+  int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  uint64_t id;
+  const std::vector<uint8_t> data = {1, 2, 3};
+  EXPECT_FALSE(client.Submit(file, data.data(), data.size(), 1, "", &id));
+  EXPECT_FALSE(client.Submit("/dev/usb/lp0/../../.." + file, data.data(),
+                             data.size(), 1, "", &id));
+  EXPECT_FALSE(client.WarmUp({file}, {}));
+  PrinterStatus status;
+  bool known;
+  EXPECT_FALSE(client.GetStatus(file, &status, &known));
+  std::vector<BatchJob> jobs(1);
+  jobs[0].data = data.data();
+  jobs[0].length = data.size();
+  std::vector<uint8_t> envelope = EncodeJobBatch(jobs);
+  std::vector<uint64_t> ids;
+  EXPECT_FALSE(
+      client.SubmitBatch({file}, envelope.data(), envelope.size(), &ids));
+
+  // Nor does the transport write into anything but a device, even one a
+  // symlink leads to.
+  EXPECT_FALSE(DeviceTransport(file).Open());
+  EXPECT_TRUE(DeviceTransport("/dev/null").Open());
+  const std::string link = path + ".link";
+  ASSERT_EQ(symlink("/dev/null", link.c_str()), 0);
+  EXPECT_FALSE(DeviceTransport(link).Open());
+  unlink(link.c_str());
+
+  struct stat info;
+  ASSERT_EQ(stat(file.c_str(), &info), 0);
+  EXPECT_EQ(info.st_size, 0);
+  unlink(file.c_str());
+}
+
+TEST(PrintDaemon, PushesStatusChangesToSubscribers) {
+  const std::string path = TempSocketPath();
+  DaemonClient client(path);
+  std::vector<PrinterStatusChange> changes;
+  {
+    DaemonFixture fixture;
+    ASSERT_TRUE(fixture.Start(path));
+    int subscription = client.Subscribe();
+    ASSERT_GE(subscription, 0);
+    EXPECT_EQ(client.Subscribe(), subscription);
+    ASSERT_TRUE(client.ReadStatusChanges(&changes));
+    EXPECT_TRUE(changes.empty());
+
+    // The job's outcome changes the printer's status, which arrives
+    // without being asked for.
+    uint64_t id;
+    ASSERT_TRUE(client.Submit("/dev/usb/lp0", std::vector<uint8_t>{1}.data(),
+                              1, 1, "", &id));
+    std::vector<PrinterStatusChange> pushed;
+    ASSERT_TRUE(WaitFor([&] {
+      EXPECT_TRUE(client.ReadStatusChanges(&changes));
+      pushed.insert(pushed.end(), changes.begin(), changes.end());
+      return !pushed.empty() && pushed.back().status.connected;
+    }));
+    EXPECT_EQ(pushed.back().printer, "/dev/usb/lp0");
+  }
+  // The subscription ends with the daemon.
+  EXPECT_TRUE(WaitFor([&] { return !client.ReadStatusChanges(&changes); }));
+  EXPECT_LT(client.Subscribe(), 0);
+}
+
+TEST(PrintDaemon, ReplacesAStaleSocketButNotALiveOne) {
+  const std::string path = TempSocketPath();
+  // What a daemon that was killed leaves behind.
+  int stale = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  ASSERT_EQ(bind(stale, reinterpret_cast<struct sockaddr*>(&address),
+                 sizeof(address)),
+            0);
+  close(stale);
+
+  DaemonFixture running;
+  ASSERT_TRUE(running.Start(path));
+  DaemonFixture another;
+  EXPECT_FALSE(another.daemon.Listen(path));
+}
+
+TEST(DaemonClient, FailsFastWithoutADaemon) {
+  DaemonClient client(TempSocketPath() + ".missing");
+  EXPECT_FALSE(client.Connect());
+  uint64_t id = 99;
+  bool sent = true;
+  EXPECT_FALSE(client.Submit("/dev/usb/lp0", nullptr, 0, 1, "", &id, false,
+                             nullptr, &sent));
+  EXPECT_FALSE(sent);
+  EXPECT_FALSE(client.connected());
+}
+
+TEST(DaemonClient, SaysAJobWasSentEvenWhenItsReplyIsLost) {
+  const std::string path = TempSocketPath();
+  // A daemon that takes the request and goes away before answering.
+  int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  ASSERT_EQ(bind(listener, reinterpret_cast<struct sockaddr*>(&address),
+                 sizeof(address)),
+            0);
+  ASSERT_EQ(listen(listener, 1), 0);
+  std::thread daemon([listener] {
+    int fd = accept(listener, nullptr, nullptr);
+    uint8_t packet[4096];
+    recv(fd, packet, sizeof(packet), 0);
+    close(fd);
+  });
+
+  DaemonClient client(path);
+  uint64_t id = 99;
+  bool sent = false;
+  EXPECT_FALSE(client.Submit("/dev/usb/lp0", std::vector<uint8_t>{1}.data(),
+                             1, 1, "", &id, false, nullptr, &sent));
+  EXPECT_TRUE(sent);
+  EXPECT_EQ(id, 0u);
+  daemon.join();
+  close(listener);
+  unlink(path.c_str());
+
+  // A request the daemon refused was sent too, but not a file that could
+  // not be opened.
+  DaemonFixture fixture;
+  ASSERT_TRUE(fixture.Start(path));
+  DaemonClient restarted(path);
+  FileJobSpec spec;
+  spec.path = path + ".missing";
+  sent = true;
+  EXPECT_FALSE(restarted.SubmitFile("/dev/usb/lp0", spec, &id, &sent));
+  EXPECT_FALSE(sent);
+  std::vector<uint64_t> ids;
+  EXPECT_FALSE(
+      restarted.SubmitBatch({"/dev/usb/lp0"}, nullptr, 0, &ids, &sent));
+  EXPECT_TRUE(sent);
+}
+
+TEST(DaemonClient, ReconnectsAfterTheDaemonRestarts) {
+  const std::string path = TempSocketPath();
+  DaemonClient client(path);
+  PrintQueueStats stats;
+  {
+    DaemonFixture fixture;
+    ASSERT_TRUE(fixture.Start(path));
+    ASSERT_TRUE(client.GetStats(&stats));
+  }
+  DaemonFixture restarted;
+  ASSERT_TRUE(restarted.Start(path));
+  uint64_t id;
+  EXPECT_TRUE(client.Submit("/dev/usb/lp0", std::vector<uint8_t>{4}.data(), 1,
+                            1, "", &id));
+  ASSERT_TRUE(WaitFor([&] { return restarted.queue.stats().completed == 1; }));
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
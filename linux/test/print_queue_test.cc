@@ -0,0 +1,1203 @@
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/print_queue.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+// Records everything written to it; can be told to fail the next writes.
+struct FakePrinter {
+  std::mutex mutex;
+  std::vector<uint8_t> received;
+  int failures_left = 0;
+  // Bytes a failing write still delivers, and reports as acknowledged.
+  size_t partial = 0;
+  int opens = 0;
+  int writes = 0;
+  // Answers GS I queries as an Epson TM-T20, which has macros.
+  bool answers_queries = false;
+  int queries = 0;
+  uint8_t last_query = 0;
+  // Offers a StreamFd(); WriteSome() reports it full |stalls| times first.
+  bool streams = false;
+  int stalls = 0;
+  // Answers GS r 1 status requests.
+  bool answers_status = false;
+  int status_requests = 0;
+  bool status_pending = false;
+  // Answers DLE EOT 1 and 4 with these; 0 leaves them unanswered.
+  uint8_t printer_status = 0;
+  uint8_t paper_status = 0;
+  uint8_t realtime_reply = 0;
+  // Open() and every write fail.
+  bool unplugged = false;
+  // Frames each job, as an LPD queue does.
+  bool frames_jobs = false;
+};
+
+bool IsStatusRequest(const uint8_t* data, size_t length) {
+  return length == 3 && data[0] == 0x1D && data[1] == 'r' && data[2] == 1;
+}
+
+class FakeTransport : public Transport {
+ public:
+  explicit FakeTransport(std::shared_ptr<FakePrinter> printer)
+      : printer_(std::move(printer)),
+        // Always writable, so the loop never waits long on it.
+        null_fd_(open("/dev/null", O_WRONLY | O_CLOEXEC)) {}
+  ~FakeTransport() override { close(null_fd_); }
+
+  bool Open() override {
+    std::lock_guard<std::mutex> lock(printer_->mutex);
+    printer_->opens++;
+    if (printer_->unplugged) {
+      return false;
+    }
+    open_ = true;
+    sent_ = 0;
+    return true;
+  }
+  void Close() override { open_ = false; }
+  bool IsOpen() const override { return open_; }
+  bool Write(const uint8_t* data, size_t length) override {
+    std::lock_guard<std::mutex> lock(printer_->mutex);
+    if (printer_->unplugged) {
+      return false;
+    }
+    if (printer_->failures_left > 0) {
+      printer_->failures_left--;
+      acknowledged_ = std::min(length, printer_->partial);
+      printer_->received.insert(printer_->received.end(), data,
+                                data + acknowledged_);
+      return false;
+    }
+    if (length == 3 && data[0] == 0x1D && data[1] == 'I') {
+      printer_->queries++;
+      printer_->last_query = data[2];
+      return true;
+    }
+    if (IsStatusRequest(data, length)) {
+      printer_->status_requests++;
+      printer_->status_pending = printer_->answers_status;
+      return true;
+    }
+    printer_->writes++;
+    printer_->received.insert(printer_->received.end(), data, data + length);
+    return true;
+  }
+  ssize_t Read(uint8_t* data, size_t length, int timeout_ms) override {
+    std::lock_guard<std::mutex> lock(printer_->mutex);
+    if (printer_->realtime_reply != 0) {
+      data[0] = printer_->realtime_reply;
+      printer_->realtime_reply = 0;
+      return 1;
+    }
+    if (printer_->status_pending) {
+      printer_->status_pending = false;
+      // Paper present.
+      data[0] = 0x00;
+      return 1;
+    }
+    if (!printer_->answers_queries) {
+      // Printers that answer status requests can be read from.
+      return printer_->answers_status ? 0 : -1;
+    }
+    const std::string reply = printer_->last_query == 67
+                                  ? std::string("_TM-T20", 8)
+                                  : std::string("_EPSON", 7);
+    memcpy(data, reply.data(), std::min(length, reply.size()));
+    return std::min(length, reply.size());
+  }
+  size_t Acknowledged() const override { return acknowledged_; }
+  int StreamFd() const override {
+    return open_ && printer_->streams ? null_fd_ : -1;
+  }
+  ssize_t WriteSome(const uint8_t* data, size_t length) override {
+    std::lock_guard<std::mutex> lock(printer_->mutex);
+    if (printer_->unplugged) {
+      return -1;
+    }
+    if (printer_->stalls > 0) {
+      printer_->stalls--;
+      return 0;
+    }
+    if (printer_->failures_left > 0) {
+      // Takes the partial bytes, then fails on the next call.
+      size_t delivered = failing_ ? 0 : std::min(length, printer_->partial);
+      failing_ = delivered > 0;
+      if (failing_) {
+        printer_->received.insert(printer_->received.end(), data,
+                                  data + delivered);
+        sent_ += delivered;
+        return static_cast<ssize_t>(delivered);
+      }
+      printer_->failures_left--;
+      return -1;
+    }
+    if (IsStatusRequest(data, length)) {
+      printer_->status_requests++;
+      printer_->status_pending = printer_->answers_status;
+      return static_cast<ssize_t>(length);
+    }
+    if (length == 3 && data[0] == 0x10 && data[1] == 0x04) {
+      printer_->realtime_reply =
+          data[2] == 1 ? printer_->printer_status
+                       : data[2] == 4 ? printer_->paper_status : 0;
+      return static_cast<ssize_t>(length);
+    }
+    printer_->writes++;
+    printer_->received.insert(printer_->received.end(), data, data + length);
+    sent_ += length;
+    return static_cast<ssize_t>(length);
+  }
+  size_t BytesSent() const override { return sent_; }
+  size_t BytesDelivered() const override { return sent_; }
+  bool FramesJobs() const override { return printer_->frames_jobs; }
+
+ private:
+  std::shared_ptr<FakePrinter> printer_;
+  int null_fd_;
+  bool open_ = false;
+  size_t acknowledged_ = 0;
+  size_t sent_ = 0;
+  bool failing_ = false;
+};
+
+bool WaitFor(const std::function<bool()>& condition) {
+  for (int i = 0; i < 500; i++) {
+    if (condition()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+}  // namespace
+
+TEST(PrintQueue, WritesJobsInOrderPerPrinter) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  EXPECT_EQ(queue.Submit("lp0", {1, 2}), 1u);
+  EXPECT_EQ(queue.Submit("lp0", {3}), 2u);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received, std::vector<uint8_t>({1, 2, 3}));
+  EXPECT_EQ(printer->opens, 1);
+}
+
+TEST(PrintQueue, ReconnectsAfterFailedWrite) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->failures_left = 1;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.Submit("lp0", {7, 7, 7});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received, std::vector<uint8_t>({7, 7, 7}));
+  EXPECT_EQ(printer->opens, 2);
+}
+
+TEST(PrintQueue, TracesJobsInTheFlightRecorder) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->failures_left = 1;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  uint64_t id = queue.Submit("lp0", {7, 7, 7});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  std::vector<TraceEvent> events;
+  queue.flight_recorder()->Snapshot(&events);
+  std::vector<TraceEventType> types;
+  int failed_writes = 0;
+  for (const TraceEvent& event : events) {
+    EXPECT_EQ(event.printer, 1);
+    if (event.type == TraceEventType::kStageEnd &&
+        event.detail == static_cast<uint8_t>(TraceStage::kWrite)) {
+      EXPECT_EQ(event.job, id);
+      failed_writes += event.value == -1;
+      continue;
+    }
+    if (event.type != TraceEventType::kStageBegin &&
+        event.type != TraceEventType::kStageEnd) {
+      types.push_back(event.type);
+    }
+  }
+  EXPECT_EQ(types, std::vector<TraceEventType>(
+                       {TraceEventType::kEnqueue, TraceEventType::kDequeue,
+                        TraceEventType::kReconnect, TraceEventType::kFinish}));
+  EXPECT_EQ(failed_writes, 1);
+}
+
+TEST(PrintQueue, ResumesFromTheLastAcknowledgedCommand) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->failures_left = 1;
+  printer->partial = 4;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  // The printer gets "AB" and half of ESC E 1 before the link drops.
+  queue.Submit("lp0", {'A', 'B', 0x1B, 'E', 1, 'C', 'D'});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  PrintQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.resent_bytes, 5u);
+  EXPECT_EQ(stats.resumed_bytes, 2u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received,
+            std::vector<uint8_t>(
+                {'A', 'B', 0x1B, 'E', 0x1B, 'E', 1, 'C', 'D'}));
+}
+
+TEST(PrintQueue, SubmitsEachJobKeyOnce) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  uint64_t id = queue.Submit("lp0", {1, 2}, 1, "order-17");
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  EXPECT_EQ(queue.Submit("lp0", {1, 2}, 1, "order-17"), id);
+  EXPECT_NE(queue.Submit("lp0", {3}, 1, "order-18"), id);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+  EXPECT_EQ(queue.stats().deduplicated_jobs, 1u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received, std::vector<uint8_t>({1, 2, 3}));
+}
+
+TEST(PrintQueue, RestoredJobsResumeFromTheirProgress) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  JournaledJob job;
+  job.id = 5;
+  job.printer = "lp0";
+  job.data = {1, 2, 3, 4};
+  job.key = "order-5";
+  job.offset = 3;
+  std::vector<JournaledJob> jobs;
+  jobs.push_back(job);
+  queue.Restore(std::move(jobs));
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  EXPECT_EQ(queue.stats().resumed_bytes, 3u);
+  EXPECT_EQ(queue.Submit("lp0", {1, 2, 3, 4}, 1, "order-5"), 5u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received, std::vector<uint8_t>({4}));
+}
+
+TEST(PrintQueue, KeepsSettledKeysAcrossRestarts) {
+  char dir_template[] = "/tmp/tpf_queue_journal_XXXXXX";
+  ASSERT_NE(mkdtemp(dir_template), nullptr);
+  const std::string path = std::string(dir_template) + "/spool.journal";
+  auto printer = std::make_shared<FakePrinter>();
+  auto factory = [&](const std::string&) {
+    return std::unique_ptr<Transport>(new FakeTransport(printer));
+  };
+  const std::vector<uint8_t> ticket = {'A', 'B', 0x1B, 'E', 1, 'C', 'D'};
+  uint64_t printed;
+  {
+    SpoolJournal journal;
+    ASSERT_TRUE(journal.Open(path, nullptr));
+    PrintQueue queue(factory, &journal);
+    printed = queue.Submit("lp0", {1, 2}, 1, "order-1");
+    ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+    {
+      // Every attempt fails once the printer has "AB".
+      std::lock_guard<std::mutex> lock(printer->mutex);
+      printer->failures_left = PrintQueue::kMaxAttempts;
+      printer->partial = 2;
+    }
+    queue.Submit("lp0", ticket, 1, "order-2");
+    ASSERT_TRUE(WaitFor([&] { return queue.stats().failed == 1; }));
+    queue.Shutdown();
+  }
+  {
+    std::lock_guard<std::mutex> lock(printer->mutex);
+    printer->received.clear();
+  }
+
+  SpoolJournal journal;
+  std::vector<JournaledJob> pending;
+  std::vector<JournaledKey> keys;
+  ASSERT_TRUE(journal.Open(path, &pending, &keys));
+  PrintQueue queue(factory, &journal);
+  queue.Restore(std::move(pending), std::move(keys));
+  // Printed before the restart, so not again.
+  EXPECT_EQ(queue.Submit("lp0", {1, 2}, 1, "order-1"), printed);
+  EXPECT_EQ(queue.stats().deduplicated_jobs, 1u);
+  // Failed before it, so resumed after what the printer already has.
+  EXPECT_GT(queue.Submit("lp0", ticket, 1, "order-2"), printed);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  EXPECT_EQ(queue.stats().resumed_bytes, 2u);
+  queue.Shutdown();
+  journal.Close();
+  unlink(path.c_str());
+  rmdir(dir_template);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received, std::vector<uint8_t>({0x1B, 'E', 1, 'C', 'D'}));
+}
+
+TEST(PrintQueue, ForgetsKeysOfJobsThatCouldNotBeJournaled) {
+  char dir_template[] = "/tmp/tpf_queue_journal_XXXXXX";
+  ASSERT_NE(mkdtemp(dir_template), nullptr);
+  const std::string path = std::string(dir_template) + "/spool.journal";
+  auto printer = std::make_shared<FakePrinter>();
+  SpoolJournalOptions options;
+  options.initial_capacity = 4096;
+  SpoolJournal journal(options);
+  ASSERT_TRUE(journal.Open(path, nullptr));
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      &journal);
+
+  // The journal cannot grow past its first 4 KB for this job.
+  struct rlimit saved;
+  ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &saved), 0);
+  struct rlimit limit = saved;
+  limit.rlim_cur = 4096;
+  void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+  uint64_t refused =
+      queue.Submit("lp0", std::vector<uint8_t>(8192, 1), 1, "order-1");
+  setrlimit(RLIMIT_FSIZE, &saved);
+  signal(SIGXFSZ, handler);
+  EXPECT_EQ(refused, 0u);
+
+  // Had the refused job kept its place among the keys, the oldest one,
+  // order-1 again, would be forgotten to make room for the last.
+  uint64_t first = queue.Submit("lp0", {1}, 1, "order-1");
+  ASSERT_NE(first, 0u);
+  for (size_t i = 2; i <= PrintQueue::kMaxJobKeys; i++) {
+    ASSERT_NE(queue.Submit("lp0", {1}, 1, "order-" + std::to_string(i)), 0u);
+  }
+  EXPECT_EQ(queue.Submit("lp0", {1}, 1, "order-1"), first);
+  queue.Shutdown();
+  journal.Close();
+  unlink(path.c_str());
+  rmdir(dir_template);
+}
+
+TEST(PrintQueue, RestoredJobsKeepTheirIds) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  JournaledJob job;
+  job.id = 41;
+  job.printer = "lp0";
+  job.data = {9};
+  std::vector<JournaledJob> jobs;
+  jobs.push_back(job);
+  queue.Restore(std::move(jobs));
+  EXPECT_EQ(queue.Submit("lp0", {10}), 42u);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+}
+
+TEST(PrintQueue, CoalescesSmallJobsUntilFlush) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  CoalesceOptions options;
+  options.enabled = true;
+  options.window = std::chrono::milliseconds(60000);
+  queue.SetCoalesceOptions(options);
+  queue.Submit("lp0", {1});
+  queue.Submit("lp0", {2, 3});
+  queue.Submit("lp0", {4});
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(queue.stats().completed, 0u);
+
+  queue.Flush("lp0");
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 3; }));
+  PrintQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.coalesced_writes, 1u);
+  EXPECT_EQ(stats.coalesced_jobs, 2u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received, std::vector<uint8_t>({1, 2, 3, 4}));
+  EXPECT_EQ(printer->writes, 1);
+}
+
+TEST(PrintQueue, CoalescedBatchStopsAtByteThreshold) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  CoalesceOptions options;
+  options.enabled = true;
+  options.window = std::chrono::milliseconds(60000);
+  options.max_bytes = 4;
+  queue.SetCoalesceOptions(options);
+  queue.Submit("lp0", {1, 2});
+  queue.Submit("lp0", {3, 4});
+  queue.Submit("lp0", {5, 6, 7, 8});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 3; }));
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->writes, 2);
+  EXPECT_EQ(printer->received.size(), 8u);
+}
+
+TEST(PrintQueue, RecordsCopiesAsAMacro) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->answers_queries = true;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.Submit("lp0", {1, 2}, 3);
+  queue.Submit("lp0", {4}, 2);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+  EXPECT_EQ(queue.stats().macro_copies, 3u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  // GS : job GS : GS ^ r 0 0, identifying the printer only once.
+  EXPECT_EQ(printer->received,
+            std::vector<uint8_t>({0x1D, ':', 1, 2, 0x1D, ':', 0x1D, '^', 3, 0,
+                                  0, 0x1D, ':', 4, 0x1D, ':', 0x1D, '^', 2, 0,
+                                  0}));
+  EXPECT_EQ(printer->queries, 2);
+}
+
+TEST(PrintQueue, ResolvesEachPrinterProfileOnce) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->answers_queries = true;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  int resolved = 0;
+  queue.SetProfileResolver([&](Transport*) {
+    resolved++;
+    PrinterProfile profile;
+    profile.name = "TEST";
+    profile.paper_width = 384;
+    profile.macros = MacroSupport::kUnsupported;
+    return profile;
+  });
+  PrinterProfile profile;
+  EXPECT_FALSE(queue.GetProfile("lp0", &profile));
+  EXPECT_EQ(profile.name, "generic");
+  queue.Submit("lp0", {1});
+  queue.Submit("lp0", {2}, 2);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+  ASSERT_TRUE(queue.GetProfile("lp0", &profile));
+  EXPECT_EQ(profile.name, "TEST");
+  EXPECT_EQ(profile.paper_width, 384);
+  EXPECT_EQ(resolved, 1);
+  // The profile ruled out macros, so the printer was not probed.
+  EXPECT_EQ(queue.stats().resent_copies, 1u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->queries, 0);
+}
+
+TEST(PrintQueue, ResendsCopiesWithoutMacros) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.Submit("lp0", {1, 2}, 3);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  // Too large for the printer's macro buffer.
+  printer->answers_queries = true;
+  queue.Submit("lp1", std::vector<uint8_t>(kMacroCapacity, 7), 2);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+  EXPECT_EQ(queue.stats().resent_copies, 3u);
+  EXPECT_EQ(queue.stats().bytes_written, 6 + 2 * kMacroCapacity);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(std::vector<uint8_t>(printer->received.begin(),
+                                 printer->received.begin() + 6),
+            std::vector<uint8_t>({1, 2, 1, 2, 1, 2}));
+  // lp0 cannot answer, so it was not asked who it is.
+  EXPECT_EQ(printer->queries, 0);
+}
+
+TEST(PrintQueue, StreamsFileJobs) {
+  char path[] = "/tmp/tpf_queue_file_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  std::vector<uint8_t> contents(kFileChunkSize + 10, 0x42);
+  ASSERT_EQ(write(fd, contents.data(), contents.size()),
+            static_cast<ssize_t>(contents.size()));
+  close(fd);
+
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  FileJobSpec spec;
+  spec.path = path;
+  EXPECT_EQ(queue.SubmitFile("lp0", spec), 1u);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  EXPECT_EQ(queue.stats().bytes_written, contents.size());
+  {
+    std::lock_guard<std::mutex> lock(printer->mutex);
+    EXPECT_EQ(printer->received, contents);
+    EXPECT_EQ(printer->writes, 2);
+  }
+  unlink(path);
+}
+
+TEST(PrintQueue, StreamsJobsFromAnIoLoop) {
+  auto first = std::make_shared<FakePrinter>();
+  auto second = std::make_shared<FakePrinter>();
+  first->streams = true;
+  first->stalls = 2;
+  second->streams = true;
+  PrintQueue queue(
+      [&](const std::string& name) {
+        return std::unique_ptr<Transport>(
+            new FakeTransport(name == "lp0" ? first : second));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  queue.Submit("lp0", {1, 2});
+  queue.Submit("lp1", {5}, 2);
+  queue.Submit("lp0", {3});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 3; }));
+  EXPECT_EQ(queue.stats().resent_copies, 1u);
+  EXPECT_EQ(queue.stats().bytes_written, 5u);
+  std::lock_guard<std::mutex> first_lock(first->mutex);
+  std::lock_guard<std::mutex> second_lock(second->mutex);
+  EXPECT_EQ(first->received, std::vector<uint8_t>({1, 2, 3}));
+  EXPECT_EQ(first->stalls, 0);
+  EXPECT_EQ(second->received, std::vector<uint8_t>({5, 5}));
+}
+
+TEST(PrintQueue, StreamResumesFromTheLastDeliveredCommand) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  printer->failures_left = 1;
+  printer->partial = 4;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  queue.Submit("lp0", {'A', 'B', 0x1B, 'E', 1, 'C', 'D'});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  EXPECT_EQ(queue.stats().resumed_bytes, 2u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received,
+            std::vector<uint8_t>(
+                {'A', 'B', 0x1B, 'E', 0x1B, 'E', 1, 'C', 'D'}));
+  EXPECT_EQ(printer->opens, 2);
+}
+
+TEST(PrintQueue, TimesBarrierJobsUntilThePrinterAnswers) {
+  for (bool io_loop : {false, true}) {
+    auto printer = std::make_shared<FakePrinter>();
+    printer->answers_status = true;
+    printer->streams = io_loop;
+    PrintQueue queue(
+        [&](const std::string&) {
+          return std::unique_ptr<Transport>(new FakeTransport(printer));
+        },
+        nullptr);
+    if (io_loop) {
+      queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+    }
+    queue.Submit("lp0", {1, 2}, 1, "", true);
+    queue.Submit("lp0", {3});
+    queue.Submit("lp0", {4}, 1, "", true);
+    ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 3; }));
+
+    PrinterLatency latency;
+    ASSERT_TRUE(queue.GetLatency("lp0", &latency));
+    EXPECT_EQ(latency.handoff.samples, 2u);
+    EXPECT_EQ(latency.completion.samples, 2u);
+    EXPECT_EQ(latency.unanswered, 0u);
+    EXPECT_GT(latency.last_completion_ms, 0);
+    EXPECT_FALSE(queue.GetLatency("lp1", &latency));
+    std::lock_guard<std::mutex> lock(printer->mutex);
+    EXPECT_EQ(printer->status_requests, 2);
+    EXPECT_EQ(printer->received, std::vector<uint8_t>({1, 2, 3, 4}));
+  }
+}
+
+TEST(PrintQueue, CountsBarriersThePrinterCannotAnswer) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.Submit("lp0", {1}, 1, "", true);
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  PrinterLatency latency;
+  ASSERT_TRUE(queue.GetLatency("lp0", &latency));
+  EXPECT_EQ(latency.handoff.samples, 1u);
+  EXPECT_EQ(latency.completion.samples, 0u);
+  EXPECT_EQ(latency.unanswered, 0u);
+  EXPECT_EQ(latency.unsupported, 1u);
+}
+
+TEST(PrintQueue, DoesNotSendBarriersToLpdQueues) {
+  for (bool io_loop : {false, true}) {
+    auto printer = std::make_shared<FakePrinter>();
+    printer->answers_status = true;
+    printer->frames_jobs = true;
+    printer->streams = io_loop;
+    PrintQueue queue(
+        [&](const std::string&) {
+          return std::unique_ptr<Transport>(new FakeTransport(printer));
+        },
+        nullptr);
+    if (io_loop) {
+      queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+    }
+    queue.Submit("lp0", {1}, 1, "", true);
+    queue.Submit("lp0", {2}, 1, "", true);
+    ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+    PrinterLatency latency;
+    ASSERT_TRUE(queue.GetLatency("lp0", &latency));
+    EXPECT_EQ(latency.unanswered, 0u);
+    EXPECT_EQ(latency.unsupported, 2u);
+    std::lock_guard<std::mutex> lock(printer->mutex);
+    EXPECT_EQ(printer->status_requests, 0);
+    EXPECT_EQ(printer->received, std::vector<uint8_t>({1, 2}));
+  }
+}
+
+TEST(PrintQueue, SpreadsGroupJobsAcrossItsPrinters) {
+  std::map<std::string, std::shared_ptr<FakePrinter>> printers = {
+      {"lp0", std::make_shared<FakePrinter>()},
+      {"lp1", std::make_shared<FakePrinter>()}};
+  PrintQueue queue(
+      [&](const std::string& printer) {
+        return std::unique_ptr<Transport>(
+            new FakeTransport(printers.at(printer)));
+      },
+      nullptr);
+  EXPECT_FALSE(queue.SetGroup("grill", {"grill"}));
+  ASSERT_TRUE(queue.SetGroup("grill", {"lp0", "lp1"}));
+  EXPECT_FALSE(queue.SetGroup("lp0", {"lp1"}));
+  // Held back, so each job sees the bytes queued before it.
+  CoalesceOptions coalesce;
+  coalesce.enabled = true;
+  coalesce.window = std::chrono::milliseconds(200);
+  queue.SetCoalesceOptions(coalesce);
+  for (int i = 0; i < 4; i++) {
+    queue.Submit("grill", std::vector<uint8_t>(100, static_cast<uint8_t>(i)));
+  }
+  queue.Flush("");
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 4; }));
+
+  std::vector<GroupMemberStats> members;
+  ASSERT_TRUE(queue.GetGroupStats("grill", &members));
+  ASSERT_EQ(members.size(), 2u);
+  for (const GroupMemberStats& member : members) {
+    EXPECT_EQ(member.routed_jobs, 2u);
+    EXPECT_FALSE(member.offline);
+    std::lock_guard<std::mutex> lock(printers.at(member.printer)->mutex);
+    EXPECT_EQ(printers.at(member.printer)->received.size(), 200u);
+  }
+  EXPECT_FALSE(queue.GetGroupStats("bar", &members));
+}
+
+TEST(PrintQueue, MovesGroupJobsOffAFailedPrinter) {
+  std::map<std::string, std::shared_ptr<FakePrinter>> printers = {
+      {"lp0", std::make_shared<FakePrinter>()},
+      {"lp1", std::make_shared<FakePrinter>()}};
+  printers["lp0"]->failures_left = 1000;
+  PrintQueue queue(
+      [&](const std::string& printer) {
+        return std::unique_ptr<Transport>(
+            new FakeTransport(printers.at(printer)));
+      },
+      nullptr);
+  ASSERT_TRUE(queue.SetGroup("grill", {"lp0", "lp1"}));
+  // Goes to lp0, which has nothing queued.
+  queue.Submit("grill", {1, 2, 3});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  // lp0 is offline now, so new jobs skip it.
+  queue.Submit("grill", {4});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+
+  PrintQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.failed, 0u);
+  EXPECT_EQ(stats.failed_over_jobs, 1u);
+  std::vector<GroupMemberStats> members;
+  ASSERT_TRUE(queue.GetGroupStats("grill", &members));
+  EXPECT_TRUE(members[0].offline);
+  EXPECT_EQ(members[0].failed_over_jobs, 1u);
+  EXPECT_FALSE(members[1].offline);
+  EXPECT_EQ(members[1].routed_jobs, 2u);
+  EXPECT_GT(members[1].bytes_per_second, 0);
+  std::lock_guard<std::mutex> lock(printers["lp1"]->mutex);
+  EXPECT_EQ(printers["lp1"]->received, std::vector<uint8_t>({1, 2, 3, 4}));
+}
+
+TEST(PrintQueue, KeepsTheLearnedChunkSizeInTheProfile) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  printer->stalls = ChunkTuner::kSettledStalls;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  queue.SetProfileResolver([](Transport*) { return PrinterProfile(); });
+  queue.Submit("lp0", std::vector<uint8_t>(10000, 'x'));
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  PrinterProfile profile;
+  ASSERT_TRUE(queue.GetProfile("lp0", &profile));
+  // Halved by each stall, then grown by every chunk taken whole.
+  EXPECT_GT(profile.chunk_size,
+            static_cast<int>(ChunkTuner::kInitialChunk >>
+                             ChunkTuner::kSettledStalls));
+  EXPECT_LT(profile.chunk_size, static_cast<int>(ChunkTuner::kInitialChunk));
+  EXPECT_EQ(profile.chunk_pacing_us, 0);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received.size(), 10000u);
+  EXPECT_GT(printer->writes, 1);
+}
+
+TEST(PrintQueue, WritesInAPinnedChunkSize) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  printer->stalls = ChunkTuner::kSettledStalls;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()), 1);
+  queue.SetProfileResolver([](Transport*) { return PrinterProfile(); });
+  queue.SetChunkSize(1000);
+  queue.Submit("lp0", std::vector<uint8_t>(10000, 'x'));
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  // Nothing learned, so nothing kept.
+  PrinterProfile profile;
+  ASSERT_TRUE(queue.GetProfile("lp0", &profile));
+  EXPECT_EQ(profile.chunk_size, 0);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->writes, 10);
+}
+
+TEST(PrintQueue, TellsTheObserverHowEachJobEnded) {
+  for (bool io_loop : {false, true}) {
+    auto printer = std::make_shared<FakePrinter>();
+    printer->streams = io_loop;
+    printer->failures_left = PrintQueue::kMaxAttempts;
+    PrintQueue queue(
+        [&](const std::string&) {
+          return std::unique_ptr<Transport>(new FakeTransport(printer));
+        },
+        nullptr);
+    if (io_loop) {
+      queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+    }
+    std::mutex mutex;
+    std::vector<JobEvent> events;
+    queue.SetJobObserver([&](const JobEvent& event) {
+      std::lock_guard<std::mutex> lock(mutex);
+      events.push_back(event);
+    });
+    uint64_t failed = queue.Submit("lp0", {1, 2, 3});
+    uint64_t printed = queue.Submit("lp0", {4, 5});
+    ASSERT_TRUE(WaitFor([&] {
+      std::lock_guard<std::mutex> lock(mutex);
+      return events.size() == 2;
+    }));
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(events[0].id, failed);
+    EXPECT_FALSE(events[0].success);
+    EXPECT_EQ(events[1].id, printed);
+    EXPECT_TRUE(events[1].success);
+    EXPECT_EQ(events[1].printer, "lp0");
+    EXPECT_EQ(events[1].length, 2u);
+    EXPECT_LE(events[1].queued_at, events[1].started_at);
+    EXPECT_LE(events[1].started_at, events[1].finished_at);
+  }
+}
+
+TEST(PrintQueue, RefusesJobsOverTheMemoryLimit) {
+  auto printer = std::make_shared<FakePrinter>();
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  CoalesceOptions options;
+  options.enabled = true;
+  options.window = std::chrono::seconds(10);
+  queue.SetCoalesceOptions(options);
+  queue.SetMemoryLimit(1000);
+  const std::vector<uint8_t> bytes(600, 'x');
+  // Larger than the limit, but nothing else is queued.
+  EXPECT_NE(queue.Submit("lp0", std::vector<uint8_t>(1200, 'y')), 0u);
+  EXPECT_FALSE(queue.CanQueue(1));
+  EXPECT_EQ(queue.Submit("lp0", bytes.data(), bytes.size()), 0u);
+  queue.Flush("");
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+  EXPECT_NE(queue.Submit("lp0", bytes.data(), bytes.size()), 0u);
+  EXPECT_EQ(queue.Submit("lp0", bytes.data(), bytes.size()), 0u);
+  PrintQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.rejected_jobs, 2u);
+  EXPECT_EQ(stats.queued_bytes, 600u);
+  queue.Flush("");
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+  // The first job's bytes, though not from the pool, were kept in it and
+  // copied into for the next.
+  stats = queue.stats();
+  EXPECT_EQ(stats.queued_bytes, 0u);
+  EXPECT_EQ(stats.buffer_allocations, 0u);
+  EXPECT_EQ(stats.buffer_reuses, 1u);
+}
+
+TEST(PrintQueue, SubmitsABatchInOrder) {
+  std::map<std::string, std::shared_ptr<FakePrinter>> printers = {
+      {"lp0", std::make_shared<FakePrinter>()},
+      {"lp1", std::make_shared<FakePrinter>()}};
+  PrintQueue queue(
+      [&](const std::string& printer) {
+        return std::unique_ptr<Transport>(
+            new FakeTransport(printers.at(printer)));
+      },
+      nullptr);
+  CoalesceOptions options;
+  options.enabled = true;
+  options.window = std::chrono::seconds(10);
+  queue.SetCoalesceOptions(options);
+  queue.SetMemoryLimit(1000);
+  const std::vector<uint8_t> small(100, 's');
+  const std::vector<uint8_t> large(900, 'l');
+  std::vector<BatchJob> jobs(5);
+  const std::vector<uint8_t>* payloads[] = {&small, &small, &small, &large,
+                                            &small};
+  for (size_t i = 0; i < jobs.size(); i++) {
+    jobs[i].printer = i % 2;
+    jobs[i].data = payloads[i]->data();
+    jobs[i].length = payloads[i]->size();
+  }
+  jobs[0].key = "order-17";
+  jobs[2].key = "order-17";
+  std::vector<uint64_t> ids;
+  queue.SubmitBatch({"lp0", "lp1"}, jobs, &ids);
+  ASSERT_EQ(ids.size(), 5u);
+  EXPECT_NE(ids[0], 0u);
+  EXPECT_NE(ids[1], ids[0]);
+  EXPECT_EQ(ids[2], ids[0]);
+  // The large job would go over the limit; the small one after it is
+  // refused with it, so that the batch stays in order.
+  EXPECT_EQ(ids[3], 0u);
+  EXPECT_EQ(ids[4], 0u);
+  PrintQueueStats stats = queue.stats();
+  EXPECT_EQ(stats.submitted, 2u);
+  EXPECT_EQ(stats.deduplicated_jobs, 1u);
+  EXPECT_EQ(stats.rejected_jobs, 2u);
+  EXPECT_EQ(stats.queued_bytes, 200u);
+  queue.Flush("");
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 2; }));
+  for (const auto& entry : printers) {
+    std::lock_guard<std::mutex> lock(entry.second->mutex);
+    EXPECT_EQ(entry.second->received, small);
+  }
+}
+
+TEST(PrintQueue, RefusesBatchesAfterShutdown) {
+  std::atomic<int> transports(0);
+  PrintQueue queue(
+      [&](const std::string&) {
+        transports++;
+        return std::unique_ptr<Transport>(
+            new FakeTransport(std::make_shared<FakePrinter>()));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  queue.Shutdown();
+  const uint8_t ticket[] = {1, 2, 3};
+  BatchJob job;
+  job.data = ticket;
+  job.length = sizeof(ticket);
+  std::vector<uint64_t> ids;
+  queue.SubmitBatch({"lp0"}, {job}, &ids);
+  EXPECT_EQ(ids, std::vector<uint64_t>({0}));
+  EXPECT_EQ(transports, 0);
+}
+
+TEST(PrintQueue, ProbesAWatchedPrinter) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  printer->printer_status = 0x12;
+  printer->paper_status = 0x12;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  std::mutex mutex;
+  std::vector<PrinterStatus> changes;
+  queue.SetStatusObserver(
+      [&](const std::string& name, const PrinterStatus& status) {
+        std::lock_guard<std::mutex> lock(mutex);
+        EXPECT_EQ(name, "lp0");
+        changes.push_back(status);
+      });
+  PrinterStatus status;
+  EXPECT_FALSE(queue.GetStatus("lp0", &status));
+  queue.Watch("lp0");
+  ASSERT_TRUE(WaitFor([&] { return queue.GetStatus("lp0", &status); }));
+  EXPECT_TRUE(status.connected);
+  EXPECT_TRUE(status.online);
+  EXPECT_EQ(status.paper, PaperState::kPresent);
+  {
+    std::lock_guard<std::mutex> lock(printer->mutex);
+    // Offline, for want of paper.
+    printer->printer_status = 0x1A;
+    printer->paper_status = 0x7E;
+  }
+  // Within a probe interval.
+  ASSERT_TRUE(WaitFor([&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return changes.size() == 2;
+  }));
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_TRUE(changes[1].connected);
+  EXPECT_FALSE(changes[1].online);
+  EXPECT_EQ(changes[1].paper, PaperState::kOut);
+}
+
+TEST(PrintQueue, KeepsTheLinkOfAPrinterThatNeverAnswers) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  queue.Watch("lp0");
+  auto probes = [&] {
+    std::vector<TraceEvent> events;
+    queue.flight_recorder()->Snapshot(&events);
+    return std::count_if(events.begin(), events.end(),
+                         [](const TraceEvent& event) {
+                           return event.type == TraceEventType::kStageEnd &&
+                                  event.detail ==
+                                      static_cast<uint8_t>(TraceStage::kProbe);
+                         });
+  };
+  ASSERT_TRUE(WaitFor([&] { return probes() >= 2; }));
+  PrinterStatus status;
+  ASSERT_TRUE(queue.GetStatus("lp0", &status));
+  EXPECT_TRUE(status.connected);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->opens, 1);
+}
+
+TEST(PrintQueue, ReportsAPrinterThatFailedAJob) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  queue.Watch("lp0");
+  PrinterStatus status;
+  // Printers that do not answer DLE EOT are online while connected.
+  ASSERT_TRUE(WaitFor([&] { return queue.GetStatus("lp0", &status); }));
+  EXPECT_TRUE(status.connected);
+  EXPECT_TRUE(status.online);
+  EXPECT_EQ(status.paper, PaperState::kUnknown);
+  {
+    std::lock_guard<std::mutex> lock(printer->mutex);
+    printer->unplugged = true;
+  }
+  queue.Submit("lp0", {1, 2, 3});
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().failed == 1; }));
+  ASSERT_TRUE(queue.GetStatus("lp0", &status));
+  EXPECT_FALSE(status.connected);
+  EXPECT_FALSE(status.online);
+}
+
+TEST(PrintQueue, WarmsUpAPrinterBeforeItsFirstJob) {
+  for (bool io_loop : {false, true}) {
+    SCOPED_TRACE(io_loop ? "IoLoop" : "threads");
+    auto printer = std::make_shared<FakePrinter>();
+    printer->streams = true;
+    // Answers the probe, so the link is not reopened to check it.
+    printer->printer_status = 0x12;
+    printer->paper_status = 0x12;
+    PrintQueue queue(
+        [&](const std::string&) {
+          return std::unique_ptr<Transport>(new FakeTransport(printer));
+        },
+        nullptr);
+    if (io_loop) {
+      queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+    }
+    std::atomic<int> resolved(0);
+    queue.SetProfileResolver([&](Transport*) {
+      resolved++;
+      PrinterProfile profile;
+      profile.paper_width = 384;
+      return profile;
+    });
+    std::mutex mutex;
+    std::vector<std::string> preloaded;
+    queue.SetSourceFactory(
+        [&](const FileJobSpec& spec, const PrinterProfile& profile) {
+          std::lock_guard<std::mutex> lock(mutex);
+          // Read with the printer's own profile.
+          EXPECT_EQ(profile.paper_width, 384);
+          preloaded.push_back(spec.path);
+          return std::unique_ptr<JobSource>();
+        });
+    FileJobSpec logo;
+    logo.path = "/tmp/logo.png";
+    logo.format = FileFormat::kImage;
+    queue.WarmUp("lp0", {logo});
+    PrinterStatus status;
+    ASSERT_TRUE(WaitFor([&] {
+      return queue.GetStatus("lp0", &status) && status.ready;
+    }));
+    EXPECT_TRUE(status.connected);
+    EXPECT_EQ(resolved, 1);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      EXPECT_EQ(preloaded, std::vector<std::string>({"/tmp/logo.png"}));
+    }
+    {
+      std::lock_guard<std::mutex> lock(printer->mutex);
+      EXPECT_EQ(printer->opens, 1);
+    }
+
+    // The job finds the link open and the printer identified.
+    queue.Submit("lp0", {1, 2, 3});
+    ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 1; }));
+    EXPECT_EQ(resolved, 1);
+    std::lock_guard<std::mutex> lock(printer->mutex);
+    EXPECT_EQ(printer->opens, 1);
+    EXPECT_EQ(printer->received, std::vector<uint8_t>({1, 2, 3}));
+  }
+}
+
+TEST(PrintQueue, WarmsUpPrintersAtOnceOnAnIoLoop) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()), 1);
+  // Every printer is still identifying while the others are.
+  std::mutex mutex;
+  std::condition_variable identified;
+  int identifying = 0;
+  queue.SetProfileResolver([&](Transport*) {
+    std::unique_lock<std::mutex> lock(mutex);
+    identifying++;
+    identified.notify_all();
+    identified.wait_for(lock, std::chrono::seconds(5),
+                        [&] { return identifying == 4; });
+    return PrinterProfile();
+  });
+  for (int i = 0; i < 4; i++) {
+    queue.WarmUp("lp" + std::to_string(i));
+  }
+  for (int i = 0; i < 4; i++) {
+    PrinterStatus status;
+    ASSERT_TRUE(WaitFor([&] {
+      return queue.GetStatus("lp" + std::to_string(i), &status) &&
+             status.ready;
+    }));
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_EQ(identifying, 4);
+}
+
+TEST(PrintQueue, ReportsAnUnpluggedPrinterAsNotReady) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->unplugged = true;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.WarmUp("lp0");
+  PrinterStatus status;
+  ASSERT_TRUE(WaitFor([&] { return queue.GetStatus("lp0", &status); }));
+  EXPECT_FALSE(status.connected);
+  EXPECT_FALSE(status.ready);
+}
+
+TEST(PrintQueue, CoalescesOnAnIoLoop) {
+  auto printer = std::make_shared<FakePrinter>();
+  printer->streams = true;
+  PrintQueue queue(
+      [&](const std::string&) {
+        return std::unique_ptr<Transport>(new FakeTransport(printer));
+      },
+      nullptr);
+  queue.SetIoLoop(std::unique_ptr<IoLoop>(new PollIoLoop()));
+  CoalesceOptions options;
+  options.enabled = true;
+  options.window = std::chrono::milliseconds(100);
+  queue.SetCoalesceOptions(options);
+  queue.Submit("lp0", {1});
+  queue.Submit("lp0", {2});
+  queue.Submit("lp0", {3});
+  // The window closes on a loop timer, without a Flush().
+  ASSERT_TRUE(WaitFor([&] { return queue.stats().completed == 3; }));
+  EXPECT_EQ(queue.stats().coalesced_writes, 1u);
+  std::lock_guard<std::mutex> lock(printer->mutex);
+  EXPECT_EQ(printer->received, std::vector<uint8_t>({1, 2, 3}));
+  EXPECT_EQ(printer->writes, 1);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "core/printer_profile.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+// Answers GS I 66 and 67 with |maker| and |model|, and reports |device_id|
+// if it is not empty.
+class QueryTransport : public Transport {
+ public:
+  bool Open() override { return true; }
+  void Close() override {}
+  bool IsOpen() const override { return true; }
+  bool Write(const uint8_t* data, size_t length) override {
+    if (length == 3 && data[0] == 0x1D && data[1] == 'I') {
+      queries++;
+      const std::string& text = data[2] == 66 ? maker : model;
+      if (answers) {
+        pending.push_back(0x5F);
+        pending.insert(pending.end(), text.begin(), text.end());
+        pending.push_back(0);
+      }
+    }
+    return true;
+  }
+  ssize_t Read(uint8_t* data, size_t length, int timeout_ms) override {
+    if (!readable) {
+      return -1;
+    }
+    size_t count = std::min(length, pending.size());
+    std::copy(pending.begin(), pending.begin() + count, data);
+    pending.erase(pending.begin(), pending.begin() + count);
+    return static_cast<ssize_t>(count);
+  }
+  bool ReadDeviceId(std::string* id) override {
+    if (device_id.empty()) {
+      return false;
+    }
+    *id = device_id;
+    return true;
+  }
+  bool FramesJobs() const override { return frames; }
+
+  bool readable = true;
+  bool answers = true;
+  bool frames = false;
+  std::string maker = "EPSON";
+  std::string model = "TM-T20II";
+  std::string device_id;
+  std::deque<uint8_t> pending;
+  int queries = 0;
+};
+
+}  // namespace
+
+TEST(PrinterProfile, ParsesDeviceIds) {
+  DeviceId id;
+  ASSERT_TRUE(ParseDeviceId(
+      "MFG:EPSON;CMD:ESC/POS;MDL:TM-T88V;CLS:PRINTER;DES:EPSON TM-T88V;",
+      &id));
+  EXPECT_EQ(id.manufacturer, "EPSON");
+  EXPECT_EQ(id.model, "TM-T88V");
+  EXPECT_EQ(id.command_set, "ESC/POS");
+
+  ASSERT_TRUE(ParseDeviceId("MANUFACTURER: Xprinter ;MODEL:XP-58IIH", &id));
+  EXPECT_EQ(id.manufacturer, "Xprinter");
+  EXPECT_EQ(id.model, "XP-58IIH");
+  EXPECT_EQ(id.command_set, "");
+
+  EXPECT_FALSE(ParseDeviceId("CLS:PRINTER;", &id));
+  EXPECT_FALSE(ParseDeviceId("", &id));
+}
+
+TEST(PrinterProfile, MatchesTheTable) {
+  DeviceId id;
+  PrinterProfile profile;
+  id.manufacturer = "Epson";
+  id.model = "EPSON TM-P20";
+  ASSERT_TRUE(LookupProfile(id, &profile));
+  EXPECT_EQ(profile.name, "EPSON TM-P20");
+  EXPECT_EQ(profile.paper_width, 384);
+  EXPECT_EQ(profile.macros, MacroSupport::kSupported);
+
+  // Clones report all sorts of makers; the model name decides.
+  id.manufacturer = "Zjiang";
+  id.model = "POS-58";
+  ASSERT_TRUE(LookupProfile(id, &profile));
+  EXPECT_EQ(profile.band_height, 64);
+  EXPECT_EQ(profile.macros, MacroSupport::kUnsupported);
+
+  id.manufacturer = "ACME";
+  id.model = "Receipt 3000";
+  EXPECT_FALSE(LookupProfile(id, &profile));
+  EXPECT_EQ(profile.name, "generic");
+  EXPECT_EQ(profile.paper_width, 576);
+  EXPECT_EQ(profile.band_height, 128);
+  EXPECT_EQ(profile.id.model, "Receipt 3000");
+}
+
+TEST(PrinterProfile, PrefersTheLinkDeviceId) {
+  QueryTransport transport;
+  transport.device_id = "MFG:EPSON;MDL:TM-m30;CMD:ESC/POS;";
+  PrinterProfile profile = ResolvePrinterProfile(&transport);
+  EXPECT_EQ(profile.name, "EPSON TM-m30");
+  EXPECT_EQ(profile.band_height, 256);
+  EXPECT_EQ(transport.queries, 0);
+}
+
+TEST(PrinterProfile, QueriesMakerAndModel) {
+  QueryTransport transport;
+  PrinterProfile profile = ResolvePrinterProfile(&transport);
+  EXPECT_EQ(profile.name, "EPSON TM-T20");
+  EXPECT_EQ(profile.id.model, "TM-T20II");
+  EXPECT_EQ(profile.macros, MacroSupport::kSupported);
+  EXPECT_EQ(ProbeMacroSupport(&transport), MacroSupport::kSupported);
+  EXPECT_EQ(transport.queries, 4);
+
+  // Answering GS I does not make an unknown printer one with macros.
+  transport.maker = "ACME";
+  transport.model = "R1";
+  profile = ResolvePrinterProfile(&transport);
+  EXPECT_EQ(profile.name, "generic");
+  EXPECT_EQ(profile.macros, MacroSupport::kUnsupported);
+  EXPECT_EQ(ProbeMacroSupport(&transport), MacroSupport::kUnsupported);
+}
+
+TEST(PrinterProfile, FallsBackToGeneric) {
+  QueryTransport silent;
+  silent.answers = false;
+  PrinterProfile profile = ResolvePrinterProfile(&silent);
+  EXPECT_EQ(profile.name, "generic");
+  EXPECT_EQ(profile.macros, MacroSupport::kUnsupported);
+  EXPECT_EQ(silent.queries, 1);
+
+  QueryTransport write_only;
+  write_only.readable = false;
+  profile = ResolvePrinterProfile(&write_only);
+  EXPECT_EQ(profile.name, "generic");
+  EXPECT_EQ(profile.macros, MacroSupport::kUnsupported);
+  EXPECT_EQ(write_only.queries, 0);
+  EXPECT_EQ(ProbeMacroSupport(&write_only), MacroSupport::kUnsupported);
+  EXPECT_EQ(write_only.queries, 0);
+
+  // An LPD queue would print every query as a job of its own.
+  QueryTransport lpd;
+  lpd.frames = true;
+  profile = ResolvePrinterProfile(&lpd);
+  EXPECT_EQ(profile.macros, MacroSupport::kUnsupported);
+  EXPECT_EQ(ProbeMacroSupport(&lpd), MacroSupport::kUnsupported);
+  EXPECT_EQ(lpd.queries, 0);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
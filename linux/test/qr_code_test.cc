@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/qr_code.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+// The 15 format bits from around the top left finder, first bit first.
+int ReadFormat(const QrCode& code) {
+  int bits = 0;
+  for (int x : {0, 1, 2, 3, 4, 5, 7, 8}) {
+    bits = bits << 1 | (code.module(x, 8) ? 1 : 0);
+  }
+  for (int y : {7, 5, 4, 3, 2, 1, 0}) {
+    bits = bits << 1 | (code.module(8, y) ? 1 : 0);
+  }
+  return bits ^ 0x5412;
+}
+
+}  // namespace
+
+TEST(QrCode, ComputesReedSolomonCodewords) {
+  // "HELLO WORLD" as a 1-M symbol.
+  std::vector<uint8_t> data = {32, 91, 11, 120, 209, 114, 220, 77,
+                               67, 64, 236, 17, 236, 17, 236, 17};
+  EXPECT_EQ(QrErrorCorrection(data, 10),
+            std::vector<uint8_t>(
+                {196, 35, 39, 119, 235, 215, 231, 226, 93, 23}));
+}
+
+TEST(QrCode, PicksTheSmallestVersionForTheMode) {
+  QrCode code;
+  // Version 1-L holds 41 digits, 25 alphanumeric characters or 17 bytes.
+  ASSERT_TRUE(QrCode::Encode(std::string(41, '7'), QrEcc::kLow, &code));
+  EXPECT_EQ(code.version(), 1);
+  ASSERT_TRUE(QrCode::Encode(std::string(42, '7'), QrEcc::kLow, &code));
+  EXPECT_EQ(code.version(), 2);
+  ASSERT_TRUE(QrCode::Encode(std::string(25, 'A'), QrEcc::kLow, &code));
+  EXPECT_EQ(code.version(), 1);
+  ASSERT_TRUE(QrCode::Encode(std::string(17, 'a'), QrEcc::kLow, &code));
+  EXPECT_EQ(code.version(), 1);
+  EXPECT_EQ(code.size(), 21);
+  ASSERT_TRUE(QrCode::Encode(std::string(17, 'a'), QrEcc::kHigh, &code));
+  EXPECT_EQ(code.version(), 3);
+  EXPECT_EQ(code.size(), 29);
+}
+
+TEST(QrCode, RejectsTextLargerThanVersion40) {
+  QrCode code;
+  EXPECT_TRUE(QrCode::Encode(std::string(2953, 'a'), QrEcc::kLow, &code));
+  EXPECT_EQ(code.version(), 40);
+  EXPECT_FALSE(QrCode::Encode(std::string(2954, 'a'), QrEcc::kLow, &code));
+}
+
+TEST(QrCode, DrawsFindersTimingAndFormat) {
+  const int kLevelBits[] = {1, 0, 3, 2};
+  const QrEcc levels[] = {QrEcc::kLow, QrEcc::kMedium, QrEcc::kQuartile,
+                          QrEcc::kHigh};
+  for (int level = 0; level < 4; level++) {
+    QrCode code;
+    ASSERT_TRUE(QrCode::Encode("https://example.com/pix?id=000123",
+                               levels[level], &code));
+    const int n = code.size();
+    for (int i = 0; i < 7; i++) {
+      // Finder outlines.
+      EXPECT_TRUE(code.module(i, 0));
+      EXPECT_TRUE(code.module(n - 1 - i, 6));
+      EXPECT_TRUE(code.module(0, n - 1 - i));
+    }
+    for (int i = 8; i < n - 8; i++) {
+      EXPECT_EQ(code.module(i, 6), i % 2 == 0);
+      EXPECT_EQ(code.module(6, i), i % 2 == 0);
+    }
+    int format = ReadFormat(code);
+    EXPECT_EQ(format >> 13, kLevelBits[level]);
+    // A valid BCH(15,5) codeword leaves no remainder.
+    int remainder = format;
+    for (int bit = 14; bit >= 10; bit--) {
+      if ((remainder >> bit) & 1) {
+        remainder ^= 0x537 << (bit - 10);
+      }
+    }
+    EXPECT_EQ(remainder, 0);
+  }
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "core/raster_encoder.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+struct Band {
+  int bytes_per_row;
+  int rows;
+  std::vector<uint8_t> data;
+};
+
+// Splits encoder output back into its GS v 0 commands.
+std::vector<Band> ParseBands(const std::vector<uint8_t>& output) {
+  std::vector<Band> bands;
+  size_t offset = 0;
+  while (offset + 8 <= output.size()) {
+    EXPECT_EQ(output[offset], 0x1D);
+    EXPECT_EQ(output[offset + 1], 0x76);
+    EXPECT_EQ(output[offset + 2], 0x30);
+    Band band;
+    band.bytes_per_row = output[offset + 4] | (output[offset + 5] << 8);
+    band.rows = output[offset + 6] | (output[offset + 7] << 8);
+    size_t length = static_cast<size_t>(band.bytes_per_row) * band.rows;
+    band.data.assign(output.begin() + offset + 8,
+                     output.begin() + offset + 8 + length);
+    bands.push_back(band);
+    offset += 8 + length;
+  }
+  EXPECT_EQ(offset, output.size());
+  return bands;
+}
+
+RasterEncoder::Sink AppendTo(std::vector<uint8_t>* output) {
+  return [output](const uint8_t* data, size_t length) {
+    output->insert(output->end(), data, data + length);
+    return true;
+  };
+}
+
+// A 64x48 gray gradient with |line| drawn as a dark row, encoded in bands of
+// 16 rows through |cache|.
+std::vector<uint8_t> EncodeReceipt(int line, BandCache* cache,
+                                   BandStats* stats) {
+  RasterOptions options;
+  options.width = 64;
+  options.band_height = 16;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(64, 48, options, AppendTo(&output));
+  encoder.SetBandCache(cache);
+  std::vector<uint8_t> row(64);
+  for (int y = 0; y < 48; y++) {
+    for (int x = 0; x < 64; x++) {
+      row[x] = y == line ? 0 : static_cast<uint8_t>(x * 3 + y);
+    }
+    EXPECT_TRUE(encoder.PushRow(row.data(), 1));
+  }
+  EXPECT_TRUE(encoder.Finish());
+  if (stats != nullptr) {
+    *stats = encoder.band_stats();
+  }
+  return output;
+}
+
+}  // namespace
+
+TEST(RasterEncoder, PacksRowsAtNativeWidth) {
+  RasterOptions options;
+  options.width = 16;
+  options.dither = DitherMode::kThreshold;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(16, 2, options, AppendTo(&output));
+  std::vector<uint8_t> row(16, 255);
+  for (int x = 0; x < 8; x++) {
+    row[x] = 0;
+  }
+  ASSERT_TRUE(encoder.PushRow(row.data(), 1));
+  ASSERT_TRUE(encoder.PushRow(row.data(), 1));
+  ASSERT_TRUE(encoder.Finish());
+
+  std::vector<Band> bands = ParseBands(output);
+  ASSERT_EQ(bands.size(), 1u);
+  EXPECT_EQ(bands[0].bytes_per_row, 2);
+  EXPECT_EQ(bands[0].rows, 2);
+  EXPECT_EQ(bands[0].data, std::vector<uint8_t>({0xFF, 0x00, 0xFF, 0x00}));
+}
+
+TEST(RasterEncoder, DownscalesByAveraging) {
+  RasterOptions options;
+  options.width = 8;
+  options.threshold = 100;
+  options.dither = DitherMode::kThreshold;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(16, 4, options, AppendTo(&output));
+  EXPECT_EQ(encoder.height(), 2);
+  // Column pairs average to 0, 127.5 and 255: only the first pair prints.
+  std::vector<uint8_t> row = {0,   0,   0,   255, 255, 255, 255, 255,
+                              255, 255, 255, 255, 255, 255, 255, 255};
+  for (int y = 0; y < 4; y++) {
+    ASSERT_TRUE(encoder.PushRow(row.data(), 1));
+  }
+  ASSERT_TRUE(encoder.Finish());
+  std::vector<Band> bands = ParseBands(output);
+  ASSERT_EQ(bands.size(), 1u);
+  EXPECT_EQ(bands[0].data, std::vector<uint8_t>({0x80, 0x80}));
+}
+
+TEST(RasterEncoder, MirrorsRowsAsTheyStream) {
+  RasterOptions options;
+  options.width = 16;
+  options.dither = DitherMode::kThreshold;
+  options.mirror = true;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(16, 1, options, AppendTo(&output));
+  std::vector<uint8_t> row(16, 255);
+  row[0] = 0;
+  ASSERT_TRUE(encoder.PushRow(row.data(), 1));
+  ASSERT_TRUE(encoder.Finish());
+  std::vector<Band> bands = ParseBands(output);
+  ASSERT_EQ(bands.size(), 1u);
+  EXPECT_EQ(bands[0].data, std::vector<uint8_t>({0x00, 0x01}));
+}
+
+TEST(RasterEncoder, QuarterTurnPutsSourceHeightAcrossThePaper) {
+  RasterOptions options;
+  options.width = 8;
+  options.dither = DitherMode::kThreshold;
+  options.rotation = Rotation::k90;
+  options.band_height = 10;
+  std::vector<uint8_t> output;
+  // Landscape source, left half black.
+  RasterEncoder encoder(16, 8, options, AppendTo(&output));
+  EXPECT_EQ(encoder.width(), 8);
+  EXPECT_EQ(encoder.height(), 16);
+  std::vector<uint8_t> row(16, 255);
+  for (int x = 0; x < 8; x++) {
+    row[x] = 0;
+  }
+  for (int y = 0; y < 8; y++) {
+    ASSERT_TRUE(encoder.PushRow(row.data(), 1));
+  }
+  ASSERT_TRUE(encoder.Finish());
+
+  std::vector<Band> bands = ParseBands(output);
+  ASSERT_EQ(bands.size(), 2u);
+  EXPECT_EQ(bands[0].rows, 10);
+  EXPECT_EQ(bands[1].rows, 6);
+  std::vector<uint8_t> rows = bands[0].data;
+  rows.insert(rows.end(), bands[1].data.begin(), bands[1].data.end());
+  // Turned clockwise, the left half is on top.
+  std::vector<uint8_t> expected(16, 0x00);
+  std::fill(expected.begin(), expected.begin() + 8, 0xFF);
+  EXPECT_EQ(rows, expected);
+}
+
+TEST(RasterEncoder, SplitsOutputIntoBands) {
+  RasterOptions options;
+  options.width = 8;
+  options.band_height = 2;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(8, 5, options, AppendTo(&output));
+  std::vector<uint8_t> row(8, 0);
+  for (int y = 0; y < 5; y++) {
+    ASSERT_TRUE(encoder.PushRow(row.data(), 1));
+  }
+  ASSERT_TRUE(encoder.Finish());
+  std::vector<Band> bands = ParseBands(output);
+  ASSERT_EQ(bands.size(), 3u);
+  EXPECT_EQ(bands[0].rows, 2);
+  EXPECT_EQ(bands[1].rows, 2);
+  EXPECT_EQ(bands[2].rows, 1);
+}
+
+TEST(RasterEncoder, TransparentPixelsAreWhite) {
+  RasterOptions options;
+  options.width = 8;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(8, 1, options, AppendTo(&output));
+  std::vector<uint8_t> row(8 * 4, 0);  // Black, fully transparent.
+  ASSERT_TRUE(encoder.PushRow(row.data(), 4));
+  ASSERT_TRUE(encoder.Finish());
+  std::vector<Band> bands = ParseBands(output);
+  ASSERT_EQ(bands.size(), 1u);
+  EXPECT_EQ(bands[0].data, std::vector<uint8_t>({0x00}));
+}
+
+TEST(RasterEncoder, DitheredMidGrayPrintsAboutHalfTheDots) {
+  RasterOptions options;
+  options.width = 64;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(64, 64, options, AppendTo(&output));
+  std::vector<uint8_t> row(64 * 3, 128);
+  for (int y = 0; y < 64; y++) {
+    ASSERT_TRUE(encoder.PushRow(row.data(), 3));
+  }
+  ASSERT_TRUE(encoder.Finish());
+  int dots = 0;
+  for (const Band& band : ParseBands(output)) {
+    for (uint8_t byte : band.data) {
+      dots += __builtin_popcount(byte);
+    }
+  }
+  EXPECT_NEAR(dots, 64 * 64 / 2, 64 * 64 / 20);
+}
+
+TEST(RasterEncoder, FinishPadsMissingRows) {
+  RasterOptions options;
+  options.width = 8;
+  std::vector<uint8_t> output;
+  RasterEncoder encoder(8, 3, options, AppendTo(&output));
+  std::vector<uint8_t> row(8, 0);
+  ASSERT_TRUE(encoder.PushRow(row.data(), 1));
+  ASSERT_TRUE(encoder.Finish());
+  std::vector<Band> bands = ParseBands(output);
+  ASSERT_EQ(bands.size(), 1u);
+  EXPECT_EQ(bands[0].data, std::vector<uint8_t>({0xFF, 0x00, 0x00}));
+}
+
+TEST(RasterEncoder, ReusesBandsFromTheCache) {
+  BandCache cache;
+  BandStats stats;
+  std::vector<Band> first = ParseBands(EncodeReceipt(20, &cache, &stats));
+  EXPECT_EQ(stats.bands, 3);
+  EXPECT_EQ(stats.reused, 0);
+
+  // Only the middle band differs.
+  std::vector<uint8_t> output = EncodeReceipt(24, &cache, &stats);
+  EXPECT_EQ(stats.bands, 3);
+  EXPECT_EQ(stats.reused, 2);
+  std::vector<Band> second = ParseBands(output);
+  ASSERT_EQ(second.size(), 3u);
+  EXPECT_EQ(second[0].data, first[0].data);
+  EXPECT_NE(second[1].data, first[1].data);
+  EXPECT_EQ(second[2].data, first[2].data);
+
+  // Reused bands are the ones a fresh cache would have dithered.
+  BandCache fresh;
+  EXPECT_EQ(EncodeReceipt(24, &fresh, nullptr), output);
+  EXPECT_EQ(cache.stats().bands, 6u);
+  EXPECT_EQ(cache.stats().reused, 2u);
+  EXPECT_EQ(cache.stats().last_job.reused, 2);
+
+  // The first band has no error carried in, memoized or not.
+  EXPECT_EQ(ParseBands(EncodeReceipt(24, nullptr, nullptr))[0].data,
+            first[0].data);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "core/bitmap_transform.h"
+#include "core/raster_kernels.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+// Gray rows with every level and some runs, so that error is carried.
+std::vector<float> GrayRows(int width, int rows) {
+  std::vector<float> gray(static_cast<size_t>(width) * rows);
+  for (size_t i = 0; i < gray.size(); i++) {
+    gray[i] = static_cast<float>((i * 37 + i / 11) % 256);
+  }
+  return gray;
+}
+
+// Runs |kernels| over |rows| rows, as the raster encoder does, and returns
+// the packed dots.
+std::vector<uint8_t> Pack(const RasterKernels& kernels, int width, int rows,
+                          bool dither) {
+  std::vector<float> gray = GrayRows(width, rows);
+  std::vector<float> current(width + 2, 0.0f);
+  std::vector<float> next(width + 2, 0.0f);
+  std::vector<uint8_t> packed(PackedStride(width) * rows);
+  for (int row = 0; row < rows; row++) {
+    const float* line = gray.data() + static_cast<size_t>(row) * width;
+    uint8_t* out = packed.data() + PackedStride(width) * row;
+    if (dither) {
+      kernels.dither(line, width, 128.0f, current.data() + 1,
+                     next.data() + 1, out);
+      current.swap(next);
+    } else {
+      kernels.threshold(line, width, 128.0f, out);
+    }
+  }
+  return packed;
+}
+
+}  // namespace
+
+TEST(RasterKernels, SpecializesStandardPaperWidths) {
+  for (int width : {384, 512, 576}) {
+    EXPECT_EQ(RasterKernelsFor(width).fixed_width, width);
+  }
+  EXPECT_EQ(RasterKernelsFor(500).fixed_width, 0);
+  EXPECT_EQ(&RasterKernelsFor(13), &GenericRasterKernels());
+}
+
+TEST(RasterKernels, SpecializedKernelsMatchTheGenericOnes) {
+  for (int width : {384, 512, 576}) {
+    const RasterKernels& fixed = RasterKernelsFor(width);
+    const RasterKernels& generic = GenericRasterKernels();
+    for (bool dither : {false, true}) {
+      EXPECT_EQ(Pack(fixed, width, 16, dither),
+                Pack(generic, width, 16, dither))
+          << width << (dither ? " dithered" : "");
+    }
+    std::vector<float> row = GrayRows(width, 1);
+    std::vector<float> fixed_sum(width, 1.0f);
+    std::vector<float> generic_sum(width, 1.0f);
+    fixed.accumulate(row.data(), width, 0.25f, fixed_sum.data());
+    generic.accumulate(row.data(), width, 0.25f, generic_sum.data());
+    EXPECT_EQ(fixed_sum, generic_sum);
+  }
+}
+
+TEST(RasterKernels, PacksAPartialLastByte) {
+  // 13 dots: black, white alternating, in two bytes.
+  std::vector<float> gray(13);
+  for (int x = 0; x < 13; x++) {
+    gray[x] = x % 2 == 0 ? 0.0f : 255.0f;
+  }
+  uint8_t packed[2] = {0xFF, 0xFF};
+  GenericRasterKernels().threshold(gray.data(), 13, 128.0f, packed);
+  EXPECT_EQ(packed[0], 0xAA);
+  EXPECT_EQ(packed[1], 0xA8);
+
+  // Pure black and white leave no error to carry.
+  std::vector<float> current(15, 0.0f);
+  std::vector<float> next(15, 9.0f);
+  packed[0] = packed[1] = 0;
+  GenericRasterKernels().dither(gray.data(), 13, 128.0f, current.data() + 1,
+                                next.data() + 1, packed);
+  EXPECT_EQ(packed[0], 0xAA);
+  EXPECT_EQ(packed[1], 0xA8);
+  for (float error : next) {
+    EXPECT_EQ(error, 0.0f);
+  }
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
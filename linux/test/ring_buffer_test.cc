@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "core/ring_buffer.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+TEST(RingBuffer, KeepsOrderAcrossWrapAndGrowth) {
+  RingBuffer<int> ring;
+  EXPECT_TRUE(ring.empty());
+  int next_in = 0;
+  int next_out = 0;
+  // Wraps around the first eight slots, then grows while wrapped.
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < 5; i++) {
+      ring.push_back(next_in++);
+    }
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(ring.front(), next_out++);
+      ring.pop_front();
+    }
+  }
+  for (int i = 0; i < 20; i++) {
+    ring.push_back(next_in++);
+  }
+  ASSERT_EQ(ring.size(), static_cast<size_t>(next_in - next_out));
+  EXPECT_EQ(ring[1], next_out + 1);
+  while (!ring.empty()) {
+    EXPECT_EQ(ring.front(), next_out++);
+    ring.pop_front();
+  }
+}
+
+TEST(RingBuffer, ReleasesWhatItPops) {
+  RingBuffer<std::shared_ptr<int>> ring;
+  auto value = std::make_shared<int>(1);
+  ring.push_back(value);
+  EXPECT_EQ(value.use_count(), 2);
+  ring.pop_front();
+  EXPECT_EQ(value.use_count(), 1);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
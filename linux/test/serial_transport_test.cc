@@ -0,0 +1,161 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/serial_transport.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+// A pseudo-terminal pair standing in for a serial printer: the transport
+// opens the slave side and the test plays the printer on the master.
+class PtyPair {
+ public:
+  PtyPair() {
+    master_ = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_ >= 0 && grantpt(master_) == 0 && unlockpt(master_) == 0) {
+      slave_path_ = ptsname(master_);
+    }
+  }
+  ~PtyPair() {
+    if (master_ >= 0) {
+      close(master_);
+    }
+  }
+
+  int master() const { return master_; }
+  const std::string& slave_path() const { return slave_path_; }
+
+  std::vector<uint8_t> ReadMaster(size_t expected) {
+    std::vector<uint8_t> received;
+    while (received.size() < expected) {
+      struct pollfd pfd = {master_, POLLIN, 0};
+      if (poll(&pfd, 1, 1000) <= 0) {
+        break;
+      }
+      uint8_t buffer[256];
+      ssize_t n = read(master_, buffer, sizeof(buffer));
+      if (n <= 0) {
+        break;
+      }
+      received.insert(received.end(), buffer, buffer + n);
+    }
+    return received;
+  }
+
+ private:
+  int master_ = -1;
+  std::string slave_path_;
+};
+
+struct termios SlaveSettings(const std::string& path) {
+  struct termios tio = {};
+  int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  tcgetattr(fd, &tio);
+  close(fd);
+  return tio;
+}
+
+}  // namespace
+
+TEST(SerialTransport, WritesRawBytesAtConfiguredRate) {
+  PtyPair pty;
+  ASSERT_FALSE(pty.slave_path().empty());
+  SerialOptions options;
+  options.baud_rate = 921600;
+  SerialTransport transport(pty.slave_path(), [&] { return options; });
+  ASSERT_TRUE(transport.Open());
+  EXPECT_EQ(transport.baud_rate(), 921600);
+
+  struct termios tio = SlaveSettings(pty.slave_path());
+  EXPECT_EQ(cfgetospeed(&tio), static_cast<speed_t>(B921600));
+  EXPECT_EQ(tio.c_oflag & OPOST, 0u);
+
+  // Bytes that a cooked tty would translate must arrive untouched.
+  std::vector<uint8_t> job = {0x1b, 0x40, '\n', 0x0d, 0x11, 0x13, 0xff};
+  ASSERT_TRUE(transport.Write(job.data(), job.size()));
+  EXPECT_EQ(pty.ReadMaster(job.size()), job);
+}
+
+TEST(SerialTransport, AppliesFlowControl) {
+  PtyPair pty;
+  ASSERT_FALSE(pty.slave_path().empty());
+  SerialOptions options;
+  options.flow_control = FlowControl::kXonXoff;
+  SerialTransport transport(pty.slave_path(), [&] { return options; });
+  ASSERT_TRUE(transport.Open());
+  struct termios tio = SlaveSettings(pty.slave_path());
+  EXPECT_NE(tio.c_iflag & IXON, 0u);
+  EXPECT_NE(tio.c_iflag & IXOFF, 0u);
+
+  // Switching options takes effect on the next write without reopening.
+  options.flow_control = FlowControl::kNone;
+  options.baud_rate = 115200;
+  uint8_t byte = 0x0a;
+  ASSERT_TRUE(transport.Write(&byte, 1));
+  tio = SlaveSettings(pty.slave_path());
+  EXPECT_EQ(tio.c_iflag & IXON, 0u);
+  EXPECT_EQ(cfgetospeed(&tio), static_cast<speed_t>(B115200));
+}
+
+TEST(SerialTransport, ProbesBaudRate) {
+  PtyPair pty;
+  ASSERT_FALSE(pty.slave_path().empty());
+  // The fake printer only understands 115200 baud. Master and slave share
+  // one termios, so it can see which rate the transport is trying.
+  std::atomic<bool> done(false);
+  std::thread printer([&] {
+    while (!done) {
+      struct pollfd pfd = {pty.master(), POLLIN, 0};
+      if (poll(&pfd, 1, 20) <= 0) {
+        continue;
+      }
+      uint8_t request[16];
+      ssize_t n = read(pty.master(), request, sizeof(request));
+      struct termios tio = {};
+      tcgetattr(pty.master(), &tio);
+      if (n == 3 && request[0] == 0x10 && request[1] == 0x04 &&
+          cfgetospeed(&tio) == B115200) {
+        uint8_t status = 0x12;
+        ASSERT_EQ(write(pty.master(), &status, 1), 1);
+      }
+    }
+  });
+
+  SerialOptions options;
+  options.baud_rate = 0;
+  SerialTransport transport(pty.slave_path(), [&] { return options; });
+  ASSERT_TRUE(transport.Open());
+  EXPECT_EQ(transport.baud_rate(), 115200);
+  done = true;
+  printer.join();
+
+  // A reconnect reuses the probed rate instead of probing again.
+  transport.Close();
+  ASSERT_TRUE(transport.Open());
+  EXPECT_EQ(transport.baud_rate(), 115200);
+}
+
+TEST(SerialTransport, ValidatesOptions) {
+  EXPECT_TRUE(IsSupportedBaudRate(9600));
+  EXPECT_TRUE(IsSupportedBaudRate(921600));
+  EXPECT_FALSE(IsSupportedBaudRate(12345));
+  FlowControl flow_control = FlowControl::kNone;
+  EXPECT_TRUE(ParseFlowControl("rtscts", &flow_control));
+  EXPECT_EQ(flow_control, FlowControl::kRtsCts);
+  EXPECT_FALSE(ParseFlowControl("dtrdsr", &flow_control));
+  EXPECT_EQ(flow_control, FlowControl::kRtsCts);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
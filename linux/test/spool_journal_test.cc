@@ -0,0 +1,382 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/spool_journal.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+class SpoolJournalTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir_template[] = "/tmp/tpf_journal_XXXXXX";
+    ASSERT_NE(mkdtemp(dir_template), nullptr);
+    dir_ = dir_template;
+    path_ = dir_ + "/spool.journal";
+  }
+
+  void TearDown() override {
+    unlink(path_.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  off_t FileSize() const {
+    struct stat st = {};
+    stat(path_.c_str(), &st);
+    return st.st_size;
+  }
+
+  std::string dir_;
+  std::string path_;
+};
+
+std::vector<uint8_t> Bytes(const std::string& text) {
+  return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+}  // namespace
+
+TEST_F(SpoolJournalTest, RecoversJobsThatNeverCompleted) {
+  {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    EXPECT_TRUE(pending.empty());
+    std::vector<uint8_t> first = Bytes("\x1b@first ticket");
+    std::vector<uint8_t> second = Bytes("second ticket\x1dV\x00");
+    ASSERT_TRUE(journal.AppendJob(1, "/dev/usb/lp0", first.data(),
+                                  first.size()));
+    ASSERT_TRUE(journal.AppendJob(2, "/dev/usb/lp1", second.data(),
+                                  second.size()));
+    ASSERT_TRUE(journal.AppendCompletion(1, true));
+  }
+
+  SpoolJournal journal;
+  std::vector<JournaledJob> pending;
+  ASSERT_TRUE(journal.Open(path_, &pending));
+  ASSERT_EQ(pending.size(), 1u);
+  EXPECT_EQ(pending[0].id, 2u);
+  EXPECT_EQ(pending[0].printer, "/dev/usb/lp1");
+  EXPECT_EQ(pending[0].data, Bytes("second ticket\x1dV\x00"));
+  EXPECT_EQ(journal.next_job_id(), 3u);
+  EXPECT_EQ(journal.stats().compacted_records, 1u);
+}
+
+TEST_F(SpoolJournalTest, CompactionDropsCompletedJobs) {
+  std::vector<uint8_t> data(4096, 0x55);
+  {
+    SpoolJournal journal;
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    for (uint64_t id = 1; id <= 100; id++) {
+      ASSERT_TRUE(journal.AppendJob(id, "lp0", data.data(), data.size()));
+      ASSERT_TRUE(journal.AppendCompletion(id, true));
+    }
+  }
+  off_t before = FileSize();
+  {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    EXPECT_TRUE(pending.empty());
+    EXPECT_EQ(journal.next_job_id(), 101u);
+  }
+  EXPECT_LT(FileSize(), before / 10);
+}
+
+TEST_F(SpoolJournalTest, StopsReplayAtTornRecord) {
+  std::vector<uint8_t> data = Bytes("ticket");
+  {
+    SpoolJournal journal;
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    ASSERT_TRUE(journal.AppendJob(1, "lp0", data.data(), data.size()));
+    ASSERT_TRUE(journal.AppendJob(2, "lp0", data.data(), data.size()));
+  }
+  // Flip a payload byte of the last record, as a crash mid-append would.
+  int fd = open(path_.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  off_t size = lseek(fd, 0, SEEK_END);
+  uint8_t garbage = 0xFF;
+  ASSERT_EQ(pwrite(fd, &garbage, 1, size - 6), 1);
+  close(fd);
+
+  SpoolJournal journal;
+  std::vector<JournaledJob> pending;
+  ASSERT_TRUE(journal.Open(path_, &pending));
+  ASSERT_EQ(pending.size(), 1u);
+  EXPECT_EQ(pending[0].id, 1u);
+  // New appends land where the torn record used to be.
+  ASSERT_TRUE(journal.AppendJob(3, "lp0", data.data(), data.size()));
+  journal.Close();
+  ASSERT_TRUE(journal.Open(path_, &pending));
+  EXPECT_EQ(pending.size(), 2u);
+}
+
+TEST_F(SpoolJournalTest, GroupsAppendsIntoFewCommits) {
+  SpoolJournalOptions options;
+  options.commit_interval = std::chrono::milliseconds(50);
+  SpoolJournal journal(options);
+  ASSERT_TRUE(journal.Open(path_, nullptr));
+  std::vector<uint8_t> data(64, 0x1b);
+  for (uint64_t id = 1; id <= 200; id++) {
+    ASSERT_TRUE(journal.AppendJob(id, "lp0", data.data(), data.size()));
+  }
+  journal.Sync();
+  SpoolJournalStats stats = journal.stats();
+  EXPECT_EQ(stats.appends, 200u);
+  EXPECT_GE(stats.commits, 1u);
+  EXPECT_LT(stats.commits, 10u);
+}
+
+TEST_F(SpoolJournalTest, GrowsPastInitialCapacity) {
+  SpoolJournalOptions options;
+  options.initial_capacity = 4096;
+  std::vector<uint8_t> data(3000, 0xAA);
+  {
+    SpoolJournal journal(options);
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    for (uint64_t id = 1; id <= 50; id++) {
+      ASSERT_TRUE(journal.AppendJob(id, "lp0", data.data(), data.size()));
+    }
+  }
+  SpoolJournal journal(options);
+  std::vector<JournaledJob> pending;
+  ASSERT_TRUE(journal.Open(path_, &pending));
+  ASSERT_EQ(pending.size(), 50u);
+  EXPECT_EQ(pending[49].data, data);
+}
+
+TEST_F(SpoolJournalTest, KeepsFileJobsApartFromByteJobs) {
+  {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    std::vector<uint8_t> bytes = Bytes("ticket");
+    std::vector<uint8_t> spec = Bytes("spec");
+    ASSERT_TRUE(journal.AppendJob(1, "lp0", bytes.data(), bytes.size()));
+    ASSERT_TRUE(journal.AppendFileJob(2, "lp0", spec.data(), spec.size()));
+    ASSERT_TRUE(journal.AppendJob(3, "lp0", bytes.data(), bytes.size()));
+    ASSERT_TRUE(journal.AppendCompletion(3, true));
+  }
+  // Reopen twice: once replaying the log, once the compacted copy.
+  for (int pass = 0; pass < 2; pass++) {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    ASSERT_EQ(pending.size(), 2u);
+    EXPECT_FALSE(pending[0].file);
+    EXPECT_TRUE(pending[1].file);
+    EXPECT_EQ(pending[1].data, Bytes("spec"));
+  }
+}
+
+TEST_F(SpoolJournalTest, KeepsCopiesThroughCompaction) {
+  {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    std::vector<uint8_t> bytes = Bytes("receipt");
+    ASSERT_TRUE(journal.AppendJob(1, "lp0", bytes.data(), bytes.size()));
+    ASSERT_TRUE(journal.AppendCopies(1, 3));
+    ASSERT_TRUE(journal.AppendJob(2, "lp0", bytes.data(), bytes.size()));
+    ASSERT_TRUE(journal.AppendJob(3, "lp0", bytes.data(), bytes.size()));
+    ASSERT_TRUE(journal.AppendCompletion(3, true));
+    EXPECT_FALSE(journal.AppendCopies(2, 0));
+  }
+  for (int pass = 0; pass < 2; pass++) {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    ASSERT_EQ(pending.size(), 2u);
+    EXPECT_EQ(pending[0].copies, 3);
+    EXPECT_EQ(pending[1].copies, 1);
+  }
+}
+
+TEST_F(SpoolJournalTest, KeepsKeysAndProgressThroughCompaction) {
+  {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    std::vector<uint8_t> bytes = Bytes("kitchen ticket");
+    ASSERT_TRUE(journal.AppendJob(1, "lp0", bytes.data(), bytes.size()));
+    ASSERT_TRUE(journal.AppendKey(1, "order-17"));
+    ASSERT_TRUE(journal.AppendProgress(1, 4));
+    ASSERT_TRUE(journal.AppendProgress(1, 9));
+    ASSERT_TRUE(journal.AppendJob(2, "lp0", bytes.data(), bytes.size()));
+    ASSERT_TRUE(journal.AppendCompletion(2, true));
+  }
+  for (int pass = 0; pass < 2; pass++) {
+    SpoolJournal journal;
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    ASSERT_EQ(pending.size(), 1u);
+    EXPECT_EQ(pending[0].key, "order-17");
+    EXPECT_EQ(pending[0].offset, 9u);
+  }
+}
+
+TEST_F(SpoolJournalTest, KeepsSettledKeysThroughCompaction) {
+  SpoolJournalOptions options;
+  options.max_keys = 2;
+  {
+    SpoolJournal journal(options);
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    std::vector<uint8_t> bytes = Bytes("kitchen ticket");
+    const char* keys[] = {"order-1", "order-2", "order-3", "order-2"};
+    for (uint64_t id = 1; id <= 4; id++) {
+      ASSERT_TRUE(journal.AppendJob(id, "lp0", bytes.data(), bytes.size()));
+      ASSERT_TRUE(journal.AppendKey(id, keys[id - 1]));
+      bool failed = id == 4;
+      ASSERT_TRUE(journal.AppendSettledKey(id, keys[id - 1], failed,
+                                           failed ? 5 : 0,
+                                           failed ? bytes.size() : 0,
+                                           failed ? 77 : 0));
+      ASSERT_TRUE(journal.AppendCompletion(id, !failed));
+    }
+  }
+  for (int pass = 0; pass < 2; pass++) {
+    SpoolJournal journal(options);
+    std::vector<JournaledJob> pending;
+    std::vector<JournaledKey> keys;
+    ASSERT_TRUE(journal.Open(path_, &pending, &keys));
+    EXPECT_TRUE(pending.empty());
+    // The latest outcome of the two most recent keys.
+    ASSERT_EQ(keys.size(), 2u);
+    EXPECT_EQ(keys[0].key, "order-3");
+    EXPECT_EQ(keys[0].id, 3u);
+    EXPECT_FALSE(keys[0].failed);
+    EXPECT_EQ(keys[1].key, "order-2");
+    EXPECT_EQ(keys[1].id, 4u);
+    EXPECT_TRUE(keys[1].failed);
+    EXPECT_EQ(keys[1].offset, 5u);
+    EXPECT_EQ(keys[1].length, 14u);
+    EXPECT_EQ(keys[1].hash, 77u);
+  }
+}
+
+TEST_F(SpoolJournalTest, CompactsWhileInUse) {
+  SpoolJournalOptions options;
+  options.initial_capacity = 64 * 1024;
+  options.compact_bytes = 64 * 1024;
+  std::vector<uint8_t> data(4096, 0x33);
+  std::vector<uint8_t> kept = Bytes("still printing");
+  {
+    SpoolJournal journal(options);
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    ASSERT_TRUE(journal.AppendJob(1, "lp0", kept.data(), kept.size()));
+    ASSERT_TRUE(journal.AppendKey(1, "order-1"));
+    ASSERT_TRUE(journal.AppendSettledKey(0, "order-0", false, 0, 0, 0));
+    for (uint64_t id = 2; id <= 300; id++) {
+      ASSERT_TRUE(journal.AppendJob(id, "lp0", data.data(), data.size()));
+      ASSERT_TRUE(journal.AppendCompletion(id, true));
+      journal.Sync();
+    }
+    for (int i = 0; i < 100 && journal.stats().compacted_records < 250; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_GE(journal.stats().compacted_records, 250u);
+    // 1.2 MB of jobs went through a log that never outgrew twice its
+    // initial size.
+    EXPECT_LE(FileSize(), 128 * 1024);
+    ASSERT_TRUE(journal.AppendJob(301, "lp1", kept.data(), kept.size()));
+  }
+  SpoolJournal journal(options);
+  std::vector<JournaledJob> pending;
+  std::vector<JournaledKey> keys;
+  ASSERT_TRUE(journal.Open(path_, &pending, &keys));
+  ASSERT_EQ(keys.size(), 1u);
+  EXPECT_EQ(keys[0].key, "order-0");
+  ASSERT_EQ(pending.size(), 2u);
+  EXPECT_EQ(pending[0].id, 1u);
+  EXPECT_EQ(pending[0].key, "order-1");
+  EXPECT_EQ(pending[0].data, kept);
+  EXPECT_EQ(pending[1].id, 301u);
+  EXPECT_EQ(pending[1].printer, "lp1");
+  EXPECT_EQ(journal.next_job_id(), 302u);
+}
+
+TEST_F(SpoolJournalTest, KeepsRecordsAppendedDuringCompaction) {
+  SpoolJournalOptions options;
+  options.initial_capacity = 64 * 1024;
+  options.compact_bytes = 64 * 1024;
+  std::vector<uint8_t> data(2048, 0x66);
+  {
+    SpoolJournal journal(options);
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    // Two writers keep appending while the flusher rewrites the log under
+    // them; only the even jobs finish.
+    auto append = [&](uint64_t first) {
+      for (uint64_t id = first; id <= 800; id += 2) {
+        EXPECT_TRUE(journal.AppendJob(id, "lp0", data.data(), data.size()));
+        if (id % 4 < 2) {
+          EXPECT_TRUE(journal.AppendCompletion(id, true));
+        }
+        if (id % 16 < 2) {
+          journal.Sync();
+        }
+      }
+    };
+    std::thread other(append, 2);
+    append(1);
+    other.join();
+    journal.Sync();
+    EXPECT_GT(journal.stats().compacted_records, 0u);
+  }
+  SpoolJournal journal(options);
+  std::vector<JournaledJob> pending;
+  ASSERT_TRUE(journal.Open(path_, &pending));
+  ASSERT_EQ(pending.size(), 400u);
+  for (size_t i = 0; i < pending.size(); i++) {
+    EXPECT_GE(pending[i].id % 4, 2u);
+    EXPECT_EQ(pending[i].data, data);
+  }
+  EXPECT_EQ(journal.next_job_id(), 801u);
+}
+
+TEST_F(SpoolJournalTest, KeepsJobIdsRisingThroughCompaction) {
+  SpoolJournalOptions options;
+  options.initial_capacity = 64 * 1024;
+  options.compact_bytes = 64 * 1024;
+  std::vector<uint8_t> data(4096, 0x44);
+  {
+    SpoolJournal journal(options);
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    for (uint64_t id = 1; id <= 40; id++) {
+      ASSERT_TRUE(journal.AppendJob(id, "lp0", data.data(), data.size()));
+      ASSERT_TRUE(journal.AppendCompletion(id, true));
+      journal.Sync();
+    }
+    for (int i = 0; i < 100 && journal.stats().compacted_records == 0; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GT(journal.stats().compacted_records, 0u);
+  }
+  {
+    SpoolJournal journal(options);
+    ASSERT_TRUE(journal.Open(path_, nullptr));
+    EXPECT_EQ(journal.next_job_id(), 41u);
+    ASSERT_TRUE(journal.AppendJob(41, "lp0", data.data(), data.size()));
+    ASSERT_TRUE(journal.AppendCompletion(41, true));
+  }
+  // The rewrite on opening left no job records, only the highest id.
+  for (int i = 0; i < 2; i++) {
+    SpoolJournal journal(options);
+    std::vector<JournaledJob> pending;
+    ASSERT_TRUE(journal.Open(path_, &pending));
+    EXPECT_TRUE(pending.empty());
+    EXPECT_EQ(journal.next_job_id(), 42u);
+  }
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/symbol_raster.h"
+
+namespace thermal_printer_flutter {
+namespace test {
+
+namespace {
+
+struct Raster {
+  int bytes_per_row = 0;
+  int rows = 0;
+  std::vector<uint8_t> data;
+};
+
+// Joins the GS v 0 bands back into one bitmap.
+Raster JoinBands(const std::vector<uint8_t>& output) {
+  Raster raster;
+  size_t offset = 0;
+  while (offset + 8 <= output.size()) {
+    EXPECT_EQ(output[offset + 1], 0x76);
+    raster.bytes_per_row = output[offset + 4] | (output[offset + 5] << 8);
+    int rows = output[offset + 6] | (output[offset + 7] << 8);
+    size_t length = static_cast<size_t>(raster.bytes_per_row) * rows;
+    raster.data.insert(raster.data.end(), output.begin() + offset + 8,
+                       output.begin() + offset + 8 + length);
+    raster.rows += rows;
+    offset += 8 + length;
+  }
+  EXPECT_EQ(offset, output.size());
+  return raster;
+}
+
+bool Dot(const Raster& raster, int x, int y) {
+  return (raster.data[y * raster.bytes_per_row + x / 8] >> (7 - x % 8)) & 1;
+}
+
+}  // namespace
+
+TEST(SymbolRaster, ScalesQrModulesInsideTheQuietZone) {
+  SymbolOptions options;
+  options.module_size = 4;
+  options.band_height = 50;
+  std::vector<uint8_t> output;
+  ASSERT_TRUE(RenderSymbol("HELLO WORLD", options, &output));
+  Raster raster = JoinBands(output);
+  // 21 modules plus 4 on each side, 4 dots each.
+  EXPECT_EQ(raster.rows, 116);
+  EXPECT_EQ(raster.bytes_per_row, 15);
+  QrCode code;
+  ASSERT_TRUE(QrCode::Encode("HELLO WORLD", options.ecc, &code));
+  for (int y = 0; y < raster.rows; y++) {
+    for (int x = 0; x < 116; x++) {
+      int mx = x / 4 - 4;
+      int my = y / 4 - 4;
+      bool dark = mx >= 0 && mx < 21 && my >= 0 && my < 21 &&
+                  code.module(mx, my);
+      ASSERT_EQ(Dot(raster, x, y), dark) << x << "," << y;
+    }
+  }
+}
+
+TEST(SymbolRaster, ShrinksModulesToFitThePaper) {
+  SymbolOptions options;
+  options.module_size = 30;
+  options.max_width = 384;
+  std::vector<uint8_t> output;
+  ASSERT_TRUE(RenderSymbol("HELLO WORLD", options, &output));
+  // 29 modules fit 384 dots at 13 dots each.
+  EXPECT_EQ(JoinBands(output).rows, 29 * 13);
+
+  options.max_width = 20;
+  output.clear();
+  EXPECT_FALSE(RenderSymbol("HELLO WORLD", options, &output));
+}
+
+TEST(SymbolRaster, RepeatsBarcodeRows) {
+  SymbolOptions options;
+  options.type = SymbolType::kEan13;
+  options.module_size = 2;
+  options.height = 60;
+  std::vector<uint8_t> output;
+  ASSERT_TRUE(RenderSymbol("400638133393", options, &output));
+  Raster raster = JoinBands(output);
+  EXPECT_EQ(raster.rows, 60);
+  // 11 + 95 + 7 modules of 2 dots.
+  EXPECT_EQ(raster.bytes_per_row, 29);
+  for (int y = 1; y < raster.rows; y++) {
+    EXPECT_TRUE(std::equal(raster.data.begin(),
+                           raster.data.begin() + raster.bytes_per_row,
+                           raster.data.begin() + y * raster.bytes_per_row));
+  }
+  // Quiet zone, then the 101 start guard.
+  EXPECT_FALSE(Dot(raster, 21, 0));
+  EXPECT_TRUE(Dot(raster, 22, 0));
+  EXPECT_TRUE(Dot(raster, 23, 0));
+  EXPECT_FALSE(Dot(raster, 24, 0));
+  EXPECT_TRUE(Dot(raster, 26, 0));
+}
+
+TEST(SymbolRaster, CacheEvictsTheLeastRecentlyUsed) {
+  SymbolCache cache(2);
+  SymbolOptions options;
+  std::shared_ptr<const std::vector<uint8_t>> first = cache.Get("one", options);
+  ASSERT_NE(first, nullptr);
+  cache.Get("two", options);
+  EXPECT_EQ(cache.Get("one", options), first);
+  cache.Get("three", options);  // Evicts "two".
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.stats().hits, 1u);
+  EXPECT_EQ(cache.stats().misses, 3u);
+  EXPECT_EQ(cache.Get("one", options), first);
+  cache.Get("two", options);
+  EXPECT_EQ(cache.stats().misses, 4u);
+
+  // Options are part of the key.
+  options.module_size = 8;
+  EXPECT_NE(cache.Get("one", options), first);
+  options.type = SymbolType::kEan8;
+  EXPECT_EQ(cache.Get("not digits", options), nullptr);
+}
+
+}  // namespace test
+}  // namespace thermal_printer_flutter
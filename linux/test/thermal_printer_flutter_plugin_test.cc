@@ -2,6 +2,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "core/file_source.h"
+#include "core/print_queue.h"
+#include "core/raster_encoder.h"
+#include "core/serial_transport.h"
+#include "core/symbol_raster.h"
 #include "include/thermal_printer_flutter/thermal_printer_flutter_plugin.h"
 #include "thermal_printer_flutter_plugin_private.h"
 
@@ -27,5 +32,189 @@ TEST(ThermalPrinterFlutterPlugin, GetPlatformVersion) {
   EXPECT_THAT(fl_value_get_string(result), testing::StartsWith("Linux "));
 }
 
+TEST(ThermalPrinterFlutterPlugin, ResolvePrinterDevice) {
+  EXPECT_EQ(resolve_printer_device("/dev/usb/lp1", "lp0"), "/dev/usb/lp1");
+  EXPECT_EQ(resolve_printer_device("", "lp0"), "/dev/usb/lp0");
+  EXPECT_EQ(resolve_printer_device(nullptr, "/dev/usb/lp2"), "/dev/usb/lp2");
+  EXPECT_EQ(resolve_printer_device(nullptr, nullptr), "");
+  EXPECT_EQ(resolve_printer_device(nullptr, "ttyUSB0"), "/dev/ttyUSB0");
+}
+
+TEST(ThermalPrinterFlutterPlugin, ResolveNetworkPrinter) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  EXPECT_EQ(resolve_network_printer(args), "");
+  fl_value_set_string_take(args, "ip", fl_value_new_string("10.0.0.7"));
+  fl_value_set_string_take(args, "port", fl_value_new_string("515"));
+  EXPECT_EQ(resolve_network_printer(args), "lpd://10.0.0.7:515/lp");
+  fl_value_set_string_take(args, "protocol", fl_value_new_string("raw"));
+  EXPECT_EQ(resolve_network_printer(args), "tcp://10.0.0.7:515");
+}
+
+TEST(ThermalPrinterFlutterPlugin, PrinterGroupKey) {
+  EXPECT_EQ(printer_group_key("kitchen"), "group:kitchen");
+  EXPECT_EQ(printer_group_key(""), "");
+  EXPECT_EQ(printer_group_key(nullptr), "");
+}
+
+TEST(ThermalPrinterFlutterPlugin, PrinterStatusValue) {
+  thermal_printer_flutter::PrinterStatus status;
+  status.connected = true;
+  status.paper = thermal_printer_flutter::PaperState::kNearEnd;
+  g_autoptr(FlValue) value = printer_status_value("/dev/usb/lp0", status);
+  EXPECT_STREQ(fl_value_get_string(fl_value_lookup_string(value, "printer")),
+               "/dev/usb/lp0");
+  EXPECT_TRUE(fl_value_get_bool(fl_value_lookup_string(value, "connected")));
+  EXPECT_FALSE(fl_value_get_bool(fl_value_lookup_string(value, "online")));
+  EXPECT_STREQ(fl_value_get_string(fl_value_lookup_string(value, "paper")),
+               "nearEnd");
+}
+
+TEST(ThermalPrinterFlutterPlugin, WriteBatchRejectsMalformedCalls) {
+  // Refused before the plugin's queue is touched.
+  g_autoptr(FlValue) args = fl_value_new_map();
+  g_autoptr(FlMethodResponse) missing = write_batch(nullptr, args);
+  EXPECT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(missing));
+
+  g_autoptr(FlValue) printer = fl_value_new_map();
+  fl_value_set_string_take(printer, "printerName", fl_value_new_string("lp0"));
+  FlValue* printers = fl_value_new_list();
+  fl_value_append(printers, printer);
+  fl_value_set_string_take(args, "printers", printers);
+  const uint8_t truncated[] = {'T', 'P', 'F', 'B', 1, 0, 0, 0};
+  fl_value_set_string_take(
+      args, "jobs", fl_value_new_uint8_list(truncated, sizeof(truncated)));
+  g_autoptr(FlMethodResponse) malformed = write_batch(nullptr, args);
+  ASSERT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(malformed));
+  EXPECT_STREQ(fl_method_error_response_get_code(
+                   FL_METHOD_ERROR_RESPONSE(malformed)),
+               "invalid_arguments");
+}
+
+TEST(ThermalPrinterFlutterPlugin, TraceCallsRejectMissingArguments) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  g_autoptr(FlMethodResponse) no_path = dump_trace(nullptr, args);
+  EXPECT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(no_path));
+
+  // A threshold needs somewhere to write the trace.
+  fl_value_set_string_take(args, "thresholdMs", fl_value_new_int(5000));
+  g_autoptr(FlMethodResponse) nowhere = set_trace_threshold(nullptr, args);
+  EXPECT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(nowhere));
+  fl_value_set_string_take(args, "thresholdMs", fl_value_new_int(-1));
+  fl_value_set_string_take(args, "path", fl_value_new_string("/tmp/t.json"));
+  g_autoptr(FlMethodResponse) negative = set_trace_threshold(nullptr, args);
+  EXPECT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(negative));
+}
+
+TEST(ThermalPrinterFlutterPlugin, WarmUpRejectsInvalidArguments) {
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "printers", fl_value_new_string("lp0"));
+  g_autoptr(FlMethodResponse) not_a_list = warm_up(nullptr, args);
+  EXPECT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(not_a_list));
+
+  // Files are described as printFile describes them, by absolute path.
+  FlValue* file = fl_value_new_map();
+  fl_value_set_string_take(file, "path", fl_value_new_string("logo.png"));
+  FlValue* files = fl_value_new_list();
+  fl_value_append_take(files, file);
+  fl_value_set_string_take(args, "printers", fl_value_new_list());
+  fl_value_set_string_take(args, "files", files);
+  g_autoptr(FlMethodResponse) relative = warm_up(nullptr, args);
+  EXPECT_TRUE(FL_IS_METHOD_ERROR_RESPONSE(relative));
+}
+
+TEST(ThermalPrinterFlutterPlugin, ReadCoalesceOptions) {
+  thermal_printer_flutter::CoalesceOptions options;
+  g_autoptr(FlValue) args = fl_value_new_map();
+  EXPECT_FALSE(read_coalesce_options(args, &options));
+  fl_value_set_string_take(args, "enabled", fl_value_new_bool(true));
+  fl_value_set_string_take(args, "windowMs", fl_value_new_int(50));
+  EXPECT_TRUE(read_coalesce_options(args, &options));
+  EXPECT_TRUE(options.enabled);
+  EXPECT_EQ(options.window.count(), 50);
+  fl_value_set_string_take(args, "maxBytes", fl_value_new_int(0));
+  EXPECT_FALSE(read_coalesce_options(args, &options));
+}
+
+TEST(ThermalPrinterFlutterPlugin, ReadRasterOptions) {
+  thermal_printer_flutter::RasterOptions options;
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "width", fl_value_new_int(384));
+  fl_value_set_string_take(args, "dither", fl_value_new_bool(false));
+  EXPECT_TRUE(read_raster_options(args, &options));
+  EXPECT_EQ(options.width, 384);
+  EXPECT_EQ(options.dither, thermal_printer_flutter::DitherMode::kThreshold);
+  fl_value_set_string_take(args, "rotation", fl_value_new_int(270));
+  fl_value_set_string_take(args, "mirror", fl_value_new_bool(true));
+  EXPECT_TRUE(read_raster_options(args, &options));
+  EXPECT_EQ(options.rotation, thermal_printer_flutter::Rotation::k270);
+  EXPECT_TRUE(options.mirror);
+  fl_value_set_string_take(args, "rotation", fl_value_new_int(45));
+  EXPECT_FALSE(read_raster_options(args, &options));
+  fl_value_set_string_take(args, "rotation", fl_value_new_int(0));
+  fl_value_set_string_take(args, "threshold", fl_value_new_int(300));
+  EXPECT_FALSE(read_raster_options(args, &options));
+}
+
+TEST(ThermalPrinterFlutterPlugin, ReadSymbolOptions) {
+  thermal_printer_flutter::SymbolOptions options;
+  g_autoptr(FlValue) args = fl_value_new_map();
+  EXPECT_TRUE(read_symbol_options(args, &options));
+  EXPECT_EQ(options.type, thermal_printer_flutter::SymbolType::kQrCode);
+  fl_value_set_string_take(args, "type", fl_value_new_string("ean13"));
+  fl_value_set_string_take(args, "ecc", fl_value_new_string("H"));
+  fl_value_set_string_take(args, "moduleSize", fl_value_new_int(3));
+  EXPECT_TRUE(read_symbol_options(args, &options));
+  EXPECT_EQ(options.type, thermal_printer_flutter::SymbolType::kEan13);
+  EXPECT_EQ(options.ecc, thermal_printer_flutter::QrEcc::kHigh);
+  EXPECT_EQ(options.module_size, 3);
+  fl_value_set_string_take(args, "type", fl_value_new_string("pdf417"));
+  EXPECT_FALSE(read_symbol_options(args, &options));
+}
+
+TEST(ThermalPrinterFlutterPlugin, ReadCopies) {
+  int copies = 1;
+  g_autoptr(FlValue) args = fl_value_new_map();
+  EXPECT_TRUE(read_copies(args, &copies));
+  EXPECT_EQ(copies, 1);
+  fl_value_set_string_take(args, "copies", fl_value_new_int(3));
+  EXPECT_TRUE(read_copies(args, &copies));
+  EXPECT_EQ(copies, 3);
+  fl_value_set_string_take(args, "copies", fl_value_new_int(0));
+  EXPECT_FALSE(read_copies(args, &copies));
+  fl_value_set_string_take(args, "copies", fl_value_new_int(256));
+  EXPECT_FALSE(read_copies(args, &copies));
+}
+
+TEST(ThermalPrinterFlutterPlugin, ReadFileJobSpec) {
+  thermal_printer_flutter::FileJobSpec spec;
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "path", fl_value_new_string("relative.bin"));
+  EXPECT_FALSE(read_file_job_spec(args, &spec));
+  fl_value_set_string_take(args, "path", fl_value_new_string("/tmp/r.bin"));
+  fl_value_set_string_take(args, "format", fl_value_new_string("bitmap"));
+  EXPECT_FALSE(read_file_job_spec(args, &spec));
+  fl_value_set_string_take(args, "bitmapWidth", fl_value_new_int(576));
+  EXPECT_TRUE(read_file_job_spec(args, &spec));
+  EXPECT_EQ(spec.format, thermal_printer_flutter::FileFormat::kBitmap);
+  EXPECT_EQ(spec.bitmap_width, 576);
+}
+
+TEST(ThermalPrinterFlutterPlugin, ReadSerialOptions) {
+  thermal_printer_flutter::SerialOptions options;
+  g_autoptr(FlValue) args = fl_value_new_map();
+  fl_value_set_string_take(args, "baudRate", fl_value_new_int(921600));
+  fl_value_set_string_take(args, "flowControl", fl_value_new_string("rtscts"));
+  ASSERT_TRUE(read_serial_options(args, &options));
+  EXPECT_EQ(options.baud_rate, 921600);
+  EXPECT_EQ(options.flow_control, thermal_printer_flutter::FlowControl::kRtsCts);
+
+  fl_value_set_string_take(args, "baudRate", fl_value_new_string("auto"));
+  ASSERT_TRUE(read_serial_options(args, &options));
+  EXPECT_EQ(options.baud_rate, 0);
+
+  fl_value_set_string_take(args, "baudRate", fl_value_new_int(12345));
+  EXPECT_FALSE(read_serial_options(args, &options));
+}
+
 }  // namespace test
 }  // namespace thermal_printer_flutter
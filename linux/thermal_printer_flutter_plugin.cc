@@ -1,19 +1,75 @@
 #include "include/thermal_printer_flutter/thermal_printer_flutter_plugin.h"
 
 #include <flutter_linux/flutter_linux.h>
+#include <glib-unix.h>
 #include <gtk/gtk.h>
 #include <sys/utsname.h>
+#include <unistd.h>
 
+#include <chrono>
 #include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
+#include "core/daemon_client.h"
+#include "core/daemon_protocol.h"
+#include "core/escpos_optimizer.h"
+#include "core/job_batch.h"
+#include "core/print_queue.h"
+#include "core/printer_profile.h"
+#include "core/serial_transport.h"
+#include "core/spool_journal.h"
+#include "core/symbol_raster.h"
+#include "core/tcp_transport.h"
+#include "core/transport_factory.h"
+#include "glib_io_loop.h"
+#include "image_decoder.h"
 #include "thermal_printer_flutter_plugin_private.h"
 
 #define THERMAL_PRINTER_FLUTTER_PLUGIN(obj) \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), thermal_printer_flutter_plugin_get_type(), \
                               ThermalPrinterFlutterPlugin))
 
+// Directory scanned for USB printer class devices.
+static const char kUsbPrinterDirectory[] = "/dev/usb";
+
+// Serial ports offered alongside the USB printers: on-board RS-232 ports and
+// USB-serial adapters (FTDI/PL2303 show up as ttyUSB, CDC-ACM as ttyACM).
+static const char* const kSerialPortPrefixes[] = {"ttyS", "ttyUSB", "ttyACM"};
+
+// Status changes the queue reported from its threads, held until the main
+// loop sends them to Dart together.
+struct PendingStatuses {
+  std::mutex mutex;
+  std::map<std::string, thermal_printer_flutter::PrinterStatus> changes;
+  bool scheduled = false;
+};
+
 struct _ThermalPrinterFlutterPlugin {
   GObject parent_instance;
+
+  thermal_printer_flutter::SpoolJournal* journal;
+  thermal_printer_flutter::PrintQueue* queue;
+  thermal_printer_flutter::SerialSettings* serial_settings;
+  thermal_printer_flutter::SymbolCache* symbols;
+  thermal_printer_flutter::BandCache* bands;
+  // The shared print daemon, used instead of |queue| while one is running.
+  thermal_printer_flutter::DaemonClient* daemon;
+  // writebytes payloads run through the ESC/POS optimizer, before and after.
+  uint64_t optimized_bytes_in;
+  uint64_t optimized_bytes_out;
+  // Pushes printer status changes to Dart while it listens.
+  FlEventChannel* status_channel;
+  bool status_listening;
+  PendingStatuses* pending_statuses;
+  // Printers watched through the daemon, with the status last sent, and
+  // the source that reads the changes the daemon pushes.
+  std::map<std::string, thermal_printer_flutter::PrinterStatus>*
+      daemon_statuses;
+  guint daemon_status_source;
 };
 
 G_DEFINE_TYPE(ThermalPrinterFlutterPlugin, thermal_printer_flutter_plugin, g_object_get_type())
@@ -25,9 +81,46 @@ static void thermal_printer_flutter_plugin_handle_method_call(
   g_autoptr(FlMethodResponse) response = nullptr;
 
   const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
 
   if (strcmp(method, "getPlatformVersion") == 0) {
     response = get_platform_version();
+  } else if (strcmp(method, "usbprinters") == 0) {
+    response = get_usb_printers();
+  } else if (strcmp(method, "writebytes") == 0) {
+    response = write_bytes(self, args);
+  } else if (strcmp(method, "writeBatch") == 0) {
+    response = write_batch(self, args);
+  } else if (strcmp(method, "printImage") == 0) {
+    response = print_image(self, args);
+  } else if (strcmp(method, "printFile") == 0) {
+    response = print_file(self, args);
+  } else if (strcmp(method, "printSymbol") == 0) {
+    response = print_symbol(self, args);
+  } else if (strcmp(method, "configureSerial") == 0) {
+    response = configure_serial(self, args);
+  } else if (strcmp(method, "setCoalescing") == 0) {
+    response = set_coalescing(self, args);
+  } else if (strcmp(method, "flush") == 0) {
+    response = flush_queue(self, args);
+  } else if (strcmp(method, "queueStats") == 0) {
+    response = get_queue_stats(self);
+  } else if (strcmp(method, "printerProfile") == 0) {
+    response = get_printer_profile(self, args);
+  } else if (strcmp(method, "printerLatency") == 0) {
+    response = get_printer_latency(self, args);
+  } else if (strcmp(method, "setPrinterGroup") == 0) {
+    response = set_printer_group(self, args);
+  } else if (strcmp(method, "printerGroupStats") == 0) {
+    response = get_printer_group_stats(self, args);
+  } else if (strcmp(method, "watchPrinter") == 0) {
+    response = watch_printer(self, args);
+  } else if (strcmp(method, "dumpTrace") == 0) {
+    response = dump_trace(self, args);
+  } else if (strcmp(method, "setTraceThreshold") == 0) {
+    response = set_trace_threshold(self, args);
+  } else if (strcmp(method, "warmUp") == 0) {
+    response = warm_up(self, args);
   } else {
     response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
   }
@@ -43,7 +136,1341 @@ FlMethodResponse* get_platform_version() {
   return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
 }
 
+// "EPSON TM-T20II" from the IEEE 1284 device ID usblp read when the printer
+// was plugged in, or an empty string for other devices.
+static std::string read_usb_printer_model(const gchar* name) {
+  g_autofree gchar* id_path = g_build_filename(
+      "/sys/class/usbmisc", name, "device", "ieee1284_id", nullptr);
+  g_autofree gchar* text = nullptr;
+  thermal_printer_flutter::DeviceId id;
+  if (!g_file_get_contents(id_path, &text, nullptr, nullptr) ||
+      !thermal_printer_flutter::ParseDeviceId(text, &id)) {
+    return std::string();
+  }
+  if (id.manufacturer.empty() ||
+      g_str_has_prefix(id.model.c_str(), id.manufacturer.c_str())) {
+    return id.model;
+  }
+  return id.model.empty() ? id.manufacturer
+                          : id.manufacturer + " " + id.model;
+}
+
+static void append_printer(FlValue* list, const gchar* name, const gchar* path,
+                           const gchar* interface, const std::string& model) {
+  g_autoptr(FlValue) printer = fl_value_new_map();
+  fl_value_set_string_take(printer, "name", fl_value_new_string(name));
+  fl_value_set_string_take(printer, "usbAddress", fl_value_new_string(path));
+  fl_value_set_string_take(printer, "type", fl_value_new_string("usb"));
+  fl_value_set_string_take(printer, "interface",
+                           fl_value_new_string(interface));
+  fl_value_set_string_take(printer, "model",
+                           fl_value_new_string(model.c_str()));
+  fl_value_set_string_take(printer, "isConnected",
+                           fl_value_new_bool(access(path, W_OK) == 0));
+  fl_value_append(list, printer);
+}
+
+// The kernel creates ttyS0..N whether or not a UART is fitted; sysfs
+// reports type 0 (PORT_UNKNOWN) for the empty ones.
+static bool is_present_serial_port(const gchar* name) {
+  if (!g_str_has_prefix(name, "ttyS")) {
+    return true;
+  }
+  g_autofree gchar* type_path =
+      g_build_filename("/sys/class/tty", name, "type", nullptr);
+  g_autofree gchar* type = nullptr;
+  if (!g_file_get_contents(type_path, &type, nullptr, nullptr)) {
+    return false;
+  }
+  return g_ascii_strtoll(type, nullptr, 10) != 0;
+}
+
+FlMethodResponse* get_usb_printers() {
+  g_autoptr(FlValue) result = fl_value_new_list();
+  g_autoptr(GDir) usb_dir = g_dir_open(kUsbPrinterDirectory, 0, nullptr);
+  if (usb_dir != nullptr) {
+    const gchar* entry;
+    while ((entry = g_dir_read_name(usb_dir)) != nullptr) {
+      if (!g_str_has_prefix(entry, "lp")) {
+        continue;
+      }
+      g_autofree gchar* path =
+          g_build_filename(kUsbPrinterDirectory, entry, nullptr);
+      append_printer(result, entry, path, "usb",
+                     read_usb_printer_model(entry));
+    }
+  }
+
+  g_autoptr(GDir) dev_dir = g_dir_open("/dev", 0, nullptr);
+  if (dev_dir != nullptr) {
+    const gchar* entry;
+    while ((entry = g_dir_read_name(dev_dir)) != nullptr) {
+      for (const char* prefix : kSerialPortPrefixes) {
+        if (g_str_has_prefix(entry, prefix) &&
+            g_ascii_isdigit(entry[strlen(prefix)]) &&
+            is_present_serial_port(entry)) {
+          g_autofree gchar* path = g_build_filename("/dev", entry, nullptr);
+          append_printer(result, entry, path, "serial", std::string());
+          break;
+        }
+      }
+    }
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Copies a Dart List<int> or Uint8List into |bytes|.
+static bool read_byte_list(FlValue* value, std::vector<uint8_t>* bytes) {
+  if (value == nullptr) {
+    return false;
+  }
+  if (fl_value_get_type(value) == FL_VALUE_TYPE_UINT8_LIST) {
+    const uint8_t* data = fl_value_get_uint8_list(value);
+    bytes->assign(data, data + fl_value_get_length(value));
+    return true;
+  }
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_LIST) {
+    return false;
+  }
+  size_t length = fl_value_get_length(value);
+  bytes->resize(length);
+  for (size_t i = 0; i < length; i++) {
+    FlValue* item = fl_value_get_list_value(value, i);
+    if (fl_value_get_type(item) != FL_VALUE_TYPE_INT) {
+      return false;
+    }
+    (*bytes)[i] = static_cast<uint8_t>(fl_value_get_int(item));
+  }
+  return true;
+}
+
+// Returns the string stored under |key| in the |args| map, or nullptr.
+static const gchar* lookup_string(FlValue* args, const gchar* key) {
+  FlValue* value = fl_value_lookup_string(args, key);
+  if (value == nullptr || fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return nullptr;
+  }
+  return fl_value_get_string(value);
+}
+
+std::string resolve_printer_device(const gchar* usb_address,
+                                   const gchar* printer_name) {
+  const gchar* device =
+      usb_address != nullptr && usb_address[0] != '\0' ? usb_address
+                                                       : printer_name;
+  if (device == nullptr || device[0] == '\0') {
+    return std::string();
+  }
+  if (device[0] == '/') {
+    return device;
+  }
+  g_autofree gchar* path = g_build_filename(
+      g_str_has_prefix(device, "tty") ? "/dev" : kUsbPrinterDirectory, device,
+      nullptr);
+  return path;
+}
+
+std::string resolve_network_printer(FlValue* args) {
+  const gchar* ip = lookup_string(args, "ip");
+  if (ip == nullptr || ip[0] == '\0') {
+    return std::string();
+  }
+  thermal_printer_flutter::NetworkEndpoint endpoint;
+  endpoint.host = ip;
+  FlValue* port = fl_value_lookup_string(args, "port");
+  if (port != nullptr && fl_value_get_type(port) == FL_VALUE_TYPE_INT) {
+    endpoint.port = static_cast<int>(fl_value_get_int(port));
+  } else if (port != nullptr &&
+             fl_value_get_type(port) == FL_VALUE_TYPE_STRING) {
+    endpoint.port =
+        static_cast<int>(g_ascii_strtoll(fl_value_get_string(port), nullptr, 10));
+  }
+  if (endpoint.port <= 0 || endpoint.port > 65535) {
+    return std::string();
+  }
+  // Port 515 is LPD unless the caller says otherwise.
+  const gchar* protocol = lookup_string(args, "protocol");
+  bool lpd = protocol != nullptr ? strcmp(protocol, "lpd") == 0
+                                 : endpoint.port == 515;
+  if (lpd) {
+    endpoint.protocol = thermal_printer_flutter::NetworkEndpoint::Protocol::kLpd;
+    const gchar* queue = lookup_string(args, "queue");
+    endpoint.queue = queue != nullptr && queue[0] != '\0' ? queue : "lp";
+  }
+  return endpoint.ToString();
+}
+
+std::string printer_group_key(const gchar* group) {
+  if (group == nullptr || group[0] == '\0') {
+    return std::string();
+  }
+  return std::string("group:") + group;
+}
+
+// Resolves the printer a call targets: a printer group when group is given,
+// a network endpoint when ip is, otherwise a USB or serial device.
+static std::string resolve_printer_key(FlValue* args) {
+  std::string group = printer_group_key(lookup_string(args, "group"));
+  if (!group.empty()) {
+    return group;
+  }
+  std::string device = resolve_network_printer(args);
+  if (device.empty()) {
+    device = resolve_printer_device(lookup_string(args, "usbAddress"),
+                                    lookup_string(args, "printerName"));
+  }
+  return device;
+}
+
+bool read_serial_options(FlValue* args,
+                         thermal_printer_flutter::SerialOptions* options) {
+  FlValue* baud_rate = fl_value_lookup_string(args, "baudRate");
+  if (baud_rate != nullptr) {
+    if (fl_value_get_type(baud_rate) == FL_VALUE_TYPE_STRING &&
+        strcmp(fl_value_get_string(baud_rate), "auto") == 0) {
+      options->baud_rate = 0;
+    } else if (fl_value_get_type(baud_rate) == FL_VALUE_TYPE_INT &&
+               (fl_value_get_int(baud_rate) == 0 ||
+                thermal_printer_flutter::IsSupportedBaudRate(
+                    static_cast<int>(fl_value_get_int(baud_rate))))) {
+      options->baud_rate = static_cast<int>(fl_value_get_int(baud_rate));
+    } else {
+      return false;
+    }
+  }
+  const gchar* flow_control = lookup_string(args, "flowControl");
+  if (flow_control != nullptr &&
+      !thermal_printer_flutter::ParseFlowControl(flow_control,
+                                                 &options->flow_control)) {
+    return false;
+  }
+  return true;
+}
+
+bool read_copies(FlValue* args, int* copies) {
+  FlValue* value = fl_value_lookup_string(args, "copies");
+  if (value == nullptr) {
+    return true;
+  }
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_INT ||
+      fl_value_get_int(value) < 1 || fl_value_get_int(value) > 255) {
+    return false;
+  }
+  *copies = static_cast<int>(fl_value_get_int(value));
+  return true;
+}
+
+// Queues the job with the daemon, or here when there is none or it could
+// not be reached. A job the daemon received but did not confirm is not
+// queued again here, as it may still print: |unconfirmed| is set instead.
+uint64_t submit_job(ThermalPrinterFlutterPlugin* self,
+                    const std::string& device, const uint8_t* data,
+                    size_t length, int copies, const std::string& key,
+                    bool barrier, bool* full, bool* unconfirmed) {
+  uint64_t job_id;
+  bool sent = false;
+  *unconfirmed = false;
+  if (self->daemon != nullptr) {
+    if (self->daemon->Submit(device, data, length, copies, key, &job_id,
+                             barrier, full, &sent)) {
+      return job_id;
+    }
+    if (sent) {
+      *unconfirmed = true;
+      return 0;
+    }
+  }
+  job_id = self->queue->Submit(device, data, length, copies, key, barrier);
+  if (full != nullptr) {
+    *full = job_id == 0 && !self->queue->CanQueue(length);
+  }
+  return job_id;
+}
+
+// The reply to a job the daemon received without confirming it.
+static FlMethodResponse* unconfirmed_response() {
+  return FL_METHOD_RESPONSE(fl_method_error_response_new(
+      "daemon_unconfirmed",
+      "The print daemon did not confirm the job; it may still print",
+      nullptr));
+}
+
+// The reply to a job submitted with submit_job(): whether it was queued,
+// queue_full if the queue already holds as much as it may, or
+// daemon_unconfirmed.
+static FlMethodResponse* job_response(uint64_t job_id, bool full,
+                                      bool unconfirmed) {
+  if (unconfirmed) {
+    return unconfirmed_response();
+  }
+  if (full) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "queue_full", "The print queue is full; retry once it drains",
+        nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(job_id != 0);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+bool get_profile(ThermalPrinterFlutterPlugin* self, const std::string& device,
+                 thermal_printer_flutter::PrinterProfile* profile) {
+  bool resolved;
+  if (self->daemon != nullptr &&
+      self->daemon->GetProfile(device, profile, &resolved)) {
+    return resolved;
+  }
+  return self->queue->GetProfile(device, profile);
+}
+
+void set_serial_options(ThermalPrinterFlutterPlugin* self,
+                        const std::string& device,
+                        const thermal_printer_flutter::SerialOptions& options) {
+  self->serial_settings->Set(device, options);
+  if (self->daemon != nullptr) {
+    self->daemon->SetSerialOptions(device, options);
+  }
+}
+
+bool read_job_key(FlValue* args, std::string* key) {
+  FlValue* value = fl_value_lookup_string(args, "jobKey");
+  if (value == nullptr || fl_value_get_type(value) == FL_VALUE_TYPE_NULL) {
+    return true;
+  }
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_STRING) {
+    return false;
+  }
+  const gchar* text = fl_value_get_string(value);
+  if (text[0] == '\0' || strlen(text) > 255) {
+    return false;
+  }
+  *key = text;
+  return true;
+}
+
+// Applies the baudRate and flowControl arguments if |device| is a serial
+// port. Returns false if they are not supported.
+static bool apply_serial_arguments(ThermalPrinterFlutterPlugin* self,
+                                   const std::string& device, FlValue* args) {
+  if (!thermal_printer_flutter::IsSerialDevicePath(device)) {
+    return true;
+  }
+  thermal_printer_flutter::SerialOptions options =
+      self->serial_settings->Get(device);
+  if (!read_serial_options(args, &options)) {
+    return false;
+  }
+  set_serial_options(self, device, options);
+  return true;
+}
+
+// Runs a job through the ESC/POS optimizer into |optimized|, counting what
+// it saved for getQueueStats().
+static void optimize_job(ThermalPrinterFlutterPlugin* self,
+                         const uint8_t* data, size_t length,
+                         std::vector<uint8_t>* optimized) {
+  thermal_printer_flutter::EscPosStats stats;
+  if (!thermal_printer_flutter::OptimizeEscPos(data, length, optimized,
+                                               &stats)) {
+    g_debug("ESC/POS optimizer stopped at byte %zu of %zu", stats.parsed,
+            stats.bytes_in);
+  }
+  g_debug("ESC/POS optimizer: %zu bytes in, %zu out", stats.bytes_in,
+          stats.bytes_out);
+  self->optimized_bytes_in += stats.bytes_in;
+  self->optimized_bytes_out += stats.bytes_out;
+}
+
+FlMethodResponse* write_bytes(ThermalPrinterFlutterPlugin* self,
+                              FlValue* args) {
+  // A Uint8List is queued straight from the message; a List<int> is copied
+  // into |bytes| first.
+  const uint8_t* data = nullptr;
+  size_t length = 0;
+  std::vector<uint8_t> bytes;
+  int copies = 1;
+  std::string job_key;
+  FlValue* value = args != nullptr &&
+                           fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                       ? fl_value_lookup_string(args, "bytes")
+                       : nullptr;
+  if (value != nullptr &&
+      fl_value_get_type(value) == FL_VALUE_TYPE_UINT8_LIST) {
+    data = fl_value_get_uint8_list(value);
+    length = fl_value_get_length(value);
+  } else if (read_byte_list(value, &bytes)) {
+    data = bytes.data();
+    length = bytes.size();
+  } else {
+    value = nullptr;
+  }
+  if (value == nullptr || !read_copies(args, &copies) ||
+      !read_job_key(args, &job_key)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for printBytes", nullptr));
+  }
+  std::string device = resolve_printer_key(args);
+  if (device.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for printBytes", nullptr));
+  }
+  if (!apply_serial_arguments(self, device, args)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Unsupported baudRate or flowControl", nullptr));
+  }
+
+  FlValue* optimize = fl_value_lookup_string(args, "optimize");
+  if (optimize != nullptr &&
+      fl_value_get_type(optimize) == FL_VALUE_TYPE_BOOL &&
+      fl_value_get_bool(optimize)) {
+    std::vector<uint8_t> optimized;
+    optimize_job(self, data, length, &optimized);
+    bytes.swap(optimized);
+    data = bytes.data();
+    length = bytes.size();
+  }
+
+  // Times the job until the printer has processed it; see printerLatency.
+  FlValue* barrier = fl_value_lookup_string(args, "barrier");
+  bool wants_barrier = barrier != nullptr &&
+                       fl_value_get_type(barrier) == FL_VALUE_TYPE_BOOL &&
+                       fl_value_get_bool(barrier);
+  bool full = false;
+  bool unconfirmed;
+  uint64_t job_id = submit_job(self, device, data, length, copies, job_key,
+                               wants_barrier, &full, &unconfirmed);
+  return job_response(job_id, full, unconfirmed);
+}
+
+FlMethodResponse* write_batch(ThermalPrinterFlutterPlugin* self,
+                              FlValue* args) {
+  bool is_map = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP;
+  FlValue* printers = is_map ? fl_value_lookup_string(args, "printers")
+                             : nullptr;
+  FlValue* envelope = is_map ? fl_value_lookup_string(args, "jobs") : nullptr;
+  if (printers == nullptr ||
+      fl_value_get_type(printers) != FL_VALUE_TYPE_LIST ||
+      envelope == nullptr ||
+      fl_value_get_type(envelope) != FL_VALUE_TYPE_UINT8_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for writeBatch", nullptr));
+  }
+  // Each printer is resolved once, however many jobs it has.
+  std::vector<std::string> devices;
+  devices.reserve(fl_value_get_length(printers));
+  for (size_t i = 0; i < fl_value_get_length(printers); i++) {
+    FlValue* printer = fl_value_get_list_value(printers, i);
+    std::string device = fl_value_get_type(printer) == FL_VALUE_TYPE_MAP
+                             ? resolve_printer_key(printer)
+                             : std::string();
+    if (device.empty()) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "invalid_arguments", "Invalid printer in writeBatch", nullptr));
+    }
+    if (!apply_serial_arguments(self, device, printer)) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "invalid_arguments", "Unsupported baudRate or flowControl",
+          nullptr));
+    }
+    devices.push_back(std::move(device));
+  }
+  const uint8_t* data = fl_value_get_uint8_list(envelope);
+  size_t length = fl_value_get_length(envelope);
+  std::vector<thermal_printer_flutter::BatchJob> jobs;
+  if (!thermal_printer_flutter::DecodeJobBatch(data, length, devices.size(),
+                                               &jobs)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Malformed writeBatch envelope", nullptr));
+  }
+
+  // The other jobs are queued straight from the message.
+  std::vector<std::vector<uint8_t>> optimized;
+  optimized.reserve(jobs.size());
+  for (thermal_printer_flutter::BatchJob& job : jobs) {
+    if (job.optimize) {
+      optimized.emplace_back();
+      optimize_job(self, job.data, job.length, &optimized.back());
+      job.data = optimized.back().data();
+      job.length = optimized.back().size();
+      job.optimize = false;
+    }
+  }
+  std::vector<uint64_t> ids;
+  bool submitted = false;
+  bool sent = false;
+  if (self->daemon != nullptr) {
+    std::vector<uint8_t> encoded;
+    if (!optimized.empty()) {
+      encoded = thermal_printer_flutter::EncodeJobBatch(jobs);
+      data = encoded.data();
+      length = encoded.size();
+    }
+    submitted = self->daemon->SubmitBatch(devices, data, length, &ids,
+                                          &sent) &&
+                ids.size() == jobs.size();
+  }
+  if (!submitted && sent) {
+    return unconfirmed_response();
+  }
+  if (!submitted) {
+    self->queue->SubmitBatch(devices, jobs, &ids);
+  }
+  std::vector<int64_t> values(ids.begin(), ids.end());
+  g_autoptr(FlValue) result =
+      fl_value_new_int64_list(values.data(), values.size());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+bool read_raster_options(FlValue* args,
+                         thermal_printer_flutter::RasterOptions* options) {
+  FlValue* width = fl_value_lookup_string(args, "width");
+  if (width != nullptr) {
+    if (fl_value_get_type(width) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(width) < 0 || fl_value_get_int(width) > 0xFFFF) {
+      return false;
+    }
+    options->width = static_cast<int>(fl_value_get_int(width));
+  }
+  FlValue* threshold = fl_value_lookup_string(args, "threshold");
+  if (threshold != nullptr) {
+    if (fl_value_get_type(threshold) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(threshold) < 0 || fl_value_get_int(threshold) > 255) {
+      return false;
+    }
+    options->threshold = static_cast<int>(fl_value_get_int(threshold));
+  }
+  FlValue* dither = fl_value_lookup_string(args, "dither");
+  if (dither != nullptr) {
+    if (fl_value_get_type(dither) != FL_VALUE_TYPE_BOOL) {
+      return false;
+    }
+    options->dither = fl_value_get_bool(dither)
+                          ? thermal_printer_flutter::DitherMode::kFloydSteinberg
+                          : thermal_printer_flutter::DitherMode::kThreshold;
+  }
+  FlValue* rotation = fl_value_lookup_string(args, "rotation");
+  if (rotation != nullptr) {
+    if (fl_value_get_type(rotation) != FL_VALUE_TYPE_INT) {
+      return false;
+    }
+    switch (fl_value_get_int(rotation)) {
+      case 0:
+        options->rotation = thermal_printer_flutter::Rotation::k0;
+        break;
+      case 90:
+        options->rotation = thermal_printer_flutter::Rotation::k90;
+        break;
+      case 180:
+        options->rotation = thermal_printer_flutter::Rotation::k180;
+        break;
+      case 270:
+        options->rotation = thermal_printer_flutter::Rotation::k270;
+        break;
+      default:
+        return false;
+    }
+  }
+  FlValue* mirror = fl_value_lookup_string(args, "mirror");
+  if (mirror != nullptr) {
+    if (fl_value_get_type(mirror) != FL_VALUE_TYPE_BOOL) {
+      return false;
+    }
+    options->mirror = fl_value_get_bool(mirror);
+  }
+  return true;
+}
+
+FlMethodResponse* print_image(ThermalPrinterFlutterPlugin* self,
+                              FlValue* args) {
+  FlValue* image = nullptr;
+  int copies = 1;
+  thermal_printer_flutter::RasterOptions options;
+  // 0: the image's own width, capped at the paper width.
+  options.width = 0;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    image = fl_value_lookup_string(args, "image");
+  }
+  std::string device =
+      image != nullptr ? resolve_printer_key(args) : std::string();
+  if (image == nullptr ||
+      fl_value_get_type(image) != FL_VALUE_TYPE_UINT8_LIST ||
+      device.empty() || !read_raster_options(args, &options) ||
+      !read_copies(args, &copies)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for printImage", nullptr));
+  }
+
+  // Until the printer has been identified this is the 80 mm default.
+  thermal_printer_flutter::PrinterProfile profile;
+  get_profile(self, device, &profile);
+  options.band_height = profile.band_height;
+  std::vector<uint8_t> raster;
+  if (!decode_image_to_raster(fl_value_get_uint8_list(image),
+                              fl_value_get_length(image), options,
+                              profile.paper_width, self->bands, &raster)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "decode_failed", "Could not decode the image as PNG or JPEG",
+        nullptr));
+  }
+  bool full = false;
+  bool unconfirmed;
+  uint64_t job_id = submit_job(self, device, raster.data(), raster.size(),
+                               copies, std::string(), false, &full,
+                               &unconfirmed);
+  return job_response(job_id, full, unconfirmed);
+}
+
+bool read_file_job_spec(FlValue* args,
+                        thermal_printer_flutter::FileJobSpec* spec) {
+  const gchar* path = lookup_string(args, "path");
+  const gchar* format = lookup_string(args, "format");
+  if (path == nullptr || !g_path_is_absolute(path)) {
+    return false;
+  }
+  spec->path = path;
+  if (format == nullptr || strcmp(format, "escpos") == 0) {
+    spec->format = thermal_printer_flutter::FileFormat::kEscPos;
+  } else if (strcmp(format, "bitmap") == 0) {
+    spec->format = thermal_printer_flutter::FileFormat::kBitmap;
+    FlValue* width = fl_value_lookup_string(args, "bitmapWidth");
+    if (width == nullptr || fl_value_get_type(width) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(width) <= 0 || fl_value_get_int(width) % 8 != 0 ||
+        fl_value_get_int(width) > 0xFFFF) {
+      return false;
+    }
+    spec->bitmap_width = static_cast<int>(fl_value_get_int(width));
+  } else if (strcmp(format, "image") == 0) {
+    spec->format = thermal_printer_flutter::FileFormat::kImage;
+  } else {
+    return false;
+  }
+  return read_raster_options(args, &spec->raster);
+}
+
+FlMethodResponse* print_file(ThermalPrinterFlutterPlugin* self,
+                             FlValue* args) {
+  thermal_printer_flutter::FileJobSpec spec;
+  // 0: the image's own width, capped at the paper width.
+  spec.raster.width = 0;
+  std::string device;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP &&
+      read_file_job_spec(args, &spec)) {
+    device = resolve_printer_key(args);
+  }
+  if (device.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for printFile", nullptr));
+  }
+  if (!g_file_test(spec.path.c_str(), G_FILE_TEST_IS_REGULAR)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "file_not_found", "The file to print does not exist", nullptr));
+  }
+  uint64_t job_id;
+  bool sent = false;
+  if (self->daemon == nullptr ||
+      !self->daemon->SubmitFile(device, spec, &job_id, &sent)) {
+    if (sent) {
+      return unconfirmed_response();
+    }
+    job_id = self->queue->SubmitFile(device, spec);
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(job_id != 0);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+bool read_symbol_options(FlValue* args,
+                         thermal_printer_flutter::SymbolOptions* options) {
+  const gchar* type = lookup_string(args, "type");
+  if (type == nullptr || strcmp(type, "qr") == 0) {
+    options->type = thermal_printer_flutter::SymbolType::kQrCode;
+  } else if (strcmp(type, "code128") == 0) {
+    options->type = thermal_printer_flutter::SymbolType::kCode128;
+  } else if (strcmp(type, "ean13") == 0) {
+    options->type = thermal_printer_flutter::SymbolType::kEan13;
+  } else if (strcmp(type, "ean8") == 0) {
+    options->type = thermal_printer_flutter::SymbolType::kEan8;
+  } else {
+    return false;
+  }
+  const gchar* ecc = lookup_string(args, "ecc");
+  if (ecc != nullptr) {
+    if (strcmp(ecc, "L") == 0) {
+      options->ecc = thermal_printer_flutter::QrEcc::kLow;
+    } else if (strcmp(ecc, "M") == 0) {
+      options->ecc = thermal_printer_flutter::QrEcc::kMedium;
+    } else if (strcmp(ecc, "Q") == 0) {
+      options->ecc = thermal_printer_flutter::QrEcc::kQuartile;
+    } else if (strcmp(ecc, "H") == 0) {
+      options->ecc = thermal_printer_flutter::QrEcc::kHigh;
+    } else {
+      return false;
+    }
+  }
+  FlValue* module_size = fl_value_lookup_string(args, "moduleSize");
+  if (module_size != nullptr) {
+    if (fl_value_get_type(module_size) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(module_size) < 1 ||
+        fl_value_get_int(module_size) > 64) {
+      return false;
+    }
+    options->module_size = static_cast<int>(fl_value_get_int(module_size));
+  }
+  FlValue* height = fl_value_lookup_string(args, "height");
+  if (height != nullptr) {
+    if (fl_value_get_type(height) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(height) < 1 || fl_value_get_int(height) > 0xFFFF) {
+      return false;
+    }
+    options->height = static_cast<int>(fl_value_get_int(height));
+  }
+  FlValue* width = fl_value_lookup_string(args, "width");
+  if (width != nullptr) {
+    if (fl_value_get_type(width) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(width) < 8 || fl_value_get_int(width) > 0xFFFF) {
+      return false;
+    }
+    options->max_width = static_cast<int>(fl_value_get_int(width));
+  }
+  return true;
+}
+
+FlMethodResponse* print_symbol(ThermalPrinterFlutterPlugin* self,
+                               FlValue* args) {
+  thermal_printer_flutter::SymbolOptions options;
+  const gchar* data = nullptr;
+  std::string device;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    device = resolve_printer_key(args);
+    thermal_printer_flutter::PrinterProfile profile;
+    get_profile(self, device, &profile);
+    options.max_width = profile.paper_width;
+    if (read_symbol_options(args, &options)) {
+      data = lookup_string(args, "data");
+    }
+  }
+  if (data == nullptr || data[0] == '\0' || device.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for printSymbol", nullptr));
+  }
+  std::shared_ptr<const std::vector<uint8_t>> bands =
+      self->symbols->Get(data, options);
+  if (!bands) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "encode_failed",
+        "The data cannot be encoded in this symbol or does not fit the paper",
+        nullptr));
+  }
+  bool full = false;
+  bool unconfirmed;
+  uint64_t job_id = submit_job(self, device, bands->data(), bands->size(), 1,
+                               std::string(), false, &full, &unconfirmed);
+  return job_response(job_id, full, unconfirmed);
+}
+
+FlMethodResponse* configure_serial(ThermalPrinterFlutterPlugin* self,
+                                   FlValue* args) {
+  std::string device;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    device = resolve_printer_device(lookup_string(args, "usbAddress"),
+                                    lookup_string(args, "printerName"));
+  }
+  thermal_printer_flutter::SerialOptions options =
+      self->serial_settings->Get(device);
+  if (!thermal_printer_flutter::IsSerialDevicePath(device) ||
+      !read_serial_options(args, &options)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for configureSerial",
+        nullptr));
+  }
+  set_serial_options(self, device, options);
+  g_autoptr(FlValue) result = fl_value_new_bool(true);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+bool read_coalesce_options(FlValue* args,
+                           thermal_printer_flutter::CoalesceOptions* options) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return false;
+  }
+  FlValue* enabled = fl_value_lookup_string(args, "enabled");
+  if (enabled == nullptr || fl_value_get_type(enabled) != FL_VALUE_TYPE_BOOL) {
+    return false;
+  }
+  options->enabled = fl_value_get_bool(enabled);
+  FlValue* window = fl_value_lookup_string(args, "windowMs");
+  if (window != nullptr) {
+    if (fl_value_get_type(window) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(window) < 0) {
+      return false;
+    }
+    options->window = std::chrono::milliseconds(fl_value_get_int(window));
+  }
+  FlValue* max_bytes = fl_value_lookup_string(args, "maxBytes");
+  if (max_bytes != nullptr) {
+    if (fl_value_get_type(max_bytes) != FL_VALUE_TYPE_INT ||
+        fl_value_get_int(max_bytes) <= 0) {
+      return false;
+    }
+    options->max_bytes = static_cast<size_t>(fl_value_get_int(max_bytes));
+  }
+  return true;
+}
+
+FlMethodResponse* set_coalescing(ThermalPrinterFlutterPlugin* self,
+                                 FlValue* args) {
+  thermal_printer_flutter::CoalesceOptions options =
+      self->queue->coalesce_options();
+  if (!read_coalesce_options(args, &options)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for setCoalescing", nullptr));
+  }
+  self->queue->SetCoalesceOptions(options);
+  if (self->daemon != nullptr) {
+    self->daemon->SetCoalesceOptions(options);
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(true);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* flush_queue(ThermalPrinterFlutterPlugin* self,
+                              FlValue* args) {
+  // Without a printer every queue is flushed.
+  std::string device;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    device = resolve_printer_key(args);
+  }
+  if (self->daemon == nullptr || !self->daemon->Flush(device)) {
+    self->queue->Flush(device);
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(true);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* get_queue_stats(ThermalPrinterFlutterPlugin* self) {
+  thermal_printer_flutter::PrintQueueStats stats;
+  if (self->daemon == nullptr || !self->daemon->GetStats(&stats)) {
+    stats = self->queue->stats();
+  }
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "submitted",
+                           fl_value_new_int(stats.submitted));
+  fl_value_set_string_take(result, "completed",
+                           fl_value_new_int(stats.completed));
+  fl_value_set_string_take(result, "failed", fl_value_new_int(stats.failed));
+  fl_value_set_string_take(result, "bytesWritten",
+                           fl_value_new_int(stats.bytes_written));
+  fl_value_set_string_take(result, "coalescedWrites",
+                           fl_value_new_int(stats.coalesced_writes));
+  fl_value_set_string_take(result, "coalescedJobs",
+                           fl_value_new_int(stats.coalesced_jobs));
+  fl_value_set_string_take(result, "macroCopies",
+                           fl_value_new_int(stats.macro_copies));
+  fl_value_set_string_take(result, "resentCopies",
+                           fl_value_new_int(stats.resent_copies));
+  fl_value_set_string_take(result, "resentBytes",
+                           fl_value_new_int(stats.resent_bytes));
+  fl_value_set_string_take(result, "resumedBytes",
+                           fl_value_new_int(stats.resumed_bytes));
+  fl_value_set_string_take(result, "deduplicatedJobs",
+                           fl_value_new_int(stats.deduplicated_jobs));
+  fl_value_set_string_take(result, "failedOverJobs",
+                           fl_value_new_int(stats.failed_over_jobs));
+  fl_value_set_string_take(result, "queuedBytes",
+                           fl_value_new_int(stats.queued_bytes));
+  fl_value_set_string_take(result, "rejectedJobs",
+                           fl_value_new_int(stats.rejected_jobs));
+  fl_value_set_string_take(result, "bufferAllocations",
+                           fl_value_new_int(stats.buffer_allocations));
+  fl_value_set_string_take(result, "bufferReuses",
+                           fl_value_new_int(stats.buffer_reuses));
+  thermal_printer_flutter::BandCacheStats bands = self->bands->stats();
+  fl_value_set_string_take(result, "rasterBands",
+                           fl_value_new_int(bands.bands));
+  fl_value_set_string_take(result, "rasterBandsReused",
+                           fl_value_new_int(bands.reused));
+  fl_value_set_string_take(result, "lastJobBands",
+                           fl_value_new_int(bands.last_job.bands));
+  fl_value_set_string_take(result, "lastJobBandsReused",
+                           fl_value_new_int(bands.last_job.reused));
+  fl_value_set_string_take(result, "optimizedBytesIn",
+                           fl_value_new_int(self->optimized_bytes_in));
+  fl_value_set_string_take(result, "optimizedBytesOut",
+                           fl_value_new_int(self->optimized_bytes_out));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* get_printer_profile(ThermalPrinterFlutterPlugin* self,
+                                      FlValue* args) {
+  std::string device;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    device = resolve_printer_key(args);
+  }
+  if (device.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for printerProfile", nullptr));
+  }
+  thermal_printer_flutter::PrinterProfile profile;
+  bool resolved = get_profile(self, device, &profile);
+  const gchar* macros = "unknown";
+  if (profile.macros == thermal_printer_flutter::MacroSupport::kSupported) {
+    macros = "supported";
+  } else if (profile.macros ==
+             thermal_printer_flutter::MacroSupport::kUnsupported) {
+    macros = "unsupported";
+  }
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "resolved", fl_value_new_bool(resolved));
+  fl_value_set_string_take(result, "name",
+                           fl_value_new_string(profile.name.c_str()));
+  fl_value_set_string_take(
+      result, "manufacturer",
+      fl_value_new_string(profile.id.manufacturer.c_str()));
+  fl_value_set_string_take(result, "model",
+                           fl_value_new_string(profile.id.model.c_str()));
+  fl_value_set_string_take(
+      result, "commandSet",
+      fl_value_new_string(profile.id.command_set.c_str()));
+  fl_value_set_string_take(result, "paperWidth",
+                           fl_value_new_int(profile.paper_width));
+  fl_value_set_string_take(result, "bandHeight",
+                           fl_value_new_int(profile.band_height));
+  fl_value_set_string_take(result, "macros", fl_value_new_string(macros));
+  fl_value_set_string_take(result, "chunkSize",
+                           fl_value_new_int(profile.chunk_size));
+  fl_value_set_string_take(result, "chunkPacingMicros",
+                           fl_value_new_int(profile.chunk_pacing_us));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlValue* latency_histogram_value(
+    const thermal_printer_flutter::LatencyHistogram& histogram) {
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "samples",
+                           fl_value_new_int(histogram.samples));
+  fl_value_set_string_take(
+      value, "meanMs",
+      fl_value_new_float(histogram.samples > 0
+                             ? static_cast<double>(histogram.total_ms) /
+                                   histogram.samples
+                             : 0));
+  fl_value_set_string_take(value, "p50Ms",
+                           fl_value_new_int(histogram.PercentileMs(50)));
+  fl_value_set_string_take(value, "p90Ms",
+                           fl_value_new_int(histogram.PercentileMs(90)));
+  fl_value_set_string_take(value, "p99Ms",
+                           fl_value_new_int(histogram.PercentileMs(99)));
+  fl_value_set_string_take(value, "maxMs",
+                           fl_value_new_int(histogram.max_ms));
+  int64_t counts[thermal_printer_flutter::LatencyHistogram::kBuckets];
+  for (int i = 0; i < thermal_printer_flutter::LatencyHistogram::kBuckets;
+       i++) {
+    counts[i] = static_cast<int64_t>(histogram.counts[i]);
+  }
+  fl_value_set_string_take(
+      value, "buckets",
+      fl_value_new_int64_list(
+          counts, thermal_printer_flutter::LatencyHistogram::kBuckets));
+  return value;
+}
+
+FlMethodResponse* get_printer_latency(ThermalPrinterFlutterPlugin* self,
+                                      FlValue* args) {
+  std::string device;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    device = resolve_printer_key(args);
+  }
+  if (device.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for printerLatency", nullptr));
+  }
+  thermal_printer_flutter::PrinterLatency latency;
+  bool measured;
+  if (self->daemon == nullptr ||
+      !self->daemon->GetLatency(device, &latency, &measured)) {
+    measured = self->queue->GetLatency(device, &latency);
+  }
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "measured", fl_value_new_bool(measured));
+  fl_value_set_string_take(result, "handoff",
+                           latency_histogram_value(latency.handoff));
+  fl_value_set_string_take(result, "completion",
+                           latency_histogram_value(latency.completion));
+  fl_value_set_string_take(result, "unanswered",
+                           fl_value_new_int(latency.unanswered));
+  fl_value_set_string_take(result, "unsupported",
+                           fl_value_new_int(latency.unsupported));
+  fl_value_set_string_take(result, "lastCompletionMs",
+                           fl_value_new_int(latency.last_completion_ms));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* set_printer_group(ThermalPrinterFlutterPlugin* self,
+                                    FlValue* args) {
+  std::string group;
+  FlValue* printers = nullptr;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    group = printer_group_key(lookup_string(args, "group"));
+    printers = fl_value_lookup_string(args, "printers");
+  }
+  if (group.empty() || printers == nullptr ||
+      fl_value_get_type(printers) != FL_VALUE_TYPE_LIST) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for setPrinterGroup",
+        nullptr));
+  }
+  std::vector<std::string> members;
+  for (size_t i = 0; i < fl_value_get_length(printers); i++) {
+    FlValue* printer = fl_value_get_list_value(printers, i);
+    std::string member;
+    if (fl_value_get_type(printer) == FL_VALUE_TYPE_MAP) {
+      member = resolve_printer_key(printer);
+    }
+    if (member.empty()) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "invalid_arguments", "Invalid printer in setPrinterGroup",
+          nullptr));
+    }
+    members.push_back(member);
+  }
+  bool ok = self->queue->SetGroup(group, members);
+  if (ok && self->daemon != nullptr) {
+    self->daemon->SetGroup(group, members);
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(ok);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* get_printer_group_stats(ThermalPrinterFlutterPlugin* self,
+                                          FlValue* args) {
+  std::string group;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    group = printer_group_key(lookup_string(args, "group"));
+  }
+  std::vector<thermal_printer_flutter::GroupMemberStats> members;
+  if (group.empty() ||
+      ((self->daemon == nullptr ||
+        !self->daemon->GetGroupStats(group, &members)) &&
+       !self->queue->GetGroupStats(group, &members))) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Unknown printer group", nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_list();
+  for (const auto& member : members) {
+    g_autoptr(FlValue) entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "printer",
+                             fl_value_new_string(member.printer.c_str()));
+    fl_value_set_string_take(entry, "queuedBytes",
+                             fl_value_new_int(member.queued_bytes));
+    fl_value_set_string_take(entry, "bytesPerSecond",
+                             fl_value_new_float(member.bytes_per_second));
+    fl_value_set_string_take(entry, "utilization",
+                             fl_value_new_float(member.utilization));
+    fl_value_set_string_take(entry, "routedJobs",
+                             fl_value_new_int(member.routed_jobs));
+    fl_value_set_string_take(entry, "failedOverJobs",
+                             fl_value_new_int(member.failed_over_jobs));
+    fl_value_set_string_take(entry, "offline",
+                             fl_value_new_bool(member.offline));
+    fl_value_append(result, entry);
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlValue* printer_status_value(
+    const std::string& printer,
+    const thermal_printer_flutter::PrinterStatus& status) {
+  const gchar* paper = "unknown";
+  switch (status.paper) {
+    case thermal_printer_flutter::PaperState::kPresent:
+      paper = "present";
+      break;
+    case thermal_printer_flutter::PaperState::kNearEnd:
+      paper = "nearEnd";
+      break;
+    case thermal_printer_flutter::PaperState::kOut:
+      paper = "out";
+      break;
+    case thermal_printer_flutter::PaperState::kUnknown:
+      break;
+  }
+  FlValue* value = fl_value_new_map();
+  fl_value_set_string_take(value, "printer",
+                           fl_value_new_string(printer.c_str()));
+  fl_value_set_string_take(value, "connected",
+                           fl_value_new_bool(status.connected));
+  fl_value_set_string_take(value, "online", fl_value_new_bool(status.online));
+  fl_value_set_string_take(value, "paper", fl_value_new_string(paper));
+  fl_value_set_string_take(value, "ready", fl_value_new_bool(status.ready));
+  return value;
+}
+
+// Sends the status changes gathered since the last call as one event, a
+// list with the latest status of each printer that changed.
+static gboolean send_pending_statuses(gpointer user_data) {
+  ThermalPrinterFlutterPlugin* self = THERMAL_PRINTER_FLUTTER_PLUGIN(user_data);
+  if (self->pending_statuses == nullptr) {
+    return G_SOURCE_REMOVE;
+  }
+  std::map<std::string, thermal_printer_flutter::PrinterStatus> changes;
+  {
+    std::lock_guard<std::mutex> lock(self->pending_statuses->mutex);
+    changes.swap(self->pending_statuses->changes);
+    self->pending_statuses->scheduled = false;
+  }
+  if (!self->status_listening || changes.empty()) {
+    return G_SOURCE_REMOVE;
+  }
+  g_autoptr(FlValue) event = fl_value_new_list();
+  for (const auto& change : changes) {
+    fl_value_append_take(event,
+                         printer_status_value(change.first, change.second));
+  }
+  g_autoptr(GError) error = nullptr;
+  if (!fl_event_channel_send(self->status_channel, event, nullptr, &error)) {
+    g_warning("Could not send printer status: %s", error->message);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// Queues |status| to be sent from the main loop; changes that arrive
+// before it runs go in the same event. Safe to call from any thread.
+static void post_printer_status(
+    ThermalPrinterFlutterPlugin* self, const std::string& printer,
+    const thermal_printer_flutter::PrinterStatus& status) {
+  PendingStatuses* pending = self->pending_statuses;
+  {
+    std::lock_guard<std::mutex> lock(pending->mutex);
+    pending->changes[printer] = status;
+    if (pending->scheduled) {
+      return;
+    }
+    pending->scheduled = true;
+  }
+  g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, send_pending_statuses,
+                  g_object_ref(self), g_object_unref);
+}
+
+// Passes on the status changes the daemon pushed for the printers watched
+// through it. If the daemon has gone, the plugin's own queue watches them
+// instead.
+static gboolean receive_daemon_statuses(gint fd, GIOCondition condition,
+                                        gpointer user_data) {
+  ThermalPrinterFlutterPlugin* self = THERMAL_PRINTER_FLUTTER_PLUGIN(user_data);
+  std::vector<thermal_printer_flutter::PrinterStatusChange> changes;
+  bool subscribed = self->daemon->ReadStatusChanges(&changes);
+  for (const auto& change : changes) {
+    auto it = self->daemon_statuses->find(change.printer);
+    if (it != self->daemon_statuses->end() && it->second != change.status) {
+      it->second = change.status;
+      post_printer_status(self, change.printer, change.status);
+    }
+  }
+  if (subscribed) {
+    return G_SOURCE_CONTINUE;
+  }
+  for (const auto& entry : *self->daemon_statuses) {
+    self->queue->Watch(entry.first);
+  }
+  self->daemon_statuses->clear();
+  self->daemon_status_source = 0;
+  return G_SOURCE_REMOVE;
+}
+
+// Has the daemon push status changes to receive_daemon_statuses(), unless
+// it already does. Returns false if it cannot.
+static bool subscribe_daemon_statuses(ThermalPrinterFlutterPlugin* self) {
+  if (self->daemon_status_source != 0) {
+    return true;
+  }
+  int fd = self->daemon->Subscribe();
+  if (fd < 0) {
+    return false;
+  }
+  self->daemon_status_source =
+      g_unix_fd_add(fd, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP |
+                                                  G_IO_ERR),
+                    receive_daemon_statuses, self);
+  return true;
+}
+
+FlMethodResponse* watch_printer(ThermalPrinterFlutterPlugin* self,
+                                FlValue* args) {
+  std::string device;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    device = resolve_printer_key(args);
+  }
+  if (device.empty()) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for watchPrinter", nullptr));
+  }
+  // Subscribed first, so no change after the status read here is missed.
+  thermal_printer_flutter::PrinterStatus status;
+  bool known;
+  if (self->daemon != nullptr && subscribe_daemon_statuses(self) &&
+      self->daemon->GetStatus(device, &status, &known)) {
+    (*self->daemon_statuses)[device] = status;
+  } else {
+    self->queue->Watch(device);
+    self->queue->GetStatus(device, &status);
+  }
+  g_autoptr(FlValue) result = printer_status_value(device, status);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* dump_trace(ThermalPrinterFlutterPlugin* self,
+                             FlValue* args) {
+  const gchar* path = nullptr;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    path = lookup_string(args, "path");
+  }
+  if (path == nullptr || path[0] == '\0') {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for dumpTrace", nullptr));
+  }
+  // Jobs go to the daemon while it runs, so its trace is the one that
+  // shows them.
+  bool written = (self->daemon != nullptr && self->daemon->DumpTrace(path)) ||
+                 self->queue->flight_recorder()->WriteChromeTrace(path);
+  g_autoptr(FlValue) result = fl_value_new_bool(written);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* set_trace_threshold(ThermalPrinterFlutterPlugin* self,
+                                      FlValue* args) {
+  const gchar* path = nullptr;
+  FlValue* threshold = nullptr;
+  if (args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+    path = lookup_string(args, "path");
+    threshold = fl_value_lookup_string(args, "thresholdMs");
+  }
+  if (threshold == nullptr ||
+      fl_value_get_type(threshold) != FL_VALUE_TYPE_INT ||
+      fl_value_get_int(threshold) < 0 ||
+      (fl_value_get_int(threshold) > 0 &&
+       (path == nullptr || path[0] == '\0'))) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for setTraceThreshold",
+        nullptr));
+  }
+  std::chrono::milliseconds threshold_ms(fl_value_get_int(threshold));
+  std::string trace_path = path != nullptr ? path : "";
+  self->queue->flight_recorder()->SetAutoDump(threshold_ms, trace_path);
+  if (self->daemon != nullptr) {
+    self->daemon->SetTraceThreshold(threshold_ms, trace_path);
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(true);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+FlMethodResponse* warm_up(ThermalPrinterFlutterPlugin* self, FlValue* args) {
+  bool is_map = args != nullptr && fl_value_get_type(args) == FL_VALUE_TYPE_MAP;
+  FlValue* printers = is_map ? fl_value_lookup_string(args, "printers")
+                             : nullptr;
+  FlValue* files = is_map ? fl_value_lookup_string(args, "files") : nullptr;
+  if ((printers != nullptr &&
+       fl_value_get_type(printers) != FL_VALUE_TYPE_LIST) ||
+      (files != nullptr && fl_value_get_type(files) != FL_VALUE_TYPE_LIST)) {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "invalid_arguments", "Invalid arguments for warmUp", nullptr));
+  }
+  std::vector<thermal_printer_flutter::FileJobSpec> preload;
+  for (size_t i = 0; files != nullptr && i < fl_value_get_length(files);
+       i++) {
+    FlValue* file = fl_value_get_list_value(files, i);
+    thermal_printer_flutter::FileJobSpec spec;
+    // As printFile reads it, so the bands cached are the ones it asks for.
+    spec.raster.width = 0;
+    if (fl_value_get_type(file) != FL_VALUE_TYPE_MAP ||
+        !read_file_job_spec(file, &spec)) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "invalid_arguments", "Invalid file in warmUp", nullptr));
+    }
+    preload.push_back(std::move(spec));
+  }
+  g_autoptr(FlMethodResponse) found = nullptr;
+  if (printers == nullptr) {
+    found = get_usb_printers();
+    printers = fl_method_success_response_get_result(
+        FL_METHOD_SUCCESS_RESPONSE(found));
+  }
+  std::vector<std::string> devices;
+  for (size_t i = 0; i < fl_value_get_length(printers); i++) {
+    FlValue* printer = fl_value_get_list_value(printers, i);
+    std::string device = fl_value_get_type(printer) == FL_VALUE_TYPE_MAP
+                             ? resolve_printer_key(printer)
+                             : std::string();
+    if (device.empty()) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "invalid_arguments", "Invalid printer in warmUp", nullptr));
+    }
+    if (!apply_serial_arguments(self, device, printer)) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "invalid_arguments", "Unsupported baudRate or flowControl",
+          nullptr));
+    }
+    devices.push_back(std::move(device));
+  }
+
+  // Warmed up where their jobs will go. The daemon pushes the statuses
+  // that warming up reports, as it does for watched printers.
+  if (self->daemon != nullptr && subscribe_daemon_statuses(self) &&
+      self->daemon->WarmUp(devices, preload)) {
+    for (const std::string& device : devices) {
+      self->daemon_statuses->emplace(
+          device, thermal_printer_flutter::PrinterStatus());
+    }
+  } else {
+    for (const std::string& device : devices) {
+      self->queue->WarmUp(device, preload);
+    }
+  }
+  g_autoptr(FlValue) result = fl_value_new_list();
+  for (const std::string& device : devices) {
+    fl_value_append_take(result, fl_value_new_string(device.c_str()));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodErrorResponse* status_listen_cb(FlEventChannel* channel,
+                                               FlValue* args,
+                                               gpointer user_data) {
+  THERMAL_PRINTER_FLUTTER_PLUGIN(user_data)->status_listening = true;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* status_cancel_cb(FlEventChannel* channel,
+                                               FlValue* args,
+                                               gpointer user_data) {
+  THERMAL_PRINTER_FLUTTER_PLUGIN(user_data)->status_listening = false;
+  return nullptr;
+}
+
 static void thermal_printer_flutter_plugin_dispose(GObject* object) {
+  ThermalPrinterFlutterPlugin* self = THERMAL_PRINTER_FLUTTER_PLUGIN(object);
+  if (self->daemon_status_source != 0) {
+    g_source_remove(self->daemon_status_source);
+    self->daemon_status_source = 0;
+  }
+  delete self->daemon_statuses;
+  self->daemon_statuses = nullptr;
+  delete self->daemon;
+  self->daemon = nullptr;
+  // The queue writes completions to the journal and encodes image files
+  // through the band cache, so it goes first.
+  delete self->queue;
+  self->queue = nullptr;
+  // Its observer posted here until it was deleted.
+  delete self->pending_statuses;
+  self->pending_statuses = nullptr;
+  g_clear_object(&self->status_channel);
+  delete self->journal;
+  self->journal = nullptr;
+  delete self->serial_settings;
+  self->serial_settings = nullptr;
+  delete self->symbols;
+  self->symbols = nullptr;
+  delete self->bands;
+  self->bands = nullptr;
+
   G_OBJECT_CLASS(thermal_printer_flutter_plugin_parent_class)->dispose(object);
 }
 
@@ -51,7 +1478,74 @@ static void thermal_printer_flutter_plugin_class_init(ThermalPrinterFlutterPlugi
   G_OBJECT_CLASS(klass)->dispose = thermal_printer_flutter_plugin_dispose;
 }
 
-static void thermal_printer_flutter_plugin_init(ThermalPrinterFlutterPlugin* self) {}
+static void thermal_printer_flutter_plugin_init(ThermalPrinterFlutterPlugin* self) {
+  // Jobs are journaled under the user cache directory so tickets queued when
+  // the app died are printed on the next launch.
+  g_autofree gchar* spool_dir = g_build_filename(
+      g_get_user_cache_dir(), "thermal_printer_flutter", nullptr);
+  g_autofree gchar* journal_path =
+      g_build_filename(spool_dir, "spool.journal", nullptr);
+  std::vector<thermal_printer_flutter::JournaledJob> pending;
+  std::vector<thermal_printer_flutter::JournaledKey> settled_keys;
+  self->journal = new thermal_printer_flutter::SpoolJournal();
+  if (g_mkdir_with_parents(spool_dir, 0700) != 0 ||
+      !self->journal->Open(journal_path, &pending, &settled_keys)) {
+    g_warning("Print spool journal unavailable at %s; jobs will not survive "
+              "a restart", journal_path);
+  }
+
+  // Receipts share headers, logos and footers; their bands are dithered once.
+  self->bands = new thermal_printer_flutter::BandCache();
+  thermal_printer_flutter::BandCache* bands = self->bands;
+
+  self->serial_settings = new thermal_printer_flutter::SerialSettings();
+  thermal_printer_flutter::SerialSettings* serial_settings =
+      self->serial_settings;
+  self->queue = new thermal_printer_flutter::PrintQueue(
+      [serial_settings](const std::string& printer) {
+        return thermal_printer_flutter::CreatePrinterTransport(
+            printer, serial_settings);
+      },
+      self->journal);
+  // Every printer is written from one GMainContext thread, with a couple
+  // more for connecting and file jobs, instead of a thread per printer.
+  self->queue->SetIoLoop(std::unique_ptr<thermal_printer_flutter::IoLoop>(
+      new thermal_printer_flutter::GlibIoLoop()));
+  // Jobs past this are refused with queue_full, so an app printing faster
+  // than its printers can keep up is told to wait instead of growing the
+  // queue without bound.
+  self->queue->SetMemoryLimit(
+      thermal_printer_flutter::PrintQueue::kDefaultMemoryLimit);
+  self->queue->SetSourceFactory(
+      [bands](const thermal_printer_flutter::FileJobSpec& spec,
+              const thermal_printer_flutter::PrinterProfile& profile) {
+        return open_print_file_source(spec, profile, bands);
+      });
+  // Paper width, band height and macro support come from the printer's
+  // device ID, read before its first job.
+  self->queue->SetProfileResolver(
+      thermal_printer_flutter::ResolvePrinterProfile);
+  // Printer status is pushed to Dart as it changes, so checking it costs
+  // Dart no method call.
+  self->pending_statuses = new PendingStatuses();
+  self->daemon_statuses =
+      new std::map<std::string, thermal_printer_flutter::PrinterStatus>();
+  self->queue->SetStatusObserver(
+      [self](const std::string& printer,
+             const thermal_printer_flutter::PrinterStatus& status) {
+        post_printer_status(self, printer, status);
+      });
+  self->queue->Restore(std::move(pending), std::move(settled_keys));
+  self->symbols = new thermal_printer_flutter::SymbolCache();
+
+  // Apps on the same machine share printers through the daemon when it
+  // runs; this process's queue is the fallback.
+  self->daemon = new thermal_printer_flutter::DaemonClient(
+      thermal_printer_flutter::DefaultDaemonSocketPath());
+  if (self->daemon->Connect()) {
+    g_debug("Printing through the print daemon");
+  }
+}
 
 static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
                            gpointer user_data) {
@@ -72,5 +1566,13 @@ void thermal_printer_flutter_plugin_register_with_registrar(FlPluginRegistrar* r
                                             g_object_ref(plugin),
                                             g_object_unref);
 
+  plugin->status_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           "thermal_printer_flutter/status",
+                           FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->status_channel,
+                                       status_listen_cb, status_cancel_cb,
+                                       plugin, nullptr);
+
   g_object_unref(plugin);
 }
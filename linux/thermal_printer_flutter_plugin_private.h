@@ -1,10 +1,190 @@
 #include <flutter_linux/flutter_linux.h>
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "include/thermal_printer_flutter/thermal_printer_flutter_plugin.h"
 
+namespace thermal_printer_flutter {
+struct CoalesceOptions;
+struct FileJobSpec;
+struct PrinterProfile;
+struct PrinterStatus;
+struct RasterOptions;
+struct SerialOptions;
+struct SymbolOptions;
+}  // namespace thermal_printer_flutter
+
 // This file exposes some plugin internals for unit testing. See
 // https://github.com/flutter/flutter/issues/88724 for current limitations
 // in the unit-testable API.
 
 // Handles the getPlatformVersion method call.
 FlMethodResponse *get_platform_version();
+
+// Handles the usbprinters method call by listing /dev/usb/lp* devices and
+// serial ports.
+FlMethodResponse *get_usb_printers();
+
+// Queues a copy of |length| bytes of |data| on the print daemon if one is
+// running, else on the plugin's own queue. Returns the job id, or 0 if it
+// was refused; |full|, if given, is set if that was because the queue had
+// reached its memory limit.
+uint64_t submit_job(ThermalPrinterFlutterPlugin *self,
+                    const std::string &device, const uint8_t *data,
+                    size_t length, int copies = 1,
+                    const std::string &key = std::string(),
+                    bool barrier = false, bool *full = nullptr);
+
+// Fills |profile| from the daemon's queue if one is running, else from the
+// plugin's own. Returns false if the printer has not been identified yet.
+bool get_profile(ThermalPrinterFlutterPlugin *self, const std::string &device,
+                 thermal_printer_flutter::PrinterProfile *profile);
+
+// Applies serial port options locally and, if one is running, on the daemon.
+void set_serial_options(ThermalPrinterFlutterPlugin *self,
+                        const std::string &device,
+                        const thermal_printer_flutter::SerialOptions &options);
+
+// Handles the writebytes method call by queuing the bytes for the printer,
+// through the ESC/POS optimizer when the optimize argument is true. A jobKey
+// argument makes the call idempotent.
+FlMethodResponse *write_bytes(ThermalPrinterFlutterPlugin *self,
+                              FlValue *args);
+
+// Handles the writeBatch method call: a printers list, each entry the
+// arguments printBytes takes to name a printer, and a jobs Uint8List in the
+// core/job_batch.h envelope. Replies with each job's id, 0 for jobs that
+// were not queued.
+FlMethodResponse *write_batch(ThermalPrinterFlutterPlugin *self,
+                              FlValue *args);
+
+// Handles the printImage method call: decodes PNG/JPEG bytes natively and
+// queues them as raster bands for the printer.
+FlMethodResponse *print_image(ThermalPrinterFlutterPlugin *self,
+                              FlValue *args);
+
+// Updates |options| from the optional width, threshold and dither
+// printImage arguments. Returns false for out of range values.
+bool read_raster_options(FlValue *args,
+                         thermal_printer_flutter::RasterOptions *options);
+
+// Reads the optional copies argument of writebytes and printImage into
+// |copies|. Returns false unless it is an integer from 1 to 255.
+bool read_copies(FlValue *args, int *copies);
+
+// Reads the optional jobKey argument of writebytes into |key|. Returns false
+// unless it is a string of 1 to 255 bytes.
+bool read_job_key(FlValue *args, std::string *key);
+
+// Handles the printFile method call: queues a file that is mapped and
+// streamed to the printer in bands when its turn comes.
+FlMethodResponse *print_file(ThermalPrinterFlutterPlugin *self,
+                             FlValue *args);
+
+// Fills |spec| from the path, format ("escpos", "bitmap" or "image"),
+// bitmapWidth and raster printFile arguments.
+bool read_file_job_spec(FlValue *args,
+                        thermal_printer_flutter::FileJobSpec *spec);
+
+// Handles the printSymbol method call: encodes a QR code or barcode
+// natively, through the symbol cache, and queues it as raster bands.
+FlMethodResponse *print_symbol(ThermalPrinterFlutterPlugin *self,
+                               FlValue *args);
+
+// Updates |options| from the type ("qr", "code128", "ean13" or "ean8"), ecc
+// ("L", "M", "Q" or "H"), moduleSize, height and width printSymbol
+// arguments. Returns false for unsupported values.
+bool read_symbol_options(FlValue *args,
+                         thermal_printer_flutter::SymbolOptions *options);
+
+// Builds the queue key ("tcp://host:port" or "lpd://host:port/queue") for
+// writebytes calls that carry ip/port/protocol/queue arguments. Returns an
+// empty string when |args| does not describe a network printer.
+std::string resolve_network_printer(FlValue *args);
+
+// Handles the configureSerial method call, storing the baud rate and flow
+// control used for a serial port's next write.
+FlMethodResponse *configure_serial(ThermalPrinterFlutterPlugin *self,
+                                   FlValue *args);
+
+// Updates |options| from the optional baudRate ("auto" or a rate) and
+// flowControl writebytes arguments. Returns false for unsupported values.
+bool read_serial_options(FlValue *args,
+                         thermal_printer_flutter::SerialOptions *options);
+
+// Maps the usbAddress/printerName pair sent from Dart to a device path.
+std::string resolve_printer_device(const gchar *usb_address,
+                                   const gchar *printer_name);
+
+// Handles the setCoalescing method call, which turns merging of small
+// consecutive jobs on or off and sets its window and byte threshold.
+FlMethodResponse *set_coalescing(ThermalPrinterFlutterPlugin *self,
+                                 FlValue *args);
+
+// Updates |options| from the enabled, windowMs and maxBytes arguments.
+// Returns false when enabled is missing or a value is out of range.
+bool read_coalesce_options(FlValue *args,
+                           thermal_printer_flutter::CoalesceOptions *options);
+
+// Handles the flush method call, writing jobs held for coalescing now.
+FlMethodResponse *flush_queue(ThermalPrinterFlutterPlugin *self,
+                              FlValue *args);
+
+// Handles the queueStats method call.
+FlMethodResponse *get_queue_stats(ThermalPrinterFlutterPlugin *self);
+
+// Handles the printerProfile method call, reporting the capabilities the
+// plugin resolved from the printer's device ID.
+FlMethodResponse *get_printer_profile(ThermalPrinterFlutterPlugin *self,
+                                      FlValue *args);
+
+// Handles the printerLatency method call, reporting the handoff and
+// completion latency histograms of the printer's barrier jobs.
+FlMethodResponse *get_printer_latency(ThermalPrinterFlutterPlugin *self,
+                                      FlValue *args);
+
+// The queue key of the printer group named |group|, kept apart from device
+// paths and network endpoints. Empty for an empty or null name.
+std::string printer_group_key(const gchar *group);
+
+// Handles the setPrinterGroup method call, which makes a group name
+// printable to and routes its jobs across the given printers.
+FlMethodResponse *set_printer_group(ThermalPrinterFlutterPlugin *self,
+                                    FlValue *args);
+
+// Handles the printerGroupStats method call, reporting each member's queued
+// bytes, measured rate and utilization.
+FlMethodResponse *get_printer_group_stats(ThermalPrinterFlutterPlugin *self,
+                                          FlValue *args);
+
+// A printer's status as sent to Dart: printer (the queue key), connected,
+// online, paper ("present", "nearEnd", "out" or "unknown") and ready.
+FlValue *printer_status_value(
+    const std::string &printer,
+    const thermal_printer_flutter::PrinterStatus &status);
+
+// Handles the watchPrinter method call. The printer's status is probed
+// from then on and changes are pushed on the thermal_printer_flutter/status
+// event channel; the reply is its status now.
+FlMethodResponse *watch_printer(ThermalPrinterFlutterPlugin *self,
+                                FlValue *args);
+
+// Handles the dumpTrace method call: writes the print queue's flight
+// recorder, the daemon's when it runs, to path as a Chrome trace. Replies
+// whether it was written.
+FlMethodResponse *dump_trace(ThermalPrinterFlutterPlugin *self,
+                             FlValue *args);
+
+// Handles the setTraceThreshold method call: thresholdMs (0 turns it off)
+// and the path the trace is written to once a job takes longer.
+FlMethodResponse *set_trace_threshold(ThermalPrinterFlutterPlugin *self,
+                                      FlValue *args);
+
+// Handles the warmUp method call: printers (every USB and serial printer
+// found when absent) are connected, identified and probed in the
+// background, and files, in printFile's arguments, read ahead for them.
+// Replies with the printers' keys; each one's status, with ready set once
+// its first job will not wait, is pushed on the status event channel.
+FlMethodResponse *warm_up(ThermalPrinterFlutterPlugin *self, FlValue *args);
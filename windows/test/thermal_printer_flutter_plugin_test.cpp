@@ -39,5 +39,37 @@ TEST(ThermalPrinterFlutterPlugin, GetPlatformVersion) {
   EXPECT_TRUE(result_string.rfind("Windows ", 0) == 0);
 }
 
+TEST(ThermalPrinterFlutterPlugin, WarmUpRepliesWithThePrinterNames) {
+  ThermalPrinterFlutterPlugin plugin;
+  EncodableMap printer;
+  printer[EncodableValue("printerName")] = EncodableValue("No Such Printer");
+  EncodableMap arguments;
+  arguments[EncodableValue("printers")] =
+      EncodableValue(flutter::EncodableList{EncodableValue(printer)});
+  flutter::EncodableList keys;
+  plugin.HandleMethodCall(
+      MethodCall("warmUp", std::make_unique<EncodableValue>(arguments)),
+      std::make_unique<MethodResultFunctions<>>(
+          [&keys](const EncodableValue* result) {
+            keys = std::get<flutter::EncodableList>(*result);
+          },
+          nullptr, nullptr));
+  // Opened in the background; a printer that is not there is not an error.
+  ASSERT_EQ(keys.size(), 1u);
+  EXPECT_EQ(std::get<std::string>(keys[0]), "No Such Printer");
+
+  bool failed = false;
+  arguments[EncodableValue("printers")] =
+      EncodableValue(flutter::EncodableList{EncodableValue(1)});
+  plugin.HandleMethodCall(
+      MethodCall("warmUp", std::make_unique<EncodableValue>(arguments)),
+      std::make_unique<MethodResultFunctions<>>(
+          nullptr,
+          [&failed](const std::string&, const std::string&,
+                    const EncodableValue*) { failed = true; },
+          nullptr));
+  EXPECT_TRUE(failed);
+}
+
 }  // namespace test
 }  // namespace thermal_printer_flutter
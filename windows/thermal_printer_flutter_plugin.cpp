@@ -10,6 +10,8 @@
 #include <flutter/plugin_registrar_windows.h>
 #include <flutter/standard_method_codec.h>
 
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <sstream>
 #include <vector>
@@ -41,7 +43,14 @@ void ThermalPrinterFlutterPlugin::RegisterWithRegistrar(
 // Construtor e destrutor padrão
 // =====================================================
 ThermalPrinterFlutterPlugin::ThermalPrinterFlutterPlugin() {}
-ThermalPrinterFlutterPlugin::~ThermalPrinterFlutterPlugin() {}
+
+ThermalPrinterFlutterPlugin::~ThermalPrinterFlutterPlugin() {
+  // Espera os aquecimentos, que ainda podem guardar handles
+  warm_ups_.clear();
+  for (const auto& entry : open_printers_) {
+    ClosePrinter(entry.second);
+  }
+}
 
 // =====================================================
 // Método auxiliar para converter string wide para string normal
@@ -66,8 +75,8 @@ std::string WideStringToString(LPCWSTR wideStr) {
 // =====================================================
 // Método para obter lista de impressoras disponíveis
 // =====================================================
-std::vector<std::string> ThermalPrinterFlutterPlugin::GetPrinters() {
-  std::vector<std::string> printers;
+std::vector<PrinterInfo> ThermalPrinterFlutterPlugin::GetPrinters() {
+  std::vector<PrinterInfo> printers;
   DWORD needed = 0;
   DWORD returned = 0;
   
@@ -75,11 +84,17 @@ std::vector<std::string> ThermalPrinterFlutterPlugin::GetPrinters() {
   EnumPrinters(PRINTER_ENUM_LOCAL | PRINTER_ENUM_CONNECTIONS, NULL, 2, NULL, 0, &needed, &returned);
   
   if (needed > 0) {
-    std::vector<BYTE> buffer(needed);
-    if (EnumPrinters(PRINTER_ENUM_LOCAL | PRINTER_ENUM_CONNECTIONS, NULL, 2, buffer.data(), needed, &needed, &returned)) {
-      PRINTER_INFO_2* printerInfo = reinterpret_cast<PRINTER_INFO_2*>(buffer.data());
+    // O buffer só cresce, então listar de novo as mesmas impressoras não aloca
+    if (printers_buffer_.size() < needed) {
+      printers_buffer_.resize(needed);
+    }
+    if (EnumPrinters(PRINTER_ENUM_LOCAL | PRINTER_ENUM_CONNECTIONS, NULL, 2, printers_buffer_.data(), needed, &needed, &returned)) {
+      PRINTER_INFO_2* printerInfo = reinterpret_cast<PRINTER_INFO_2*>(printers_buffer_.data());
       for (DWORD i = 0; i < returned; i++) {
-        printers.push_back(WideStringToString(printerInfo[i].pPrinterName));
+        PrinterInfo printer;
+        printer.name = WideStringToString(printerInfo[i].pPrinterName);
+        printer.driver = WideStringToString(printerInfo[i].pDriverName);
+        printers.push_back(printer);
       }
     }
   }
@@ -91,50 +106,130 @@ std::vector<std::string> ThermalPrinterFlutterPlugin::GetPrinters() {
 // Método principal para imprimir bytes na impressora
 // Implementação baseada no exemplo do win32
 // =====================================================
-void ThermalPrinterFlutterPlugin::PrintBytes(const std::vector<uint8_t>& bytes, const std::string& printerName) {
+bool ThermalPrinterFlutterPlugin::SetPrinterName(const std::string& printerName) {
+    // Converte o nome da impressora para string wide (Unicode)
+    // Necessário porque o Windows usa strings Unicode internamente. A string
+    // é reaproveitada, então usar de novo a mesma impressora não aloca
+    int wchars_num = MultiByteToWideChar(CP_UTF8, 0, printerName.c_str(), -1, NULL, 0);
+    if (wchars_num <= 0) {
+        return false;
+    }
+    printer_name_.resize(wchars_num - 1);
+    MultiByteToWideChar(CP_UTF8, 0, printerName.c_str(), -1, &printer_name_[0], wchars_num);
+    return true;
+}
+
+bool ThermalPrinterFlutterPlugin::IsConnected(const std::string& printerName) {
+    if (!SetPrinterName(printerName)) {
+        return false;
+    }
     HANDLE hPrinter;
+    if (!OpenPrinter(&printer_name_[0], &hPrinter, NULL)) {
+        return false;
+    }
+    // Consulta o estado no spooler, no mesmo buffer usado pela listagem
+    DWORD needed = 0;
+    GetPrinter(hPrinter, 2, NULL, 0, &needed);
+    bool connected = false;
+    if (needed > 0) {
+        if (printers_buffer_.size() < needed) {
+            printers_buffer_.resize(needed);
+        }
+        if (GetPrinter(hPrinter, 2, printers_buffer_.data(), needed, &needed)) {
+            const PRINTER_INFO_2* info = reinterpret_cast<PRINTER_INFO_2*>(printers_buffer_.data());
+            const DWORD offline = PRINTER_STATUS_OFFLINE | PRINTER_STATUS_NOT_AVAILABLE | PRINTER_STATUS_ERROR;
+            connected = (info->Status & offline) == 0 &&
+                        (info->Attributes & PRINTER_ATTRIBUTE_WORK_OFFLINE) == 0;
+        }
+    }
+    ClosePrinter(hPrinter);
+    return connected;
+}
+
+// =====================================================
+// Aquecimento: abre as impressoras antes do primeiro trabalho
+// =====================================================
+void ThermalPrinterFlutterPlugin::WarmUp(const std::wstring& printerName) {
+    HANDLE hPrinter;
+    if (!OpenPrinter(const_cast<LPWSTR>(printerName.c_str()), &hPrinter, NULL)) {
+        return;
+    }
+    // Ler PRINTER_INFO_2 faz o spooler carregar o driver e, numa impressora
+    // compartilhada, conectar ao servidor dela
+    DWORD needed = 0;
+    GetPrinter(hPrinter, 2, NULL, 0, &needed);
+    if (needed > 0) {
+        std::vector<uint8_t> info(needed);
+        GetPrinter(hPrinter, 2, info.data(), needed, &needed);
+    }
+    KeepPrinter(printerName, hPrinter);
+}
+
+HANDLE ThermalPrinterFlutterPlugin::TakePrinter(const std::wstring& printerName) {
+    std::lock_guard<std::mutex> lock(printers_mutex_);
+    auto it = open_printers_.find(printerName);
+    if (it == open_printers_.end()) {
+        return NULL;
+    }
+    HANDLE printer = it->second;
+    open_printers_.erase(it);
+    return printer;
+}
+
+void ThermalPrinterFlutterPlugin::KeepPrinter(const std::wstring& printerName, HANDLE printer) {
+    std::lock_guard<std::mutex> lock(printers_mutex_);
+    auto inserted = open_printers_.emplace(printerName, printer);
+    if (!inserted.second) {
+        // Já há um aberto para ela
+        ClosePrinter(printer);
+    }
+}
+
+void ThermalPrinterFlutterPlugin::PrintBytes(const uint8_t* data, size_t length, const std::string& printerName) {
     DOC_INFO_1 docInfo = { 0 };
     DWORD bytesWritten;
+    // Nome do documento já em Unicode, sem conversão a cada trabalho
+    static wchar_t docName[] = L"ESC/POS Print Job";
 
-    // Converte o nome da impressora para string wide (Unicode)
-    // Necessário porque o Windows usa strings Unicode internamente
-    int wchars_num = MultiByteToWideChar(CP_UTF8, 0, printerName.c_str(), -1, NULL, 0);
-    wchar_t* wstr = new wchar_t[wchars_num];
-    MultiByteToWideChar(CP_UTF8, 0, printerName.c_str(), -1, wstr, wchars_num);
-
-    // Converte o nome do documento para string wide
-    const char* docName = "ESC/POS Print Job";
-    int doc_wchars_num = MultiByteToWideChar(CP_UTF8, 0, docName, -1, NULL, 0);
-    wchar_t* doc_wstr = new wchar_t[doc_wchars_num];
-    MultiByteToWideChar(CP_UTF8, 0, docName, -1, doc_wstr, doc_wchars_num);
+    if (!SetPrinterName(printerName)) {
+        return;
+    }
 
     // Configura as informações do documento
-    docInfo.pDocName = doc_wstr;
+    docInfo.pDocName = docName;
     docInfo.pOutputFile = NULL;
     docInfo.pDatatype = NULL;
 
-    // Abre a impressora
-    if (OpenPrinter(wstr, &hPrinter, NULL)) {
-        // Inicia o documento
-        if (StartDocPrinter(hPrinter, 1, (LPBYTE)&docInfo)) {
-            // Inicia a página
-            StartPagePrinter(hPrinter);
-            
-            // Escreve os bytes na impressora
-            // Cast explícito necessário para os tipos esperados pela API do Windows
-            WritePrinter(hPrinter, (LPVOID)bytes.data(), (DWORD)bytes.size(), &bytesWritten);
-            
-            // Finaliza a página e o documento
-            EndPagePrinter(hPrinter);
-            EndDocPrinter(hPrinter);
+    // Usa o handle aberto pelo aquecimento ou pelo trabalho anterior
+    HANDLE hPrinter = TakePrinter(printer_name_);
+    bool started = hPrinter != NULL && StartDocPrinter(hPrinter, 1, (LPBYTE)&docInfo);
+    if (!started) {
+        // Sem handle guardado, ou ele deixou de valer (o spooler reiniciou,
+        // por exemplo): abre a impressora
+        if (hPrinter != NULL) {
+            ClosePrinter(hPrinter);
         }
-        // Fecha a impressora
+        if (!OpenPrinter(&printer_name_[0], &hPrinter, NULL)) {
+            return;
+        }
+        started = StartDocPrinter(hPrinter, 1, (LPBYTE)&docInfo) != 0;
+    }
+    if (!started) {
         ClosePrinter(hPrinter);
+        return;
     }
+    // Inicia a página
+    StartPagePrinter(hPrinter);
 
-    // Limpa a memória alocada
-    delete[] wstr;
-    delete[] doc_wstr;
+    // Escreve os bytes na impressora
+    // Cast explícito necessário para os tipos esperados pela API do Windows
+    WritePrinter(hPrinter, (LPVOID)data, (DWORD)length, &bytesWritten);
+
+    // Finaliza a página e o documento
+    EndPagePrinter(hPrinter);
+    EndDocPrinter(hPrinter);
+    // Fica aberta para o próximo trabalho
+    KeepPrinter(printer_name_, hPrinter);
 }
 
 // =====================================================
@@ -162,7 +257,9 @@ void ThermalPrinterFlutterPlugin::HandleMethodCall(
     flutter::EncodableList printerList;
     for (const auto& printer : printers) {
       flutter::EncodableMap printerMap;
-      printerMap[flutter::EncodableValue("name")] = flutter::EncodableValue(printer);
+      printerMap[flutter::EncodableValue("name")] = flutter::EncodableValue(printer.name);
+      // O driver identifica fabricante e modelo, como o ID IEEE 1284 no Linux
+      printerMap[flutter::EncodableValue("model")] = flutter::EncodableValue(printer.driver);
       printerMap[flutter::EncodableValue("type")] = flutter::EncodableValue("usb");
       printerMap[flutter::EncodableValue("isConnected")] = flutter::EncodableValue(true);
       printerList.push_back(flutter::EncodableValue(printerMap));
@@ -177,30 +274,104 @@ void ThermalPrinterFlutterPlugin::HandleMethodCall(
       const auto printer_iter = arguments->find(flutter::EncodableValue("printerName"));
       
       if (bytes_iter != arguments->end() && printer_iter != arguments->end()) {
-        // Converte os argumentos para os tipos corretos
+        // Converte os argumentos para os tipos corretos. Um Uint8List chega
+        // como std::vector<uint8_t> e é impresso sem cópia
+        const auto* bytes_data = std::get_if<std::vector<uint8_t>>(&bytes_iter->second);
         const auto* bytes_list = std::get_if<flutter::EncodableList>(&bytes_iter->second);
         const auto* printer_name = std::get_if<std::string>(&printer_iter->second);
         
+        if (bytes_data && printer_name) {
+          PrintBytes(bytes_data->data(), bytes_data->size(), *printer_name);
+          result->Success(flutter::EncodableValue(true));
+          return;
+        }
         if (bytes_list && printer_name) {
-          // Converte a lista de inteiros para bytes
-          std::vector<uint8_t> bytes;
-          bytes.reserve(bytes_list->size());
+          // Converte a lista de inteiros para bytes, num buffer reaproveitado
+          bytes_.clear();
+          bytes_.reserve(bytes_list->size());
           
           for (size_t i = 0; i < bytes_list->size(); ++i) {
             const auto* int_value = std::get_if<int32_t>(&(*bytes_list)[i]);
             if (int_value) {
-              bytes.push_back(static_cast<uint8_t>(*int_value));
+              bytes_.push_back(static_cast<uint8_t>(*int_value));
             }
           }
           
           // Chama o método de impressão
-          PrintBytes(bytes, *printer_name);
+          PrintBytes(bytes_.data(), bytes_.size(), *printer_name);
           result->Success(flutter::EncodableValue(true));
           return;
         }
       }
     }
     result->Error("invalid_arguments", "Invalid arguments for printBytes");
+  } else if (method_call.method_name().compare("isConnected") == 0) {
+    // Verifica no spooler se a impressora está disponível
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (arguments) {
+      const auto printer_iter = arguments->find(flutter::EncodableValue("printerName"));
+      if (printer_iter != arguments->end()) {
+        const auto* printer_name = std::get_if<std::string>(&printer_iter->second);
+        if (printer_name) {
+          result->Success(flutter::EncodableValue(IsConnected(*printer_name)));
+          return;
+        }
+      }
+    }
+    result->Error("invalid_arguments", "Invalid arguments for isConnected");
+  } else if (method_call.method_name().compare("warmUp") == 0) {
+    // Abre as impressoras em segundo plano e responde na hora com os nomes.
+    // Sem "printers", aquece todas as instaladas
+    const auto* arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const flutter::EncodableList* printers = nullptr;
+    if (arguments) {
+      const auto printers_iter = arguments->find(flutter::EncodableValue("printers"));
+      if (printers_iter != arguments->end()) {
+        printers = std::get_if<flutter::EncodableList>(&printers_iter->second);
+        if (!printers) {
+          result->Error("invalid_arguments", "Invalid arguments for warmUp");
+          return;
+        }
+      }
+    }
+    std::vector<std::string> names;
+    if (printers) {
+      for (const auto& printer : *printers) {
+        const auto* printer_map = std::get_if<flutter::EncodableMap>(&printer);
+        const std::string* name = nullptr;
+        if (printer_map) {
+          const auto name_iter = printer_map->find(flutter::EncodableValue("printerName"));
+          if (name_iter != printer_map->end()) {
+            name = std::get_if<std::string>(&name_iter->second);
+          }
+        }
+        if (!name) {
+          result->Error("invalid_arguments", "Invalid printer in warmUp");
+          return;
+        }
+        names.push_back(*name);
+      }
+    } else {
+      for (const auto& printer : GetPrinters()) {
+        names.push_back(printer.name);
+      }
+    }
+    // Os que já terminaram saem da lista
+    warm_ups_.erase(
+        std::remove_if(warm_ups_.begin(), warm_ups_.end(),
+                       [](const std::future<void>& warm_up) {
+                         return warm_up.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                       }),
+        warm_ups_.end());
+    flutter::EncodableList keys;
+    for (const auto& name : names) {
+      if (SetPrinterName(name)) {
+        warm_ups_.push_back(std::async(std::launch::async,
+                                       [this, printer_name = printer_name_] { WarmUp(printer_name); }));
+      }
+      keys.push_back(flutter::EncodableValue(name));
+    }
+    result->Success(flutter::EncodableValue(keys));
   } else {
     result->NotImplemented();
   }
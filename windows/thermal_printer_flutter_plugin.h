@@ -3,13 +3,25 @@
 
 #include <flutter/method_channel.h>
 #include <flutter/plugin_registrar_windows.h>
+#include <windows.h>
 
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace thermal_printer_flutter {
 
+// Impressora instalada, com o driver que a identifica.
+struct PrinterInfo {
+  std::string name;
+  // Nome do driver (PRINTER_INFO_2::pDriverName), que traz fabricante e
+  // modelo, como "EPSON TM-T20II Receipt5".
+  std::string driver;
+};
+
 class ThermalPrinterFlutterPlugin : public flutter::Plugin {
  public:
   static void RegisterWithRegistrar(flutter::PluginRegistrarWindows *registrar);
@@ -28,8 +40,30 @@ class ThermalPrinterFlutterPlugin : public flutter::Plugin {
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
  private:
-  std::vector<std::string> GetPrinters();
-  void PrintBytes(const std::vector<uint8_t>& bytes, const std::string& printerName);
+  std::vector<PrinterInfo> GetPrinters();
+  void PrintBytes(const uint8_t* data, size_t length, const std::string& printerName);
+  // Se a impressora existe e o spooler não a marca como offline ou com erro.
+  bool IsConnected(const std::string& printerName);
+  // Converte |printerName| para |printer_name_|. Falha se o nome for inválido.
+  bool SetPrinterName(const std::string& printerName);
+  // Abre |printerName| no spooler e lê suas informações, o que o primeiro
+  // trabalho teria de esperar, e guarda o handle para ele. Roda numa
+  // thread de aquecimento.
+  void WarmUp(const std::wstring& printerName);
+  // O handle guardado para |printerName|, retirado da lista, ou NULL.
+  HANDLE TakePrinter(const std::wstring& printerName);
+  // Guarda |printer| aberto para o próximo trabalho em |printerName|.
+  void KeepPrinter(const std::wstring& printerName, HANDLE printer);
+
+  // Reaproveitados entre chamadas, para não alocar a cada trabalho.
+  std::vector<uint8_t> printers_buffer_;
+  std::wstring printer_name_;
+  std::vector<uint8_t> bytes_;
+  // Handles abertos por impressora, usados pelo trabalho seguinte.
+  std::mutex printers_mutex_;
+  std::map<std::wstring, HANDLE> open_printers_;
+  // Aquecimentos em andamento, um por impressora.
+  std::vector<std::future<void>> warm_ups_;
 };
 
 }  // namespace thermal_printer_flutter